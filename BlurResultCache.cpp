@@ -0,0 +1,130 @@
+#include "BlurResultCache.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "GaussianKernel.h"
+
+namespace {
+
+inline uint64_t Mix(uint64_t h, uint64_t v) {
+    h ^= v * 0x9E3779B97F4A7C15ull;
+    h = (h << 27) | (h >> 37);
+    return h * 0xBF58476D1CE4E5B9ull + 0x94D049BB133111EBull;
+}
+
+} // namespace
+
+int32_t QuantizeCacheSigma(float sigma) {
+    return sigma > 0.0f ? (int32_t)std::lround(sigma / kCacheSigmaStep) : 0;
+}
+
+float CacheSigma(int32_t sigmaSteps) {
+    return sigmaSteps * kCacheSigmaStep;
+}
+
+uint64_t HashCpuImage(const CpuImage& image) {
+    // Four independent lanes keep the multiplies from serializing
+    uint64_t lanes[4] = { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull };
+    const uint8_t* data = image.pixels.data();
+    size_t size = image.pixels.size();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t v;
+            memcpy(&v, data + i + l * 8, 8);
+            lanes[l] = Mix(lanes[l], v);
+        }
+    }
+    uint64_t h = Mix(Mix(lanes[0], lanes[1]), Mix(lanes[2], lanes[3]));
+    for (; i < size; i++) h = Mix(h, data[i]);
+    return Mix(h, ((uint64_t)image.width << 32) | image.height);
+}
+
+BlurResultCache::BlurResultCache(size_t budgetBytes) {
+    m_stats.budgetBytes = budgetBytes;
+}
+
+size_t BlurResultCache::KeyHash::operator()(const BlurCacheKey& key) const {
+    uint64_t h = Mix(key.sourceHash, (uint64_t)(uint32_t)key.sigmaSteps);
+    h = Mix(h, ((uint64_t)key.engine << 8) | (uint64_t)key.edgeMode);
+    return (size_t)h;
+}
+
+std::shared_ptr<const CpuImage> BlurResultCache::Find(const BlurCacheKey& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        m_stats.misses++;
+        return nullptr;
+    }
+    m_stats.hits++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->image;
+}
+
+void BlurResultCache::Insert(const BlurCacheKey& key, std::shared_ptr<const CpuImage> image) {
+    if (!image) return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_stats.bytes -= it->second->image->pixels.size();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+    if (image->pixels.size() > m_stats.budgetBytes) return;
+
+    m_stats.bytes += image->pixels.size();
+    m_lru.push_front(Entry{ key, std::move(image) });
+    m_index[key] = m_lru.begin();
+    m_stats.insertions++;
+    EvictToBudget();
+}
+
+void BlurResultCache::SetBudget(size_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.budgetBytes = budgetBytes;
+    EvictToBudget();
+}
+
+void BlurResultCache::Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+    m_stats.bytes = 0;
+}
+
+BlurResultCache::Stats BlurResultCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.entries = m_lru.size();
+    return stats;
+}
+
+void BlurResultCache::EvictToBudget() {
+    // Results handed out earlier stay alive through their shared_ptr
+    while (m_stats.bytes > m_stats.budgetBytes && !m_lru.empty()) {
+        Entry& oldest = m_lru.back();
+        m_stats.bytes -= oldest.image->pixels.size();
+        m_index.erase(oldest.key);
+        m_lru.pop_back();
+        m_stats.evictions++;
+    }
+}
+
+std::shared_ptr<const CpuImage> CpuBlurImageCached(BlurResultCache& cache, const CpuImage& src,
+    uint64_t sourceHash, float blurRadius, CpuBlurEngine engine, ThreadPool& pool)
+{
+    BlurCacheKey key;
+    key.sourceHash = sourceHash;
+    key.sigmaSteps = QuantizeCacheSigma(SigmaFromBlurRadius(blurRadius));
+    key.engine = engine;
+    key.edgeMode = BlurEdgeMode::Clamp;
+    if (auto cached = cache.Find(key)) return cached;
+
+    // Blur at the quantized sigma (the inverse of SigmaFromBlurRadius)
+    auto result = std::make_shared<CpuImage>();
+    CpuBlurImage(src, *result, 2.0f * CacheSigma(key.sigmaSteps), engine, pool);
+    cache.Insert(key, result);
+    return result;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "CpuBlurEngine.h"
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Blurred results kept for reuse, so scrubbing the slider back to a radius it
+// has already shown (or blurring the same image twice in a batch) costs a
+// lookup instead of a blur. Entries are evicted least recently used first
+// once their pixels exceed the byte budget. Safe to use from several threads.
+
+// How a blur treats pixels past the image edge. Every engine clamps today;
+// the key carries it so that adding a mode can't serve stale results.
+enum class BlurEdgeMode : uint8_t {
+    Clamp,
+};
+
+struct BlurCacheKey {
+    uint64_t sourceHash = 0; // HashCpuImage of the source
+    int32_t sigmaSteps = 0;  // QuantizeCacheSigma
+    CpuBlurEngine engine = CpuBlurEngine::Direct;
+    BlurEdgeMode edgeMode = BlurEdgeMode::Clamp;
+
+    bool operator==(const BlurCacheKey& other) const {
+        return sourceHash == other.sourceHash && sigmaSteps == other.sigmaSteps && engine == other.engine &&
+            edgeMode == other.edgeMode;
+    }
+};
+
+// Sigma is keyed in 1/1024 pixel steps. Blurs served through CpuBlurImageCached
+// run at the quantized sigma, so a cached result is exactly what a fresh blur
+// with the same key would produce.
+constexpr float kCacheSigmaStep = 1.0f / 1024.0f;
+int32_t QuantizeCacheSigma(float sigma);
+float CacheSigma(int32_t sigmaSteps);
+
+// Content hash of the pixels and size. Reads the whole image once, so callers
+// hash a source when it is loaded and keep the value.
+uint64_t HashCpuImage(const CpuImage& image);
+
+class BlurResultCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0; // pixel bytes held
+        size_t budgetBytes = 0;
+    };
+
+    explicit BlurResultCache(size_t budgetBytes);
+
+    BlurResultCache(const BlurResultCache&) = delete;
+    BlurResultCache& operator=(const BlurResultCache&) = delete;
+
+    // The cached result, now the most recently used, or nullptr (a miss).
+    std::shared_ptr<const CpuImage> Find(const BlurCacheKey& key);
+
+    // Adds or replaces the result for key, then evicts down to the budget.
+    // A result larger than the whole budget is not kept.
+    void Insert(const BlurCacheKey& key, std::shared_ptr<const CpuImage> image);
+
+    // Shrinking the budget evicts right away.
+    void SetBudget(size_t budgetBytes);
+    void Clear();
+    Stats GetStats() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const BlurCacheKey& key) const;
+    };
+    struct Entry {
+        BlurCacheKey key;
+        std::shared_ptr<const CpuImage> image;
+    };
+
+    void EvictToBudget();
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_lru; // most recently used first
+    std::unordered_map<BlurCacheKey, std::list<Entry>::iterator, KeyHash> m_index;
+    Stats m_stats;
+};
+
+// CpuBlurImage through the cache: returns the cached result for
+// (sourceHash, blurRadius, engine), or blurs src and caches it.
+std::shared_ptr<const CpuImage> CpuBlurImageCached(BlurResultCache& cache, const CpuImage& src,
+    uint64_t sourceHash, float blurRadius, CpuBlurEngine engine, ThreadPool& pool);
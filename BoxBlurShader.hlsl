@@ -0,0 +1,59 @@
+// Running-sum box filter for the "Box cascade" blur mode. ApplyBoxCascadeBlur
+// dispatches one pass per box of BuildBoxCascade, first along rows and then
+// along columns. Each thread walks a whole line, adding the texel entering
+// the window and subtracting the one leaving it, so the cost per pixel does
+// not depend on the radius.
+
+Texture2D inputTexture : register(t0);
+SamplerState inputSampler : register(s0);
+RWTexture2D<float4> outputTexture : register(u0);
+
+cbuffer BoxBlurSettings : register(b0)
+{
+    uint2 size;        // output size in texels
+    float2 texelSize;  // (1 / width, 1 / height)
+    int boxRadius;     // the box averages 2 * boxRadius + 1 texels
+};
+
+// Texel p of the output grid with clamp addressing. Sampling at the texel
+// center lets the first pass read the source image at any size, like the
+// pixel shader passes do.
+float4 Fetch(int2 p)
+{
+    p = clamp(p, int2(0, 0), int2(size) - 1);
+    return inputTexture.SampleLevel(inputSampler, (float2(p) + 0.5) * texelSize, 0);
+}
+
+void BoxLine(int2 start, int2 step, int length)
+{
+    int last = length - 1;
+    float4 sum = Fetch(start) * boxRadius;
+    for (int i = 0; i <= boxRadius; i++)
+    {
+        sum += Fetch(start + step * min(i, last));
+    }
+
+    float scale = 1.0 / (2 * boxRadius + 1);
+    for (int x = 0; x < length; x++)
+    {
+        outputTexture[start + step * x] = sum * scale;
+        sum += Fetch(start + step * min(x + boxRadius + 1, last));
+        sum -= Fetch(start + step * max(x - boxRadius, 0));
+    }
+}
+
+// One thread per row
+[numthreads(64, 1, 1)]
+void CSBoxHorizontal(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= size.y) return;
+    BoxLine(int2(0, id.x), int2(1, 0), int(size.x));
+}
+
+// One thread per column
+[numthreads(64, 1, 1)]
+void CSBoxVertical(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= size.x) return;
+    BoxLine(int2(id.x, 0), int2(0, 1), int(size.y));
+}
@@ -0,0 +1,205 @@
+#include "CpuBlur.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+
+namespace {
+
+template <int Channels, typename Sample>
+constexpr CpuBlurRowKernels FormatKernels() {
+    return {
+        CpuIsa::Scalar, HorizontalRowFormat<Channels, Sample, kRuntimeRadius>, VerticalRowFormat<Sample, kRuntimeRadius>,
+        RTBLUR_FIXED_RADIUS_KERNELS(HorizontalRowCopy<Channels * sizeof(typename Sample::Storage)>,
+            HorizontalRowFormat, Channels, Sample, ),
+        RTBLUR_FIXED_RADIUS_KERNELS(VerticalRowCopy<sizeof(typename Sample::Storage)>, VerticalRowFormat, Sample, ),
+    };
+}
+
+// Indexed by CpuSampleType, then channels 1, 2, 4. [U8][4 channels] doubles
+// as the scalar RGBA8 kernels.
+const CpuBlurRowKernels g_cpuBlurFormatKernels[4][3] = {
+    { FormatKernels<1, SampleU8>(), FormatKernels<2, SampleU8>(), FormatKernels<4, SampleU8>() },
+    { FormatKernels<1, SampleU16>(), FormatKernels<2, SampleU16>(), FormatKernels<4, SampleU16>() },
+    { FormatKernels<1, SampleF16>(), FormatKernels<2, SampleF16>(), FormatKernels<4, SampleF16>() },
+    { FormatKernels<1, SampleF32>(), FormatKernels<2, SampleF32>(), FormatKernels<4, SampleF32>() },
+};
+
+void TransposePixelsGeneric(const uint8_t* const* rows, uint32_t rowCount, uint32_t x0, uint32_t columns,
+    uint8_t* dst, size_t dstPitch)
+{
+    TransposePixelsScalar(rows, 0, rowCount, x0, 0, columns, dst, dstPitch);
+}
+
+std::atomic<int> g_cpuBlurIsa{ -1 };
+std::atomic<bool> g_cpuBlurSpecialization{ true };
+
+} // namespace
+
+const CpuBlurRowKernels& GetCpuBlurRowKernels(CpuIsa isa) {
+    CpuIsa best = DetectCpuIsa();
+    if (isa > best) isa = best;
+#if RTBLUR_HAS_X86_KERNELS
+    switch (isa) {
+    case CpuIsa::Avx512: return g_cpuBlurKernelsAvx512;
+    case CpuIsa::Avx2: return g_cpuBlurKernelsAvx2;
+    case CpuIsa::Sse41: return g_cpuBlurKernelsSse41;
+    default: break;
+    }
+#endif
+    return g_cpuBlurFormatKernels[(int)CpuSampleType::U8][2];
+}
+
+const CpuBlurRowKernels& GetCpuBlurRowKernels(CpuIsa isa, int channels, CpuSampleType type) {
+    if (channels == 4 && type == CpuSampleType::U8) return GetCpuBlurRowKernels(isa);
+    int channelIndex = channels == 1 ? 0 : channels == 2 ? 1 : 2;
+    return g_cpuBlurFormatKernels[(int)type][channelIndex];
+}
+
+HorizontalRowKernel SelectHorizontalRowKernel(const CpuBlurRowKernels& kernels, int radius) {
+    bool fixed = radius <= kMaxFixedKernelRadius && g_cpuBlurSpecialization.load(std::memory_order_relaxed);
+    return fixed ? kernels.fixedHorizontal[radius] : kernels.horizontal;
+}
+
+VerticalRowKernel SelectVerticalRowKernel(const CpuBlurRowKernels& kernels, int radius) {
+    bool fixed = radius <= kMaxFixedKernelRadius && g_cpuBlurSpecialization.load(std::memory_order_relaxed);
+    return fixed ? kernels.fixedVertical[radius] : kernels.vertical;
+}
+
+void SetCpuBlurKernelSpecialization(bool enabled) {
+    g_cpuBlurSpecialization = enabled;
+}
+
+bool GetCpuBlurKernelSpecialization() {
+    return g_cpuBlurSpecialization.load();
+}
+
+TransposePixelsKernel GetCpuTransposePixelsKernel(CpuIsa isa) {
+    CpuIsa best = DetectCpuIsa();
+    if (isa > best) isa = best;
+#if RTBLUR_HAS_X86_KERNELS
+    switch (isa) {
+    case CpuIsa::Avx512:
+    case CpuIsa::Avx2: return g_cpuTransposePixelsAvx2;
+    case CpuIsa::Sse41: return g_cpuTransposePixelsSse41;
+    default: break;
+    }
+#endif
+    return TransposePixelsGeneric;
+}
+
+CpuIsa GetCpuBlurIsa() {
+    int isa = g_cpuBlurIsa.load();
+    return isa < 0 ? DetectCpuIsa() : (CpuIsa)isa;
+}
+
+void SetCpuBlurIsa(CpuIsa isa) {
+    g_cpuBlurIsa = (int)GetCpuBlurRowKernels(isa).isa;
+}
+
+bool CpuBlurIsCopy(const GaussianKernel& kernel) {
+    return kernel.radius == 0 && GetCpuBlurKernelSpecialization();
+}
+
+void CpuBlurHorizontalRows(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1)
+{
+    int radius = kernel.radius;
+    HorizontalRowKernel horizontal = SelectHorizontalRowKernel(GetCpuBlurRowKernels(GetCpuBlurIsa()), radius);
+    uint32_t width = src.width;
+
+    // Row with its edge pixels repeated, so the kernels never branch on bounds
+    thread_local std::vector<uint8_t> padded;
+    padded.resize(((size_t)width + 2 * radius) * 4);
+
+    for (uint32_t y = y0; y < y1; y++) {
+        const uint8_t* row = src.Row(y);
+        uint8_t* left = padded.data();
+        uint8_t* right = padded.data() + ((size_t)radius + width) * 4;
+        for (int i = 0; i < radius; i++) {
+            memcpy(left + i * 4, row, 4);
+            memcpy(right + i * 4, row + (width - 1) * 4, 4);
+        }
+        memcpy(padded.data() + radius * 4, row, src.RowPitch());
+        horizontal(padded.data(), dst.Row(y), width, kernel.weights.data(), radius);
+    }
+}
+
+void CpuBlurVerticalRows(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1)
+{
+    int radius = kernel.radius;
+    VerticalRowKernel vertical = SelectVerticalRowKernel(GetCpuBlurRowKernels(GetCpuBlurIsa()), radius);
+    int lastRow = (int)src.height - 1;
+    size_t byteOffset = (size_t)x0 * 4;
+    size_t count = (size_t)(x1 - x0) * 4;
+
+    thread_local std::vector<const uint8_t*> rows;
+    rows.resize(2 * radius + 1);
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (int i = -radius; i <= radius; i++) {
+            int sy = std::min(std::max((int)y + i, 0), lastRow);
+            rows[i + radius] = src.Row(sy) + byteOffset;
+        }
+        vertical(rows.data(), dst.Row(y) + byteOffset, count, kernel.weights.data(), radius);
+    }
+}
+
+void CpuBlurVerticalRowsTransposed(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1)
+{
+    int radius = kernel.radius;
+    CpuIsa isa = GetCpuBlurIsa();
+    HorizontalRowKernel horizontal = SelectHorizontalRowKernel(GetCpuBlurRowKernels(isa), radius);
+    TransposePixelsKernel transpose = GetCpuTransposePixelsKernel(isa);
+    int lastRow = (int)src.height - 1;
+    uint32_t outputRows = y1 - y0;
+    uint32_t paddedRows = outputRows + 2 * radius;
+    size_t paddedPitch = (size_t)paddedRows * 4;
+    size_t outputPitch = (size_t)outputRows * 4;
+
+    // The rows the range taps, clamped, so the transposed columns come out
+    // padded the way CpuBlurHorizontalRows pads a row
+    thread_local std::vector<const uint8_t*> rows;
+    thread_local std::vector<uint8_t> columns;
+    thread_local std::vector<uint8_t> blurred;
+    rows.resize(paddedRows);
+    columns.resize(kCpuBlurTransposeColumns * paddedPitch);
+    blurred.resize(kCpuBlurTransposeColumns * outputPitch);
+    for (uint32_t i = 0; i < paddedRows; i++) {
+        int sy = std::min(std::max((int)(y0 + i) - radius, 0), lastRow);
+        rows[i] = src.Row(sy);
+    }
+    const uint8_t* blurredRows[kCpuBlurTransposeColumns];
+    for (uint32_t c = 0; c < kCpuBlurTransposeColumns; c++) blurredRows[c] = blurred.data() + c * outputPitch;
+
+    for (uint32_t x = x0; x < x1; x += kCpuBlurTransposeColumns) {
+        uint32_t count = std::min(kCpuBlurTransposeColumns, x1 - x);
+        transpose(rows.data(), paddedRows, x, count, columns.data(), paddedPitch);
+        for (uint32_t c = 0; c < count; c++) {
+            horizontal(columns.data() + c * paddedPitch, blurred.data() + c * outputPitch, outputRows,
+                kernel.weights.data(), radius);
+        }
+        transpose(blurredRows, count, 0, outputRows, dst.Row(y0) + (size_t)x * 4, dst.RowPitch());
+    }
+}
+
+void CpuGaussianBlur(const CpuImage& src, CpuImage& dst, float blurRadius) {
+    if (src.Empty()) return;
+
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+    if (CpuBlurIsCopy(*kernel)) {
+        if (&dst != &src) dst = src;
+        return;
+    }
+
+    CpuImage temp(src.width, src.height);
+    CpuBlurHorizontalRows(src, temp, *kernel, 0, src.height);
+
+    if (dst.width != src.width || dst.height != src.height) dst = CpuImage(src.width, src.height);
+    CpuBlurVerticalRows(temp, dst, *kernel, 0, src.height, 0, src.width);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuFeatures.h"
+#include "CpuImage.h"
+#include "GaussianKernel.h"
+
+// CPU implementation of the two passes in GaussianBlurShader.hlsl, used when
+// there is no usable D3D11 adapter. Same kernel table, same tap order, same
+// clamp addressing, and the intermediate is stored as 8-bit like g_tempTexture.
+// Every instruction set produces bit-identical output.
+
+// Instruction set the row kernels run with. Defaults to DetectCpuIsa(); setting
+// one the CPU lacks falls back to the best supported one below it.
+CpuIsa GetCpuBlurIsa();
+void SetCpuBlurIsa(CpuIsa isa);
+
+// A radius-0 kernel leaves every pixel as it is, so the blur is a copy of the
+// source. False while SetCpuBlurKernelSpecialization(false) benchmarks the
+// generic path.
+bool CpuBlurIsCopy(const GaussianKernel& kernel);
+
+// Blurs src into dst (resized as needed). src and dst may be the same image.
+void CpuGaussianBlur(const CpuImage& src, CpuImage& dst, float blurRadius);
+
+// The passes over a sub-range, for callers that split the work themselves.
+// dst must already have src's size.
+void CpuBlurHorizontalRows(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1);
+void CpuBlurVerticalRows(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1);
+
+// The vertical pass by transposing: every kCpuBlurTransposeColumns columns of
+// the range (with the rows they tap) are transposed into rows, blurred with the
+// horizontal kernel and transposed back into dst. Both kernels sum the same
+// taps in the same order, so the output equals CpuBlurVerticalRows'.
+constexpr uint32_t kCpuBlurTransposeColumns = 32;
+
+void CpuBlurVerticalRowsTransposed(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel,
+    uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1);
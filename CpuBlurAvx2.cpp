@@ -0,0 +1,343 @@
+#include "CpuBlurKernels.h"
+
+#if RTBLUR_HAS_X86_KERNELS
+
+#include <immintrin.h>
+
+// One __m256 holds two RGBA pixels as floats; each loop iteration blurs eight
+// pixels (32 bytes) with four independent accumulators. Deliberately no FMA:
+// a fused multiply-add would round differently from the scalar reference.
+
+namespace {
+
+RTBLUR_TARGET("avx2")
+inline __m256 Load8BytesAsFloats(const uint8_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+RTBLUR_TARGET("avx2")
+inline void Store32(uint8_t* dst, __m256 a, __m256 b, __m256 c, __m256 d) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256i ia = _mm256_cvttps_epi32(_mm256_add_ps(a, half));
+    __m256i ib = _mm256_cvttps_epi32(_mm256_add_ps(b, half));
+    __m256i ic = _mm256_cvttps_epi32(_mm256_add_ps(c, half));
+    __m256i id = _mm256_cvttps_epi32(_mm256_add_ps(d, half));
+    // The packs work per 128-bit lane, which leaves the 4-byte groups in
+    // a0 b0 c0 d0 a1 b1 c1 d1 order
+    __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(ia, ib), _mm256_packus_epi32(ic, id));
+    packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256((__m256i*)dst, packed);
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("avx2")
+void HorizontalRowAvx2(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m256 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm256_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        const uint8_t* src = paddedSrc + x * 4;
+        for (int i = -radius; i <= radius; i++) {
+            __m256 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm256_set1_ps(weights[i < 0 ? -i : i]);
+            const uint8_t* p = src + (radius + i) * 4;
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, Load8BytesAsFloats(p + 0)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, Load8BytesAsFloats(p + 8)));
+            acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(w, Load8BytesAsFloats(p + 16)));
+            acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(w, Load8BytesAsFloats(p + 24)));
+        }
+        Store32(dst + x * 4, acc0, acc1, acc2, acc3);
+    }
+    HorizontalRowScalar(paddedSrc, dst, x, width, weights, radius);
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("avx2")
+void VerticalRowAvx2(const uint8_t* const* rows, uint8_t* dst, size_t count,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m256 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm256_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        for (int i = -radius; i <= radius; i++) {
+            __m256 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm256_set1_ps(weights[i < 0 ? -i : i]);
+            const uint8_t* p = rows[i + radius] + k;
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, Load8BytesAsFloats(p + 0)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, Load8BytesAsFloats(p + 8)));
+            acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(w, Load8BytesAsFloats(p + 16)));
+            acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(w, Load8BytesAsFloats(p + 24)));
+        }
+        Store32(dst + k, acc0, acc1, acc2, acc3);
+    }
+    VerticalRowScalar(rows, dst, k, count, weights, radius);
+}
+
+// Fixed-point kernels: samples widen to 16-bit lanes and _mm256_madd_epi16
+// multiplies two taps and adds them into 32-bit sums in one instruction.
+// 16-bit samples are biased by -32768 to fit the signed lanes; the weights
+// sum to 1 << 15, so adding 32768 back after the shift undoes it exactly.
+template <typename T>
+RTBLUR_TARGET("avx2")
+inline __m256i LoadFixedPointSamples(const uint8_t* p);
+
+template <>
+RTBLUR_TARGET("avx2")
+inline __m256i LoadFixedPointSamples<uint8_t>(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+template <>
+RTBLUR_TARGET("avx2")
+inline __m256i LoadFixedPointSamples<uint16_t>(const uint8_t* p) {
+    return _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi16((short)0x8000));
+}
+
+// lo/hi hold samples 0-3 and 4-7 of each 128-bit lane, as the unpacks left them
+template <typename T>
+RTBLUR_TARGET("avx2")
+inline void StoreFixedPointSamples(uint8_t* dst, __m256i lo, __m256i hi) {
+    const __m256i half = _mm256_set1_epi32(1 << (kFixedPointWeightBits - 1));
+    lo = _mm256_srai_epi32(_mm256_add_epi32(lo, half), kFixedPointWeightBits);
+    hi = _mm256_srai_epi32(_mm256_add_epi32(hi, half), kFixedPointWeightBits);
+    if (sizeof(T) == 1) {
+        __m256i words = _mm256_packs_epi32(lo, hi);
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(bytes));
+    }
+    else {
+        const __m256i bias = _mm256_set1_epi32(32768);
+        __m256i words = _mm256_packus_epi32(_mm256_add_epi32(lo, bias), _mm256_add_epi32(hi, bias));
+        _mm256_storeu_si256((__m256i*)dst, words);
+    }
+}
+
+template <typename T>
+RTBLUR_TARGET("avx2")
+inline void AccumulateFixedPointPair(__m256i& lo, __m256i& hi, __m256i a, __m256i b, __m256i weights) {
+    lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights));
+    hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights));
+}
+
+template <typename T>
+RTBLUR_TARGET("avx2")
+void VerticalRowFixedPointAvx2(const uint8_t* const* taps, uint8_t* dst, size_t count,
+    const int16_t* weights, int radius)
+{
+    // Taps go in pairs (2p, 2p + 1) with both weights in each 32-bit lane;
+    // the odd one out, tap 2 * radius, is paired with zeros
+    __m256i pairWeights[kMaxKernelRadius + 1];
+    for (int p = 0; p < radius; p++) {
+        int i = 2 * p - radius;
+        int32_t w0 = (uint16_t)weights[i < 0 ? -i : i];
+        int32_t w1 = (uint16_t)weights[i + 1 < 0 ? -(i + 1) : i + 1];
+        pairWeights[p] = _mm256_set1_epi32(w0 | (w1 << 16));
+    }
+    pairWeights[radius] = _mm256_set1_epi32((uint16_t)weights[radius]);
+    const uint8_t* lastTap = taps[2 * radius];
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        size_t offset = k * sizeof(T);
+        size_t offset2 = offset + 16 * sizeof(T);
+        __m256i lo = zero, hi = zero, lo2 = zero, hi2 = zero;
+        for (int p = 0; p < radius; p++) {
+            const uint8_t* a = taps[2 * p];
+            const uint8_t* b = taps[2 * p + 1];
+            AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(a + offset),
+                LoadFixedPointSamples<T>(b + offset), pairWeights[p]);
+            AccumulateFixedPointPair<T>(lo2, hi2, LoadFixedPointSamples<T>(a + offset2),
+                LoadFixedPointSamples<T>(b + offset2), pairWeights[p]);
+        }
+        AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(lastTap + offset), zero, pairWeights[radius]);
+        AccumulateFixedPointPair<T>(lo2, hi2, LoadFixedPointSamples<T>(lastTap + offset2), zero, pairWeights[radius]);
+        StoreFixedPointSamples<T>(dst + offset, lo, hi);
+        StoreFixedPointSamples<T>(dst + offset2, lo2, hi2);
+    }
+    for (; k + 16 <= count; k += 16) {
+        size_t offset = k * sizeof(T);
+        __m256i lo = zero, hi = zero;
+        for (int p = 0; p < radius; p++) {
+            AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(taps[2 * p] + offset),
+                LoadFixedPointSamples<T>(taps[2 * p + 1] + offset), pairWeights[p]);
+        }
+        AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(lastTap + offset), zero, pairWeights[radius]);
+        StoreFixedPointSamples<T>(dst + offset, lo, hi);
+    }
+    VerticalRowFixedPointScalar<T>(taps, dst, k, count, weights, radius);
+}
+
+// Half-float kernels for the linear-light engine, with F16C conversions that
+// round to nearest even like FloatToHalf
+RTBLUR_TARGET("avx2,f16c")
+inline __m256 Load8Halves(const uint16_t* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p));
+}
+
+RTBLUR_TARGET("avx2,f16c")
+inline void Store8Halves(uint16_t* p, __m256 v) {
+    _mm_storeu_si128((__m128i*)p, _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+
+RTBLUR_TARGET("avx2,f16c")
+void HorizontalRowHalfAvx2(const float* paddedSrc, uint16_t* dst, uint32_t width, const float* weights, int radius) {
+    size_t count = (size_t)width * 4;
+    __m256 tapWeights[kMaxKernelTaps];
+    for (int i = -radius; i <= radius; i++) tapWeights[i + radius] = _mm256_set1_ps(weights[i < 0 ? -i : i]);
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        for (int i = -radius; i <= radius; i++) {
+            __m256 w = tapWeights[i + radius];
+            const float* p = paddedSrc + k + (size_t)(radius + i) * 4;
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, _mm256_loadu_ps(p + 0)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, _mm256_loadu_ps(p + 8)));
+            acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(w, _mm256_loadu_ps(p + 16)));
+            acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(w, _mm256_loadu_ps(p + 24)));
+        }
+        Store8Halves(dst + k + 0, acc0);
+        Store8Halves(dst + k + 8, acc1);
+        Store8Halves(dst + k + 16, acc2);
+        Store8Halves(dst + k + 24, acc3);
+    }
+    HorizontalRowHalfScalar(paddedSrc, dst, k, count, weights, radius);
+}
+
+RTBLUR_TARGET("avx2,f16c")
+void VerticalRowHalfAvx2(const uint16_t* const* rows, uint16_t* dst, size_t count, const float* weights, int radius) {
+    __m256 tapWeights[kMaxKernelTaps];
+    for (int i = -radius; i <= radius; i++) tapWeights[i + radius] = _mm256_set1_ps(weights[i < 0 ? -i : i]);
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+        for (int i = -radius; i <= radius; i++) {
+            __m256 w = tapWeights[i + radius];
+            const uint16_t* p = rows[i + radius] + k;
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(w, Load8Halves(p + 0)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(w, Load8Halves(p + 8)));
+            acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(w, Load8Halves(p + 16)));
+            acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(w, Load8Halves(p + 24)));
+        }
+        Store8Halves(dst + k + 0, acc0);
+        Store8Halves(dst + k + 8, acc1);
+        Store8Halves(dst + k + 16, acc2);
+        Store8Halves(dst + k + 24, acc3);
+    }
+    VerticalRowHalfScalar(rows, dst, k, count, weights, radius);
+}
+
+RTBLUR_TARGET("avx2,f16c")
+void HalfToFloatRowAvx2(const uint16_t* src, float* dst, size_t count) {
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) _mm256_storeu_ps(dst + k, Load8Halves(src + k));
+    for (; k < count; k++) dst[k] = HalfToFloat(src[k]);
+}
+
+// Eight samples (two pixels) per gather, alpha offset into the table's second half
+RTBLUR_TARGET("avx2")
+void DecodeRowTableAvx2(const uint8_t* src, float* dst, size_t count, const float* table) {
+    const __m256i alpha = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256i index = _mm256_add_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + k))), alpha);
+        _mm256_storeu_ps(dst + k, _mm256_i32gather_ps(table, index, 4));
+    }
+    DecodeRowTableScalar(src, dst, k, count, table);
+}
+
+// Gathers 4 bytes at each entry and keeps the low one, which the table's
+// padding makes safe at its last entry
+RTBLUR_TARGET("avx2")
+void EncodeRowTableAvx2(const uint16_t* src, uint8_t* dst, size_t count, const uint8_t* table) {
+    const __m256i alpha = _mm256_setr_epi32(0, 0, 0, kHalfOne + 1, 0, 0, 0, kHalfOne + 1);
+    const __m256i one = _mm256_set1_epi32(kHalfOne);
+    const __m256i low = _mm256_set1_epi32(0xFF);
+    const int* bytes = reinterpret_cast<const int*>(table);
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + k)));
+        __m256i b = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + k + 8)));
+        a = _mm256_and_si256(_mm256_i32gather_epi32(bytes, _mm256_add_epi32(_mm256_min_epu32(a, one), alpha), 1), low);
+        b = _mm256_and_si256(_mm256_i32gather_epi32(bytes, _mm256_add_epi32(_mm256_min_epu32(b, one), alpha), 1), low);
+        // packus works per 128-bit lane; the permute restores a0..a7 b0..b7
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128((__m128i*)(dst + k), packed);
+    }
+    EncodeRowTableScalar(src, dst, k, count, table);
+}
+
+// Eight rows of eight pixels per block: the 4x4 transpose of the SSE4.1
+// kernel in each 128-bit lane, then the lanes swapped into place.
+RTBLUR_TARGET("avx2")
+void TransposePixelsAvx2(const uint8_t* const* rows, uint32_t rowCount, uint32_t x0, uint32_t columns,
+    uint8_t* dst, size_t dstPitch)
+{
+    uint32_t blockRows = rowCount & ~7u;
+    uint32_t blockColumns = columns & ~7u;
+    for (uint32_t r = 0; r < blockRows; r += 8) {
+        for (uint32_t c = 0; c < blockColumns; c += 8) {
+            size_t offset = (size_t)(x0 + c) * 4;
+            __m256i in[8], pairs[8], quads[8];
+            for (int i = 0; i < 8; i++) in[i] = _mm256_loadu_si256((const __m256i*)(rows[r + i] + offset));
+            for (int i = 0; i < 8; i += 2) {
+                pairs[i] = _mm256_unpacklo_epi32(in[i], in[i + 1]);     // 0 0 1 1 | 4 4 5 5
+                pairs[i + 1] = _mm256_unpackhi_epi32(in[i], in[i + 1]); // 2 2 3 3 | 6 6 7 7
+            }
+            for (int i = 0; i < 8; i += 4) {
+                quads[i + 0] = _mm256_unpacklo_epi64(pairs[i], pairs[i + 2]);     // column 0 | 4
+                quads[i + 1] = _mm256_unpackhi_epi64(pairs[i], pairs[i + 2]);     // column 1 | 5
+                quads[i + 2] = _mm256_unpacklo_epi64(pairs[i + 1], pairs[i + 3]); // column 2 | 6
+                quads[i + 3] = _mm256_unpackhi_epi64(pairs[i + 1], pairs[i + 3]); // column 3 | 7
+            }
+            uint8_t* out = dst + c * dstPitch + (size_t)r * 4;
+            for (int i = 0; i < 4; i++) {
+                _mm256_storeu_si256((__m256i*)(out + i * dstPitch), _mm256_permute2x128_si256(quads[i], quads[i + 4], 0x20));
+                _mm256_storeu_si256((__m256i*)(out + (i + 4) * dstPitch), _mm256_permute2x128_si256(quads[i], quads[i + 4], 0x31));
+            }
+        }
+        TransposePixelsScalar(rows, r, r + 8, x0, blockColumns, columns, dst, dstPitch);
+    }
+    TransposePixelsScalar(rows, blockRows, rowCount, x0, 0, columns, dst, dstPitch);
+}
+
+} // namespace
+
+const TransposePixelsKernel g_cpuTransposePixelsAvx2 = TransposePixelsAvx2;
+
+const CpuHalfRowKernels g_cpuHalfKernelsAvx2 = {
+    CpuIsa::Avx2, HorizontalRowHalfAvx2, VerticalRowHalfAvx2, HalfToFloatRowAvx2, DecodeRowTableAvx2,
+    EncodeRowTableAvx2,
+};
+
+const CpuFixedPointRowKernels g_cpuFixedPointKernelsAvx2 = {
+    CpuIsa::Avx2,
+    HorizontalRowFixedPoint<uint8_t, VerticalRowFixedPointAvx2<uint8_t>>, VerticalRowFixedPointAvx2<uint8_t>,
+    HorizontalRowFixedPoint<uint16_t, VerticalRowFixedPointAvx2<uint16_t>>, VerticalRowFixedPointAvx2<uint16_t>,
+};
+
+const CpuBlurRowKernels g_cpuBlurKernelsAvx2 = {
+    CpuIsa::Avx2, HorizontalRowAvx2<kRuntimeRadius>, VerticalRowAvx2<kRuntimeRadius>,
+    RTBLUR_FIXED_RADIUS_KERNELS(HorizontalRowCopy<4>, HorizontalRowAvx2, ),
+    RTBLUR_FIXED_RADIUS_KERNELS(VerticalRowCopy<1>, VerticalRowAvx2, ),
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "CpuBlurKernels.h"
+
+#if RTBLUR_HAS_X86_KERNELS
+
+#include <immintrin.h>
+
+// AVX-512F implies FMA, and GCC would otherwise fuse the multiply and add
+// below, breaking bit-exactness with the other variants.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// One __m512 holds four RGBA pixels as floats; each loop iteration blurs
+// sixteen pixels (64 bytes) with four independent accumulators.
+
+namespace {
+
+RTBLUR_TARGET("avx512f")
+inline __m512 Load16BytesAsFloats(const uint8_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+
+RTBLUR_TARGET("avx512f")
+inline void Store16(uint8_t* dst, __m512 acc) {
+    __m512i rounded = _mm512_cvttps_epi32(_mm512_add_ps(acc, _mm512_set1_ps(0.5f)));
+    _mm_storeu_si128((__m128i*)dst, _mm512_cvtusepi32_epi8(rounded));
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("avx512f")
+void HorizontalRowAvx512(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m512 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm512_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        const uint8_t* src = paddedSrc + x * 4;
+        for (int i = -radius; i <= radius; i++) {
+            __m512 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm512_set1_ps(weights[i < 0 ? -i : i]);
+            const uint8_t* p = src + (radius + i) * 4;
+            acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(w, Load16BytesAsFloats(p + 0)));
+            acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(w, Load16BytesAsFloats(p + 16)));
+            acc2 = _mm512_add_ps(acc2, _mm512_mul_ps(w, Load16BytesAsFloats(p + 32)));
+            acc3 = _mm512_add_ps(acc3, _mm512_mul_ps(w, Load16BytesAsFloats(p + 48)));
+        }
+        uint8_t* out = dst + x * 4;
+        Store16(out + 0, acc0);
+        Store16(out + 16, acc1);
+        Store16(out + 32, acc2);
+        Store16(out + 48, acc3);
+    }
+    HorizontalRowScalar(paddedSrc, dst, x, width, weights, radius);
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("avx512f")
+void VerticalRowAvx512(const uint8_t* const* rows, uint8_t* dst, size_t count,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m512 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm512_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    size_t k = 0;
+    for (; k + 64 <= count; k += 64) {
+        __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+        for (int i = -radius; i <= radius; i++) {
+            __m512 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm512_set1_ps(weights[i < 0 ? -i : i]);
+            const uint8_t* p = rows[i + radius] + k;
+            acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(w, Load16BytesAsFloats(p + 0)));
+            acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(w, Load16BytesAsFloats(p + 16)));
+            acc2 = _mm512_add_ps(acc2, _mm512_mul_ps(w, Load16BytesAsFloats(p + 32)));
+            acc3 = _mm512_add_ps(acc3, _mm512_mul_ps(w, Load16BytesAsFloats(p + 48)));
+        }
+        Store16(dst + k + 0, acc0);
+        Store16(dst + k + 16, acc1);
+        Store16(dst + k + 32, acc2);
+        Store16(dst + k + 48, acc3);
+    }
+    VerticalRowScalar(rows, dst, k, count, weights, radius);
+}
+
+} // namespace
+
+const CpuBlurRowKernels g_cpuBlurKernelsAvx512 = {
+    CpuIsa::Avx512, HorizontalRowAvx512<kRuntimeRadius>, VerticalRowAvx512<kRuntimeRadius>,
+    RTBLUR_FIXED_RADIUS_KERNELS(HorizontalRowCopy<4>, HorizontalRowAvx512, ),
+    RTBLUR_FIXED_RADIUS_KERNELS(VerticalRowCopy<1>, VerticalRowAvx512, ),
+};
+
+#endif
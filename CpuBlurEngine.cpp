@@ -0,0 +1,97 @@
+#include "CpuBlurEngine.h"
+
+#include <algorithm>
+
+#include "CpuBlur.h"
+#include "CpuBlurTiled.h"
+#include "CpuBoxBlur.h"
+#include "CpuFixedPointBlur.h"
+#include "CpuLinearLightBlur.h"
+#include "CpuPyramidBlur.h"
+#include "CpuRecursiveBlur.h"
+#include "CpuVariableBlur.h"
+#include "Trace.h"
+
+const char* CpuBlurEngineName(CpuBlurEngine engine) {
+    switch (engine) {
+    case CpuBlurEngine::Direct: return "direct";
+    case CpuBlurEngine::BoxCascade: return "box";
+    case CpuBlurEngine::Recursive: return "recursive";
+    case CpuBlurEngine::Pyramid: return "pyramid";
+    case CpuBlurEngine::FixedPoint: return "fixed";
+    case CpuBlurEngine::LinearLight: return "linear";
+    default: return "unknown";
+    }
+}
+
+int CpuBlurEngineReach(CpuBlurEngine engine, float blurRadius) {
+    float sigma = SigmaFromBlurRadius(blurRadius);
+    switch (engine) {
+    case CpuBlurEngine::Direct:
+    case CpuBlurEngine::FixedPoint: {
+        auto kernel = GetGaussianKernel(sigma);
+        return CpuBlurIsCopy(*kernel) ? 0 : kernel->radius;
+    }
+    case CpuBlurEngine::LinearLight: {
+        auto kernel = GetGaussianKernel(sigma, kLinearLightKernelTolerance);
+        return CpuBlurIsCopy(*kernel) ? 0 : kernel->radius;
+    }
+    case CpuBlurEngine::BoxCascade: {
+        int reach = 0;
+        for (int radius : BuildBoxCascade(sigma).radii) reach += radius;
+        return reach;
+    }
+    default:
+        return -1;
+    }
+}
+
+void CpuBlurImage(const CpuImage& src, CpuImage& dst, float blurRadius, CpuBlurEngine engine, ThreadPool& pool) {
+    TRACE_SCOPE(CpuBlurEngineName(engine));
+    switch (engine) {
+    case CpuBlurEngine::BoxCascade:
+        CpuBoxCascadeBlur(src, dst, blurRadius, pool);
+        break;
+    case CpuBlurEngine::Recursive:
+        CpuRecursiveGaussianBlur(src, dst, blurRadius, pool);
+        break;
+    case CpuBlurEngine::Pyramid:
+        CpuPyramidBlur(src, dst, blurRadius, pool);
+        break;
+    case CpuBlurEngine::FixedPoint:
+        CpuFixedPointBlur(src, dst, blurRadius, pool);
+        break;
+    case CpuBlurEngine::LinearLight:
+        CpuLinearLightBlur(src, dst, blurRadius, pool);
+        break;
+    default:
+        CpuGaussianBlurTiled(src, dst, blurRadius, pool);
+        break;
+    }
+}
+
+void CpuBlurImages(const std::vector<CpuBlurJob>& jobs, CpuBlurEngine engine, ThreadPool& pool) {
+    TRACE_SCOPE("blur batch");
+    std::vector<const CpuBlurJob*> small;
+    for (const CpuBlurJob& job : jobs) {
+        if ((size_t)job.src->width * job.src->height <= kCpuBlurBatchSmallPixels) small.push_back(&job);
+        else CpuBlurImage(*job.src, *job.dst, job.blurRadius, engine, pool);
+    }
+
+    // Largest first, so the last tasks to start are the shortest
+    std::stable_sort(small.begin(), small.end(), [](const CpuBlurJob* a, const CpuBlurJob* b) {
+        return (size_t)a->src->width * a->src->height > (size_t)b->src->width * b->src->height;
+    });
+    pool.ParallelFor(small.size(), [&](size_t i) {
+        // A pool of one runs every ParallelFor inline on this thread
+        thread_local ThreadPool serial(1);
+        CpuBlurImage(*small[i]->src, *small[i]->dst, small[i]->blurRadius, engine, serial);
+    });
+}
+
+void CpuBlurImage(const CpuImage& src, CpuImage& dst, float blurRadius, const CpuImage& radiusMap,
+    ThreadPool& pool)
+{
+    TRACE_SCOPE("variable");
+    CpuVariableBlur(src, dst, radiusMap, blurRadius, pool);
+}
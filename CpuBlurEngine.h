@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// The CPU blur algorithms behind one call, so callers pick an engine rather
+// than a function. All of them take the same blur radius and clamp at the
+// edges; they differ in cost and in how closely they follow the exact kernel.
+// LinearLight alone blurs a different quantity, so its output differs from the
+// others on purpose wherever colors change.
+enum class CpuBlurEngine {
+    Direct,      // truncated Gaussian kernel, CpuGaussianBlurTiled
+    BoxCascade,  // running-sum boxes, CpuBoxCascadeBlur
+    Recursive,   // Young-van Vliet IIR, CpuRecursiveGaussianBlur
+    Pyramid,     // downsample-blur-upsample, CpuPyramidBlur
+    FixedPoint,  // direct with Q15 integer weights, CpuFixedPointBlur
+    LinearLight, // direct in linear light rather than on sRGB values, CpuLinearLightBlur
+    Count
+};
+
+const char* CpuBlurEngineName(CpuBlurEngine engine);
+
+// How far a source pixel reaches into the output, in pixels along each axis:
+// blurring a crop that extends this far past a region (or to the image edge)
+// gives exactly the whole-image result inside the region. -1 for engines that
+// can't be cropped that way: Recursive's support never ends, and Pyramid's
+// result depends on where its downsampling blocks fall.
+int CpuBlurEngineReach(CpuBlurEngine engine, float blurRadius);
+
+void CpuBlurImage(const CpuImage& src, CpuImage& dst, float blurRadius, CpuBlurEngine engine, ThreadPool& pool);
+
+// One image of a CpuBlurImages batch, with its own radius
+struct CpuBlurJob {
+    const CpuImage* src = nullptr;
+    CpuImage* dst = nullptr;
+    float blurRadius = 0.0f;
+};
+
+// Images up to this many pixels are blurred whole by one thread in a batch
+constexpr size_t kCpuBlurBatchSmallPixels = 1024 * 1024;
+
+// Blurs a list of images in one submission to the pool. A small image split
+// into tiles across every thread spends more on waking and joining them than
+// on blurring, so the small ones become one task each, largest first, that a
+// single thread runs start to finish with its scratch buffers still warm; the
+// pool is woken once for the whole list. Larger images are blurred one after
+// another with the whole pool, as by CpuBlurImage. Output is the same as
+// calling CpuBlurImage on each job.
+void CpuBlurImages(const std::vector<CpuBlurJob>& jobs, CpuBlurEngine engine, ThreadPool& pool);
+
+// Spatially varying blur: radiusMap scales blurRadius per pixel, 255 being
+// blurRadius and 0 sharp. Runs on summed-area tables (CpuVariableBlur.h)
+// whatever the map, since the fixed-radius engines can't vary their kernel.
+void CpuBlurImage(const CpuImage& src, CpuImage& dst, float blurRadius, const CpuImage& radiusMap,
+    ThreadPool& pool);
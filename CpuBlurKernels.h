@@ -0,0 +1,403 @@
+#pragma once
+
+// Row kernels behind CpuBlur.cpp. Every variant accumulates the taps in the
+// same order (-radius..+radius) with a separate multiply and add per tap, so
+// all instruction sets produce bit-identical output.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "CpuFeatures.h"
+#include "GaussianKernel.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RTBLUR_TARGET(isa) __attribute__((target(isa)))
+#else
+#define RTBLUR_TARGET(isa)
+#endif
+
+// paddedSrc holds width + 2 * radius RGBA8 pixels: the row with its edge pixels
+// repeated radius times on each side, which is the clamp addressing of
+// g_linearClampSampler.
+typedef void (*HorizontalRowKernel)(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width,
+    const float* weights, int radius);
+
+// rows holds the 2 * radius + 1 source rows (already clamped) that output row
+// taps, top to bottom. Blurs bytes [0, count) of them into dst.
+typedef void (*VerticalRowKernel)(const uint8_t* const* rows, uint8_t* dst, size_t count,
+    const float* weights, int radius);
+
+// Row kernels are also compiled for each kernel radius up to
+// kMaxFixedKernelRadius, with the tap count known and the weights broadcast
+// once per row. Radius 0 (sigma near 0, the bottom of the slider) is a plain
+// copy.
+
+// Template argument of the kernels built for any radius.
+constexpr int kRuntimeRadius = -1;
+
+struct CpuBlurRowKernels {
+    CpuIsa isa;
+    HorizontalRowKernel horizontal; // any radius
+    VerticalRowKernel vertical;
+    HorizontalRowKernel fixedHorizontal[kMaxFixedKernelRadius + 1]; // indexed by radius
+    VerticalRowKernel fixedVertical[kMaxFixedKernelRadius + 1];
+};
+
+// Sample storage of the rows a kernel reads and writes. The interactive blur
+// is RGBA8; the other kinds are for 1, 2 or 4 channel images of deeper samples.
+enum class CpuSampleType {
+    U8,
+    U16,
+    F16,
+    F32,
+};
+
+// Kernels for isa, or the best available below it when isa is not supported
+// by this CPU or this build. RGBA8 rows.
+const CpuBlurRowKernels& GetCpuBlurRowKernels(CpuIsa isa);
+
+// Kernels for rows of channels (1, 2 or 4) samples of type per pixel; width
+// counts pixels and the vertical count counts samples. Formats other than
+// RGBA8 have scalar kernels only.
+const CpuBlurRowKernels& GetCpuBlurRowKernels(CpuIsa isa, int channels, CpuSampleType type);
+
+// The kernel specialized for radius when there is one, else the generic one.
+// SetCpuBlurKernelSpecialization(false) always picks the generic kernels, for
+// benchmarking the difference.
+HorizontalRowKernel SelectHorizontalRowKernel(const CpuBlurRowKernels& kernels, int radius);
+VerticalRowKernel SelectVerticalRowKernel(const CpuBlurRowKernels& kernels, int radius);
+void SetCpuBlurKernelSpecialization(bool enabled);
+bool GetCpuBlurKernelSpecialization();
+
+inline uint8_t QuantizeUnorm8(float value) {
+    int v = (int)(value + 0.5f);
+    return (uint8_t)(v > 255 ? 255 : v);
+}
+
+// Scalar versions over a sub-range, shared by the SIMD variants for their tails.
+inline void HorizontalRowScalar(const uint8_t* paddedSrc, uint8_t* dst, uint32_t x0, uint32_t x1,
+    const float* weights, int radius)
+{
+    for (uint32_t x = x0; x < x1; x++) {
+        for (int c = 0; c < 4; c++) {
+            float acc = 0.0f;
+            for (int i = -radius; i <= radius; i++) {
+                acc += weights[i < 0 ? -i : i] * (float)paddedSrc[(x + radius + i) * 4 + c];
+            }
+            dst[x * 4 + c] = QuantizeUnorm8(acc);
+        }
+    }
+}
+
+inline void VerticalRowScalar(const uint8_t* const* rows, uint8_t* dst, size_t begin, size_t end,
+    const float* weights, int radius)
+{
+    for (size_t k = begin; k < end; k++) {
+        float acc = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            acc += weights[i < 0 ? -i : i] * (float)rows[i + radius][k];
+        }
+        dst[k] = QuantizeUnorm8(acc);
+    }
+}
+
+// Conversions between IEEE half floats and floats, rounding to nearest even.
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13); // inf / NaN
+    }
+    else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0) {
+        bits = sign;
+    }
+    else {
+        // Subnormal: normalize into a float exponent
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, 4);
+    return f;
+}
+
+inline uint16_t FloatToHalf(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF) return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    int e = (int)exponent - 112;
+    if (e >= 0x1F) return (uint16_t)(sign | 0x7C00); // overflow to inf
+    if (e <= 0) {
+        if (e < -10) return sign;
+        // Subnormal half: shift the mantissa with its implicit bit into place
+        mantissa |= 0x800000;
+        int shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is right
+    return (uint16_t)(sign | half);
+}
+
+// How each CpuSampleType is stored and converted. Blurred values are rounded
+// the way QuantizeUnorm8 rounds 8-bit ones.
+struct SampleU8 {
+    typedef uint8_t Storage;
+    static float Load(uint8_t v) { return (float)v; }
+    static uint8_t Store(float v) { return QuantizeUnorm8(v); }
+};
+
+struct SampleU16 {
+    typedef uint16_t Storage;
+    static float Load(uint16_t v) { return (float)v; }
+    static uint16_t Store(float v) {
+        int q = (int)(v + 0.5f);
+        return (uint16_t)(q > 65535 ? 65535 : q);
+    }
+};
+
+struct SampleF16 {
+    typedef uint16_t Storage;
+    static float Load(uint16_t v) { return HalfToFloat(v); }
+    static uint16_t Store(float v) { return FloatToHalf(v); }
+};
+
+struct SampleF32 {
+    typedef float Storage;
+    static float Load(float v) { return v; }
+    static float Store(float v) { return v; }
+};
+
+// Scalar kernels for any pixel format, radius fixed at compile time unless
+// FixedRadius is kRuntimeRadius. With Channels 4 and SampleU8 they compute
+// exactly what HorizontalRowScalar / VerticalRowScalar do.
+template <int Channels, typename Sample, int FixedRadius>
+void HorizontalRowFormat(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width, const float* weights, int radius) {
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    typedef typename Sample::Storage T;
+    const T* src = reinterpret_cast<const T*>(paddedSrc);
+    T* out = reinterpret_cast<T*>(dst);
+    for (uint32_t x = 0; x < width; x++) {
+        for (int c = 0; c < Channels; c++) {
+            float acc = 0.0f;
+            for (int i = -radius; i <= radius; i++) {
+                acc += weights[i < 0 ? -i : i] * Sample::Load(src[(x + radius + i) * Channels + c]);
+            }
+            out[x * Channels + c] = Sample::Store(acc);
+        }
+    }
+}
+
+template <typename Sample, int FixedRadius>
+void VerticalRowFormat(const uint8_t* const* rows, uint8_t* dst, size_t count, const float* weights, int radius) {
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    typedef typename Sample::Storage T;
+    T* out = reinterpret_cast<T*>(dst);
+    for (size_t k = 0; k < count; k++) {
+        float acc = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            acc += weights[i < 0 ? -i : i] * Sample::Load(reinterpret_cast<const T*>(rows[i + radius])[k]);
+        }
+        out[k] = Sample::Store(acc);
+    }
+}
+
+// Radius 0: weights[0] is exactly 1, so the blur is a copy.
+template <size_t PixelBytes>
+void HorizontalRowCopy(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width, const float*, int) {
+    memcpy(dst, paddedSrc, (size_t)width * PixelBytes);
+}
+
+template <size_t SampleBytes>
+void VerticalRowCopy(const uint8_t* const* rows, uint8_t* dst, size_t count, const float*, int) {
+    memcpy(dst, rows[0], count * SampleBytes);
+}
+
+// Initializer for CpuBlurRowKernels::fixedHorizontal / fixedVertical from a
+// kernel template whose last argument is the radius.
+#define RTBLUR_FIXED_RADIUS_KERNELS(copy, kernel, ...) \
+    { copy, kernel<__VA_ARGS__ 1>, kernel<__VA_ARGS__ 2>, kernel<__VA_ARGS__ 3>, kernel<__VA_ARGS__ 4>, \
+      kernel<__VA_ARGS__ 5>, kernel<__VA_ARGS__ 6>, kernel<__VA_ARGS__ 7>, kernel<__VA_ARGS__ 8> }
+
+// Integer kernels for the fixed-point engine (CpuFixedPointBlur.h). Weights
+// are Q15 (kFixedPointWeightBits) and sum to exactly 1 << 15, so a pass is an
+// exact integer sum rounded once: (acc + (1 << 14)) >> 15. Every variant
+// produces the same output. Rows are RGBA with 8- or 16-bit samples; width
+// counts pixels and count counts samples, as for the float kernels.
+constexpr int kFixedPointWeightBits = 15;
+
+typedef void (*HorizontalRowFixedPointKernel)(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width,
+    const int16_t* weights, int radius);
+typedef void (*VerticalRowFixedPointKernel)(const uint8_t* const* rows, uint8_t* dst, size_t count,
+    const int16_t* weights, int radius);
+
+struct CpuFixedPointRowKernels {
+    CpuIsa isa;
+    HorizontalRowFixedPointKernel horizontal8;
+    VerticalRowFixedPointKernel vertical8;
+    HorizontalRowFixedPointKernel horizontal16;
+    VerticalRowFixedPointKernel vertical16;
+};
+
+// Same fallback rules as GetCpuBlurRowKernels. The SIMD kernels need 16-bit
+// integer lanes, which AVX-512F alone lacks, so AVX-512 runs the AVX2 ones.
+const CpuFixedPointRowKernels& GetCpuFixedPointRowKernels(CpuIsa isa);
+
+template <typename T>
+inline T RoundFixedPoint(int32_t acc) {
+    return (T)((acc + (1 << (kFixedPointWeightBits - 1))) >> kFixedPointWeightBits);
+}
+
+// Both passes reduce to one operation: tap j of the 2 * radius + 1 reads
+// samples from taps[j], and out[k] = sum of weight(j - radius) * taps[j][k].
+// The vertical kernels are exactly that with the source rows as taps; this is
+// the scalar version over samples [begin, end), also used for SIMD tails.
+template <typename T>
+inline void VerticalRowFixedPointScalar(const uint8_t* const* taps, uint8_t* dst, size_t begin, size_t end,
+    const int16_t* weights, int radius)
+{
+    T* out = reinterpret_cast<T*>(dst);
+    for (size_t k = begin; k < end; k++) {
+        int32_t acc = 0;
+        for (int i = -radius; i <= radius; i++) {
+            acc += weights[i < 0 ? -i : i] * (int32_t)reinterpret_cast<const T*>(taps[i + radius])[k];
+        }
+        out[k] = RoundFixedPoint<T>(acc);
+    }
+}
+
+// Horizontal kernel from a vertical one: tap j of a padded row starts j
+// pixels in.
+template <typename T, VerticalRowFixedPointKernel vertical>
+void HorizontalRowFixedPoint(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width, const int16_t* weights, int radius) {
+    const uint8_t* taps[2 * kMaxKernelRadius + 1];
+    for (int j = 0; j <= 2 * radius; j++) taps[j] = paddedSrc + (size_t)j * 4 * sizeof(T);
+    vertical(taps, dst, (size_t)width * 4, weights, radius);
+}
+
+// Kernels for the linear-light engine (CpuLinearLightBlur.h). The horizontal
+// pass reads a padded row of float samples and the intermediate between the
+// passes is half floats, so the vertical pass reads half the bytes of float.
+// Same tap order and separate multiply and add as the 8-bit kernels, so
+// every variant is bit-identical here too.
+typedef void (*HorizontalRowHalfKernel)(const float* paddedSrc, uint16_t* dst, uint32_t width,
+    const float* weights, int radius);
+typedef void (*VerticalRowHalfKernel)(const uint16_t* const* rows, uint16_t* dst, size_t count,
+    const float* weights, int radius);
+typedef void (*HalfToFloatRowKernel)(const uint16_t* src, float* dst, size_t count);
+
+// Table lookups of the 8-bit format, per RGBA pixel: colour samples index the
+// first half of the table and alpha the second. Decode tables hold 2 * 256
+// floats; encode tables 2 * (kHalfOne + 1) bytes indexed by the half float
+// clamped to 1.0, plus 3 bytes of padding for 4-byte gathers.
+constexpr uint16_t kHalfOne = 0x3C00;
+typedef void (*DecodeRowTableKernel)(const uint8_t* src, float* dst, size_t count, const float* table);
+typedef void (*EncodeRowTableKernel)(const uint16_t* src, uint8_t* dst, size_t count, const uint8_t* table);
+
+struct CpuHalfRowKernels {
+    CpuIsa isa;
+    HorizontalRowHalfKernel horizontal;
+    VerticalRowHalfKernel vertical;
+    HalfToFloatRowKernel toFloat;
+    DecodeRowTableKernel decode8;
+    EncodeRowTableKernel encode8;
+};
+
+// The conversions need F16C, so the SIMD kernels are AVX2 + F16C (also used
+// for AVX-512); anything less gets the scalar ones.
+const CpuHalfRowKernels& GetCpuHalfRowKernels(CpuIsa isa);
+
+// Samples [begin, end) of the row; sample k's taps are k + 4 * (radius + i).
+inline void HorizontalRowHalfScalar(const float* paddedSrc, uint16_t* dst, size_t begin, size_t end,
+    const float* weights, int radius)
+{
+    for (size_t k = begin; k < end; k++) {
+        float acc = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            acc += weights[i < 0 ? -i : i] * paddedSrc[k + (size_t)(radius + i) * 4];
+        }
+        dst[k] = FloatToHalf(acc);
+    }
+}
+
+inline void VerticalRowHalfScalar(const uint16_t* const* rows, uint16_t* dst, size_t begin, size_t end,
+    const float* weights, int radius)
+{
+    for (size_t k = begin; k < end; k++) {
+        float acc = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            acc += weights[i < 0 ? -i : i] * HalfToFloat(rows[i + radius][k]);
+        }
+        dst[k] = FloatToHalf(acc);
+    }
+}
+
+// Samples [begin, end) of the row, both multiples of 4
+inline void DecodeRowTableScalar(const uint8_t* src, float* dst, size_t begin, size_t end, const float* table) {
+    for (size_t k = begin; k < end; k += 4) {
+        dst[k + 0] = table[src[k + 0]];
+        dst[k + 1] = table[src[k + 1]];
+        dst[k + 2] = table[src[k + 2]];
+        dst[k + 3] = table[256 + src[k + 3]];
+    }
+}
+
+inline void EncodeRowTableScalar(const uint16_t* src, uint8_t* dst, size_t begin, size_t end, const uint8_t* table) {
+    const uint8_t* alpha = table + kHalfOne + 1;
+    for (size_t k = begin; k < end; k += 4) {
+        dst[k + 0] = table[std::min(src[k + 0], kHalfOne)];
+        dst[k + 1] = table[std::min(src[k + 1], kHalfOne)];
+        dst[k + 2] = table[std::min(src[k + 2], kHalfOne)];
+        dst[k + 3] = alpha[std::min(src[k + 3], kHalfOne)];
+    }
+}
+
+// Copies a block of RGBA8 pixels transposed, for the vertical pass's
+// transpose strategy: pixel x0 + c of rows[r] goes to pixel r of the row at
+// dst + c * dstPitch, for r < rowCount and c < columns.
+typedef void (*TransposePixelsKernel)(const uint8_t* const* rows, uint32_t rowCount, uint32_t x0, uint32_t columns,
+    uint8_t* dst, size_t dstPitch);
+
+// SSE4.1 moves 4x4 blocks and AVX2 (also used for AVX-512) 8x8 blocks.
+TransposePixelsKernel GetCpuTransposePixelsKernel(CpuIsa isa);
+
+// Rows [r0, r1) and columns [c0, c1) of the block.
+inline void TransposePixelsScalar(const uint8_t* const* rows, uint32_t r0, uint32_t r1, uint32_t x0,
+    uint32_t c0, uint32_t c1, uint8_t* dst, size_t dstPitch)
+{
+    for (uint32_t c = c0; c < c1; c++) {
+        uint8_t* out = dst + c * dstPitch;
+        for (uint32_t r = r0; r < r1; r++) memcpy(out + (size_t)r * 4, rows[r] + (size_t)(x0 + c) * 4, 4);
+    }
+}
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RTBLUR_HAS_X86_KERNELS 1
+extern const CpuBlurRowKernels g_cpuBlurKernelsSse41;
+extern const CpuBlurRowKernels g_cpuBlurKernelsAvx2;
+extern const CpuBlurRowKernels g_cpuBlurKernelsAvx512;
+extern const CpuFixedPointRowKernels g_cpuFixedPointKernelsSse41;
+extern const CpuFixedPointRowKernels g_cpuFixedPointKernelsAvx2;
+extern const CpuHalfRowKernels g_cpuHalfKernelsAvx2;
+extern const TransposePixelsKernel g_cpuTransposePixelsSse41;
+extern const TransposePixelsKernel g_cpuTransposePixelsAvx2;
+#endif
@@ -0,0 +1,654 @@
+#include "CpuBlurServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kServerMagic = 0x52554C42; // "BLUR"
+constexpr size_t kSegmentNameSize = 96;
+// Largest image side a request may name, a sanity check like the shard header's
+constexpr uint32_t kMaxServerImageSide = 1u << 16;
+// Requests whose queue and blur times the stats percentiles cover
+constexpr size_t kRecentRequests = 1024;
+
+enum class RequestType : uint32_t { Blur = 1, Stats = 2 };
+
+struct WireRequest {
+    uint32_t magic = kServerMagic;
+    uint32_t type = 0;
+    uint64_t id = 0;
+    char segment[kSegmentNameSize] = {};
+    uint64_t srcOffset = 0;
+    uint64_t dstOffset = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float blurRadius = 0.0f;
+    uint32_t engine = 0;
+    int32_t priority = 0;
+    uint32_t reserved = 0;
+};
+
+// Followed by textBytes of text: the JSON of a stats request
+struct WireReply {
+    uint32_t magic = kServerMagic;
+    uint32_t status = 0;
+    uint64_t id = 0;
+    double queueMs = 0.0;
+    double blurMs = 0.0;
+    uint32_t batchSize = 0;
+    uint32_t textBytes = 0;
+};
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+double Milliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p * values.size());
+    return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+}
+
+#ifdef _WIN32
+// "/name" and "name" both become "Local\name", the session's namespace
+std::string NativeSegmentName(const std::string& name) {
+    return "Local\\" + (name.size() > 1 && name[0] == '/' ? name.substr(1) : name);
+}
+
+// A named mapping lives as long as any handle to it, and the server keeps one
+// open for every segment it maps, so a name can't come to mean a new object
+// while the server has it mapped
+bool SegmentIdentity(const std::string&, uint64_t& identity) {
+    identity = 0;
+    return true;
+}
+#else
+uint64_t IdentityOf(const struct stat& info) {
+    // The inode alone can be reused once a removed object is gone
+    uint64_t created = (uint64_t)info.st_ctim.tv_sec * 1000000000u + (uint64_t)info.st_ctim.tv_nsec;
+    return ((uint64_t)info.st_ino * 0x9E3779B97F4A7C15ull) ^ created;
+}
+
+bool SegmentIdentity(const std::string& name, uint64_t& identity) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    bool known = fstat(fd, &info) == 0;
+    close(fd);
+    if (known) identity = IdentityOf(info);
+    return known;
+}
+#endif
+
+// A blur request from receipt to answer; lives on its connection thread's stack
+struct ServerJob {
+    WireRequest request;
+    Clock::time_point arrived;
+    uint64_t sequence = 0;
+    BlurServerStatus status = BlurServerStatus::Ok;
+    double queueMs = 0.0;
+    double blurMs = 0.0;
+    uint32_t batchSize = 0;
+    bool done = false;
+};
+
+// priority_queue puts the largest first: higher priority, then earlier arrival
+struct JobOrder {
+    bool operator()(const ServerJob* a, const ServerJob* b) const {
+        if (a->request.priority != b->request.priority) return a->request.priority < b->request.priority;
+        return a->sequence > b->sequence;
+    }
+};
+
+struct Connection {
+    Socket socket;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+};
+
+volatile std::sig_atomic_t g_stopRequested = 0;
+
+void RequestStop(int) {
+    g_stopRequested = 1;
+}
+
+} // namespace
+
+SharedSegment::~SharedSegment() {
+    Close();
+}
+
+SharedSegment::SharedSegment(SharedSegment&& other) noexcept {
+    *this = std::move(other);
+}
+
+SharedSegment& SharedSegment::operator=(SharedSegment&& other) noexcept {
+    if (this != &other) {
+        Close();
+        m_name = std::move(other.m_name);
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_identity = other.m_identity;
+        m_owner = other.m_owner;
+        m_handle = other.m_handle;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_owner = false;
+        other.m_handle = -1;
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+bool SharedSegment::Create(const std::string& name, size_t size, std::string* error) {
+    Close();
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, NativeSegmentName(name).c_str());
+    if (!mapping) return Fail(error, "can't create shared memory " + name);
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return Fail(error, "shared memory " + name + " already exists");
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view) {
+        CloseHandle(mapping);
+        return Fail(error, "can't map shared memory " + name);
+    }
+    m_name = name;
+    m_data = (uint8_t*)view;
+    m_size = size;
+    m_owner = true;
+    m_handle = (intptr_t)mapping;
+    return true;
+}
+
+bool SharedSegment::Open(const std::string& name, std::string* error) {
+    Close();
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, NativeSegmentName(name).c_str());
+    if (!mapping) return Fail(error, "can't open shared memory " + name);
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info = {};
+    if (!view || VirtualQuery(view, &info, sizeof(info)) == 0) {
+        if (view) UnmapViewOfFile(view);
+        CloseHandle(mapping);
+        return Fail(error, "can't map shared memory " + name);
+    }
+    m_name = name;
+    m_data = (uint8_t*)view;
+    m_size = info.RegionSize; // whole pages: the creator's size rounded up
+    m_handle = (intptr_t)mapping;
+    return true;
+}
+
+void SharedSegment::Close() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_handle != -1) CloseHandle((HANDLE)m_handle);
+    m_data = nullptr;
+    m_size = 0;
+    m_identity = 0;
+    m_owner = false;
+    m_handle = -1;
+}
+#else
+bool SharedSegment::Create(const std::string& name, size_t size, std::string* error) {
+    Close();
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return Fail(error, "can't create shared memory " + name);
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0 && fstat(fd, &info) == 0) {
+        view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return Fail(error, "can't map shared memory " + name);
+    }
+    m_name = name;
+    m_data = (uint8_t*)view;
+    m_size = size;
+    m_identity = IdentityOf(info);
+    m_owner = true;
+    return true;
+}
+
+bool SharedSegment::Open(const std::string& name, std::string* error) {
+    Close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return Fail(error, "can't open shared memory " + name);
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        view = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) return Fail(error, "can't map shared memory " + name);
+    m_name = name;
+    m_data = (uint8_t*)view;
+    m_size = (size_t)info.st_size;
+    m_identity = IdentityOf(info);
+    return true;
+}
+
+void SharedSegment::Close() {
+    if (m_data) munmap(m_data, m_size);
+    if (m_owner) shm_unlink(m_name.c_str());
+    m_data = nullptr;
+    m_size = 0;
+    m_identity = 0;
+    m_owner = false;
+}
+#endif
+
+const char* BlurServerStatusName(BlurServerStatus status) {
+    switch (status) {
+    case BlurServerStatus::Ok: return "ok";
+    case BlurServerStatus::BadRequest: return "bad request";
+    case BlurServerStatus::BadSegment: return "can't open segment";
+    case BlurServerStatus::OutOfBounds: return "image past the end of its segment";
+    case BlurServerStatus::ShuttingDown: return "server shutting down";
+    }
+    return "unknown";
+}
+
+struct BlurServer::State {
+    BlurServerOptions options;
+    std::unique_ptr<ThreadPool> pool;
+    Socket listener;
+    std::thread acceptThread;
+    std::thread dispatchThread;
+    std::atomic<bool> stopping{false};
+    Clock::time_point started;
+
+    mutable std::mutex mutex;
+    std::condition_variable queued;   // the dispatcher waits for requests
+    std::condition_variable finished; // connection threads wait for their job
+    std::priority_queue<ServerJob*, std::vector<ServerJob*>, JobOrder> queue;
+    uint64_t nextSequence = 0;
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t batches = 0;
+    uint64_t batchedJobs = 0;
+    std::deque<double> recentQueueMs;
+    std::deque<double> recentBlurMs;
+
+    std::mutex connectionMutex;
+    std::list<Connection> connections;
+
+    // The dispatcher's alone, apart from the count the stats report
+    std::list<std::shared_ptr<SharedSegment>> segments; // most recently used first
+    std::atomic<size_t> segmentCount{0};
+    std::vector<CpuImage> sources;
+    std::vector<CpuImage> results;
+
+    void AcceptLoop();
+    void ServeConnection(Connection& connection);
+    void DispatchLoop();
+    void RunBatch(const std::vector<ServerJob*>& batch);
+    std::shared_ptr<SharedSegment> MapSegment(const std::string& name);
+    std::string StatsJson() const;
+};
+
+void BlurServer::State::AcceptLoop() {
+    TraceSetThreadName("server accept");
+    while (!stopping) {
+        Socket socket = listener.Accept(0.2);
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (!it->finished) {
+                ++it;
+                continue;
+            }
+            it->thread.join();
+            it = connections.erase(it);
+        }
+        if (!socket.Valid() || stopping) continue;
+        connections.emplace_back();
+        Connection& connection = connections.back();
+        connection.socket = std::move(socket);
+        connection.thread = std::thread([this, &connection] { ServeConnection(connection); });
+    }
+}
+
+void BlurServer::State::ServeConnection(Connection& connection) {
+    TraceSetThreadName("server connection");
+    WireRequest request;
+    while (!stopping && connection.socket.ReceiveAll(&request, sizeof(request))) {
+        // Anything else means the two sides disagree on the format; hang up
+        if (request.magic != kServerMagic) break;
+        request.segment[kSegmentNameSize - 1] = '\0';
+        WireReply reply;
+        reply.id = request.id;
+        std::string text;
+        if (request.type == (uint32_t)RequestType::Stats) {
+            text = StatsJson();
+        } else if (request.type == (uint32_t)RequestType::Blur) {
+            ServerJob job;
+            job.request = request;
+            job.arrived = Clock::now();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (stopping) {
+                    job.status = BlurServerStatus::ShuttingDown;
+                } else {
+                    job.sequence = nextSequence++;
+                    queue.push(&job);
+                    queued.notify_one();
+                    finished.wait(lock, [&] { return job.done; });
+                }
+            }
+            reply.status = (uint32_t)job.status;
+            reply.queueMs = job.queueMs;
+            reply.blurMs = job.blurMs;
+            reply.batchSize = job.batchSize;
+        } else {
+            reply.status = (uint32_t)BlurServerStatus::BadRequest;
+        }
+        reply.textBytes = (uint32_t)text.size();
+        if (!connection.socket.SendAll(&reply, sizeof(reply))) break;
+        if (!text.empty() && !connection.socket.SendAll(text.data(), text.size())) break;
+    }
+    connection.finished = true;
+}
+
+void BlurServer::State::DispatchLoop() {
+    TraceSetThreadName("server dispatch");
+    for (;;) {
+        std::vector<ServerJob*> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            while (!queue.empty() && batch.size() < options.maxBatch) {
+                batch.push_back(queue.top());
+                queue.pop();
+            }
+        }
+        RunBatch(batch);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++batches;
+            batchedJobs += batch.size();
+            for (ServerJob* job : batch) {
+                ++requests;
+                if (job->status != BlurServerStatus::Ok) ++failures;
+                recentQueueMs.push_back(job->queueMs);
+                recentBlurMs.push_back(job->blurMs);
+                if (recentQueueMs.size() > kRecentRequests) recentQueueMs.pop_front();
+                if (recentBlurMs.size() > kRecentRequests) recentBlurMs.pop_front();
+                job->done = true;
+            }
+        }
+        finished.notify_all();
+    }
+}
+
+std::shared_ptr<SharedSegment> BlurServer::State::MapSegment(const std::string& name) {
+    uint64_t identity = 0;
+    if (!SegmentIdentity(name, identity)) return nullptr;
+    for (auto it = segments.begin(); it != segments.end(); ++it) {
+        if ((*it)->Name() != name) continue;
+        std::shared_ptr<SharedSegment> segment = *it;
+        segments.erase(it);
+        // A removed segment whose name was reused: map the new one instead
+        if (identity != 0 && segment->Identity() != identity) break;
+        segments.push_front(segment);
+        return segment;
+    }
+    auto segment = std::make_shared<SharedSegment>();
+    if (!segment->Open(name)) {
+        segmentCount = segments.size();
+        return nullptr;
+    }
+    segments.push_front(segment);
+    while (segments.size() > std::max<size_t>(options.maxSegments, 1)) segments.pop_back();
+    segmentCount = segments.size();
+    return segment;
+}
+
+void BlurServer::State::RunBatch(const std::vector<ServerJob*>& batch) {
+    TRACE_SCOPE("server batch");
+    Clock::time_point start = Clock::now();
+    if (sources.size() < batch.size()) {
+        sources.resize(batch.size());
+        results.resize(batch.size());
+    }
+    std::vector<std::shared_ptr<SharedSegment>> mapped(batch.size());
+    std::vector<bool> engines((size_t)CpuBlurEngine::Count, false);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ServerJob& job = *batch[i];
+        const WireRequest& request = job.request;
+        job.queueMs = Milliseconds(start - job.arrived);
+        if (request.engine >= (uint32_t)CpuBlurEngine::Count || request.width == 0 || request.height == 0 ||
+            request.width > kMaxServerImageSide || request.height > kMaxServerImageSide ||
+            !std::isfinite(request.blurRadius) || request.blurRadius < 0.0f) {
+            job.status = BlurServerStatus::BadRequest;
+            continue;
+        }
+        mapped[i] = MapSegment(request.segment);
+        if (!mapped[i]) {
+            job.status = BlurServerStatus::BadSegment;
+            continue;
+        }
+        uint64_t bytes = (uint64_t)request.width * request.height * 4;
+        uint64_t size = mapped[i]->Size();
+        if (bytes > size || request.srcOffset > size - bytes || request.dstOffset > size - bytes) {
+            job.status = BlurServerStatus::OutOfBounds;
+            mapped[i].reset();
+            continue;
+        }
+        CpuImage& source = sources[i];
+        if (source.width != request.width || source.height != request.height) {
+            source = CpuImage(request.width, request.height);
+        }
+        memcpy(source.pixels.data(), mapped[i]->Data() + request.srcOffset, (size_t)bytes);
+        engines[request.engine] = true;
+    }
+
+    for (size_t engine = 0; engine < engines.size(); ++engine) {
+        if (!engines[engine]) continue;
+        std::vector<CpuBlurJob> jobs;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (!mapped[i] || batch[i]->request.engine != engine) continue;
+            jobs.push_back({&sources[i], &results[i], batch[i]->request.blurRadius});
+        }
+        CpuBlurImages(jobs, (CpuBlurEngine)engine, *pool);
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (!mapped[i]) continue;
+        memcpy(mapped[i]->Data() + batch[i]->request.dstOffset, results[i].pixels.data(), results[i].pixels.size());
+    }
+    double blurMs = Milliseconds(Clock::now() - start);
+    for (ServerJob* job : batch) {
+        job->blurMs = blurMs;
+        job->batchSize = (uint32_t)batch.size();
+    }
+}
+
+std::string BlurServer::State::StatsJson() const {
+    std::vector<double> queueMs, blurMs;
+    uint64_t requestCount, failureCount, batchCount, batchedCount;
+    size_t depth;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queueMs.assign(recentQueueMs.begin(), recentQueueMs.end());
+        blurMs.assign(recentBlurMs.begin(), recentBlurMs.end());
+        requestCount = requests;
+        failureCount = failures;
+        batchCount = batches;
+        batchedCount = batchedJobs;
+        depth = queue.size();
+    }
+    char json[1024];
+    snprintf(json, sizeof(json),
+        "{\"uptime_s\": %.1f, \"threads\": %u, \"requests\": %llu, \"errors\": %llu, \"batches\": %llu, "
+        "\"mean_batch\": %.2f, \"queued\": %zu, \"segments\": %zu, "
+        "\"queue_ms\": {\"p50\": %.3f, \"p99\": %.3f}, \"blur_ms\": {\"p50\": %.3f, \"p99\": %.3f}}",
+        Milliseconds(Clock::now() - started) / 1000.0, pool->ThreadCount(), (unsigned long long)requestCount,
+        (unsigned long long)failureCount, (unsigned long long)batchCount,
+        batchCount ? (double)batchedCount / batchCount : 0.0, depth, segmentCount.load(),
+        Percentile(queueMs, 0.5), Percentile(queueMs, 0.99), Percentile(blurMs, 0.5), Percentile(blurMs, 0.99));
+    return json;
+}
+
+BlurServer::BlurServer() = default;
+
+BlurServer::~BlurServer() {
+    Stop();
+}
+
+bool BlurServer::Start(const BlurServerOptions& options, std::string* error) {
+    Stop();
+    auto state = std::make_unique<State>();
+    state->options = options;
+    state->options.maxBatch = std::max(options.maxBatch, 1u);
+    state->listener = Socket::ListenLocal(options.socketPath, error);
+    if (!state->listener.Valid()) return false;
+    state->pool = std::make_unique<ThreadPool>(options.threads);
+    state->started = Clock::now();
+    State* s = state.get();
+    state->dispatchThread = std::thread([s] { s->DispatchLoop(); });
+    state->acceptThread = std::thread([s] { s->AcceptLoop(); });
+    m_state = std::move(state);
+    return true;
+}
+
+void BlurServer::Stop() {
+    if (!m_state) return;
+    State& s = *m_state;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.stopping = true;
+        while (!s.queue.empty()) {
+            s.queue.top()->status = BlurServerStatus::ShuttingDown;
+            s.queue.top()->done = true;
+            s.queue.pop();
+        }
+    }
+    s.queued.notify_all();
+    s.finished.notify_all();
+    // The batch in progress, if any, finishes and is answered
+    s.dispatchThread.join();
+    s.acceptThread.join();
+    for (Connection& connection : s.connections) connection.socket.Shutdown();
+    for (Connection& connection : s.connections) connection.thread.join();
+    s.listener.Close();
+    remove(s.options.socketPath.c_str());
+    m_state.reset();
+}
+
+std::string BlurServer::StatsJson() const {
+    return m_state ? m_state->StatsJson() : std::string("{}");
+}
+
+int RunBlurServer(const BlurServerOptions& options) {
+    BlurServer server;
+    std::string error;
+    if (!server.Start(options, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+    fprintf(stderr, "Serving blurs on %s\n", options.socketPath.c_str());
+    while (!g_stopRequested) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    fprintf(stderr, "Stopping: %s\n", server.StatsJson().c_str());
+    server.Stop();
+    return 0;
+}
+
+bool BlurClient::Connect(const std::string& socketPath, std::string* error) {
+    m_socket = Socket::ConnectLocal(socketPath, error);
+    return m_socket.Valid();
+}
+
+bool BlurClient::Blur(const SharedSegment& segment, size_t srcOffset, size_t dstOffset, uint32_t width,
+    uint32_t height, float blurRadius, CpuBlurEngine engine, int priority, BlurReply* reply, std::string* error)
+{
+    if (segment.Name().empty() || segment.Name().size() >= kSegmentNameSize) {
+        return Fail(error, "segment name must be 1 to " + std::to_string(kSegmentNameSize - 1) + " characters");
+    }
+    WireRequest request;
+    request.type = (uint32_t)RequestType::Blur;
+    request.id = m_nextId++;
+    memcpy(request.segment, segment.Name().c_str(), segment.Name().size());
+    request.srcOffset = srcOffset;
+    request.dstOffset = dstOffset;
+    request.width = width;
+    request.height = height;
+    request.blurRadius = blurRadius;
+    request.engine = (uint32_t)engine;
+    request.priority = priority;
+
+    WireReply answer;
+    if (!m_socket.SendAll(&request, sizeof(request)) || !m_socket.ReceiveAll(&answer, sizeof(answer)) ||
+        answer.magic != kServerMagic || answer.id != request.id || answer.textBytes != 0)
+    {
+        m_socket.Close();
+        return Fail(error, "lost the connection to the blur server");
+    }
+    BlurServerStatus status = (BlurServerStatus)answer.status;
+    if (reply) {
+        reply->status = status;
+        reply->queueMs = answer.queueMs;
+        reply->blurMs = answer.blurMs;
+        reply->batchSize = answer.batchSize;
+    }
+    if (status != BlurServerStatus::Ok) return Fail(error, BlurServerStatusName(status));
+    return true;
+}
+
+bool BlurClient::Stats(std::string& json, std::string* error) {
+    WireRequest request;
+    request.type = (uint32_t)RequestType::Stats;
+    request.id = m_nextId++;
+    WireReply answer;
+    if (!m_socket.SendAll(&request, sizeof(request)) || !m_socket.ReceiveAll(&answer, sizeof(answer)) ||
+        answer.magic != kServerMagic || answer.id != request.id)
+    {
+        m_socket.Close();
+        return Fail(error, "lost the connection to the blur server");
+    }
+    json.resize(answer.textBytes);
+    if (answer.textBytes > 0 && !m_socket.ReceiveAll(&json[0], json.size())) {
+        m_socket.Close();
+        return Fail(error, "lost the connection to the blur server");
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CpuBlurEngine.h"
+#include "CpuSocket.h"
+
+// A long-running blur service, so that callers blurring many small images
+// don't pay for a process, a thread pool and cold caches every time. Clients
+// connect over a local (AF_UNIX) socket and send fixed-size requests naming a
+// shared memory segment they created and the byte offsets of a source and a
+// destination image in it; the pixels themselves never cross the socket. The
+// server maps each segment once and keeps it mapped while the name refers to
+// the same object.
+//
+// Requests from all connections wait in one queue, highest priority first and
+// in arrival order within a priority. A dispatcher thread takes up to maxBatch
+// of them at a time and blurs them with CpuBlurImages, one call per engine, so
+// that a burst of small requests wakes the pool once. A connection has one
+// request in flight; clients wanting more open more connections.
+//
+// The engines work on CpuImages, which own their pixels, so the server copies
+// a request's source out of the segment into a buffer it reuses and the result
+// back in, one memcpy each way. Blurring in the segment itself would take a
+// view type through every engine; the two copies cost under a tenth of even the
+// cheapest blur (1.4 ms at 1080p on one core, against 15.6 ms for the direct
+// engine at radius 4). The wire format is the host's byte order; client and
+// server run on one machine.
+
+// Caller-owned shared memory: a POSIX shm_open object ("/name") on Linux, a
+// named file mapping ("Local\\name") on Windows
+class SharedSegment {
+public:
+    SharedSegment() = default;
+    // Unmaps, and removes the name if this segment created it
+    ~SharedSegment();
+
+    SharedSegment(SharedSegment&& other) noexcept;
+    SharedSegment& operator=(SharedSegment&& other) noexcept;
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    // Fails if the name is taken
+    bool Create(const std::string& name, size_t size, std::string* error = nullptr);
+    bool Open(const std::string& name, std::string* error = nullptr);
+    void Close();
+
+    uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+    const std::string& Name() const { return m_name; }
+    // Tells the object now behind Name() apart from an earlier one that was
+    // removed; 0 where the platform can't tell (see SegmentIdentity)
+    uint64_t Identity() const { return m_identity; }
+
+private:
+    std::string m_name;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    uint64_t m_identity = 0;
+    bool m_owner = false;
+    intptr_t m_handle = -1;
+};
+
+enum class BlurServerStatus : uint32_t {
+    Ok,
+    BadRequest,  // malformed, or an unknown engine
+    BadSegment,  // the named segment can't be opened
+    OutOfBounds, // an image runs past the end of its segment
+    ShuttingDown
+};
+
+const char* BlurServerStatusName(BlurServerStatus status);
+
+struct BlurServerOptions {
+    std::string socketPath;
+    unsigned threads = 0;   // blur pool size; 0 is one per core
+    unsigned maxBatch = 16; // requests blurred together
+    size_t maxSegments = 64; // mappings kept open, least recently used dropped
+};
+
+class BlurServer {
+public:
+    BlurServer();
+    // Stops, if still running
+    ~BlurServer();
+
+    // Listens on options.socketPath and serves from background threads
+    bool Start(const BlurServerOptions& options, std::string* error = nullptr);
+    // Answers what is queued with ShuttingDown, closes the connections and
+    // removes the socket file
+    void Stop();
+
+    // The stats endpoint's JSON: request, error and batch counts, queue depth,
+    // mapped segments, and queue and blur time percentiles of recent requests
+    std::string StatsJson() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+// Runs a server until SIGINT or SIGTERM; the process exit code
+int RunBlurServer(const BlurServerOptions& options);
+
+struct BlurReply {
+    BlurServerStatus status = BlurServerStatus::Ok;
+    double queueMs = 0.0; // from arrival to the start of its batch
+    double blurMs = 0.0;  // the whole batch, copies included
+    uint32_t batchSize = 0;
+};
+
+// One connection to a server. Not thread-safe; give each thread its own.
+class BlurClient {
+public:
+    bool Connect(const std::string& socketPath, std::string* error = nullptr);
+    bool Connected() const { return m_socket.Valid(); }
+
+    // Blurs the width x height RGBA8 image at srcOffset in segment into
+    // dstOffset, which may be the same, and waits for the answer. False when
+    // the connection fails or the server answers with an error.
+    bool Blur(const SharedSegment& segment, size_t srcOffset, size_t dstOffset, uint32_t width, uint32_t height,
+        float blurRadius, CpuBlurEngine engine, int priority = 0, BlurReply* reply = nullptr,
+        std::string* error = nullptr);
+
+    bool Stats(std::string& json, std::string* error = nullptr);
+
+private:
+    Socket m_socket;
+    uint64_t m_nextId = 1;
+};
@@ -0,0 +1,223 @@
+#include "CpuBlurKernels.h"
+
+#if RTBLUR_HAS_X86_KERNELS
+
+#include <cstring>
+#include <smmintrin.h>
+
+// One __m128 holds one RGBA pixel as four floats; each loop iteration blurs
+// four pixels (16 bytes) with four independent accumulators.
+
+namespace {
+
+RTBLUR_TARGET("sse4.1")
+inline __m128 LoadPixelFloats(const uint8_t* p) {
+    int32_t bits;
+    memcpy(&bits, p, 4);
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits)));
+}
+
+RTBLUR_TARGET("sse4.1")
+inline void Store16(uint8_t* dst, __m128 a, __m128 b, __m128 c, __m128 d) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128i ia = _mm_cvttps_epi32(_mm_add_ps(a, half));
+    __m128i ib = _mm_cvttps_epi32(_mm_add_ps(b, half));
+    __m128i ic = _mm_cvttps_epi32(_mm_add_ps(c, half));
+    __m128i id = _mm_cvttps_epi32(_mm_add_ps(d, half));
+    __m128i packed = _mm_packus_epi16(_mm_packus_epi32(ia, ib), _mm_packus_epi32(ic, id));
+    _mm_storeu_si128((__m128i*)dst, packed);
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("sse4.1")
+void HorizontalRowSse41(const uint8_t* paddedSrc, uint8_t* dst, uint32_t width,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m128 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+        const uint8_t* src = paddedSrc + x * 4;
+        for (int i = -radius; i <= radius; i++) {
+            __m128 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm_set1_ps(weights[i < 0 ? -i : i]);
+            const uint8_t* p = src + (radius + i) * 4;
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, LoadPixelFloats(p + 0)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, LoadPixelFloats(p + 4)));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(w, LoadPixelFloats(p + 8)));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(w, LoadPixelFloats(p + 12)));
+        }
+        Store16(dst + x * 4, acc0, acc1, acc2, acc3);
+    }
+    HorizontalRowScalar(paddedSrc, dst, x, width, weights, radius);
+}
+
+template <int FixedRadius>
+RTBLUR_TARGET("sse4.1")
+void VerticalRowSse41(const uint8_t* const* rows, uint8_t* dst, size_t count,
+    const float* weights, int radius)
+{
+    // A compile-time radius unrolls the taps and broadcasts each weight once per row
+    if (FixedRadius != kRuntimeRadius) radius = FixedRadius;
+    __m128 fixedWeights[FixedRadius != kRuntimeRadius ? 2 * FixedRadius + 1 : 1];
+    if (FixedRadius != kRuntimeRadius) {
+        for (int i = -radius; i <= radius; i++) fixedWeights[i + radius] = _mm_set1_ps(weights[i < 0 ? -i : i]);
+    }
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps(), acc3 = _mm_setzero_ps();
+        for (int i = -radius; i <= radius; i++) {
+            __m128 w = FixedRadius != kRuntimeRadius ? fixedWeights[i + radius]
+                : _mm_set1_ps(weights[i < 0 ? -i : i]);
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(rows[i + radius] + k));
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes))));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)))));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)))));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)))));
+        }
+        Store16(dst + k, acc0, acc1, acc2, acc3);
+    }
+    VerticalRowScalar(rows, dst, k, count, weights, radius);
+}
+
+// Fixed-point kernels, as in CpuBlurAvx2.cpp with eight samples per block
+template <typename T>
+RTBLUR_TARGET("sse4.1")
+inline __m128i LoadFixedPointSamples(const uint8_t* p);
+
+template <>
+RTBLUR_TARGET("sse4.1")
+inline __m128i LoadFixedPointSamples<uint8_t>(const uint8_t* p) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)p));
+}
+
+template <>
+RTBLUR_TARGET("sse4.1")
+inline __m128i LoadFixedPointSamples<uint16_t>(const uint8_t* p) {
+    return _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi16((short)0x8000));
+}
+
+template <typename T>
+RTBLUR_TARGET("sse4.1")
+inline void StoreFixedPointSamples(uint8_t* dst, __m128i lo, __m128i hi) {
+    const __m128i half = _mm_set1_epi32(1 << (kFixedPointWeightBits - 1));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, half), kFixedPointWeightBits);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, half), kFixedPointWeightBits);
+    if (sizeof(T) == 1) {
+        __m128i words = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(words, words));
+    }
+    else {
+        const __m128i bias = _mm_set1_epi32(32768);
+        _mm_storeu_si128((__m128i*)dst, _mm_packus_epi32(_mm_add_epi32(lo, bias), _mm_add_epi32(hi, bias)));
+    }
+}
+
+template <typename T>
+RTBLUR_TARGET("sse4.1")
+inline void AccumulateFixedPointPair(__m128i& lo, __m128i& hi, __m128i a, __m128i b, __m128i weights) {
+    lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+    hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+}
+
+template <typename T>
+RTBLUR_TARGET("sse4.1")
+void VerticalRowFixedPointSse41(const uint8_t* const* taps, uint8_t* dst, size_t count,
+    const int16_t* weights, int radius)
+{
+    __m128i pairWeights[kMaxKernelRadius + 1];
+    for (int p = 0; p < radius; p++) {
+        int i = 2 * p - radius;
+        int32_t w0 = (uint16_t)weights[i < 0 ? -i : i];
+        int32_t w1 = (uint16_t)weights[i + 1 < 0 ? -(i + 1) : i + 1];
+        pairWeights[p] = _mm_set1_epi32(w0 | (w1 << 16));
+    }
+    pairWeights[radius] = _mm_set1_epi32((uint16_t)weights[radius]);
+    const uint8_t* lastTap = taps[2 * radius];
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16) {
+        size_t offset = k * sizeof(T);
+        size_t offset2 = offset + 8 * sizeof(T);
+        __m128i lo = zero, hi = zero, lo2 = zero, hi2 = zero;
+        for (int p = 0; p < radius; p++) {
+            const uint8_t* a = taps[2 * p];
+            const uint8_t* b = taps[2 * p + 1];
+            AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(a + offset),
+                LoadFixedPointSamples<T>(b + offset), pairWeights[p]);
+            AccumulateFixedPointPair<T>(lo2, hi2, LoadFixedPointSamples<T>(a + offset2),
+                LoadFixedPointSamples<T>(b + offset2), pairWeights[p]);
+        }
+        AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(lastTap + offset), zero, pairWeights[radius]);
+        AccumulateFixedPointPair<T>(lo2, hi2, LoadFixedPointSamples<T>(lastTap + offset2), zero, pairWeights[radius]);
+        StoreFixedPointSamples<T>(dst + offset, lo, hi);
+        StoreFixedPointSamples<T>(dst + offset2, lo2, hi2);
+    }
+    for (; k + 8 <= count; k += 8) {
+        size_t offset = k * sizeof(T);
+        __m128i lo = zero, hi = zero;
+        for (int p = 0; p < radius; p++) {
+            AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(taps[2 * p] + offset),
+                LoadFixedPointSamples<T>(taps[2 * p + 1] + offset), pairWeights[p]);
+        }
+        AccumulateFixedPointPair<T>(lo, hi, LoadFixedPointSamples<T>(lastTap + offset), zero, pairWeights[radius]);
+        StoreFixedPointSamples<T>(dst + offset, lo, hi);
+    }
+    VerticalRowFixedPointScalar<T>(taps, dst, k, count, weights, radius);
+}
+
+// Four rows of four pixels per block: pair up the pixels of rows r, r + 1
+// and of r + 2, r + 3, then the pairs into columns.
+RTBLUR_TARGET("sse4.1")
+void TransposePixelsSse41(const uint8_t* const* rows, uint32_t rowCount, uint32_t x0, uint32_t columns,
+    uint8_t* dst, size_t dstPitch)
+{
+    uint32_t blockRows = rowCount & ~3u;
+    uint32_t blockColumns = columns & ~3u;
+    for (uint32_t r = 0; r < blockRows; r += 4) {
+        for (uint32_t c = 0; c < blockColumns; c += 4) {
+            size_t offset = (size_t)(x0 + c) * 4;
+            __m128i a = _mm_loadu_si128((const __m128i*)(rows[r + 0] + offset));
+            __m128i b = _mm_loadu_si128((const __m128i*)(rows[r + 1] + offset));
+            __m128i e = _mm_loadu_si128((const __m128i*)(rows[r + 2] + offset));
+            __m128i f = _mm_loadu_si128((const __m128i*)(rows[r + 3] + offset));
+            __m128i ab0 = _mm_unpacklo_epi32(a, b); // a0 b0 a1 b1
+            __m128i ab1 = _mm_unpackhi_epi32(a, b); // a2 b2 a3 b3
+            __m128i ef0 = _mm_unpacklo_epi32(e, f);
+            __m128i ef1 = _mm_unpackhi_epi32(e, f);
+            uint8_t* out = dst + c * dstPitch + (size_t)r * 4;
+            _mm_storeu_si128((__m128i*)(out + 0 * dstPitch), _mm_unpacklo_epi64(ab0, ef0));
+            _mm_storeu_si128((__m128i*)(out + 1 * dstPitch), _mm_unpackhi_epi64(ab0, ef0));
+            _mm_storeu_si128((__m128i*)(out + 2 * dstPitch), _mm_unpacklo_epi64(ab1, ef1));
+            _mm_storeu_si128((__m128i*)(out + 3 * dstPitch), _mm_unpackhi_epi64(ab1, ef1));
+        }
+        TransposePixelsScalar(rows, r, r + 4, x0, blockColumns, columns, dst, dstPitch);
+    }
+    TransposePixelsScalar(rows, blockRows, rowCount, x0, 0, columns, dst, dstPitch);
+}
+
+} // namespace
+
+const TransposePixelsKernel g_cpuTransposePixelsSse41 = TransposePixelsSse41;
+
+const CpuFixedPointRowKernels g_cpuFixedPointKernelsSse41 = {
+    CpuIsa::Sse41,
+    HorizontalRowFixedPoint<uint8_t, VerticalRowFixedPointSse41<uint8_t>>, VerticalRowFixedPointSse41<uint8_t>,
+    HorizontalRowFixedPoint<uint16_t, VerticalRowFixedPointSse41<uint16_t>>, VerticalRowFixedPointSse41<uint16_t>,
+};
+
+const CpuBlurRowKernels g_cpuBlurKernelsSse41 = {
+    CpuIsa::Sse41, HorizontalRowSse41<kRuntimeRadius>, VerticalRowSse41<kRuntimeRadius>,
+    RTBLUR_FIXED_RADIUS_KERNELS(HorizontalRowCopy<4>, HorizontalRowSse41, ),
+    RTBLUR_FIXED_RADIUS_KERNELS(VerticalRowCopy<1>, VerticalRowSse41, ),
+};
+
+#endif
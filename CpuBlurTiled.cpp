@@ -0,0 +1,244 @@
+#include "CpuBlurTiled.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurKernels.h"
+#include "GaussianKernel.h"
+#include "Trace.h"
+
+CpuBlurTiling ChooseCpuBlurTiling(uint32_t width, uint32_t height, int kernelRadius) {
+    CpuBlurTiling tiling;
+    size_t rowPitch = (size_t)width * 4;
+    size_t windowRows = 2 * (size_t)kernelRadius + 1;
+
+    // Horizontal: a band of source rows plus the output rows stays in cache
+    size_t bandRows = kCpuBlurTileBytes / (2 * rowPitch);
+    tiling.bandRows = (uint32_t)std::min<size_t>(std::max<size_t>(bandRows, 1), height);
+
+    // Vertical: the 2r + 1 rows a strip slides over stay in cache, in whole
+    // 64-byte lines so neighbouring strips never share one
+    size_t stripBytes = kCpuBlurTileBytes / windowRows / 64 * 64;
+    stripBytes = std::max<size_t>(stripBytes, 64);
+    tiling.stripColumns = (uint32_t)std::min<size_t>(stripBytes / 4, width);
+
+    // Taller tasks reuse more of the window; 4x the window keeps about 80% of
+    // the loaded rows useful
+    size_t stripRows = std::max<size_t>(64, 4 * windowRows);
+    tiling.stripRows = (uint32_t)std::min<size_t>(stripRows, height);
+
+    // Transpose: half the tile holds the transposed columns, 2r + 1 rows
+    // longer than the output
+    size_t columnBytes = (size_t)kCpuBlurTransposeColumns * 4;
+    size_t transposeRows = kCpuBlurTileBytes / 2 / columnBytes;
+    transposeRows = transposeRows > windowRows + 64 ? transposeRows - windowRows + 1 : 64;
+    tiling.transposeRows = (uint32_t)std::min<size_t>(transposeRows, height);
+
+    // Fused: the 2r + 1 horizontally blurred rows the vertical kernel slides
+    // over take half of the detected L2. Tiles are tall, as each one blurs
+    // its 2r halo rows horizontally again; 8x the halo keeps that at 12.5% at
+    // most, and CpuBlurFusedTileRows never shortens them below it.
+    size_t l2 = GetCpuCacheSizes().l2;
+    size_t scratchBytes = (l2 ? l2 : kCpuBlurTileBytes) / 2;
+    size_t fusedColumns = scratchBytes / (windowRows * 4) / 16 * 16;
+    fusedColumns = std::min<size_t>(std::max<size_t>(fusedColumns, 16), 1024);
+    tiling.fusedColumns = (uint32_t)std::min<size_t>(fusedColumns, width);
+    size_t fusedRows = std::max<size_t>(256, 16 * (size_t)kernelRadius);
+    tiling.fusedRows = (uint32_t)std::min<size_t>(fusedRows, height);
+    return tiling;
+}
+
+namespace {
+
+std::atomic<int> g_cpuBlurSchedule{ (int)CpuBlurSchedule::Auto };
+std::atomic<int> g_cpuVerticalPass{ (int)CpuVerticalPass::Auto };
+
+// Blurs the pixels [x0, x1) x [y0, y1) of src into dst, top to bottom. The
+// source rows they tap are blurred horizontally into a ring of 2r + 1 rows
+// just ahead of the vertical kernel, each from a padded copy of its pixels
+// x0 - r to x1 + r, clamped like CpuBlurHorizontalRows pads a row, so every
+// intermediate value equals the two-pass one.
+void BlurFusedTile(const CpuImage& src, CpuImage& dst, const GaussianKernel& kernel, HorizontalRowKernel horizontal,
+    VerticalRowKernel vertical, uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1)
+{
+    int radius = kernel.radius;
+    const float* weights = kernel.weights.data();
+    uint32_t columns = x1 - x0;
+    size_t scratchPitch = (size_t)columns * 4;
+    int lastRow = (int)src.height - 1;
+    int top = std::max((int)y0 - radius, 0);
+    int bottom = std::min((int)y1 - 1 + radius, lastRow);
+
+    // The part of the padded segment inside the image, and how many edge
+    // pixels repeat on either side of it
+    uint32_t inside0 = (uint32_t)std::max((int)x0 - radius, 0);
+    uint32_t inside1 = std::min(x1 + radius, src.width);
+    uint32_t leftRepeat = inside0 + radius - x0;
+    uint32_t rightRepeat = x1 + radius - inside1;
+
+    // Source row sy lives in slot sy % windowRows. Clamping only repeats the
+    // first and last image rows, which stay in the ring while they're tapped.
+    int windowRows = 2 * radius + 1;
+    thread_local std::vector<uint8_t> padded;
+    thread_local std::vector<uint8_t> ring;
+    thread_local std::vector<const uint8_t*> rows;
+    padded.resize(((size_t)columns + 2 * radius) * 4);
+    ring.resize((size_t)windowRows * scratchPitch);
+    rows.resize(windowRows);
+
+    int blurred = top; // next source row to blur horizontally
+    for (uint32_t y = y0; y < y1; y++) {
+        int needed = std::min((int)y + radius, bottom);
+        for (; blurred <= needed; blurred++) {
+            const uint8_t* row = src.Row(blurred);
+            uint8_t* out = padded.data();
+            for (uint32_t i = 0; i < leftRepeat; i++, out += 4) memcpy(out, row + (size_t)inside0 * 4, 4);
+            memcpy(out, row + (size_t)inside0 * 4, (size_t)(inside1 - inside0) * 4);
+            out += (size_t)(inside1 - inside0) * 4;
+            for (uint32_t i = 0; i < rightRepeat; i++, out += 4) memcpy(out, row + (size_t)(inside1 - 1) * 4, 4);
+            horizontal(padded.data(), ring.data() + (blurred % windowRows) * scratchPitch, columns, weights, radius);
+        }
+        for (int i = -radius; i <= radius; i++) {
+            int sy = std::min(std::max((int)y + i, 0), lastRow);
+            rows[i + radius] = ring.data() + (sy % windowRows) * scratchPitch;
+        }
+        vertical(rows.data(), dst.Row(y) + (size_t)x0 * 4, scratchPitch, weights, radius);
+    }
+}
+
+} // namespace
+
+const char* CpuBlurScheduleName(CpuBlurSchedule schedule) {
+    switch (schedule) {
+    case CpuBlurSchedule::Auto: return "auto";
+    case CpuBlurSchedule::TwoPass: return "two-pass";
+    case CpuBlurSchedule::Fused: return "fused";
+    default: return "?";
+    }
+}
+
+CpuBlurSchedule GetCpuBlurSchedule() {
+    return (CpuBlurSchedule)g_cpuBlurSchedule.load();
+}
+
+void SetCpuBlurSchedule(CpuBlurSchedule schedule) {
+    g_cpuBlurSchedule = (int)schedule;
+}
+
+uint32_t CpuBlurFusedTileRows(const CpuBlurTiling& tiling, uint32_t width, uint32_t height, int kernelRadius,
+    uint32_t threadCount)
+{
+    size_t tileColumns = (width + tiling.fusedColumns - 1) / tiling.fusedColumns;
+    uint32_t minRows = std::max<uint32_t>(64, 16 * (uint32_t)kernelRadius);
+    uint32_t tileRows = tiling.fusedRows;
+    while (tileRows / 2 >= minRows && tileColumns * ((height + tileRows - 1) / tileRows) < 2 * (size_t)threadCount) {
+        tileRows /= 2;
+    }
+    return tileRows;
+}
+
+CpuBlurSchedule ResolveCpuBlurSchedule(uint32_t width, uint32_t height, int kernelRadius, uint32_t threadCount) {
+    CpuBlurSchedule schedule = GetCpuBlurSchedule();
+    if (schedule != CpuBlurSchedule::Auto) return schedule;
+    if (kernelRadius > kCpuBlurFusedMaxRadius) return CpuBlurSchedule::TwoPass;
+    CpuBlurTiling tiling = ChooseCpuBlurTiling(width, height, kernelRadius);
+    uint32_t tileRows = CpuBlurFusedTileRows(tiling, width, height, kernelRadius, threadCount);
+    size_t tileColumns = (width + tiling.fusedColumns - 1) / tiling.fusedColumns;
+    return tileColumns * ((height + tileRows - 1) / tileRows) >= threadCount ? CpuBlurSchedule::Fused : CpuBlurSchedule::TwoPass;
+}
+
+const char* CpuVerticalPassName(CpuVerticalPass pass) {
+    switch (pass) {
+    case CpuVerticalPass::Auto: return "auto";
+    case CpuVerticalPass::Strips: return "strips";
+    case CpuVerticalPass::Transpose: return "transpose";
+    default: return "?";
+    }
+}
+
+CpuVerticalPass GetCpuVerticalPass() {
+    return (CpuVerticalPass)g_cpuVerticalPass.load();
+}
+
+void SetCpuVerticalPass(CpuVerticalPass pass) {
+    g_cpuVerticalPass = (int)pass;
+}
+
+CpuVerticalPass ResolveCpuVerticalPass(uint32_t width, int kernelRadius) {
+    CpuVerticalPass pass = GetCpuVerticalPass();
+    if (pass != CpuVerticalPass::Auto) return pass;
+    size_t rowBytes = (size_t)width * 4;
+    size_t windowBytes = (2 * (size_t)kernelRadius + 1) * rowBytes;
+    bool transpose = rowBytes >= kCpuBlurTransposeRowBytes && windowBytes > kCpuBlurTransposeWindowBytes;
+    return transpose ? CpuVerticalPass::Transpose : CpuVerticalPass::Strips;
+}
+
+void CpuGaussianBlurTiled(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool) {
+    if (src.Empty()) return;
+
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+    if (CpuBlurIsCopy(*kernel)) {
+        if (&dst != &src) dst = src;
+        return;
+    }
+    CpuBlurTiling tiling = ChooseCpuBlurTiling(src.width, src.height, kernel->radius);
+
+    // Fused tiles read source pixels other tiles write, so blurring in place
+    // needs the intermediate image
+    uint32_t threadCount = pool.ThreadCount();
+    if (ResolveCpuBlurSchedule(src.width, src.height, kernel->radius, threadCount) == CpuBlurSchedule::Fused &&
+        &dst != &src)
+    {
+        TRACE_SCOPE("fused passes");
+        const CpuBlurRowKernels& kernels = GetCpuBlurRowKernels(GetCpuBlurIsa());
+        HorizontalRowKernel horizontal = SelectHorizontalRowKernel(kernels, kernel->radius);
+        VerticalRowKernel vertical = SelectVerticalRowKernel(kernels, kernel->radius);
+        if (dst.width != src.width || dst.height != src.height) dst = CpuImage(src.width, src.height);
+
+        size_t tileColumns = (src.width + tiling.fusedColumns - 1) / tiling.fusedColumns;
+        uint32_t tileRows = CpuBlurFusedTileRows(tiling, src.width, src.height, kernel->radius, threadCount);
+        size_t tilesPerColumn = (src.height + tileRows - 1) / tileRows;
+        pool.ParallelFor(tileColumns * tilesPerColumn, [&](size_t tile) {
+            uint32_t x0 = (uint32_t)(tile / tilesPerColumn) * tiling.fusedColumns;
+            uint32_t y0 = (uint32_t)(tile % tilesPerColumn) * tileRows;
+            BlurFusedTile(src, dst, *kernel, horizontal, vertical, x0, std::min(x0 + tiling.fusedColumns, src.width),
+                y0, std::min(y0 + tileRows, src.height));
+        });
+        return;
+    }
+
+    CpuImage temp(src.width, src.height);
+    {
+        TRACE_SCOPE("horizontal pass");
+        size_t bandCount = (src.height + tiling.bandRows - 1) / tiling.bandRows;
+        pool.ParallelFor(bandCount, [&](size_t band) {
+            uint32_t y0 = (uint32_t)band * tiling.bandRows;
+            uint32_t y1 = std::min(y0 + tiling.bandRows, src.height);
+            CpuBlurHorizontalRows(src, temp, *kernel, y0, y1);
+        });
+    }
+
+    TRACE_SCOPE("vertical pass");
+    if (dst.width != src.width || dst.height != src.height) dst = CpuImage(src.width, src.height);
+    bool transpose = ResolveCpuVerticalPass(src.width, kernel->radius) == CpuVerticalPass::Transpose;
+    uint32_t blockRows = transpose ? tiling.transposeRows : tiling.stripRows;
+    size_t stripCount = (src.width + tiling.stripColumns - 1) / tiling.stripColumns;
+    size_t blocksPerStrip = (src.height + blockRows - 1) / blockRows;
+    pool.ParallelFor(stripCount * blocksPerStrip, [&](size_t tile) {
+        uint32_t strip = (uint32_t)(tile / blocksPerStrip);
+        uint32_t block = (uint32_t)(tile % blocksPerStrip);
+        uint32_t x0 = strip * tiling.stripColumns;
+        uint32_t x1 = std::min(x0 + tiling.stripColumns, src.width);
+        uint32_t y0 = block * blockRows;
+        uint32_t y1 = std::min(y0 + blockRows, src.height);
+        if (transpose) {
+            CpuBlurVerticalRowsTransposed(temp, dst, *kernel, y0, y1, x0, x1);
+        }
+        else {
+            CpuBlurVerticalRows(temp, dst, *kernel, y0, y1, x0, x1);
+        }
+    });
+}
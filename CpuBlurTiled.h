@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Multithreaded CpuGaussianBlur. The horizontal pass is split into row bands
+// and the vertical pass into column strips (cut again into row blocks), each
+// sized to stay in cache, and all of them run on a ThreadPool. On wide images
+// with large radii the strips transpose their columns instead
+// (CpuVerticalPass). Every output
+// pixel goes through the same row kernels as the single-threaded path, so the
+// result is bit-identical for any thread count.
+
+// Working set one tile aims for; roughly a per-core L2.
+constexpr size_t kCpuBlurTileBytes = 256 * 1024;
+
+struct CpuBlurTiling {
+    uint32_t bandRows;      // rows per horizontal-pass task
+    uint32_t stripColumns;  // pixels per vertical-pass strip
+    uint32_t stripRows;     // rows per vertical-pass task within a strip
+    uint32_t transposeRows; // rows per task with CpuVerticalPass::Transpose
+    uint32_t fusedColumns;  // tile size with CpuBlurSchedule::Fused
+    uint32_t fusedRows;
+};
+
+CpuBlurTiling ChooseCpuBlurTiling(uint32_t width, uint32_t height, int kernelRadius);
+
+// How the two passes are scheduled. Both give the same output; RTBlurBench
+// --fused times them against each other.
+enum class CpuBlurSchedule {
+    Auto, // ResolveCpuBlurSchedule picks per image, radius and thread count (the default)
+    // The horizontal pass over the whole image into a full-size intermediate,
+    // then the vertical pass, like ApplyGaussianBlur's g_tempTexture
+    TwoPass,
+    // Each task walks a tile top to bottom, blurring the source rows it and
+    // its halo tap horizontally into a ring of 2r + 1 rows sized to stay in
+    // L2, and the ring vertically into dst. No intermediate image, so about
+    // half the memory traffic
+    Fused,
+    Count,
+};
+
+// Largest kernel radius Auto runs fused. Beyond it the passes are bound by
+// arithmetic rather than memory, and blurring the halo rows twice loses more
+// than the intermediate image saves (0.77x to 0.97x from radius 5 up, and
+// 0.84x to 0.89x at radius 62 and 186 with 1 to 3 threads, in RTBlurBench --fused).
+constexpr int kCpuBlurFusedMaxRadius = 3;
+
+const char* CpuBlurScheduleName(CpuBlurSchedule schedule);
+CpuBlurSchedule GetCpuBlurSchedule();
+void SetCpuBlurSchedule(CpuBlurSchedule schedule);
+
+// Rows per fused tile: tiling.fusedRows, halved while there are fewer than two
+// tiles per thread, but never below 8x the 2r halo rows each tile blurs twice
+uint32_t CpuBlurFusedTileRows(const CpuBlurTiling& tiling, uint32_t width, uint32_t height, int kernelRadius,
+    uint32_t threadCount);
+
+// The schedule set with SetCpuBlurSchedule, or for Auto: fused when the kernel
+// radius is at most kCpuBlurFusedMaxRadius and the fused tiles give every
+// thread one, else two-pass
+CpuBlurSchedule ResolveCpuBlurSchedule(uint32_t width, uint32_t height, int kernelRadius, uint32_t threadCount);
+
+// How the vertical pass walks the intermediate image. Both give the same
+// output; RTBlurBench --vertical-pass times them against each other.
+enum class CpuVerticalPass {
+    Auto,      // ResolveCpuVerticalPass picks per image and radius (the default)
+    Strips,    // vertical row kernels over column strips (CpuBlurVerticalRows)
+    Transpose, // transpose column blocks into rows and run the horizontal kernel (CpuBlurVerticalRowsTransposed)
+    Count,
+};
+
+const char* CpuVerticalPassName(CpuVerticalPass pass);
+CpuVerticalPass GetCpuVerticalPass();
+void SetCpuVerticalPass(CpuVerticalPass pass);
+
+// The strategy GetCpuVerticalPass() gives for an image width and kernel radius.
+// Auto transposes when rows are at least kCpuBlurTransposeRowBytes apart and
+// the 2r + 1 rows a strip slides over span more than
+// kCpuBlurTransposeWindowBytes: then every row a strip taps misses the cache
+// and TLB, while the transpose reads each row once per block of columns. On
+// one core that won 1.1-2x at 16K and 32K pixels wide from radius 20 up;
+// narrower images, or a small radius, ran as fast or faster in strips.
+constexpr size_t kCpuBlurTransposeRowBytes = 64 * 1024;
+constexpr size_t kCpuBlurTransposeWindowBytes = 2 * 1024 * 1024;
+
+CpuVerticalPass ResolveCpuVerticalPass(uint32_t width, int kernelRadius);
+
+void CpuGaussianBlurTiled(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool);
@@ -0,0 +1,122 @@
+#include "CpuBoxBlur.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+
+namespace {
+
+// Pixels per vertical strip: 64 floats across, so a row of the strip is one
+// short contiguous run the compiler can vectorize.
+constexpr uint32_t kBoxStripColumns = 16;
+
+// One box of 2 * radius + 1 taps along a line of `length` positions, each
+// holding `lanes` interleaved floats. Edge positions repeat (clamp). The
+// running sums are double so long lines don't drift.
+void BoxPass(const float* in, float* out, int length, int lanes, int radius, std::vector<double>& sums) {
+    int last = length - 1;
+    sums.assign(lanes, 0.0);
+
+    // Window around position 0: radius copies of in[0] on the left, then
+    // in[0..radius] with the clamp repeating in[last] past the end
+    for (int l = 0; l < lanes; l++) {
+        double sum = radius * (double)in[l];
+        for (int i = 0; i <= radius; i++) sum += in[std::min(i, last) * lanes + l];
+        sums[l] = sum;
+    }
+
+    double scale = 1.0 / (2 * radius + 1);
+    for (int p = 0; p < length; p++) {
+        float* o = out + (size_t)p * lanes;
+        const float* add = in + (size_t)std::min(p + radius + 1, last) * lanes;
+        const float* sub = in + (size_t)std::max(p - radius, 0) * lanes;
+        for (int l = 0; l < lanes; l++) {
+            o[l] = (float)(sums[l] * scale);
+            sums[l] += (double)add[l] - (double)sub[l];
+        }
+    }
+}
+
+// Runs every box of the cascade over a line of `length` positions that starts
+// `pad` positions into a, ping-ponging between a and b. The pad positions on
+// either side are filled with copies of the line's end positions first, so
+// with pad at least the sum of the radii, the boxes see the source clamped
+// rather than each clamping the previous box's output: the result is the
+// combined kernel applied with clamp addressing, edges included. Returns
+// where the line's result starts.
+const float* BoxCascadeLine(float* a, float* b, int length, int pad, int lanes, const BoxCascade& cascade,
+    std::vector<double>& sums)
+{
+    float* first = a + (size_t)pad * lanes;
+    float* last = a + (size_t)(pad + length - 1) * lanes;
+    for (int p = 0; p < pad; p++) {
+        std::copy(first, first + lanes, a + (size_t)p * lanes);
+        std::copy(last, last + lanes, last + (size_t)(p + 1) * lanes);
+    }
+
+    for (int radius : cascade.radii) {
+        if (radius == 0) continue;
+        BoxPass(a, b, length + 2 * pad, lanes, radius, sums);
+        std::swap(a, b);
+    }
+    return a + (size_t)pad * lanes;
+}
+
+} // namespace
+
+void CpuBoxCascadeBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool, int passes) {
+    if (src.Empty()) return;
+
+    BoxCascade cascade = BuildBoxCascade(SigmaFromBlurRadius(blurRadius), passes);
+    uint32_t width = src.width, height = src.height;
+    int pad = 0;
+    for (int radius : cascade.radii) pad += radius;
+
+    // Horizontal: one row per task-iteration, four lanes (RGBA) per position
+    CpuImage temp(width, height);
+    const uint32_t bandRows = 16;
+    pool.ParallelFor((height + bandRows - 1) / bandRows, [&](size_t band) {
+        thread_local std::vector<float> a, b;
+        thread_local std::vector<double> sums;
+        a.resize((size_t)(width + 2 * pad) * 4);
+        b.resize(a.size());
+
+        uint32_t y0 = (uint32_t)band * bandRows;
+        uint32_t y1 = std::min(y0 + bandRows, height);
+        for (uint32_t y = y0; y < y1; y++) {
+            const uint8_t* row = src.Row(y);
+            float* line = a.data() + (size_t)pad * 4;
+            for (size_t i = 0; i < (size_t)width * 4; i++) line[i] = row[i];
+            const float* result = BoxCascadeLine(a.data(), b.data(), (int)width, pad, 4, cascade, sums);
+            uint8_t* out = temp.Row(y);
+            for (size_t i = 0; i < (size_t)width * 4; i++) out[i] = QuantizeUnorm8(result[i]);
+        }
+    });
+
+    // Vertical: a strip of columns runs down the whole image, one position per
+    // row, so every step reads and writes contiguous memory
+    if (dst.width != width || dst.height != height) dst = CpuImage(width, height);
+    pool.ParallelFor((width + kBoxStripColumns - 1) / kBoxStripColumns, [&](size_t strip) {
+        uint32_t x0 = (uint32_t)strip * kBoxStripColumns;
+        uint32_t columns = std::min(kBoxStripColumns, width - x0);
+        int lanes = (int)columns * 4;
+
+        thread_local std::vector<float> a, b;
+        thread_local std::vector<double> sums;
+        a.resize((size_t)(height + 2 * pad) * lanes);
+        b.resize(a.size());
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = temp.Row(y) + (size_t)x0 * 4;
+            float* line = a.data() + (size_t)(pad + y) * lanes;
+            for (int l = 0; l < lanes; l++) line[l] = row[l];
+        }
+        const float* result = BoxCascadeLine(a.data(), b.data(), (int)height, pad, lanes, cascade, sums);
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* out = dst.Row(y) + (size_t)x0 * 4;
+            const float* line = result + (size_t)y * lanes;
+            for (int l = 0; l < lanes; l++) out[l] = QuantizeUnorm8(line[l]);
+        }
+    });
+}
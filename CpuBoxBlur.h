@@ -0,0 +1,14 @@
+#pragma once
+
+#include "CpuImage.h"
+#include "GaussianKernel.h"
+#include "ThreadPool.h"
+
+// "Fast Gaussian": BuildBoxCascade's boxes applied with running sums, so the
+// cost per pixel is the same at any radius. Each direction keeps float
+// intermediates between its boxes; the horizontal result is stored as 8-bit
+// like the other CPU paths. Clamp addressing at the edges, applied to the
+// source: lines are padded by the cascade's reach so the boxes don't each clamp
+// the previous one's output, which would lose up to ~40 steps at a corner.
+void CpuBoxCascadeBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool,
+    int passes = 3);
@@ -0,0 +1,302 @@
+#include "CpuEngineProfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "CpuBlur.h"
+#include "CpuFeatures.h"
+#include "CpuReferenceBlur.h"
+#include "GaussianKernel.h"
+#include "Trace.h"
+
+const float kCpuEngineCalibrationRadius[kCpuEngineCalibrationRadii] = { 2.0f, 6.0f, 16.0f, 40.0f, 80.0f, 120.0f };
+
+namespace {
+
+// The small image mostly measures the fixed cost of a call, the large one the
+// cost per pixel; the accuracy image is blurred once per radius. The large one
+// is also at least twice the L2 (LargeCalibrationSide), so its cost per pixel
+// includes the trips to L3 and memory that real images make.
+constexpr uint32_t kSmallSide = 128;
+constexpr uint32_t kMinLargeSide = 1024;
+constexpr uint32_t kAccuracySide = 160;
+// Each timing repeats until it has run this long and at least this many
+// times, like RTBlurBench --min-seconds, so one slow run can't skew the model
+constexpr double kMinTimingSeconds = 0.1;
+constexpr int kMinTimingRuns = 3;
+constexpr const char* kProfileHeader = "RTBlur CPU engine profile 1";
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+bool Pickable(CpuBlurEngine engine) {
+    return engine != CpuBlurEngine::LinearLight;
+}
+
+// Blocks of flat color with hard edges over mild noise, as in RTBlurBench's
+// accuracy runs, so that the error shows at edges rather than averaging out
+void FillCalibrationPattern(CpuImage& image) {
+    uint32_t state = 12345;
+    for (uint32_t y = 0; y < image.height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < image.width; x++) {
+            uint32_t block = (x / 37) * 7919u + (y / 53) * 104729u;
+            block ^= block >> 7;
+            block *= 0x9E3779B1u;
+            for (int c = 0; c < 4; c++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                int value = (int)((block >> (c * 8)) & 0xFF) + (int)(state & 15) - 8;
+                row[x * 4 + c] = (uint8_t)std::min(std::max(value, 0), 255);
+            }
+        }
+    }
+}
+
+uint32_t LargeCalibrationSide() {
+    // 4 bytes a pixel, so twice the L2 in bytes is l2 / 2 pixels
+    uint32_t side = (uint32_t)std::ceil(std::sqrt(GetCpuCacheSizes().l2 / 2.0));
+    return std::max(side, kMinLargeSide);
+}
+
+// Fastest run of at least kMinTimingRuns that together take kMinTimingSeconds
+double BestMs(const CpuImage& src, CpuImage& dst, float blurRadius, CpuBlurEngine engine, ThreadPool& pool) {
+    double best = 0.0, totalMs = 0.0;
+    for (int i = 0; i < kMinTimingRuns || totalMs < kMinTimingSeconds * 1000.0; i++) {
+        auto start = std::chrono::steady_clock::now();
+        CpuBlurImage(src, dst, blurRadius, engine, pool);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = i == 0 ? ms : std::min(best, ms);
+        totalMs += ms;
+    }
+    return best;
+}
+
+// The calibration segment blurRadius falls in, [index, index + 1], and how far
+// along it: below 0 or above 1 outside the calibrated radii
+void LocateRadius(float blurRadius, int& index, double& t) {
+    index = 0;
+    while (index + 2 < kCpuEngineCalibrationRadii && blurRadius > kCpuEngineCalibrationRadius[index + 1]) index++;
+    float r0 = kCpuEngineCalibrationRadius[index], r1 = kCpuEngineCalibrationRadius[index + 1];
+    t = (blurRadius - r0) / (r1 - r0);
+}
+
+// Linear between calibration radii. Below the first the cost stays flat;
+// past the last it keeps rising with the last segment's slope, if it rises.
+double InterpolateCost(const double* values, float blurRadius) {
+    int index;
+    double t;
+    LocateRadius(blurRadius, index, t);
+    double v0 = values[index], v1 = values[index + 1];
+    if (t <= 0.0) return v0;
+    if (t >= 1.0) return v1 + std::max(v1 - v0, 0.0) * (t - 1.0);
+    return v0 + (v1 - v0) * t;
+}
+
+bool ParseEngineName(const char* name, CpuBlurEngine& engine) {
+    for (int i = 0; i < (int)CpuBlurEngine::Count; i++) {
+        if (!strcmp(name, CpuBlurEngineName((CpuBlurEngine)i))) {
+            engine = (CpuBlurEngine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool CpuEngineProfile::Matches(const ThreadPool& pool) const {
+    return Calibrated() && threads == pool.ThreadCount() && isa == CpuIsaName(GetCpuBlurIsa());
+}
+
+double CpuEngineProfile::PredictMs(CpuBlurEngine engine, uint32_t width, uint32_t height, float blurRadius) const {
+    const CpuEngineCost& cost = costs[(size_t)engine];
+    double pixels = (double)width * height;
+    return InterpolateCost(cost.overheadMs, blurRadius) + InterpolateCost(cost.nsPerPixel, blurRadius) * pixels * 1e-6;
+}
+
+double CpuEngineProfile::ExpectedError(CpuBlurEngine engine, float blurRadius) const {
+    const CpuEngineCost& cost = costs[(size_t)engine];
+    int index;
+    double t;
+    LocateRadius(blurRadius, index, t);
+    if (t <= 0.0) return cost.maxError[index];
+    if (t >= 1.0) return cost.maxError[index + 1];
+    return std::max(cost.maxError[index], cost.maxError[index + 1]);
+}
+
+void CalibrateCpuEngines(ThreadPool& pool, CpuEngineProfile& profile) {
+    TRACE_SCOPE("calibrate engines");
+    profile = CpuEngineProfile();
+    profile.isa = CpuIsaName(GetCpuBlurIsa());
+    profile.threads = pool.ThreadCount();
+
+    uint32_t largeSide = LargeCalibrationSide();
+    CpuImage small(kSmallSide, kSmallSide), large(largeSide, largeSide), accuracy(kAccuracySide, kAccuracySide);
+    FillCalibrationPattern(small);
+    FillCalibrationPattern(large);
+    FillCalibrationPattern(accuracy);
+    double smallPixels = (double)kSmallSide * kSmallSide;
+    double largePixels = (double)largeSide * largeSide;
+
+    // One output per size, so no timed run reallocates its output
+    CpuImage output, smallOutput, largeOutput;
+    std::vector<double> reference;
+    for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+        float blurRadius = kCpuEngineCalibrationRadius[r];
+        CpuReferenceGaussianBlur(accuracy, reference, SigmaFromBlurRadius(blurRadius), pool);
+        for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+            CpuBlurEngine engine = (CpuBlurEngine)e;
+            if (!Pickable(engine)) continue;
+            CpuEngineCost& cost = profile.costs[e];
+            cost.calibrated = true;
+            // Doubles as the warm-up: kernels built, scratch buffers allocated
+            CpuBlurImage(accuracy, output, blurRadius, engine, pool);
+            cost.maxError[r] = MeasureImageError(output, reference).maxAbs;
+
+            double smallMs = BestMs(small, smallOutput, blurRadius, engine, pool);
+            double largeMs = BestMs(large, largeOutput, blurRadius, engine, pool);
+            double msPerPixel = std::max((largeMs - smallMs) / (largePixels - smallPixels), 0.0);
+            cost.nsPerPixel[r] = msPerPixel * 1e6;
+            cost.overheadMs[r] = std::max(smallMs - msPerPixel * smallPixels, 0.0);
+        }
+    }
+}
+
+bool LoadCpuEngineProfile(const std::string& path, CpuEngineProfile& profile, std::string* error) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return Fail(error, "can't open " + path);
+    CpuEngineProfile loaded;
+    char line[512];
+    bool headerSeen = false, radiiMatch = false;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char name[64];
+        float radii[kCpuEngineCalibrationRadii + 1];
+        int index;
+        double overheadMs, nsPerPixel, maxError;
+        if (!strcmp(line, kProfileHeader)) {
+            headerSeen = true;
+        }
+        else if (sscanf(line, "isa %63s", name) == 1) {
+            loaded.isa = name;
+        }
+        else if (!strncmp(line, "threads ", 8)) {
+            loaded.threads = (unsigned)strtoul(line + 8, nullptr, 10);
+        }
+        else if (!strncmp(line, "radii", 5)) {
+            // A profile from a build with other calibration radii is stale
+            int count = 0;
+            char* cursor = line + 5;
+            for (char* end; count <= kCpuEngineCalibrationRadii; cursor = end) {
+                radii[count] = strtof(cursor, &end);
+                if (end == cursor) break;
+                count++;
+            }
+            radiiMatch = count == kCpuEngineCalibrationRadii &&
+                std::equal(radii, radii + count, kCpuEngineCalibrationRadius);
+        }
+        else if (sscanf(line, "%63s %d %lf %lf %lf", name, &index, &overheadMs, &nsPerPixel, &maxError) == 5) {
+            CpuBlurEngine engine;
+            if (!ParseEngineName(name, engine) || index < 0 || index >= kCpuEngineCalibrationRadii) continue;
+            CpuEngineCost& cost = loaded.costs[(size_t)engine];
+            cost.calibrated = Pickable(engine);
+            cost.overheadMs[index] = overheadMs;
+            cost.nsPerPixel[index] = nsPerPixel;
+            cost.maxError[index] = maxError;
+        }
+    }
+    fclose(file);
+    if (!headerSeen || !radiiMatch || !loaded.Calibrated()) return Fail(error, path + " is not a current engine profile");
+    profile = loaded;
+    return true;
+}
+
+bool SaveCpuEngineProfile(const std::string& path, const CpuEngineProfile& profile, std::string* error) {
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return Fail(error, "can't write " + path);
+    fprintf(file, "%s\nisa %s\nthreads %u\nradii", kProfileHeader, profile.isa.c_str(), profile.threads);
+    for (float radius : kCpuEngineCalibrationRadius) fprintf(file, " %g", radius);
+    fprintf(file, "\n# engine, radius index, ms per call, ns per pixel, max error in 8-bit steps\n");
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        const CpuEngineCost& cost = profile.costs[e];
+        if (!cost.calibrated) continue;
+        for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+            fprintf(file, "%s %d %.6g %.6g %.6g\n", CpuBlurEngineName((CpuBlurEngine)e), r, cost.overheadMs[r],
+                cost.nsPerPixel[r], cost.maxError[r]);
+        }
+    }
+    bool ok = fclose(file) == 0;
+    return ok || Fail(error, "can't write " + path);
+}
+
+std::string DefaultCpuEngineProfilePath() {
+    namespace fs = std::filesystem;
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    if (base && *base) return (fs::path(base) / "RTBlur" / "engines.txt").string();
+#else
+    const char* cache = getenv("XDG_CACHE_HOME");
+    if (cache && *cache) return (fs::path(cache) / "rtblur" / "engines.txt").string();
+    const char* home = getenv("HOME");
+    if (home && *home) return (fs::path(home) / ".cache" / "rtblur" / "engines.txt").string();
+#endif
+    return "rtblur-engines.txt";
+}
+
+bool LoadOrCalibrateCpuEngines(const std::string& path, ThreadPool& pool, CpuEngineProfile& profile,
+    bool* calibrated, std::string* error)
+{
+    if (calibrated) *calibrated = false;
+    if (LoadCpuEngineProfile(path, profile) && profile.Matches(pool)) return true;
+    CalibrateCpuEngines(pool, profile);
+    if (calibrated) *calibrated = true;
+    return SaveCpuEngineProfile(path, profile, error);
+}
+
+CpuEngineChoice ChooseCpuEngine(const CpuEngineProfile& profile, uint32_t width, uint32_t height, float blurRadius,
+    double tolerance)
+{
+    CpuEngineChoice choice;
+    choice.predictedMs = profile.PredictMs(CpuBlurEngine::Direct, width, height, blurRadius);
+    choice.expectedError = profile.ExpectedError(CpuBlurEngine::Direct, blurRadius);
+    // Every engine copies a kernel this narrow
+    if (CpuBlurIsCopy(*GetGaussianKernel(SigmaFromBlurRadius(blurRadius)))) return choice;
+
+    bool found = false;
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        CpuBlurEngine engine = (CpuBlurEngine)e;
+        if (!Pickable(engine) || !profile.costs[e].calibrated) continue;
+        double expectedError = profile.ExpectedError(engine, blurRadius);
+        if (expectedError > tolerance) continue;
+        double predictedMs = profile.PredictMs(engine, width, height, blurRadius);
+        if (!found || predictedMs < choice.predictedMs) {
+            choice.engine = engine;
+            choice.predictedMs = predictedMs;
+            choice.expectedError = expectedError;
+            found = true;
+        }
+    }
+    return choice;
+}
+
+CpuEngineChoice CpuBlurImageAuto(const CpuImage& src, CpuImage& dst, float blurRadius, double tolerance,
+    const CpuEngineProfile& profile, ThreadPool& pool)
+{
+    CpuEngineChoice choice = ChooseCpuEngine(profile, src.width, src.height, blurRadius, tolerance);
+    auto start = std::chrono::steady_clock::now();
+    CpuBlurImage(src, dst, blurRadius, choice.engine, pool);
+    choice.actualMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return choice;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+#include "CpuBlurEngine.h"
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Picks the CPU engine for a blur from a cost model of this machine, so that
+// callers ask for a tolerance rather than an engine. CalibrateCpuEngines times
+// every engine on a small image and one larger than the L2 at each of the
+// calibration radii, each timing repeated for at least 0.1 s, and measures its
+// error against the exact Gaussian; the profile keeps, per engine and radius,
+// a fixed cost per call and a cost per pixel, and the worst error seen.
+// Predictions interpolate linearly between calibration radii.
+//
+// A calibration takes a few seconds (about 9 on one thread, less with more),
+// so profiles are saved and reused while the instruction set and pool size
+// they were measured with still apply. LinearLight blurs a different quantity
+// and is never picked.
+
+constexpr int kCpuEngineCalibrationRadii = 6;
+extern const float kCpuEngineCalibrationRadius[kCpuEngineCalibrationRadii];
+
+struct CpuEngineCost {
+    bool calibrated = false;
+    double overheadMs[kCpuEngineCalibrationRadii] = {};
+    double nsPerPixel[kCpuEngineCalibrationRadii] = {};
+    double maxError[kCpuEngineCalibrationRadii] = {}; // 8-bit steps from the exact Gaussian
+};
+
+struct CpuEngineProfile {
+    std::string isa;      // CpuIsaName of the blur ISA it was measured with
+    unsigned threads = 0; // pool size it was measured with
+    CpuEngineCost costs[(size_t)CpuBlurEngine::Count];
+
+    bool Calibrated() const { return threads != 0; }
+    // Whether it was measured with this ISA and pool size
+    bool Matches(const ThreadPool& pool) const;
+    double PredictMs(CpuBlurEngine engine, uint32_t width, uint32_t height, float blurRadius) const;
+    // Worst error of the two calibration radii around blurRadius
+    double ExpectedError(CpuBlurEngine engine, float blurRadius) const;
+};
+
+void CalibrateCpuEngines(ThreadPool& pool, CpuEngineProfile& profile);
+
+bool LoadCpuEngineProfile(const std::string& path, CpuEngineProfile& profile, std::string* error = nullptr);
+bool SaveCpuEngineProfile(const std::string& path, const CpuEngineProfile& profile, std::string* error = nullptr);
+
+// %LOCALAPPDATA%\RTBlur\engines.txt on Windows, $XDG_CACHE_HOME/rtblur or
+// ~/.cache/rtblur elsewhere
+std::string DefaultCpuEngineProfilePath();
+
+// Loads path if it fits pool; otherwise calibrates and saves it there. False
+// only when the save failed, with profile still usable.
+bool LoadOrCalibrateCpuEngines(const std::string& path, ThreadPool& pool, CpuEngineProfile& profile,
+    bool* calibrated = nullptr, std::string* error = nullptr);
+
+struct CpuEngineChoice {
+    CpuBlurEngine engine = CpuBlurEngine::Direct;
+    double predictedMs = 0.0;
+    double expectedError = 0.0;
+    double actualMs = 0.0; // set by CpuBlurImageAuto
+};
+
+// The engine predicted fastest for this blur among those whose error stays
+// within tolerance (8-bit steps); Direct when none does
+CpuEngineChoice ChooseCpuEngine(const CpuEngineProfile& profile, uint32_t width, uint32_t height, float blurRadius,
+    double tolerance);
+
+// ChooseCpuEngine, then CpuBlurImage with the engine picked, timed
+CpuEngineChoice CpuBlurImageAuto(const CpuImage& src, CpuImage& dst, float blurRadius, double tolerance,
+    const CpuEngineProfile& profile, ThreadPool& pool);
@@ -0,0 +1,136 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RTBLUR_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+#if RTBLUR_X86
+void Cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned)r[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long ReadXcr0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+CpuFeatures QueryCpuFeatures() {
+    CpuFeatures features;
+#if RTBLUR_X86
+    unsigned regs[4];
+    Cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+    if (maxLeaf < 1) return features;
+
+    Cpuid(1, 0, regs);
+    unsigned ecx1 = regs[2];
+    features.sse41 = (ecx1 >> 19) & 1;
+
+    // AVX needs the OS to save YMM state (XCR0 bits 1-2), AVX-512 also the
+    // opmask and ZMM state (bits 5-7)
+    bool osxsave = (ecx1 >> 27) & 1;
+    bool avx = (ecx1 >> 28) & 1;
+    unsigned long long xcr0 = osxsave ? ReadXcr0() : 0;
+    bool osAvx = avx && (xcr0 & 0x6) == 0x6;
+    bool osAvx512 = osAvx && (xcr0 & 0xE6) == 0xE6;
+    features.f16c = osAvx && ((ecx1 >> 29) & 1);
+
+    if (maxLeaf >= 7) {
+        Cpuid(7, 0, regs);
+        unsigned ebx7 = regs[1];
+        features.avx2 = osAvx && ((ebx7 >> 5) & 1);
+        features.avx512 = osAvx512 && ((ebx7 >> 16) & 1);
+    }
+#endif
+    return features;
+}
+
+CpuCacheSizes QueryCpuCacheSizes() {
+    CpuCacheSizes sizes;
+#if RTBLUR_X86
+    unsigned regs[4];
+    Cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+
+    // Deterministic cache parameters, one subleaf per cache until type 0
+    if (maxLeaf >= 4) {
+        for (unsigned subleaf = 0; subleaf < 16; subleaf++) {
+            Cpuid(4, subleaf, regs);
+            unsigned type = regs[0] & 0x1F;
+            if (type == 0) break;
+            if (type == 2) continue; // instruction cache
+            unsigned level = (regs[0] >> 5) & 0x7;
+            size_t ways = ((regs[1] >> 22) & 0x3FF) + 1;
+            size_t partitions = ((regs[1] >> 12) & 0x3FF) + 1;
+            size_t lineSize = (regs[1] & 0xFFF) + 1;
+            size_t sets = (size_t)regs[2] + 1;
+            size_t bytes = ways * partitions * lineSize * sets;
+            if (level == 1) sizes.l1d = bytes;
+            else if (level == 2) sizes.l2 = bytes;
+            else if (level == 3) sizes.l3 = bytes;
+        }
+    }
+
+    // AMD leaves leaf 4 empty and reports sizes in the extended leaves
+    Cpuid(0x80000000, 0, regs);
+    unsigned maxExtendedLeaf = regs[0];
+    if (sizes.l1d == 0 && maxExtendedLeaf >= 0x80000005) {
+        Cpuid(0x80000005, 0, regs);
+        sizes.l1d = (size_t)(regs[2] >> 24) * 1024;
+    }
+    if (sizes.l2 == 0 && maxExtendedLeaf >= 0x80000006) {
+        Cpuid(0x80000006, 0, regs);
+        sizes.l2 = (size_t)(regs[2] >> 16) * 1024;
+        sizes.l3 = (size_t)(regs[3] >> 18) * 512 * 1024;
+    }
+#endif
+    return sizes;
+}
+
+} // namespace
+
+const CpuCacheSizes& GetCpuCacheSizes() {
+    static const CpuCacheSizes sizes = QueryCpuCacheSizes();
+    return sizes;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = QueryCpuFeatures();
+    return features;
+}
+
+CpuIsa DetectCpuIsa() {
+    const CpuFeatures& features = GetCpuFeatures();
+    if (features.avx512) return CpuIsa::Avx512;
+    if (features.avx2) return CpuIsa::Avx2;
+    if (features.sse41) return CpuIsa::Sse41;
+    return CpuIsa::Scalar;
+}
+
+const char* CpuIsaName(CpuIsa isa) {
+    switch (isa) {
+    case CpuIsa::Sse41: return "SSE4.1";
+    case CpuIsa::Avx2: return "AVX2";
+    case CpuIsa::Avx512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
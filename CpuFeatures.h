@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Instruction sets the CPU blur kernels are built for, in increasing order.
+enum class CpuIsa {
+    Scalar,
+    Sse41,
+    Avx2,
+    Avx512,
+};
+
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+    bool avx512 = false; // AVX-512F with OS support for the opmask/ZMM state
+    bool f16c = false;
+};
+
+// CPUID + XGETBV, queried once. All false on non-x86 builds.
+const CpuFeatures& GetCpuFeatures();
+
+// Data cache sizes of one core, in bytes; 0 where CPUID doesn't say. l3 is
+// the whole cache, shared with the other cores.
+struct CpuCacheSizes {
+    size_t l1d = 0;
+    size_t l2 = 0;
+    size_t l3 = 0;
+};
+
+// CPUID leaf 4 (Intel) or 0x80000005/6 (AMD), queried once.
+const CpuCacheSizes& GetCpuCacheSizes();
+
+// Best instruction set both the CPU and the OS support.
+CpuIsa DetectCpuIsa();
+
+const char* CpuIsaName(CpuIsa isa);
@@ -0,0 +1,206 @@
+#include "CpuFixedPointBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CpuBlur.h"
+#include "CpuBlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "CpuFeatures.h"
+#include "Trace.h"
+
+namespace {
+
+template <typename T>
+void VerticalRowFixedPointGeneric(const uint8_t* const* taps, uint8_t* dst, size_t count,
+    const int16_t* weights, int radius)
+{
+    VerticalRowFixedPointScalar<T>(taps, dst, 0, count, weights, radius);
+}
+
+const CpuFixedPointRowKernels g_cpuFixedPointKernelsScalar = {
+    CpuIsa::Scalar,
+    HorizontalRowFixedPoint<uint8_t, VerticalRowFixedPointGeneric<uint8_t>>, VerticalRowFixedPointGeneric<uint8_t>,
+    HorizontalRowFixedPoint<uint16_t, VerticalRowFixedPointGeneric<uint16_t>>, VerticalRowFixedPointGeneric<uint16_t>,
+};
+
+// A tightly packed RGBA image of 8- or 16-bit samples, seen as bytes
+struct FixedPointPlane {
+    uint8_t* pixels;
+    uint32_t width;
+    uint32_t height;
+    size_t rowPitch;
+
+    uint8_t* Row(uint32_t y) const { return pixels + y * rowPitch; }
+};
+
+template <typename T>
+void HorizontalRows(const FixedPointPlane& src, const FixedPointPlane& dst, const FixedPointKernel& kernel,
+    HorizontalRowFixedPointKernel horizontal, uint32_t y0, uint32_t y1)
+{
+    const size_t pixelBytes = 4 * sizeof(T);
+    int radius = kernel.radius;
+    uint32_t width = src.width;
+
+    thread_local std::vector<uint8_t> padded;
+    padded.resize(((size_t)width + 2 * radius) * pixelBytes);
+
+    for (uint32_t y = y0; y < y1; y++) {
+        const uint8_t* row = src.Row(y);
+        uint8_t* left = padded.data();
+        uint8_t* right = padded.data() + ((size_t)radius + width) * pixelBytes;
+        for (int i = 0; i < radius; i++) {
+            memcpy(left + i * pixelBytes, row, pixelBytes);
+            memcpy(right + i * pixelBytes, row + (width - 1) * pixelBytes, pixelBytes);
+        }
+        memcpy(padded.data() + radius * pixelBytes, row, src.rowPitch);
+        horizontal(padded.data(), dst.Row(y), width, kernel.weights.data(), radius);
+    }
+}
+
+template <typename T>
+void VerticalRows(const FixedPointPlane& src, const FixedPointPlane& dst, const FixedPointKernel& kernel,
+    VerticalRowFixedPointKernel vertical, uint32_t y0, uint32_t y1, uint32_t x0, uint32_t x1)
+{
+    int radius = kernel.radius;
+    int lastRow = (int)src.height - 1;
+    size_t byteOffset = (size_t)x0 * 4 * sizeof(T);
+    size_t count = (size_t)(x1 - x0) * 4;
+
+    thread_local std::vector<const uint8_t*> rows;
+    rows.resize(2 * radius + 1);
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (int i = -radius; i <= radius; i++) {
+            int sy = std::min(std::max((int)y + i, 0), lastRow);
+            rows[i + radius] = src.Row(sy) + byteOffset;
+        }
+        vertical(rows.data(), dst.Row(y) + byteOffset, count, kernel.weights.data(), radius);
+    }
+}
+
+// The tiling of CpuGaussianBlurTiled. ChooseCpuBlurTiling sizes tiles for
+// 4-byte pixels, so 16-bit images get half the columns and band rows.
+template <typename T>
+void FixedPointBlurTiled(const FixedPointPlane& src, const FixedPointPlane& dst, const FixedPointKernel& kernel,
+    ThreadPool& pool)
+{
+    const CpuFixedPointRowKernels& kernels = GetCpuFixedPointRowKernels(GetCpuBlurIsa());
+    HorizontalRowFixedPointKernel horizontal = sizeof(T) == 1 ? kernels.horizontal8 : kernels.horizontal16;
+    VerticalRowFixedPointKernel vertical = sizeof(T) == 1 ? kernels.vertical8 : kernels.vertical16;
+
+    CpuBlurTiling tiling = ChooseCpuBlurTiling(src.width, src.height, kernel.radius);
+    if (sizeof(T) == 2) {
+        tiling.bandRows = std::max<uint32_t>(tiling.bandRows / 2, 1);
+        tiling.stripColumns = std::max<uint32_t>(tiling.stripColumns / 2, 16);
+    }
+
+    std::vector<uint8_t> tempPixels(src.rowPitch * src.height);
+    FixedPointPlane temp = { tempPixels.data(), src.width, src.height, src.rowPitch };
+    {
+        TRACE_SCOPE("horizontal pass");
+        size_t bandCount = (src.height + tiling.bandRows - 1) / tiling.bandRows;
+        pool.ParallelFor(bandCount, [&](size_t band) {
+            uint32_t y0 = (uint32_t)band * tiling.bandRows;
+            uint32_t y1 = std::min(y0 + tiling.bandRows, src.height);
+            HorizontalRows<T>(src, temp, kernel, horizontal, y0, y1);
+        });
+    }
+
+    TRACE_SCOPE("vertical pass");
+    size_t stripCount = (src.width + tiling.stripColumns - 1) / tiling.stripColumns;
+    size_t blocksPerStrip = (src.height + tiling.stripRows - 1) / tiling.stripRows;
+    pool.ParallelFor(stripCount * blocksPerStrip, [&](size_t tile) {
+        uint32_t strip = (uint32_t)(tile / blocksPerStrip);
+        uint32_t block = (uint32_t)(tile % blocksPerStrip);
+        uint32_t x0 = strip * tiling.stripColumns;
+        uint32_t x1 = std::min(x0 + tiling.stripColumns, src.width);
+        uint32_t y0 = block * tiling.stripRows;
+        uint32_t y1 = std::min(y0 + tiling.stripRows, src.height);
+        VerticalRows<T>(temp, dst, kernel, vertical, y0, y1, x0, x1);
+    });
+}
+
+} // namespace
+
+const CpuFixedPointRowKernels& GetCpuFixedPointRowKernels(CpuIsa isa) {
+    CpuIsa best = DetectCpuIsa();
+    if (isa > best) isa = best;
+#if RTBLUR_HAS_X86_KERNELS
+    switch (isa) {
+    case CpuIsa::Avx512:
+    case CpuIsa::Avx2: return g_cpuFixedPointKernelsAvx2;
+    case CpuIsa::Sse41: return g_cpuFixedPointKernelsSse41;
+    default: break;
+    }
+#endif
+    return g_cpuFixedPointKernelsScalar;
+}
+
+FixedPointKernel BuildFixedPointKernel(const GaussianKernel& kernel) {
+    const int one = 1 << kFixedPointWeightBits;
+    FixedPointKernel fixed;
+    fixed.radius = kernel.radius;
+    fixed.weights.resize(kernel.radius + 1);
+
+    int sum = 0;
+    for (int i = 1; i <= kernel.radius; i++) {
+        fixed.weights[i] = (int16_t)std::lround(kernel.weights[i] * one);
+        sum += 2 * fixed.weights[i];
+    }
+    // The center takes the rounding residual, so the weights sum to exactly
+    // one and flat areas come out unchanged. It has to fit in int16 too; a
+    // kernel that narrow is a copy.
+    int center = one - sum;
+    if (kernel.radius == 0 || center > INT16_MAX) {
+        fixed.radius = 0;
+        fixed.weights.assign(1, 0);
+        return fixed;
+    }
+    fixed.weights[0] = (int16_t)center;
+
+    for (int i = 0; i <= kernel.radius; i++) {
+        double error = std::fabs((double)fixed.weights[i] / one - kernel.weights[i]);
+        fixed.weightError += i == 0 ? error : 2 * error;
+    }
+    return fixed;
+}
+
+double FixedPointBlurMaxDeviation(const FixedPointKernel& kernel, double maxValue) {
+    return kernel.radius == 0 ? 0.0 : 2.0 * (kernel.weightError * maxValue + 0.5);
+}
+
+void CpuFixedPointBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool) {
+    if (src.Empty()) return;
+
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+    FixedPointKernel fixed = BuildFixedPointKernel(*kernel);
+    if (fixed.radius == 0) {
+        if (&dst != &src) dst = src;
+        return;
+    }
+    if (dst.width != src.width || dst.height != src.height) dst = CpuImage(src.width, src.height);
+
+    FixedPointPlane srcPlane = { const_cast<uint8_t*>(src.pixels.data()), src.width, src.height, src.RowPitch() };
+    FixedPointPlane dstPlane = { dst.pixels.data(), dst.width, dst.height, dst.RowPitch() };
+    FixedPointBlurTiled<uint8_t>(srcPlane, dstPlane, fixed, pool);
+}
+
+void CpuFixedPointBlur16(const uint16_t* src, uint16_t* dst, uint32_t width, uint32_t height,
+    float blurRadius, ThreadPool& pool)
+{
+    if (width == 0 || height == 0) return;
+
+    size_t rowPitch = (size_t)width * 4 * sizeof(uint16_t);
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+    FixedPointKernel fixed = BuildFixedPointKernel(*kernel);
+    if (fixed.radius == 0) {
+        if (dst != src) memcpy(dst, src, rowPitch * height);
+        return;
+    }
+
+    FixedPointPlane srcPlane = { (uint8_t*)const_cast<uint16_t*>(src), width, height, rowPitch };
+    FixedPointPlane dstPlane = { (uint8_t*)dst, width, height, rowPitch };
+    FixedPointBlurTiled<uint16_t>(srcPlane, dstPlane, fixed, pool);
+}
@@ -0,0 +1,352 @@
+#include "CpuFrameIO.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+// Above any video format (16K is 15360x8640), so a corrupt header can't ask
+// for frames of gigabytes
+constexpr uint32_t kMaxY4mSide = 1u << 14;
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+// Chroma subsampling as log2 of the horizontal and vertical factors
+void ChromaShift(FrameChroma chroma, int& shiftX, int& shiftY) {
+    shiftX = chroma == FrameChroma::Yuv420 || chroma == FrameChroma::Yuv422 ? 1 : 0;
+    shiftY = chroma == FrameChroma::Yuv420 ? 1 : 0;
+}
+
+// Stdio stream over a file or, for "-", stdin/stdout switched to binary mode.
+// Closed on destruction unless it is a standard stream.
+class FrameFile {
+public:
+    ~FrameFile() {
+        if (m_file && m_owned) fclose(m_file);
+    }
+
+    bool Open(const std::string& path, bool write) {
+        if (path == "-") {
+            m_file = write ? stdout : stdin;
+#ifdef _WIN32
+            _setmode(_fileno(m_file), _O_BINARY);
+#endif
+        }
+        else {
+            m_file = fopen(path.c_str(), write ? "wb" : "rb");
+            m_owned = true;
+        }
+        if (!m_file) return false;
+        // Frames are megabytes each; a large buffer keeps the syscalls few
+        setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+        return true;
+    }
+
+    FILE* Get() const { return m_file; }
+
+    bool Close() {
+        if (!m_file) return false;
+        bool ok = fflush(m_file) == 0 && !ferror(m_file);
+        if (m_owned) ok = fclose(m_file) == 0 && ok;
+        m_file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* m_file = nullptr;
+    bool m_owned = false;
+};
+
+// Reads up to and including the next '\n' into line, without it. False at
+// the end of the stream or when the line is longer than maxLength.
+bool ReadLine(FILE* file, std::string& line, size_t maxLength) {
+    line.clear();
+    for (;;) {
+        int c = fgetc(file);
+        if (c == EOF) return false;
+        if (c == '\n') return true;
+        if (line.size() == maxLength) return false;
+        line += (char)c;
+    }
+}
+
+void YuvToRgba(const FrameFormat& format, const uint8_t* planes, CpuImage& rgba) {
+    uint32_t width = format.width, height = format.height;
+    const uint8_t* luma = planes;
+    if (format.chroma == FrameChroma::Mono) {
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* out = rgba.Row(y);
+            for (uint32_t x = 0; x < width; x++, out += 4) {
+                uint8_t v = luma[(size_t)y * width + x];
+                out[0] = out[1] = out[2] = v;
+                out[3] = 255;
+            }
+        }
+        return;
+    }
+    int shiftX, shiftY;
+    ChromaShift(format.chroma, shiftX, shiftY);
+    size_t chromaWidth = (width + (1u << shiftX) - 1) >> shiftX;
+    size_t chromaHeight = (height + (1u << shiftY) - 1) >> shiftY;
+    const uint8_t* cb = luma + (size_t)width * height;
+    const uint8_t* cr = cb + chromaWidth * chromaHeight;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* lumaRow = luma + (size_t)y * width;
+        const uint8_t* cbRow = cb + (y >> shiftY) * chromaWidth;
+        const uint8_t* crRow = cr + (y >> shiftY) * chromaWidth;
+        uint8_t* out = rgba.Row(y);
+        for (uint32_t x = 0; x < width; x++, out += 4) {
+            out[0] = lumaRow[x];
+            out[1] = cbRow[x >> shiftX];
+            out[2] = crRow[x >> shiftX];
+            out[3] = 255;
+        }
+    }
+}
+
+// Inverse of YuvToRgba; each chroma sample is the rounded mean of its block
+void RgbaToYuv(const FrameFormat& format, const CpuImage& rgba, uint8_t* planes) {
+    uint32_t width = format.width, height = format.height;
+    uint8_t* luma = planes;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* in = rgba.Row(y);
+        for (uint32_t x = 0; x < width; x++) luma[(size_t)y * width + x] = in[x * 4];
+    }
+    if (format.chroma == FrameChroma::Mono) return;
+
+    int shiftX, shiftY;
+    ChromaShift(format.chroma, shiftX, shiftY);
+    uint32_t chromaWidth = (width + (1u << shiftX) - 1) >> shiftX;
+    uint32_t chromaHeight = (height + (1u << shiftY) - 1) >> shiftY;
+    uint8_t* cb = luma + (size_t)width * height;
+    uint8_t* cr = cb + (size_t)chromaWidth * chromaHeight;
+    for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+        uint32_t y0 = cy << shiftY, y1 = std::min(y0 + (1u << shiftY), height);
+        for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+            uint32_t x0 = cx << shiftX, x1 = std::min(x0 + (1u << shiftX), width);
+            unsigned sumCb = 0, sumCr = 0, count = 0;
+            for (uint32_t y = y0; y < y1; y++) {
+                const uint8_t* in = rgba.Row(y);
+                for (uint32_t x = x0; x < x1; x++, count++) {
+                    sumCb += in[x * 4 + 1];
+                    sumCr += in[x * 4 + 2];
+                }
+            }
+            cb[(size_t)cy * chromaWidth + cx] = (uint8_t)((sumCb + count / 2) / count);
+            cr[(size_t)cy * chromaWidth + cx] = (uint8_t)((sumCr + count / 2) / count);
+        }
+    }
+}
+
+bool ParseY4mHeader(const std::string& line, FrameFormat& format, std::string* error) {
+    static const char kMagic[] = "YUV4MPEG2";
+    if (line.compare(0, sizeof(kMagic) - 1, kMagic) != 0) return Fail(error, "not a YUV4MPEG2 stream");
+    format.chroma = FrameChroma::Yuv420; // the default without a C token
+    size_t pos = sizeof(kMagic) - 1;
+    while (pos < line.size()) {
+        size_t end = line.find(' ', pos + 1);
+        if (end == std::string::npos) end = line.size();
+        std::string token = line.substr(pos + 1, end - pos - 1);
+        pos = end;
+        if (token.empty()) continue;
+        if (token[0] == 'W' || token[0] == 'H') {
+            // Parsed wider than the field, so huge values can't wrap into range
+            unsigned long long side = strtoull(token.c_str() + 1, nullptr, 10);
+            if (side > kMaxY4mSide) {
+                return Fail(error, "Y4M frame size " + token + " is too large (at most " +
+                    std::to_string(kMaxY4mSide) + " per side)");
+            }
+            (token[0] == 'W' ? format.width : format.height) = (uint32_t)side;
+            continue;
+        }
+        if (token[0] == 'C') {
+            std::string space = token.substr(1);
+            if (space == "mono") format.chroma = FrameChroma::Mono;
+            else if (space == "420" || space == "420jpeg" || space == "420paldv" || space == "420mpeg2") {
+                format.chroma = FrameChroma::Yuv420;
+            }
+            else if (space == "422") format.chroma = FrameChroma::Yuv422;
+            else if (space == "444") format.chroma = FrameChroma::Yuv444;
+            else return Fail(error, "unsupported Y4M colorspace C" + space + " (8-bit mono, 420, 422 and 444 only)");
+        }
+        format.y4mParams += ' ';
+        format.y4mParams += token;
+    }
+    if (format.width == 0 || format.height == 0) return Fail(error, "Y4M header lacks the frame size");
+    return true;
+}
+
+class Y4mFrameReader : public FrameReader {
+public:
+    bool Open(const std::string& path, std::string* error) {
+        if (!m_file.Open(path, false)) return Fail(error, "can't open " + path);
+        std::string header;
+        if (!ReadLine(m_file.Get(), header, 1024)) return Fail(error, "missing Y4M header");
+        if (!ParseY4mHeader(header, m_format, error)) return false;
+        m_planes.resize(m_format.FrameBytes());
+        return true;
+    }
+
+    bool ReadFrame(CpuImage& rgba) override {
+        std::string line;
+        if (!ReadLine(m_file.Get(), line, 1024)) {
+            if (!line.empty() || ferror(m_file.Get())) m_error = "bad FRAME header";
+            return false;
+        }
+        if (line.compare(0, 5, "FRAME") != 0) {
+            m_error = "bad FRAME header";
+            return false;
+        }
+        if (fread(m_planes.data(), 1, m_planes.size(), m_file.Get()) != m_planes.size()) {
+            m_error = "truncated frame";
+            return false;
+        }
+        if (rgba.width != m_format.width || rgba.height != m_format.height) {
+            rgba = CpuImage(m_format.width, m_format.height);
+        }
+        YuvToRgba(m_format, m_planes.data(), rgba);
+        return true;
+    }
+
+private:
+    FrameFile m_file;
+    std::vector<uint8_t> m_planes;
+};
+
+class RawFrameReader : public FrameReader {
+public:
+    bool Open(const std::string& path, uint32_t width, uint32_t height, std::string* error) {
+        if (!m_file.Open(path, false)) return Fail(error, "can't open " + path);
+        m_format.width = width;
+        m_format.height = height;
+        return true;
+    }
+
+    bool ReadFrame(CpuImage& rgba) override {
+        if (rgba.width != m_format.width || rgba.height != m_format.height) {
+            rgba = CpuImage(m_format.width, m_format.height);
+        }
+        size_t read = fread(rgba.pixels.data(), 1, rgba.pixels.size(), m_file.Get());
+        if (read != rgba.pixels.size() && (read != 0 || ferror(m_file.Get()))) m_error = "truncated frame";
+        return read == rgba.pixels.size();
+    }
+
+private:
+    FrameFile m_file;
+};
+
+// A gradient under a checkerboard that scrolls a few pixels per frame, so
+// successive frames differ the way camera frames do
+class SyntheticFrameReader : public FrameReader {
+public:
+    SyntheticFrameReader(uint32_t width, uint32_t height, uint64_t frameCount) : m_frameCount(frameCount) {
+        m_format.width = width;
+        m_format.height = height;
+    }
+
+    bool ReadFrame(CpuImage& rgba) override {
+        if (m_frame == m_frameCount) return false;
+        uint32_t width = m_format.width, height = m_format.height;
+        if (rgba.width != width || rgba.height != height) rgba = CpuImage(width, height);
+        uint32_t shift = (uint32_t)(m_frame * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* out = rgba.Row(y);
+            uint8_t green = (uint8_t)(y * 255 / height);
+            for (uint32_t x = 0; x < width; x++, out += 4) {
+                out[0] = (uint8_t)(x * 255 / width);
+                out[1] = green;
+                out[2] = (((x + shift) >> 5) ^ (y >> 5)) & 1 ? 255 : 0;
+                out[3] = 255;
+            }
+        }
+        m_frame++;
+        return true;
+    }
+
+private:
+    uint64_t m_frameCount;
+    uint64_t m_frame = 0;
+};
+
+class FileFrameWriter : public FrameWriter {
+public:
+    bool Open(const std::string& path, const FrameFormat& format, std::string* error) {
+        if (!m_file.Open(path, true)) return Fail(error, "can't create " + path);
+        m_format = format;
+        if (format.chroma != FrameChroma::Rgba) {
+            fprintf(m_file.Get(), "YUV4MPEG2 W%u H%u%s\n", format.width, format.height, format.y4mParams.c_str());
+            m_planes.resize(format.FrameBytes());
+        }
+        return !ferror(m_file.Get());
+    }
+
+    bool WriteFrame(const CpuImage& rgba) override {
+        FILE* file = m_file.Get();
+        if (m_format.chroma == FrameChroma::Rgba) {
+            return fwrite(rgba.pixels.data(), 1, rgba.pixels.size(), file) == rgba.pixels.size();
+        }
+        RgbaToYuv(m_format, rgba, m_planes.data());
+        fputs("FRAME\n", file);
+        return fwrite(m_planes.data(), 1, m_planes.size(), file) == m_planes.size();
+    }
+
+    bool Finish() override { return m_file.Close(); }
+
+private:
+    FrameFile m_file;
+    FrameFormat m_format;
+    std::vector<uint8_t> m_planes;
+};
+
+} // namespace
+
+size_t FrameFormat::FrameBytes() const {
+    size_t pixels = (size_t)width * height;
+    if (chroma == FrameChroma::Rgba) return pixels * 4;
+    if (chroma == FrameChroma::Mono) return pixels;
+    int shiftX, shiftY;
+    ChromaShift(chroma, shiftX, shiftY);
+    size_t chromaWidth = (width + (1u << shiftX) - 1) >> shiftX;
+    size_t chromaHeight = (height + (1u << shiftY) - 1) >> shiftY;
+    return pixels + 2 * chromaWidth * chromaHeight;
+}
+
+std::unique_ptr<FrameReader> OpenFrameReader(const std::string& path, uint32_t rawWidth, uint32_t rawHeight,
+    std::string* error)
+{
+    if (rawWidth != 0 || rawHeight != 0) {
+        if (rawWidth == 0 || rawHeight == 0) {
+            Fail(error, "raw frames need a width and height");
+            return nullptr;
+        }
+        auto reader = std::make_unique<RawFrameReader>();
+        if (!reader->Open(path, rawWidth, rawHeight, error)) return nullptr;
+        return reader;
+    }
+    auto reader = std::make_unique<Y4mFrameReader>();
+    if (!reader->Open(path, error)) return nullptr;
+    return reader;
+}
+
+std::unique_ptr<FrameReader> CreateSyntheticFrameReader(uint32_t width, uint32_t height, uint64_t frameCount) {
+    return std::make_unique<SyntheticFrameReader>(width, height, frameCount);
+}
+
+std::unique_ptr<FrameWriter> CreateFrameWriter(const std::string& path, const FrameFormat& format,
+    std::string* error)
+{
+    auto writer = std::make_unique<FileFrameWriter>();
+    if (!writer->Open(path, format, error)) return nullptr;
+    return writer;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CpuImage.h"
+
+// Frame sequences for RTBlurBatch --video: YUV4MPEG2 (.y4m) streams or
+// headerless RGBA8 frames, read from a file or stdin ("-") and written to a
+// file or stdout ("-"). Frames are handed over as RGBA8 CpuImages so every
+// engine can blur them. Y4M frames are interleaved as R = Y, G = Cb, B = Cr
+// with opaque alpha and the chroma repeated to full resolution, and the chroma
+// is averaged back down when written. The blur is linear, so blurring YCbCr is
+// blurring RGB up to rounding. 8-bit Y4M only: mono, 4:2:0, 4:2:2 and 4:4:4.
+
+enum class FrameChroma {
+    Rgba, // headerless RGBA8 frames
+    Mono, // Y4M Cmono
+    Yuv420,
+    Yuv422,
+    Yuv444,
+};
+
+struct FrameFormat {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    FrameChroma chroma = FrameChroma::Rgba;
+    std::string y4mParams; // header tokens besides W and H (C, F, I, A, X), written back unchanged
+
+    // Bytes of one frame in the stream, without Y4M's FRAME line
+    size_t FrameBytes() const;
+};
+
+class FrameReader {
+public:
+    virtual ~FrameReader() = default;
+    const FrameFormat& Format() const { return m_format; }
+
+    // Reads the next frame into rgba, resizing it. False at the end of the
+    // stream, and also on a read error, which Error() then describes.
+    virtual bool ReadFrame(CpuImage& rgba) = 0;
+    const std::string& Error() const { return m_error; }
+
+protected:
+    FrameFormat m_format;
+    std::string m_error;
+};
+
+class FrameWriter {
+public:
+    virtual ~FrameWriter() = default;
+    virtual bool WriteFrame(const CpuImage& rgba) = 0;
+    // Flushes and reports whether everything was written
+    virtual bool Finish() = 0;
+};
+
+// Y4M unless rawWidth and rawHeight are given, which select RGBA8 frames of
+// that size. path "-" reads stdin.
+std::unique_ptr<FrameReader> OpenFrameReader(const std::string& path, uint32_t rawWidth, uint32_t rawHeight,
+    std::string* error = nullptr);
+
+// frameCount RGBA8 frames of a moving test pattern, generated on the fly, for
+// running the video pipeline without a source.
+std::unique_ptr<FrameReader> CreateSyntheticFrameReader(uint32_t width, uint32_t height, uint64_t frameCount);
+
+// Writes frames in format (Y4M with its header, or bare RGBA8). path "-"
+// writes stdout.
+std::unique_ptr<FrameWriter> CreateFrameWriter(const std::string& path, const FrameFormat& format,
+    std::string* error = nullptr);
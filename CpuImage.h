@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tightly packed RGBA8 image, the CPU-side twin of the
+// DXGI_FORMAT_R8G8B8A8_UNORM textures the GPU path uses.
+struct CpuImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+
+    CpuImage() = default;
+    CpuImage(uint32_t w, uint32_t h) : width(w), height(h), pixels((size_t)w * h * 4) {}
+
+    size_t RowPitch() const { return (size_t)width * 4; }
+    uint8_t* Row(uint32_t y) { return pixels.data() + y * RowPitch(); }
+    const uint8_t* Row(uint32_t y) const { return pixels.data() + y * RowPitch(); }
+    bool Empty() const { return pixels.empty(); }
+};
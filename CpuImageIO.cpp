@@ -0,0 +1,209 @@
+#include "CpuImageIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// Walks the text header of a Netpbm file
+struct HeaderReader {
+    const uint8_t* bytes;
+    size_t size;
+    size_t pos = 0;
+
+    void SkipSpaceAndComments() {
+        while (pos < size) {
+            if (bytes[pos] == '#') {
+                while (pos < size && bytes[pos] != '\n') pos++;
+            }
+            else if (isspace(bytes[pos])) {
+                pos++;
+            }
+            else {
+                break;
+            }
+        }
+    }
+
+    bool Token(std::string& token) {
+        SkipSpaceAndComments();
+        token.clear();
+        while (pos < size && !isspace(bytes[pos])) token += (char)bytes[pos++];
+        return !token.empty();
+    }
+
+    bool Number(uint32_t& value) {
+        std::string token;
+        if (!Token(token) || token.size() > 9) return false;
+        for (char c : token) {
+            if (c < '0' || c > '9') return false;
+        }
+        value = (uint32_t)strtoul(token.c_str(), nullptr, 10);
+        return true;
+    }
+};
+
+bool Fail(std::string* error, const char* message) {
+    if (error) *error = message;
+    return false;
+}
+
+} // namespace
+
+NetpbmFormat NetpbmFormatFromExtension(const std::string& extension) {
+    std::string ext = extension;
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    if (ext == ".pgm") return NetpbmFormat::Pgm;
+    if (ext == ".ppm" || ext == ".pnm") return NetpbmFormat::Ppm;
+    if (ext == ".pam") return NetpbmFormat::Pam;
+    return NetpbmFormat::Unknown;
+}
+
+bool ParseNetpbmHeader(const uint8_t* bytes, size_t size, NetpbmHeader& header, std::string* error) {
+    HeaderReader reader{ bytes, size };
+    std::string magic;
+    if (!reader.Token(magic)) return Fail(error, "empty file");
+
+    header = NetpbmHeader();
+    if (magic == "P5" || magic == "P6") {
+        header.format = magic == "P5" ? NetpbmFormat::Pgm : NetpbmFormat::Ppm;
+        header.depth = magic == "P5" ? 1 : 3;
+        if (!reader.Number(header.width) || !reader.Number(header.height) || !reader.Number(header.maxval)) {
+            return Fail(error, "bad header");
+        }
+        // Exactly one whitespace byte separates the header from the raster
+        reader.pos++;
+    }
+    else if (magic == "P7") {
+        header.format = NetpbmFormat::Pam;
+        std::string key, tupleType;
+        for (;;) {
+            if (!reader.Token(key)) return Fail(error, "bad header");
+            if (key == "ENDHDR") break;
+            if (key == "WIDTH") { if (!reader.Number(header.width)) return Fail(error, "bad WIDTH"); }
+            else if (key == "HEIGHT") { if (!reader.Number(header.height)) return Fail(error, "bad HEIGHT"); }
+            else if (key == "DEPTH") { if (!reader.Number(header.depth)) return Fail(error, "bad DEPTH"); }
+            else if (key == "MAXVAL") { if (!reader.Number(header.maxval)) return Fail(error, "bad MAXVAL"); }
+            else if (key == "TUPLTYPE") { reader.Token(tupleType); }
+        }
+        while (reader.pos < size && bytes[reader.pos] != '\n') reader.pos++;
+        reader.pos++;
+        if (header.depth < 1 || header.depth > 4) return Fail(error, "unsupported PAM depth");
+    }
+    else {
+        return Fail(error, "not a binary PGM, PPM or PAM file");
+    }
+
+    if (header.width == 0 || header.height == 0) return Fail(error, "empty image");
+    if (header.maxval == 0 || header.maxval > 255) return Fail(error, "only 8-bit samples are supported");
+
+    header.rasterOffset = reader.pos;
+    if (reader.pos > size || (size - reader.pos) / header.RowBytes() < header.height) {
+        return Fail(error, "truncated raster");
+    }
+    return true;
+}
+
+void NetpbmRowToRgba(const NetpbmHeader& header, const uint8_t* in, uint8_t* rgba) {
+    // Depth 1: gray, 2: gray + alpha, 3: RGB, 4: RGBA
+    uint32_t depth = header.depth;
+    bool hasAlpha = depth == 2 || depth == 4;
+    uint8_t* out = rgba;
+    for (uint32_t x = 0; x < header.width; x++, in += depth, out += 4) {
+        if (depth <= 2) {
+            out[0] = out[1] = out[2] = in[0];
+        }
+        else {
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = in[2];
+        }
+        out[3] = hasAlpha ? in[depth - 1] : 255;
+    }
+
+    // Stretch smaller maxvals to the full 8-bit range
+    if (header.maxval != 255) {
+        uint32_t maxval = header.maxval;
+        for (size_t i = 0; i < (size_t)header.width * 4; i++) {
+            rgba[i] = (uint8_t)std::min<uint32_t>(255, (rgba[i] * 255u + maxval / 2) / maxval);
+        }
+    }
+}
+
+bool DecodeNetpbm(const std::vector<uint8_t>& bytes, CpuImage& image, NetpbmFormat& format, std::string* error) {
+    NetpbmHeader header;
+    if (!ParseNetpbmHeader(bytes.data(), bytes.size(), header, error)) return false;
+
+    format = header.format;
+    image = CpuImage(header.width, header.height);
+    const uint8_t* raster = bytes.data() + header.rasterOffset;
+    for (uint32_t y = 0; y < header.height; y++) {
+        NetpbmRowToRgba(header, raster + y * header.RowBytes(), image.Row(y));
+    }
+    return true;
+}
+
+int NetpbmDepth(NetpbmFormat format) {
+    return format == NetpbmFormat::Pgm ? 1 : format == NetpbmFormat::Ppm ? 3 : 4;
+}
+
+std::string NetpbmHeaderText(NetpbmFormat format, uint32_t width, uint32_t height) {
+    char header[160];
+    switch (format) {
+    case NetpbmFormat::Pgm:
+        snprintf(header, sizeof(header), "P5\n%u %u\n255\n", width, height);
+        break;
+    case NetpbmFormat::Ppm:
+        snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+        break;
+    default:
+        snprintf(header, sizeof(header), "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+            width, height);
+        break;
+    }
+    return header;
+}
+
+void RgbaToNetpbmRow(NetpbmFormat format, const uint8_t* rgba, uint8_t* out, uint32_t width) {
+    int depth = NetpbmDepth(format);
+    if (depth == 4) {
+        memcpy(out, rgba, (size_t)width * 4);
+        return;
+    }
+    for (uint32_t x = 0; x < width; x++, rgba += 4, out += depth) {
+        for (int c = 0; c < depth; c++) out[c] = rgba[c];
+    }
+}
+
+std::vector<uint8_t> EncodeNetpbm(const CpuImage& image, NetpbmFormat format) {
+    std::string header = NetpbmHeaderText(format, image.width, image.height);
+    size_t rowBytes = (size_t)image.width * NetpbmDepth(format);
+    std::vector<uint8_t> bytes(header.size() + rowBytes * image.height);
+    memcpy(bytes.data(), header.data(), header.size());
+    for (uint32_t y = 0; y < image.height; y++) {
+        RgbaToNetpbmRow(format, image.Row(y), bytes.data() + header.size() + y * rowBytes, image.width);
+    }
+    return bytes;
+}
+
+bool ReadFileBytes(const std::string& path, std::vector<uint8_t>& bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::streamoff size = file.tellg();
+    if (size < 0) return false;
+    bytes.resize((size_t)size);
+    file.seekg(0);
+    return (bool)file.read(reinterpret_cast<char*>(bytes.data()), size);
+}
+
+bool WriteFileBytes(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuImage.h"
+
+// Netpbm reading and writing for the headless tools, which can't use WIC.
+// Decodes binary PGM (P5), PPM (P6) and PAM (P7: GRAYSCALE, GRAYSCALE_ALPHA,
+// RGB, RGB_ALPHA) with maxval up to 255 into RGBA8; missing alpha is opaque.
+enum class NetpbmFormat {
+    Unknown,
+    Pgm, // P5, written from the red channel
+    Ppm, // P6, alpha dropped
+    Pam  // P7 RGB_ALPHA
+};
+
+struct NetpbmHeader {
+    NetpbmFormat format = NetpbmFormat::Unknown;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depth = 0;      // samples per pixel in the file
+    uint32_t maxval = 0;
+    size_t rasterOffset = 0; // first byte of row 0
+
+    size_t RowBytes() const { return (size_t)width * depth; }
+};
+
+// Picks the output format from a file extension (.pgm, .ppm/.pnm, .pam).
+NetpbmFormat NetpbmFormatFromExtension(const std::string& extension);
+
+// On failure returns false and describes the problem in *error if given.
+bool DecodeNetpbm(const std::vector<uint8_t>& bytes, CpuImage& image, NetpbmFormat& format,
+    std::string* error = nullptr);
+
+// Header only, for readers that walk the raster themselves (e.g. through a
+// memory mapping). Also checks that size covers the whole raster.
+bool ParseNetpbmHeader(const uint8_t* bytes, size_t size, NetpbmHeader& header, std::string* error = nullptr);
+
+// One raster row (header.RowBytes() bytes) to header.width RGBA8 pixels
+void NetpbmRowToRgba(const NetpbmHeader& header, const uint8_t* in, uint8_t* rgba);
+
+std::vector<uint8_t> EncodeNetpbm(const CpuImage& image, NetpbmFormat format);
+
+// Pieces of EncodeNetpbm for writing one row at a time
+int NetpbmDepth(NetpbmFormat format);
+std::string NetpbmHeaderText(NetpbmFormat format, uint32_t width, uint32_t height);
+void RgbaToNetpbmRow(NetpbmFormat format, const uint8_t* rgba, uint8_t* out, uint32_t width);
+
+bool ReadFileBytes(const std::string& path, std::vector<uint8_t>& bytes);
+bool WriteFileBytes(const std::string& path, const std::vector<uint8_t>& bytes);
@@ -0,0 +1,242 @@
+#include "CpuLinearLightBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "Trace.h"
+
+namespace {
+
+void HorizontalRowHalfGeneric(const float* paddedSrc, uint16_t* dst, uint32_t width, const float* weights, int radius) {
+    HorizontalRowHalfScalar(paddedSrc, dst, 0, (size_t)width * 4, weights, radius);
+}
+
+void VerticalRowHalfGeneric(const uint16_t* const* rows, uint16_t* dst, size_t count, const float* weights, int radius) {
+    VerticalRowHalfScalar(rows, dst, 0, count, weights, radius);
+}
+
+void HalfToFloatRowGeneric(const uint16_t* src, float* dst, size_t count) {
+    for (size_t k = 0; k < count; k++) dst[k] = HalfToFloat(src[k]);
+}
+
+void DecodeRowTableGeneric(const uint8_t* src, float* dst, size_t count, const float* table) {
+    DecodeRowTableScalar(src, dst, 0, count, table);
+}
+
+void EncodeRowTableGeneric(const uint16_t* src, uint8_t* dst, size_t count, const uint8_t* table) {
+    EncodeRowTableScalar(src, dst, 0, count, table);
+}
+
+const CpuHalfRowKernels g_cpuHalfKernelsScalar = {
+    CpuIsa::Scalar, HorizontalRowHalfGeneric, VerticalRowHalfGeneric, HalfToFloatRowGeneric,
+    DecodeRowTableGeneric, EncodeRowTableGeneric,
+};
+
+// The 8-bit tables are laid out for CpuHalfRowKernels::decode8 and encode8;
+// the encode tables cover [0, 1] by half-float bit pattern
+struct LinearLightTables {
+    float srgb8ToLinear[512]; // then alpha, as i * (1 / 255)
+    float srgb16ToLinear[257]; // at k * 256 / 65535, interpolated between
+    uint8_t halfToSrgb8[2 * (kHalfOne + 1) + 3]; // then alpha (unorm), then padding
+    uint16_t halfToSrgb16[kHalfOne + 1];
+    uint16_t halfToUnorm16[kHalfOne + 1];
+};
+
+const LinearLightTables& GetLinearLightTables() {
+    static const LinearLightTables* tables = [] {
+        LinearLightTables* t = new LinearLightTables;
+        for (int i = 0; i < 256; i++) {
+            t->srgb8ToLinear[i] = (float)SrgbToLinear(i / 255.0);
+            t->srgb8ToLinear[256 + i] = i * (1.0f / 255.0f);
+        }
+        for (int i = 0; i <= 256; i++) t->srgb16ToLinear[i] = (float)SrgbToLinear(i * 256 / 65535.0);
+        for (int h = 0; h <= kHalfOne; h++) {
+            double linear = HalfToFloat((uint16_t)h);
+            t->halfToSrgb8[h] = (uint8_t)std::lround(LinearToSrgb(linear) * 255.0);
+            t->halfToSrgb8[kHalfOne + 1 + h] = (uint8_t)std::lround(linear * 255.0);
+            t->halfToSrgb16[h] = (uint16_t)std::lround(LinearToSrgb(linear) * 65535.0);
+            t->halfToUnorm16[h] = (uint16_t)std::lround(linear * 65535.0);
+        }
+        memset(t->halfToSrgb8 + 2 * (kHalfOne + 1), 0, 3);
+        return t;
+    }();
+    return *tables;
+}
+
+// Encode table index of a half float. The sums of non-negative samples with
+// positive weights are never negative (not even -0), and rounding can't push
+// them past 1, so this clamp only keeps a stray value inside the table.
+inline uint16_t HalfTableIndex(uint16_t h) {
+    return std::min(h, kHalfOne);
+}
+
+// What the engine needs to know about a pixel format: decode one row of
+// pixels to linear floats, and encode half floats back
+struct LinearLightFormat {
+    size_t sampleBytes;
+    void (*decode)(const uint8_t* src, float* dst, uint32_t width);
+    void (*encode)(const uint16_t* src, uint8_t* dst, size_t count);
+    float kernelTolerance;
+};
+
+void DecodeSrgb8(const uint8_t* src, float* dst, uint32_t width) {
+    GetCpuHalfRowKernels(GetCpuBlurIsa()).decode8(src, dst, (size_t)width * 4, GetLinearLightTables().srgb8ToLinear);
+}
+
+void EncodeSrgb8(const uint16_t* src, uint8_t* dst, size_t count) {
+    GetCpuHalfRowKernels(GetCpuBlurIsa()).encode8(src, dst, count, GetLinearLightTables().halfToSrgb8);
+}
+
+void DecodeSrgb16(const uint8_t* bytes, float* dst, uint32_t width) {
+    const float* table = GetLinearLightTables().srgb16ToLinear;
+    const uint16_t* src = reinterpret_cast<const uint16_t*>(bytes);
+    for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+        for (int c = 0; c < 3; c++) {
+            uint32_t v = src[c];
+            float t = (v & 0xFF) * (1.0f / 256.0f);
+            dst[c] = table[v >> 8] + (table[(v >> 8) + 1] - table[v >> 8]) * t;
+        }
+        dst[3] = src[3] * (1.0f / 65535.0f);
+    }
+}
+
+void EncodeSrgb16(const uint16_t* src, uint8_t* bytes, size_t count) {
+    const LinearLightTables& tables = GetLinearLightTables();
+    uint16_t* dst = reinterpret_cast<uint16_t*>(bytes);
+    for (size_t k = 0; k + 4 <= count; k += 4) {
+        dst[k + 0] = tables.halfToSrgb16[HalfTableIndex(src[k + 0])];
+        dst[k + 1] = tables.halfToSrgb16[HalfTableIndex(src[k + 1])];
+        dst[k + 2] = tables.halfToSrgb16[HalfTableIndex(src[k + 2])];
+        dst[k + 3] = tables.halfToUnorm16[HalfTableIndex(src[k + 3])];
+    }
+}
+
+void DecodeHalf(const uint8_t* src, float* dst, uint32_t width) {
+    GetCpuHalfRowKernels(GetCpuBlurIsa()).toFloat(reinterpret_cast<const uint16_t*>(src), dst, (size_t)width * 4);
+}
+
+void EncodeHalf(const uint16_t* src, uint8_t* dst, size_t count) {
+    memcpy(dst, src, count * sizeof(uint16_t));
+}
+
+const LinearLightFormat kSrgb8Format = { 1, DecodeSrgb8, EncodeSrgb8, kLinearLightKernelTolerance };
+const LinearLightFormat kSrgb16Format = { 2, DecodeSrgb16, EncodeSrgb16, kLinearLightKernelTolerance };
+const LinearLightFormat kHalfFormat = { 2, DecodeHalf, EncodeHalf, kDefaultKernelTolerance };
+
+// The tiling of CpuGaussianBlurTiled, with the tiles shrunk for the 8-byte
+// pixels of the intermediate
+void LinearLightBlurTiled(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height,
+    const LinearLightFormat& format, float blurRadius, ThreadPool& pool)
+{
+    size_t rowPitch = (size_t)width * 4 * format.sampleBytes;
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius), format.kernelTolerance);
+    if (CpuBlurIsCopy(*kernel)) {
+        if (dst != src) memcpy(dst, src, rowPitch * height);
+        return;
+    }
+    const CpuHalfRowKernels& kernels = GetCpuHalfRowKernels(GetCpuBlurIsa());
+    int radius = kernel->radius;
+    const float* weights = kernel->weights.data();
+
+    CpuBlurTiling tiling = ChooseCpuBlurTiling(width, height, radius);
+    tiling.bandRows = std::max<uint32_t>(tiling.bandRows / 2, 1);
+    tiling.stripColumns = std::max<uint32_t>(tiling.stripColumns / 2, 16);
+
+    // Every sample is written by the horizontal pass, so no zero fill
+    size_t tempPitch = (size_t)width * 4;
+    std::unique_ptr<uint16_t[]> temp(new uint16_t[tempPitch * height]);
+    {
+        TRACE_SCOPE("horizontal pass");
+        size_t bandCount = (height + tiling.bandRows - 1) / tiling.bandRows;
+        pool.ParallelFor(bandCount, [&](size_t band) {
+            uint32_t y0 = (uint32_t)band * tiling.bandRows;
+            uint32_t y1 = std::min(y0 + tiling.bandRows, height);
+            // Decoded row with its edge pixels repeated, as CpuBlurHorizontalRows pads
+            thread_local std::vector<float> padded;
+            padded.resize(((size_t)width + 2 * radius) * 4);
+            float* row = padded.data() + (size_t)radius * 4;
+            for (uint32_t y = y0; y < y1; y++) {
+                format.decode(src + y * rowPitch, row, width);
+                for (int i = 0; i < radius; i++) {
+                    memcpy(padded.data() + (size_t)i * 4, row, 4 * sizeof(float));
+                    memcpy(row + ((size_t)width + i) * 4, row + ((size_t)width - 1) * 4, 4 * sizeof(float));
+                }
+                kernels.horizontal(padded.data(), temp.get() + y * tempPitch, width, weights, radius);
+            }
+        });
+    }
+
+    TRACE_SCOPE("vertical pass");
+    size_t stripCount = (width + tiling.stripColumns - 1) / tiling.stripColumns;
+    size_t blocksPerStrip = (height + tiling.stripRows - 1) / tiling.stripRows;
+    pool.ParallelFor(stripCount * blocksPerStrip, [&](size_t tile) {
+        uint32_t strip = (uint32_t)(tile / blocksPerStrip);
+        uint32_t block = (uint32_t)(tile % blocksPerStrip);
+        uint32_t x0 = strip * tiling.stripColumns;
+        uint32_t x1 = std::min(x0 + tiling.stripColumns, width);
+        uint32_t y0 = block * tiling.stripRows;
+        uint32_t y1 = std::min(y0 + tiling.stripRows, height);
+        size_t offset = (size_t)x0 * 4;
+        size_t count = (size_t)(x1 - x0) * 4;
+
+        thread_local std::vector<const uint16_t*> rows;
+        thread_local std::vector<uint16_t> blurred;
+        rows.resize(2 * radius + 1);
+        blurred.resize(count);
+        for (uint32_t y = y0; y < y1; y++) {
+            for (int i = -radius; i <= radius; i++) {
+                int sy = std::min(std::max((int)y + i, 0), (int)height - 1);
+                rows[i + radius] = temp.get() + sy * tempPitch + offset;
+            }
+            kernels.vertical(rows.data(), blurred.data(), count, weights, radius);
+            format.encode(blurred.data(), dst + y * rowPitch + offset * format.sampleBytes, count);
+        }
+    });
+}
+
+} // namespace
+
+const CpuHalfRowKernels& GetCpuHalfRowKernels(CpuIsa isa) {
+    CpuIsa best = DetectCpuIsa();
+    if (isa > best) isa = best;
+#if RTBLUR_HAS_X86_KERNELS
+    if (isa >= CpuIsa::Avx2 && GetCpuFeatures().f16c) return g_cpuHalfKernelsAvx2;
+#endif
+    return g_cpuHalfKernelsScalar;
+}
+
+double SrgbToLinear(double encoded) {
+    return encoded <= 0.04045 ? encoded / 12.92 : std::pow((encoded + 0.055) / 1.055, 2.4);
+}
+
+double LinearToSrgb(double linear) {
+    return linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+void CpuLinearLightBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool) {
+    if (src.Empty()) return;
+    if (&dst != &src && (dst.width != src.width || dst.height != src.height)) dst = CpuImage(src.width, src.height);
+    LinearLightBlurTiled(src.pixels.data(), dst.pixels.data(), src.width, src.height, kSrgb8Format, blurRadius, pool);
+}
+
+void CpuLinearLightBlur16(const uint16_t* src, uint16_t* dst, uint32_t width, uint32_t height,
+    float blurRadius, ThreadPool& pool)
+{
+    if (width == 0 || height == 0) return;
+    LinearLightBlurTiled(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), width, height,
+        kSrgb16Format, blurRadius, pool);
+}
+
+void CpuBlurHalf(const uint16_t* src, uint16_t* dst, uint32_t width, uint32_t height,
+    float blurRadius, ThreadPool& pool)
+{
+    if (width == 0 || height == 0) return;
+    LinearLightBlurTiled(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), width, height,
+        kHalfFormat, blurRadius, pool);
+}
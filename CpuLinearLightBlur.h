@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuImage.h"
+#include "GaussianKernel.h"
+#include "ThreadPool.h"
+
+// The direct engine's Gaussian applied in linear light. Blurring sRGB-encoded
+// values averages the wrong quantity and darkens edges between bright and
+// dark areas; here the color channels are decoded to linear light first and
+// encoded again afterwards, both through lookup tables rather than pow().
+// Alpha is linear already and is only scaled. Between the passes the image is
+// kept as half floats: half the bytes of float, and no rounding to the input
+// format. Same kernel and clamp addressing as CpuGaussianBlurTiled.
+//
+// The encode table is indexed by the half-float result (15361 entries for
+// [0, 1]), so encoding is exact for the value the vertical pass stored.
+
+// Kernel truncation tolerance for sRGB data. The truncated tail's error is in
+// linear light, and encoding multiplies it by the curve's slope, up to 12.92
+// near black, so the tail is cut that much finer than kDefaultKernelTolerance.
+// Linear half-float data keeps the default.
+constexpr float kLinearLightKernelTolerance = kDefaultKernelTolerance / 12.92f;
+
+// The sRGB transfer function, exact, on [0, 1].
+double SrgbToLinear(double encoded);
+double LinearToSrgb(double linear);
+
+// RGBA8, sRGB-encoded color.
+void CpuLinearLightBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool);
+
+// RGBA16, sRGB-encoded color as in 16-bit PNG and TIFF files, tightly packed.
+// The half-float intermediate keeps about 12 bits of the encoded precision.
+void CpuLinearLightBlur16(const uint16_t* src, uint16_t* dst, uint32_t width, uint32_t height,
+    float blurRadius, ThreadPool& pool);
+
+// RGBA16F that is linear already (scRGB and other HDR sources): blurred with
+// no transfer function and no clamping, so values above 1 survive.
+void CpuBlurHalf(const uint16_t* src, uint16_t* dst, uint32_t width, uint32_t height,
+    float blurRadius, ThreadPool& pool);
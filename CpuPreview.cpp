@@ -0,0 +1,83 @@
+#include "CpuPreview.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+
+namespace {
+
+// Source pixels covering one output pixel, and how much of each
+struct AreaTaps {
+    uint32_t first = 0;
+    std::vector<float> weights;
+};
+
+std::vector<AreaTaps> BuildAreaTaps(uint32_t srcSize, uint32_t dstSize) {
+    std::vector<AreaTaps> taps(dstSize);
+    double step = (double)srcSize / dstSize;
+    for (uint32_t i = 0; i < dstSize; i++) {
+        double begin = i * step, end = (i + 1) * step;
+        uint32_t first = (uint32_t)begin;
+        uint32_t last = std::min((uint32_t)std::ceil(end), srcSize);
+        taps[i].first = first;
+        for (uint32_t s = first; s < last; s++) {
+            double covered = std::min(end, s + 1.0) - std::max(begin, (double)s);
+            taps[i].weights.push_back((float)(covered / step));
+        }
+    }
+    return taps;
+}
+
+} // namespace
+
+PreviewSize ChoosePreviewSize(uint32_t imageWidth, uint32_t imageHeight, float displayWidth, float displayHeight) {
+    PreviewSize preview;
+    preview.width = imageWidth;
+    preview.height = imageHeight;
+    if (imageWidth == 0 || imageHeight == 0 || !(displayWidth >= 1.0f) || !(displayHeight >= 1.0f)) return preview;
+
+    // Fit inside the display area, never upscale
+    double scale = std::min({ (double)displayWidth / imageWidth, (double)displayHeight / imageHeight, 1.0 });
+    preview.width = std::max<uint32_t>(1, (uint32_t)std::lround(imageWidth * scale));
+    preview.height = std::max<uint32_t>(1, (uint32_t)std::lround(imageHeight * scale));
+    // Rounding makes the two axes differ slightly; use their mean
+    preview.scale = (float)(0.5 * ((double)preview.width / imageWidth + (double)preview.height / imageHeight));
+    return preview;
+}
+
+void CpuDownsampleArea(const CpuImage& src, CpuImage& dst, uint32_t width, uint32_t height, ThreadPool& pool) {
+    width = std::min(width, src.width);
+    height = std::min(height, src.height);
+    if (dst.width != width || dst.height != height) dst = CpuImage(width, height);
+    if (src.Empty() || width == 0 || height == 0) return;
+
+    std::vector<AreaTaps> columns = BuildAreaTaps(src.width, width);
+    std::vector<AreaTaps> rows = BuildAreaTaps(src.height, height);
+
+    // One output row per task: average its source rows horizontally, then
+    // sum them with the row weights. Each source row feeds at most two tasks.
+    pool.ParallelFor(height, [&](size_t y) {
+        thread_local std::vector<float> accum;
+        accum.assign((size_t)width * 4, 0.0f);
+        const AreaTaps& rowTaps = rows[y];
+        for (size_t r = 0; r < rowTaps.weights.size(); r++) {
+            const uint8_t* in = src.Row(rowTaps.first + (uint32_t)r);
+            float rowWeight = rowTaps.weights[r];
+            for (uint32_t x = 0; x < width; x++) {
+                const AreaTaps& columnTaps = columns[x];
+                const uint8_t* pixel = in + (size_t)columnTaps.first * 4;
+                float sum[4] = {};
+                for (size_t k = 0; k < columnTaps.weights.size(); k++, pixel += 4) {
+                    float w = columnTaps.weights[k];
+                    for (int c = 0; c < 4; c++) sum[c] += w * pixel[c];
+                }
+                float* out = accum.data() + (size_t)x * 4;
+                for (int c = 0; c < 4; c++) out[c] += rowWeight * sum[c];
+            }
+        }
+        uint8_t* out = dst.Row((uint32_t)y);
+        for (size_t i = 0; i < accum.size(); i++) out[i] = QuantizeUnorm8(accum[i]);
+    });
+}
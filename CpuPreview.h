@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Interactive preview for the CPU blur: while the slider moves, blur a copy
+// of the image at the size it is displayed at, with the radius scaled to
+// match, and only blur the full-resolution image once the value settles.
+// Downscaling with an area average and blurring commute up to rounding, so
+// the preview looks like the full blur shown at that size.
+
+struct PreviewSize {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float scale = 1.0f; // preview pixels per image pixel
+};
+
+// The displayed size, kept within the image and at its aspect ratio.
+PreviewSize ChoosePreviewSize(uint32_t imageWidth, uint32_t imageHeight, float displayWidth, float displayHeight);
+
+// The slider value that blurs the preview by the same fraction of the image.
+inline float PreviewBlurRadius(float blurRadius, const PreviewSize& preview) {
+    return blurRadius * preview.scale;
+}
+
+// Area-averaging resize to a smaller or equal size: each output pixel is the
+// mean of the source area it covers, partly covered pixels weighted by
+// coverage.
+void CpuDownsampleArea(const CpuImage& src, CpuImage& dst, uint32_t width, uint32_t height, ThreadPool& pool);
@@ -0,0 +1,156 @@
+#include "CpuPyramidBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "GaussianKernel.h"
+
+namespace {
+
+// One pyramid level: RGBA float, 0..255 like the other CPU paths
+struct PyramidLevel {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> pixels;
+
+    void Resize(uint32_t w, uint32_t h) {
+        width = w;
+        height = h;
+        pixels.resize((size_t)w * h * 4);
+    }
+    float* Row(uint32_t y) { return pixels.data() + (size_t)y * width * 4; }
+    const float* Row(uint32_t y) const { return pixels.data() + (size_t)y * width * 4; }
+};
+
+inline void Store(float& out, float v) { out = v; }
+inline void Store(uint8_t& out, float v) { out = QuantizeUnorm8(std::max(v, 0.0f)); }
+
+// Where a linear-clamp sampler reads for destination texel i: the two source
+// texels and the weight of the second. Destination texel centers map to
+// source texel coordinate (i + 0.5) * scale - 0.5 + offset, the same mapping
+// PSResample applies to its uv.
+struct BilinearTap {
+    uint32_t i0, i1;
+    float t;
+};
+
+std::vector<BilinearTap> BilinearTaps(uint32_t srcSize, uint32_t dstSize, double scale, double offset) {
+    std::vector<BilinearTap> taps(dstSize);
+    for (uint32_t i = 0; i < dstSize; i++) {
+        double s = (i + 0.5) * scale - 0.5 + offset;
+        s = std::min(std::max(s, 0.0), (double)(srcSize - 1));
+        uint32_t i0 = (uint32_t)s;
+        taps[i] = { i0, std::min(i0 + 1, srcSize - 1), (float)(s - i0) };
+    }
+    return taps;
+}
+
+// Bilinear resample of an RGBA image of In into one of Out, rows in parallel.
+// scale is source texels per destination texel, offset is in source texels.
+template <typename In, typename Out>
+void Resample(const In* src, uint32_t srcWidth, uint32_t srcHeight,
+    Out* dst, uint32_t dstWidth, uint32_t dstHeight, double scale, double offset, ThreadPool& pool)
+{
+    std::vector<BilinearTap> xTaps = BilinearTaps(srcWidth, dstWidth, scale, offset);
+    std::vector<BilinearTap> yTaps = BilinearTaps(srcHeight, dstHeight, scale, offset);
+    size_t srcPitch = (size_t)srcWidth * 4, dstPitch = (size_t)dstWidth * 4;
+
+    pool.ParallelFor(dstHeight, [&](size_t y) {
+        const BilinearTap& ty = yTaps[y];
+        const In* row0 = src + ty.i0 * srcPitch;
+        const In* row1 = src + ty.i1 * srcPitch;
+        Out* out = dst + y * dstPitch;
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            const BilinearTap& tx = xTaps[x];
+            for (int c = 0; c < 4; c++) {
+                float top = (float)row0[tx.i0 * 4 + c] * (1.0f - tx.t) + (float)row0[tx.i1 * 4 + c] * tx.t;
+                float bottom = (float)row1[tx.i0 * 4 + c] * (1.0f - tx.t) + (float)row1[tx.i1 * 4 + c] * tx.t;
+                Store(out[x * 4 + c], top * (1.0f - ty.t) + bottom * ty.t);
+            }
+        }
+    });
+}
+
+// Separable Gaussian on a level, in place via temp. The levels are small, so
+// this is the plain per-tap loop with clamped indices.
+void BlurLevel(PyramidLevel& level, PyramidLevel& temp, const GaussianKernel& kernel, ThreadPool& pool) {
+    uint32_t width = level.width, height = level.height;
+    int r = kernel.radius;
+    temp.Resize(width, height);
+
+    pool.ParallelFor(height, [&](size_t y) {
+        // Clamp by padding the row with copies of its end pixels
+        thread_local std::vector<float> padded;
+        padded.resize(((size_t)width + 2 * r) * 4);
+        const float* in = level.Row((uint32_t)y);
+        for (int x = -r; x < (int)width + r; x++) {
+            int sx = std::min(std::max(x, 0), (int)width - 1);
+            std::copy(in + sx * 4, in + sx * 4 + 4, padded.data() + (size_t)(x + r) * 4);
+        }
+        float* out = temp.Row((uint32_t)y);
+        for (uint32_t x = 0; x < width; x++) {
+            const float* center = padded.data() + (size_t)(x + r) * 4;
+            float sum[4] = {};
+            for (int i = -r; i <= r; i++) {
+                float w = kernel.weights[i < 0 ? -i : i];
+                for (int c = 0; c < 4; c++) sum[c] += center[i * 4 + c] * w;
+            }
+            std::copy(sum, sum + 4, out + (size_t)x * 4);
+        }
+    });
+
+    // Vertical: accumulate whole rows so every tap reads contiguously
+    pool.ParallelFor(height, [&](size_t y) {
+        float* out = level.Row((uint32_t)y);
+        std::fill(out, out + (size_t)width * 4, 0.0f);
+        for (int i = -r; i <= r; i++) {
+            int sy = std::min(std::max((int)y + i, 0), (int)height - 1);
+            const float* in = temp.Row((uint32_t)sy);
+            float w = kernel.weights[i < 0 ? -i : i];
+            for (size_t j = 0; j < (size_t)width * 4; j++) out[j] += in[j] * w;
+        }
+    });
+}
+
+} // namespace
+
+void CpuPyramidBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool) {
+    if (src.Empty()) return;
+
+    BlurPyramid pyramid = BuildBlurPyramid(SigmaFromBlurRadius(blurRadius));
+    if (pyramid.levels == 0) {
+        CpuGaussianBlurTiled(src, dst, blurRadius, pool);
+        return;
+    }
+
+    // levels[k - 1] is level k; level 0 is the source itself
+    std::vector<PyramidLevel> levels(pyramid.levels);
+    for (int k = 1; k <= pyramid.levels; k++) {
+        levels[k - 1].Resize(PyramidLevelExtent(pyramid, src.width, k), PyramidLevelExtent(pyramid, src.height, k));
+    }
+
+    // The first step reads the source shifted by the margin; clamping there
+    // fills the margin with edge pixels at full resolution
+    double padding = PyramidPadding(pyramid);
+    Resample(src.pixels.data(), src.width, src.height,
+        levels[0].pixels.data(), levels[0].width, levels[0].height, 2.0, -padding, pool);
+    for (size_t k = 1; k < levels.size(); k++) {
+        Resample(levels[k - 1].pixels.data(), levels[k - 1].width, levels[k - 1].height,
+            levels[k].pixels.data(), levels[k].width, levels[k].height, 2.0, 0.0, pool);
+    }
+
+    PyramidLevel temp;
+    BlurLevel(levels.back(), temp, *GetGaussianKernel(pyramid.levelSigma), pool);
+
+    // Back up: each level is overwritten by the upsampled one below it
+    for (size_t k = levels.size() - 1; k > 0; k--) {
+        Resample(levels[k].pixels.data(), levels[k].width, levels[k].height,
+            levels[k - 1].pixels.data(), levels[k - 1].width, levels[k - 1].height, 0.5, 0.0, pool);
+    }
+    if (dst.width != src.width || dst.height != src.height) dst = CpuImage(src.width, src.height);
+    Resample(levels[0].pixels.data(), levels[0].width, levels[0].height,
+        dst.pixels.data(), dst.width, dst.height, 0.5, padding * 0.5, pool);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// BuildBlurPyramid on the CPU, mirroring the GPU pyramid mode step for step:
+// bilinear halving down to the smallest level, a direct Gaussian there, and
+// bilinear upsampling back. Levels below full resolution are float RGBA so
+// only the final result rounds to 8 bits. Radii too small for a pyramid go
+// to CpuGaussianBlurTiled.
+void CpuPyramidBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool);
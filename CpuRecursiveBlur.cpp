@@ -0,0 +1,190 @@
+#include "CpuRecursiveBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+#include "CpuBlurTiled.h"
+#include "GaussianKernel.h"
+
+namespace {
+
+constexpr uint32_t kRecursiveStripColumns = 16;
+
+// Filters one line of `length` positions with `lanes` interleaved floats each,
+// in place: forward into data, then backward over it. State is double; with
+// poles this close to 1 float state drifts visibly at large sigma.
+void RecursiveLine(float* data, int length, int lanes, const RecursiveGaussian& f,
+    std::vector<double>& state)
+{
+    state.resize((size_t)lanes * 4);
+    double* s1 = state.data();
+    double* s2 = s1 + lanes;
+    double* s3 = s2 + lanes;
+    double* edge = s3 + lanes;
+    const double B = f.B, a1 = f.a1, a2 = f.a2, a3 = f.a3;
+
+    // Causal pass. Left of the line the input repeats data[0], where the
+    // filter sits in its steady state (unit DC gain), so the history is data[0].
+    for (int l = 0; l < lanes; l++) {
+        s1[l] = s2[l] = s3[l] = data[l];
+        edge[l] = data[(size_t)(length - 1) * lanes + l];
+    }
+    for (int p = 0; p < length; p++) {
+        float* x = data + (size_t)p * lanes;
+        for (int l = 0; l < lanes; l++) {
+            double w = B * x[l] + a1 * s1[l] + a2 * s2[l] + a3 * s3[l];
+            s3[l] = s2[l];
+            s2[l] = s1[l];
+            s1[l] = w;
+            x[l] = (float)w;
+        }
+    }
+
+    // Anti-causal pass, starting from the state the filter would reach if the
+    // line continued with its last input value (Triggs-Sdika)
+    for (int l = 0; l < lanes; l++) {
+        double u = edge[l];
+        double d0 = s1[l] - u, d1 = s2[l] - u, d2 = s3[l] - u;
+        double y0 = u + f.M[0][0] * d0 + f.M[0][1] * d1 + f.M[0][2] * d2;
+        double y1 = u + f.M[1][0] * d0 + f.M[1][1] * d1 + f.M[1][2] * d2;
+        double y2 = u + f.M[2][0] * d0 + f.M[2][1] * d1 + f.M[2][2] * d2;
+        s1[l] = y0;
+        s2[l] = y1;
+        s3[l] = y2;
+    }
+    for (int p = length - 1; p >= 0; p--) {
+        float* x = data + (size_t)p * lanes;
+        for (int l = 0; l < lanes; l++) {
+            double y = B * x[l] + a1 * s1[l] + a2 * s2[l] + a3 * s3[l];
+            s3[l] = s2[l];
+            s2[l] = s1[l];
+            s1[l] = y;
+            x[l] = (float)y;
+        }
+    }
+}
+
+} // namespace
+
+RecursiveGaussian BuildRecursiveGaussian(double sigma) {
+    RecursiveGaussian f;
+    f.sigma = sigma;
+
+    // Young & van Vliet (1995). Their q(sigma) fit minimizes the error against
+    // the Gaussian rather than matching its variance; the response comes out
+    // roughly 10% wider by second moment but closer in shape.
+    double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330
+                            : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+    // Their coefficients are polynomials in q, printed to six digits. Rounded
+    // that way b0 picks up an extra 1e-5 * q^2 that moves the poles, and by
+    // sigma 100 the response is several percent too wide; expanding the
+    // product over the poles they came from (m0, m1 +- i m2) avoids that.
+    const double m0 = 1.16680, m1 = 1.10783, m2 = 1.40586;
+    double m = m1 * m1 + m2 * m2;
+    double q2 = q * q, q3 = q2 * q;
+    double b0 = (m0 + q) * (m + 2.0 * m1 * q + q2);
+    double b1 = q * (2.0 * m0 * m1 + m + (2.0 * m0 + 4.0 * m1) * q + 3.0 * q2);
+    double b2 = -q2 * (m0 + 2.0 * m1 + 3.0 * q);
+    double b3 = q3;
+    f.a1 = b1 / b0;
+    f.a2 = b2 / b0;
+    f.a3 = b3 / b0;
+    f.B = 1.0 - (f.a1 + f.a2 + f.a3);
+
+    // The right-boundary matrix maps the forward filter's last three outputs
+    // (relative to the edge value) to the backward filter's initial state.
+    // It is linear, so derive it column by column: let the forward filter ring
+    // out from each unit state with zero input, then run the backward filter
+    // over that tail from zero. Triggs & Sdika give the closed form; running it
+    // out avoids transcribing it. The tail decays by about e every sigma samples.
+    int tail = (int)(30.0 * sigma) + 100;
+    std::vector<double> w(tail + 3);
+    for (int j = 0; j < 3; j++) {
+        double h1 = j == 0, h2 = j == 1, h3 = j == 2;
+        for (int n = 0; n < tail; n++) {
+            double v = f.a1 * h1 + f.a2 * h2 + f.a3 * h3;
+            h3 = h2;
+            h2 = h1;
+            h1 = v;
+            w[n] = v;
+        }
+        double y1 = 0.0, y2 = 0.0, y3 = 0.0;
+        for (int n = tail - 1; n >= 0; n--) {
+            double y = f.B * w[n] + f.a1 * y1 + f.a2 * y2 + f.a3 * y3;
+            y3 = y2;
+            y2 = y1;
+            y1 = y;
+            if (n <= 2) f.M[n][j] = y;
+        }
+    }
+    return f;
+}
+
+std::vector<double> RecursiveGaussianWeights(const RecursiveGaussian& filter, int radius) {
+    // Pad well past the window so the truncated line ends don't feed back in
+    int pad = (int)(10.0 * filter.sigma) + 16;
+    int length = 2 * (radius + pad) + 1;
+    std::vector<float> line(length, 0.0f);
+    line[length / 2] = 1.0f;
+    std::vector<double> state;
+    RecursiveLine(line.data(), length, 1, filter, state);
+    return std::vector<double>(line.begin() + pad, line.end() - pad);
+}
+
+void CpuRecursiveGaussianBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool) {
+    if (src.Empty()) return;
+
+    double sigma = SigmaFromBlurRadius(blurRadius);
+    if (sigma < kMinRecursiveSigma) {
+        CpuGaussianBlurTiled(src, dst, blurRadius, pool);
+        return;
+    }
+
+    RecursiveGaussian filter = BuildRecursiveGaussian(sigma);
+    uint32_t width = src.width, height = src.height;
+
+    // Horizontal: rows in bands, four lanes per position
+    CpuImage temp(width, height);
+    const uint32_t bandRows = 16;
+    pool.ParallelFor((height + bandRows - 1) / bandRows, [&](size_t band) {
+        thread_local std::vector<float> line;
+        thread_local std::vector<double> state;
+        line.resize((size_t)width * 4);
+
+        uint32_t y0 = (uint32_t)band * bandRows;
+        uint32_t y1 = std::min(y0 + bandRows, height);
+        for (uint32_t y = y0; y < y1; y++) {
+            const uint8_t* row = src.Row(y);
+            for (size_t i = 0; i < line.size(); i++) line[i] = row[i];
+            RecursiveLine(line.data(), (int)width, 4, filter, state);
+            uint8_t* out = temp.Row(y);
+            for (size_t i = 0; i < line.size(); i++) out[i] = QuantizeUnorm8(std::max(line[i], 0.0f));
+        }
+    });
+
+    // Vertical: strips of columns walk down the image row by row, so both
+    // directions of the filter read contiguous memory
+    if (dst.width != width || dst.height != height) dst = CpuImage(width, height);
+    pool.ParallelFor((width + kRecursiveStripColumns - 1) / kRecursiveStripColumns, [&](size_t strip) {
+        uint32_t x0 = (uint32_t)strip * kRecursiveStripColumns;
+        int lanes = (int)std::min(kRecursiveStripColumns, width - x0) * 4;
+
+        thread_local std::vector<float> column;
+        thread_local std::vector<double> state;
+        column.resize((size_t)height * lanes);
+
+        for (uint32_t y = 0; y < height; y++) {
+            const uint8_t* row = temp.Row(y) + (size_t)x0 * 4;
+            float* line = column.data() + (size_t)y * lanes;
+            for (int l = 0; l < lanes; l++) line[l] = row[l];
+        }
+        RecursiveLine(column.data(), (int)height, lanes, filter, state);
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* out = dst.Row(y) + (size_t)x0 * 4;
+            const float* line = column.data() + (size_t)y * lanes;
+            for (int l = 0; l < lanes; l++) out[l] = QuantizeUnorm8(std::max(line[l], 0.0f));
+        }
+    });
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Young-van Vliet recursive Gaussian: a third-order causal filter followed by
+// the same filter run backwards, a fixed handful of multiply-adds per pixel
+// and direction at any sigma. Meant for very wide blurs where even the box
+// cascade's extra passes over memory hurt.
+struct RecursiveGaussian {
+    double sigma = 0.0;
+    double B = 1.0;              // input gain; the filter has unit DC gain
+    double a1 = 0.0, a2 = 0.0, a3 = 0.0; // feedback on the previous three outputs
+    // Triggs-Sdika right-boundary matrix: the backward filter's initial state
+    // is u + M * (last three forward outputs - u), where u is the edge value.
+    // This matches clamp addressing exactly instead of assuming zeros.
+    double M[3][3] = {};
+};
+
+// Coefficients for sigma >= kMinRecursiveSigma.
+RecursiveGaussian BuildRecursiveGaussian(double sigma);
+
+// Impulse response of the forward-backward filter over 2 * radius + 1 taps,
+// for comparing against the exact kernel with MeasureKernelError.
+std::vector<double> RecursiveGaussianWeights(const RecursiveGaussian& filter, int radius);
+
+// Below this the recursive approximation is poor and the direct kernel is only
+// a few taps anyway, so CpuRecursiveGaussianBlur hands small radii to it.
+constexpr double kMinRecursiveSigma = 2.0;
+
+void CpuRecursiveGaussianBlur(const CpuImage& src, CpuImage& dst, float blurRadius, ThreadPool& pool);
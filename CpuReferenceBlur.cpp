@@ -0,0 +1,77 @@
+#include "CpuReferenceBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "CpuLinearLightBlur.h"
+#include "GaussianKernel.h"
+
+void CpuReferenceGaussianBlur(const CpuImage& src, std::vector<double>& out, double sigma, ThreadPool& pool,
+    bool linearLight)
+{
+    uint32_t width = src.width, height = src.height;
+    out.assign(src.pixels.size(), 0.0);
+    if (src.Empty()) return;
+
+    // Far enough out that the dropped weights are below double rounding of the sums
+    int radius = 0;
+    while (sigma > 0.0 && ReferenceGaussianWeight(radius + 1, sigma) > 1e-13) radius++;
+    std::vector<double> weights(radius + 1);
+    for (int k = 0; k <= radius; k++) weights[k] = ReferenceGaussianWeight(k, sigma);
+
+    // Sample values on the 0..255 scale, decoded when blurring in linear light
+    double decode[256];
+    for (int v = 0; v < 256; v++) decode[v] = linearLight ? SrgbToLinear(v / 255.0) * 255.0 : v;
+
+    size_t rowValues = (size_t)width * 4;
+    std::vector<double> temp(src.pixels.size());
+    pool.ParallelFor(height, [&](size_t y) {
+        const uint8_t* row = src.Row((uint32_t)y);
+        double* dst = temp.data() + y * rowValues;
+        for (int x = 0; x < (int)width; x++) {
+            for (int c = 0; c < 4; c++) {
+                double sum = 0.0;
+                for (int k = -radius; k <= radius; k++) {
+                    int sx = std::min(std::max(x + k, 0), (int)width - 1);
+                    uint8_t v = row[(size_t)sx * 4 + c];
+                    sum += weights[k < 0 ? -k : k] * (c < 3 ? decode[v] : v);
+                }
+                dst[(size_t)x * 4 + c] = sum;
+            }
+        }
+    });
+
+    pool.ParallelFor(height, [&](size_t y) {
+        double* dst = out.data() + y * rowValues;
+        for (int k = -radius; k <= radius; k++) {
+            int sy = std::min(std::max((int)y + k, 0), (int)height - 1);
+            const double* row = temp.data() + (size_t)sy * rowValues;
+            double w = weights[k < 0 ? -k : k];
+            for (size_t i = 0; i < rowValues; i++) dst[i] += w * row[i];
+        }
+        if (linearLight) {
+            for (size_t i = 0; i < rowValues; i++) {
+                if (i % 4 != 3) dst[i] = LinearToSrgb(std::min(std::max(dst[i] / 255.0, 0.0), 1.0)) * 255.0;
+            }
+        }
+    });
+}
+
+ImageError MeasureImageError(const CpuImage& image, const std::vector<double>& reference) {
+    ImageError error;
+    size_t count = std::min(image.pixels.size(), reference.size());
+    if (count == 0) return error;
+
+    double sumAbs = 0.0, sumSquares = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double diff = std::fabs(image.pixels[i] - reference[i]);
+        error.maxAbs = std::max(error.maxAbs, diff);
+        sumAbs += diff;
+        sumSquares += diff * diff;
+    }
+    error.meanAbs = sumAbs / count;
+    double mse = sumSquares / count;
+    error.psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    return error;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// The blur every engine approximates, computed the slow way: the untruncated
+// discrete Gaussian (ReferenceGaussianWeight) in double precision, with clamp
+// addressing and no rounding between the passes. out holds width * height * 4
+// values on the 0..255 scale. Costs O(sigma) per pixel and direction, so meant
+// for accuracy checks on modest images. With linearLight the color channels
+// are blurred in linear light with the exact sRGB curves, the reference for
+// CpuLinearLightBlur.
+void CpuReferenceGaussianBlur(const CpuImage& src, std::vector<double>& out, double sigma, ThreadPool& pool,
+    bool linearLight = false);
+
+// How far an 8-bit result is from the reference, in 8-bit steps.
+struct ImageError {
+    double maxAbs = 0.0;
+    double meanAbs = 0.0;
+    double psnr = 0.0; // dB against a peak of 255; infinite when the result is exact
+};
+
+ImageError MeasureImageError(const CpuImage& image, const std::vector<double>& reference);
@@ -0,0 +1,447 @@
+#include "CpuRowIO.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CpuImageIO.h"
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path) {
+    Close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > SIZE_MAX) {
+        Close();
+        return false;
+    }
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        Close();
+        return false;
+    }
+    m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        Close();
+        return false;
+    }
+    m_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+}
+
+void MappedFile::Release(size_t offset, size_t length) {
+    // Unlocking pages that aren't locked drops them from the working set
+    if (m_data && length > 0) VirtualUnlock((void*)(m_data + offset), length);
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    m_data = (const uint8_t*)data;
+    m_size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (m_data) munmap((void*)m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+void MappedFile::Release(size_t offset, size_t length) {
+    if (!m_data || length == 0) return;
+    // Only whole pages inside the range
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = (offset + length) / page * page;
+    if (end > begin) madvise((void*)(m_data + begin), end - begin, MADV_DONTNEED);
+}
+
+#endif
+
+namespace {
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+std::string LowerExtension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return "";
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return ext;
+}
+
+// Releases the mapped rows behind the reader every few megabytes
+class ReleaseBehind {
+public:
+    explicit ReleaseBehind(MappedFile& file) : m_file(file) {}
+
+    void Consumed(size_t end) {
+        if (end - m_released < kChunk) return;
+        m_file.Release(m_released, end - m_released);
+        m_released = end;
+    }
+
+private:
+    static constexpr size_t kChunk = 8 << 20;
+    MappedFile& m_file;
+    size_t m_released = 0;
+};
+
+class RawRowReader : public RowReader {
+public:
+    bool Open(const std::string& path, uint32_t width, uint32_t height, std::string* error) {
+        if (width == 0 || height == 0) return Fail(error, "raw input needs its width and height");
+        if (!m_file.Open(path)) return Fail(error, "can't map file");
+        if (m_file.Size() / ((size_t)width * 4) < height) return Fail(error, "file is smaller than width x height RGBA8");
+        m_width = width;
+        m_height = height;
+        return true;
+    }
+
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+
+    bool ReadRow(uint8_t* rgba) override {
+        if (m_row >= m_height) return false;
+        size_t rowBytes = (size_t)m_width * 4;
+        size_t offset = m_row++ * rowBytes;
+        memcpy(rgba, m_file.Data() + offset, rowBytes);
+        m_release.Consumed(offset + rowBytes);
+        return true;
+    }
+
+private:
+    MappedFile m_file;
+    ReleaseBehind m_release{ m_file };
+    uint32_t m_width = 0, m_height = 0;
+    size_t m_row = 0;
+};
+
+class NetpbmRowReader : public RowReader {
+public:
+    bool Open(const std::string& path, std::string* error) {
+        if (!m_file.Open(path)) return Fail(error, "can't map file");
+        return ParseNetpbmHeader(m_file.Data(), m_file.Size(), m_header, error);
+    }
+
+    uint32_t Width() const override { return m_header.width; }
+    uint32_t Height() const override { return m_header.height; }
+
+    bool ReadRow(uint8_t* rgba) override {
+        if (m_row >= m_header.height) return false;
+        size_t offset = m_header.rasterOffset + m_row++ * m_header.RowBytes();
+        NetpbmRowToRgba(m_header, m_file.Data() + offset, rgba);
+        m_release.Consumed(offset + m_header.RowBytes());
+        return true;
+    }
+
+private:
+    MappedFile m_file;
+    ReleaseBehind m_release{ m_file };
+    NetpbmHeader m_header;
+    size_t m_row = 0;
+};
+
+// Uncompressed, chunky, 8 bits per sample TIFF or BigTIFF, read strip by strip
+class TiffRowReader : public RowReader {
+public:
+    bool Open(const std::string& path, std::string* error) {
+        if (!m_file.Open(path)) return Fail(error, "can't map file");
+        if (m_file.Size() < 16) return Fail(error, "not a TIFF file");
+
+        const uint8_t* d = m_file.Data();
+        if (d[0] == 'I' && d[1] == 'I') m_bigEndian = false;
+        else if (d[0] == 'M' && d[1] == 'M') m_bigEndian = true;
+        else return Fail(error, "not a TIFF file");
+
+        uint16_t version = (uint16_t)Read(2, 2);
+        uint64_t ifdOffset = 0;
+        if (version == 42) {
+            ifdOffset = Read(4, 4);
+        }
+        else if (version == 43) {
+            m_big = true;
+            ifdOffset = Read(8, 8);
+        }
+        else {
+            return Fail(error, "not a TIFF file");
+        }
+
+        uint64_t width = 0, height = 0, compression = 1, photometric = 1, samples = 1;
+        uint64_t rowsPerStrip = UINT32_MAX, planar = 1, bits = 8;
+        size_t entrySize = m_big ? 20 : 12;
+        size_t countSize = m_big ? 8 : 2;
+        if (ifdOffset > m_file.Size() - countSize) return Fail(error, "bad IFD offset");
+        size_t ifd = (size_t)ifdOffset;
+        uint64_t entries = Read(ifd, (int)countSize);
+        // Divided rather than multiplied: a BigTIFF count can overflow the product
+        if (entries > (m_file.Size() - ifd - countSize) / entrySize) return Fail(error, "truncated IFD");
+
+        for (uint64_t e = 0; e < entries; e++) {
+            size_t entry = ifd + countSize + (size_t)e * entrySize;
+            uint16_t tag = (uint16_t)Read(entry, 2);
+            Field field;
+            if (!ReadField(entry, field)) return Fail(error, "bad TIFF field");
+            switch (tag) {
+            case 256: width = Value(field, 0); break;
+            case 257: height = Value(field, 0); break;
+            case 258: bits = Value(field, 0); break; // all samples must match; checked below
+            case 259: compression = Value(field, 0); break;
+            case 262: photometric = Value(field, 0); break;
+            case 273: m_stripOffsets = field; break;
+            case 277: samples = Value(field, 0); break;
+            case 278: rowsPerStrip = Value(field, 0); break;
+            case 284: planar = Value(field, 0); break;
+            default: break;
+            }
+            if (tag == 258) {
+                for (uint64_t i = 1; i < field.count; i++) {
+                    if (Value(field, i) != bits) return Fail(error, "mixed bits per sample");
+                }
+            }
+        }
+
+        if (width == 0 || height == 0 || width > UINT32_MAX || height > UINT32_MAX) return Fail(error, "bad image size");
+        if (compression != 1) return Fail(error, "only uncompressed TIFF is supported");
+        if (bits != 8) return Fail(error, "only 8-bit samples are supported");
+        if (planar != 1) return Fail(error, "only chunky (interleaved) TIFF is supported");
+        if (photometric > 2 || samples < 1 || samples > 4) return Fail(error, "only gray and RGB TIFF are supported");
+        if (m_stripOffsets.count == 0) return Fail(error, "missing strip offsets");
+
+        m_width = (uint32_t)width;
+        m_height = (uint32_t)height;
+        m_rowsPerStrip = (uint32_t)std::min<uint64_t>(std::max<uint64_t>(rowsPerStrip, 1), height);
+
+        // Gray and RGB images with one extra sample carry alpha (or something
+        // that blurs like it)
+        m_header.format = NetpbmFormat::Pam;
+        m_header.width = m_width;
+        m_header.height = m_height;
+        m_header.depth = (uint32_t)samples;
+        m_header.maxval = 255;
+        if (photometric == 2 && samples < 3) return Fail(error, "RGB TIFF with fewer than 3 samples");
+        if (photometric == 0 && samples > 2) return Fail(error, "WhiteIsZero TIFF with more than one color sample");
+        m_whiteIsZero = photometric == 0;
+
+        size_t strips = ((size_t)m_height + m_rowsPerStrip - 1) / m_rowsPerStrip;
+        if (m_stripOffsets.count < strips) return Fail(error, "missing strip offsets");
+        for (size_t s = 0; s < strips; s++) {
+            uint32_t rows = std::min(m_rowsPerStrip, m_height - (uint32_t)(s * m_rowsPerStrip));
+            uint64_t offset = Value(m_stripOffsets, s);
+            if (offset > m_file.Size() || (m_file.Size() - offset) / m_header.RowBytes() < rows) {
+                return Fail(error, "strip outside the file");
+            }
+        }
+        return true;
+    }
+
+    uint32_t Width() const override { return m_width; }
+    uint32_t Height() const override { return m_height; }
+
+    bool ReadRow(uint8_t* rgba) override {
+        if (m_row >= m_height) return false;
+        size_t strip = m_row / m_rowsPerStrip;
+        size_t offset = (size_t)Value(m_stripOffsets, strip) + (m_row % m_rowsPerStrip) * m_header.RowBytes();
+        NetpbmRowToRgba(m_header, m_file.Data() + offset, rgba);
+        if (m_whiteIsZero) {
+            for (uint32_t x = 0; x < m_width; x++) {
+                for (int c = 0; c < 3; c++) rgba[x * 4 + c] = (uint8_t)(255 - rgba[x * 4 + c]);
+            }
+        }
+        m_row++;
+        // Strips are usually in file order; release a strip once it's done
+        if (m_row % m_rowsPerStrip == 0 || m_row == m_height) {
+            m_file.Release((size_t)Value(m_stripOffsets, strip), (m_row - strip * m_rowsPerStrip) * m_header.RowBytes());
+        }
+        return true;
+    }
+
+private:
+    struct Field {
+        uint16_t type = 0;
+        uint64_t count = 0;
+        size_t offset = 0; // where the values are, inline or not
+    };
+
+    uint64_t Read(size_t offset, int bytes) const {
+        const uint8_t* p = m_file.Data() + offset;
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; i++) {
+            int shift = m_bigEndian ? (bytes - 1 - i) * 8 : i * 8;
+            v |= (uint64_t)p[i] << shift;
+        }
+        return v;
+    }
+
+    static int TypeSize(uint16_t type) {
+        switch (type) {
+        case 1: return 1;  // BYTE
+        case 3: return 2;  // SHORT
+        case 4: return 4;  // LONG
+        case 16: return 8; // LONG8 (BigTIFF)
+        default: return 0;
+        }
+    }
+
+    bool ReadField(size_t entry, Field& field) const {
+        field.type = (uint16_t)Read(entry + 2, 2);
+        field.count = Read(entry + 4, m_big ? 8 : 4);
+        size_t valueOffset = entry + (m_big ? 12 : 8);
+        int size = TypeSize(field.type);
+        if (size == 0) {
+            field.count = 0; // a tag we don't read
+            return true;
+        }
+        size_t inlineBytes = m_big ? 8 : 4;
+        // Compared by division so that a huge count can't wrap the byte size
+        // around into something that looks inline
+        if (field.count <= inlineBytes / size) {
+            field.offset = valueOffset;
+        }
+        else {
+            uint64_t offset = Read(valueOffset, (int)inlineBytes);
+            if (offset > m_file.Size() || (m_file.Size() - offset) / size < field.count) return false;
+            field.offset = (size_t)offset;
+        }
+        return true;
+    }
+
+    uint64_t Value(const Field& field, uint64_t i) const {
+        int size = TypeSize(field.type);
+        return i < field.count ? Read(field.offset + (size_t)i * size, size) : 0;
+    }
+
+    MappedFile m_file;
+    bool m_bigEndian = false;
+    bool m_big = false;
+    bool m_whiteIsZero = false; // gray stored inverted (PhotometricInterpretation 0)
+    Field m_stripOffsets; // strip sizes follow from RowsPerStrip
+    NetpbmHeader m_header; // describes one row's layout for NetpbmRowToRgba
+    uint32_t m_width = 0, m_height = 0, m_rowsPerStrip = 0;
+    size_t m_row = 0;
+};
+
+class FileRowWriter : public RowWriter {
+public:
+    bool Open(const std::string& path, uint32_t width, uint32_t height, NetpbmFormat format, std::string* error) {
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_file) return Fail(error, "can't create file");
+        m_width = width;
+        m_format = format;
+        if (format != NetpbmFormat::Unknown) {
+            std::string header = NetpbmHeaderText(format, width, height);
+            m_file.write(header.data(), (std::streamsize)header.size());
+            m_row.resize((size_t)width * NetpbmDepth(format));
+        }
+        return (bool)m_file;
+    }
+
+    bool WriteRow(const uint8_t* rgba) override {
+        if (m_format == NetpbmFormat::Unknown) {
+            m_file.write(reinterpret_cast<const char*>(rgba), (std::streamsize)m_width * 4);
+        }
+        else {
+            RgbaToNetpbmRow(m_format, rgba, m_row.data(), m_width);
+            m_file.write(reinterpret_cast<const char*>(m_row.data()), (std::streamsize)m_row.size());
+        }
+        return (bool)m_file;
+    }
+
+    bool Finish() override {
+        m_file.close();
+        return !m_file.fail();
+    }
+
+private:
+    std::ofstream m_file;
+    uint32_t m_width = 0;
+    NetpbmFormat m_format = NetpbmFormat::Unknown; // Unknown: raw RGBA8
+    std::vector<uint8_t> m_row;
+};
+
+} // namespace
+
+std::unique_ptr<RowReader> OpenRowReader(const std::string& path, uint32_t rawWidth, uint32_t rawHeight,
+    std::string* error)
+{
+    std::string ext = LowerExtension(path);
+    if (ext == ".raw") {
+        auto reader = std::make_unique<RawRowReader>();
+        if (reader->Open(path, rawWidth, rawHeight, error)) return reader;
+    }
+    else if (NetpbmFormatFromExtension(ext) != NetpbmFormat::Unknown) {
+        auto reader = std::make_unique<NetpbmRowReader>();
+        if (reader->Open(path, error)) return reader;
+    }
+    else if (ext == ".tif" || ext == ".tiff") {
+        auto reader = std::make_unique<TiffRowReader>();
+        if (reader->Open(path, error)) return reader;
+    }
+    else {
+        Fail(error, "unsupported file type");
+    }
+    return nullptr;
+}
+
+std::unique_ptr<RowWriter> CreateRowWriter(const std::string& path, uint32_t width, uint32_t height,
+    std::string* error)
+{
+    std::string ext = LowerExtension(path);
+    NetpbmFormat format = NetpbmFormatFromExtension(ext);
+    if (format == NetpbmFormat::Unknown && ext != ".raw") {
+        Fail(error, "output must be .raw, .pgm, .ppm, .pnm or .pam");
+        return nullptr;
+    }
+    auto writer = std::make_unique<FileRowWriter>();
+    if (!writer->Open(path, width, height, format, error)) return nullptr;
+    return writer;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CpuStreamBlur.h"
+
+// Read-only memory mapping of a whole file. Readers walk it row by row and
+// hand consumed ranges back with Release, so resident memory stays bounded
+// even when the file is many times larger than RAM.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+    // Hint that [offset, offset + length) won't be read again
+    void Release(size_t offset, size_t length);
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;    // HANDLE
+    void* m_mapping = nullptr; // HANDLE
+#endif
+};
+
+// Row readers over a memory-mapped file, picked by extension:
+//   .raw                         headerless RGBA8, rawWidth x rawHeight
+//   .pgm .ppm .pnm .pam          Netpbm, as CpuImageIO decodes it
+//   .tif .tiff                   uncompressed strip TIFF or BigTIFF: 8-bit
+//                                gray (either polarity), gray + alpha, RGB
+//                                or RGBA, chunky
+std::unique_ptr<RowReader> OpenRowReader(const std::string& path, uint32_t rawWidth, uint32_t rawHeight,
+    std::string* error = nullptr);
+
+// Row writer picked by extension: .raw writes bare RGBA8, .pgm/.ppm/.pnm/.pam
+// write Netpbm. Rows go straight to the file.
+std::unique_ptr<RowWriter> CreateRowWriter(const std::string& path, uint32_t width, uint32_t height,
+    std::string* error = nullptr);
@@ -0,0 +1,300 @@
+#include "CpuSocket.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+constexpr NativeSocket kNativeInvalid = INVALID_SOCKET;
+constexpr int kSendFlags = 0;
+
+void CloseNative(NativeSocket s) { closesocket(s); }
+
+// WSAStartup once per process; never cleaned up, like the process itself
+bool StartSockets() {
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+#else
+using NativeSocket = int;
+constexpr NativeSocket kNativeInvalid = -1;
+constexpr int kSendFlags = MSG_NOSIGNAL;
+
+void CloseNative(NativeSocket s) { close(s); }
+bool StartSockets() { return true; }
+#endif
+
+NativeSocket Native(intptr_t handle) { return (NativeSocket)handle; }
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+bool MakeAddress(const std::string& host, uint16_t port, sockaddr_in& address, std::string* error) {
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    std::string numeric = host == "localhost" ? "127.0.0.1" : host;
+    if (inet_pton(AF_INET, numeric.c_str(), &address.sin_addr) != 1) {
+        return Fail(error, "bad IPv4 address " + host);
+    }
+    return true;
+}
+
+bool MakeLocalAddress(const std::string& path, sockaddr_un& address, std::string* error) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return Fail(error, "bad socket path " + path);
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+enum class LocalPathState { Free, Stale, InUse };
+
+// Whether a server can take path: nothing is there, or a socket that refuses
+// connections, left by a server that exited without removing it. A live
+// server's socket, or any other file, is in use.
+LocalPathState ProbeLocalPath(const std::string& path, const sockaddr_un& address) {
+#ifdef _WIN32
+    // AF_UNIX sockets are reparse points on Windows
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES) return LocalPathState::Free;
+    if (!(attributes & FILE_ATTRIBUTE_REPARSE_POINT)) return LocalPathState::InUse;
+#else
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) return errno == ENOENT ? LocalPathState::Free : LocalPathState::InUse;
+    if (!S_ISSOCK(info.st_mode)) return LocalPathState::InUse;
+#endif
+    NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == kNativeInvalid) return LocalPathState::InUse;
+    bool refused = false;
+    if (connect(s, (const sockaddr*)&address, sizeof(address)) != 0) {
+#ifdef _WIN32
+        refused = WSAGetLastError() == WSAECONNREFUSED;
+#else
+        refused = errno == ECONNREFUSED;
+#endif
+    }
+    CloseNative(s);
+    return refused ? LocalPathState::Stale : LocalPathState::InUse;
+}
+
+} // namespace
+
+Socket::~Socket() {
+    Close();
+}
+
+Socket::Socket(Socket&& other) noexcept : m_handle(other.m_handle) {
+    other.m_handle = kInvalid;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    if (this != &other) {
+        Close();
+        m_handle = other.m_handle;
+        other.m_handle = kInvalid;
+    }
+    return *this;
+}
+
+void Socket::Close() {
+    if (Valid()) CloseNative(Native(m_handle));
+    m_handle = kInvalid;
+}
+
+void Socket::Shutdown() {
+#ifdef _WIN32
+    if (Valid()) shutdown(Native(m_handle), SD_BOTH);
+#else
+    if (Valid()) shutdown(Native(m_handle), SHUT_RDWR);
+#endif
+}
+
+Socket Socket::Listen(const std::string& host, uint16_t port, std::string* error) {
+    sockaddr_in address;
+    if (!StartSockets()) {
+        Fail(error, "can't start sockets");
+        return Socket();
+    }
+    if (!MakeAddress(host, port, address, error)) return Socket();
+    NativeSocket s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == kNativeInvalid) {
+        Fail(error, "can't create socket");
+        return Socket();
+    }
+    Socket listener((intptr_t)s);
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    if (bind(s, (const sockaddr*)&address, sizeof(address)) != 0 || listen(s, 64) != 0) {
+        Fail(error, "can't listen on " + host + ":" + std::to_string(port));
+        return Socket();
+    }
+    return listener;
+}
+
+uint16_t Socket::LocalPort() const {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (!Valid() || getsockname(Native(m_handle), (sockaddr*)&address, &length) != 0) return 0;
+    return ntohs(address.sin_port);
+}
+
+Socket Socket::Accept(double timeoutSeconds) {
+    if (!Valid()) return Socket();
+    NativeSocket s = Native(m_handle);
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(s, &readable);
+    timeval timeout;
+    timeout.tv_sec = (long)timeoutSeconds;
+    timeout.tv_usec = (long)((timeoutSeconds - (double)timeout.tv_sec) * 1e6);
+    if (select((int)s + 1, &readable, nullptr, nullptr, &timeout) <= 0) return Socket();
+    NativeSocket client = accept(s, nullptr, nullptr);
+    if (client == kNativeInvalid) return Socket();
+    // Messages are a header and a payload; don't hold the header back
+    int noDelay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    return Socket((intptr_t)client);
+}
+
+Socket Socket::Connect(const std::string& host, uint16_t port, std::string* error) {
+    sockaddr_in address;
+    if (!StartSockets()) {
+        Fail(error, "can't start sockets");
+        return Socket();
+    }
+    if (!MakeAddress(host, port, address, error)) return Socket();
+    NativeSocket s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == kNativeInvalid) {
+        Fail(error, "can't create socket");
+        return Socket();
+    }
+    Socket connection((intptr_t)s);
+    if (connect(s, (const sockaddr*)&address, sizeof(address)) != 0) {
+        Fail(error, "can't connect to " + host + ":" + std::to_string(port));
+        return Socket();
+    }
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    return connection;
+}
+
+Socket Socket::ListenLocal(const std::string& path, std::string* error) {
+    sockaddr_un address;
+    if (!StartSockets()) {
+        Fail(error, "can't start sockets");
+        return Socket();
+    }
+    if (!MakeLocalAddress(path, address, error)) return Socket();
+    NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == kNativeInvalid) {
+        Fail(error, "can't create socket");
+        return Socket();
+    }
+    Socket listener((intptr_t)s);
+    LocalPathState state = ProbeLocalPath(path, address);
+    if (state == LocalPathState::InUse) {
+        Fail(error, path + " is already in use");
+        return Socket();
+    }
+    if (state == LocalPathState::Stale) remove(path.c_str());
+    if (bind(s, (const sockaddr*)&address, sizeof(address)) != 0 || listen(s, 64) != 0) {
+        Fail(error, "can't listen on " + path);
+        return Socket();
+    }
+    return listener;
+}
+
+Socket Socket::ConnectLocal(const std::string& path, std::string* error) {
+    sockaddr_un address;
+    if (!StartSockets()) {
+        Fail(error, "can't start sockets");
+        return Socket();
+    }
+    if (!MakeLocalAddress(path, address, error)) return Socket();
+    NativeSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == kNativeInvalid) {
+        Fail(error, "can't create socket");
+        return Socket();
+    }
+    Socket connection((intptr_t)s);
+    if (connect(s, (const sockaddr*)&address, sizeof(address)) != 0) {
+        Fail(error, "can't connect to " + path);
+        return Socket();
+    }
+    return connection;
+}
+
+bool Socket::SendAll(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0 && Valid()) {
+        int chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+        int sent = (int)send(Native(m_handle), bytes, chunk, kSendFlags);
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return size == 0;
+}
+
+bool Socket::ReceiveAll(void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0 && Valid()) {
+        int chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+        int received = (int)recv(Native(m_handle), bytes, chunk, 0);
+        if (received <= 0) return false;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return size == 0;
+}
+
+void Socket::SetReceiveTimeout(double seconds) {
+    if (!Valid()) return;
+#ifdef _WIN32
+    DWORD timeout = (DWORD)(seconds * 1000.0);
+#else
+    timeval timeout;
+    timeout.tv_sec = (long)seconds;
+    timeout.tv_usec = (long)((seconds - (double)timeout.tv_sec) * 1e6);
+#endif
+    setsockopt(Native(m_handle), SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+bool ParseHostPort(const std::string& text, std::string& host, uint16_t& port) {
+    size_t colon = text.rfind(':');
+    host = colon == std::string::npos ? "127.0.0.1" : text.substr(0, colon);
+    std::string digits = colon == std::string::npos ? text : text.substr(colon + 1);
+    char* end = nullptr;
+    unsigned long value = strtoul(digits.c_str(), &end, 10);
+    if (digits.empty() || *end != '\0' || value == 0 || value > 65535 || host.empty()) return false;
+    port = (uint16_t)value;
+    return true;
+}
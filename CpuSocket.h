@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Blocking stream sockets for the headless tools' worker processes and blur
+// server, over TCP or local (AF_UNIX) addresses: Winsock on Windows, BSD
+// sockets elsewhere. Sends never raise SIGPIPE; a peer that went away shows up
+// as a failed SendAll or ReceiveAll.
+class Socket {
+public:
+    Socket() = default;
+    ~Socket();
+
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    bool Valid() const { return m_handle != kInvalid; }
+    void Close();
+    // Ends the connection both ways without closing the handle, which wakes
+    // another thread blocked receiving on it
+    void Shutdown();
+
+    // Listens on host:port; port 0 picks a free one, see LocalPort
+    static Socket Listen(const std::string& host, uint16_t port, std::string* error = nullptr);
+    uint16_t LocalPort() const;
+    // Waits up to timeoutSeconds for a connection; invalid on timeout or error
+    Socket Accept(double timeoutSeconds);
+
+    static Socket Connect(const std::string& host, uint16_t port, std::string* error = nullptr);
+
+    // Unix domain sockets at a file system path (Windows 10 1803 and later).
+    // ListenLocal replaces a stale socket file left at path, but fails when a
+    // server still listens there or path is some other file.
+    static Socket ListenLocal(const std::string& path, std::string* error = nullptr);
+    static Socket ConnectLocal(const std::string& path, std::string* error = nullptr);
+
+    // False as soon as the connection fails or closes, and when a receive
+    // waits longer than the receive timeout
+    bool SendAll(const void* data, size_t size);
+    bool ReceiveAll(void* data, size_t size);
+    // 0 waits forever
+    void SetReceiveTimeout(double seconds);
+
+private:
+    static constexpr intptr_t kInvalid = -1;
+    explicit Socket(intptr_t handle) : m_handle(handle) {}
+    intptr_t m_handle = kInvalid;
+};
+
+// "host:port", or just "port" for 127.0.0.1
+bool ParseHostPort(const std::string& text, std::string& host, uint16_t& port);
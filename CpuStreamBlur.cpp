@@ -0,0 +1,79 @@
+#include "CpuStreamBlur.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurKernels.h"
+#include "GaussianKernel.h"
+
+bool CpuStreamGaussianBlur(RowReader& reader, RowWriter& writer, float blurRadius, ThreadPool& pool,
+    CpuStreamBlurStats* stats)
+{
+    uint32_t width = reader.Width(), height = reader.Height();
+    if (width == 0 || height == 0) return false;
+
+    auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+    const float* weights = kernel->weights.data();
+    int radius = kernel->radius;
+    const CpuBlurRowKernels& kernels = GetCpuBlurRowKernels(GetCpuBlurIsa());
+    HorizontalRowKernel horizontal = SelectHorizontalRowKernel(kernels, radius);
+    VerticalRowKernel vertical = SelectVerticalRowKernel(kernels, radius);
+    size_t rowBytes = (size_t)width * 4;
+    size_t paddedBytes = ((size_t)width + 2 * radius) * 4;
+
+    // Producing output rows [y, y + batch) taps source rows y - radius ..
+    // y + batch - 1 + radius, so a ring of that many horizontally blurred rows
+    // is enough; row j lives in slot j % ringRows.
+    uint32_t batch = kCpuStreamBatchRows;
+    size_t ringRows = 2 * (size_t)radius + batch;
+    std::vector<uint8_t> ring(ringRows * rowBytes);
+    std::vector<uint8_t> input((size_t)batch * paddedBytes);
+    std::vector<uint8_t> output((size_t)batch * rowBytes);
+    if (stats) stats->bufferBytes = ring.size() + input.size() + output.size();
+
+    auto slot = [&](uint32_t row) { return ring.data() + (row % ringRows) * rowBytes; };
+
+    uint32_t loaded = 0; // source rows read and blurred horizontally so far
+    for (uint32_t y0 = 0; y0 < height; y0 += batch) {
+        uint32_t y1 = std::min(y0 + batch, height);
+
+        // Read up to the last row this batch taps. Reading is sequential;
+        // the horizontal pass over the new rows runs on the pool.
+        uint32_t needed = std::min(y1 + (uint32_t)radius, height);
+        while (loaded < needed) {
+            uint32_t first = loaded;
+            uint32_t count = std::min(needed - loaded, batch);
+            for (uint32_t i = 0; i < count; i++) {
+                uint8_t* padded = input.data() + i * paddedBytes;
+                if (!reader.ReadRow(padded + (size_t)radius * 4)) return false;
+                // Repeat the edge pixels, the clamp addressing CpuBlurHorizontalRows uses
+                for (int k = 0; k < radius; k++) {
+                    memcpy(padded + k * 4, padded + (size_t)radius * 4, 4);
+                    memcpy(padded + ((size_t)radius + width + k) * 4, padded + ((size_t)radius + width - 1) * 4, 4);
+                }
+            }
+            pool.ParallelFor(count, [&](size_t i) {
+                horizontal(input.data() + i * paddedBytes, slot(first + (uint32_t)i), width, weights, radius);
+            });
+            loaded += count;
+        }
+
+        pool.ParallelFor(y1 - y0, [&](size_t i) {
+            uint32_t y = y0 + (uint32_t)i;
+            thread_local std::vector<const uint8_t*> rows;
+            rows.resize(2 * radius + 1);
+            for (int k = -radius; k <= radius; k++) {
+                int sy = std::min(std::max((int)y + k, 0), (int)height - 1);
+                rows[k + radius] = slot((uint32_t)sy);
+            }
+            vertical(rows.data(), output.data() + i * rowBytes, rowBytes, weights, radius);
+        });
+
+        for (uint32_t y = y0; y < y1; y++) {
+            if (!writer.WriteRow(output.data() + (size_t)(y - y0) * rowBytes)) return false;
+        }
+    }
+    return writer.Finish();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ThreadPool.h"
+
+// Row-at-a-time image source and sink for blurring images that don't fit in
+// memory (or in a D3D11 texture). Rows are RGBA8, top to bottom.
+class RowReader {
+public:
+    virtual ~RowReader() = default;
+    virtual uint32_t Width() const = 0;
+    virtual uint32_t Height() const = 0;
+    // Converts the next row into rgba, Width() pixels
+    virtual bool ReadRow(uint8_t* rgba) = 0;
+};
+
+class RowWriter {
+public:
+    virtual ~RowWriter() = default;
+    virtual bool WriteRow(const uint8_t* rgba) = 0;
+    // Flushes and reports whether everything reached the file
+    virtual bool Finish() = 0;
+};
+
+// CpuGaussianBlur over a stream of rows, bit-identical to it. Each row gets
+// its horizontal pass as it is read and goes into a ring of
+// 2 * kernel radius + batch rows; output rows are produced and written as
+// soon as the ring holds all the rows they tap. Rows are handled in batches
+// of kCpuStreamBatchRows so the passes can run on the pool, which keeps peak
+// memory at O((radius + batch) * width) whatever the height.
+constexpr uint32_t kCpuStreamBatchRows = 32;
+
+struct CpuStreamBlurStats {
+    size_t bufferBytes = 0; // ring plus staging rows
+};
+
+bool CpuStreamGaussianBlur(RowReader& reader, RowWriter& writer, float blurRadius, ThreadPool& pool,
+    CpuStreamBlurStats* stats = nullptr);
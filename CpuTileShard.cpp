@@ -0,0 +1,480 @@
+#include "CpuTileShard.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "CpuSocket.h"
+#include "Trace.h"
+
+namespace {
+
+constexpr uint32_t kShardMagic = 0x44524853; // "SHRD"
+// Largest tile side a worker accepts, a sanity check on the header
+constexpr uint32_t kMaxShardTileSide = 1u << 16;
+
+bool Fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+// Precedes every tile in both directions. To the worker, width x height pixels
+// follow and core is the part to send back; the answer carries the core's
+// pixels with width and height set to its size.
+struct ShardHeader {
+    uint32_t magic = kShardMagic;
+    uint32_t engine = 0;
+    uint64_t tileId = 0;
+    float blurRadius = 0.0f;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t coreX = 0;
+    uint32_t coreY = 0;
+    uint32_t coreWidth = 0;
+    uint32_t coreHeight = 0;
+};
+
+// A tile of the current band: core [x0, x0 + width) x [y0, y0 + height) of the
+// image, cut with its halo from the coordinator's window of input rows
+struct ShardTile {
+    uint64_t id = 0;
+    uint32_t x0 = 0, y0 = 0, width = 0, height = 0;
+    uint32_t haloX0 = 0, haloY0 = 0, haloWidth = 0, haloHeight = 0;
+    int attempts = 0;
+};
+
+#ifdef _WIN32
+struct WorkerProcess {
+    HANDLE handle = nullptr;
+};
+
+std::string CurrentExecutablePath() {
+    char path[MAX_PATH];
+    DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    return length > 0 && length < MAX_PATH ? std::string(path, length) : std::string();
+}
+
+bool SpawnProcess(const std::vector<std::string>& args, WorkerProcess& process) {
+    std::string commandLine;
+    for (const std::string& arg : args) {
+        if (!commandLine.empty()) commandLine += ' ';
+        commandLine += '"' + arg + '"';
+    }
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION info = {};
+    if (!CreateProcessA(args[0].c_str(), &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup,
+        &info))
+    {
+        return false;
+    }
+    CloseHandle(info.hThread);
+    process.handle = info.hProcess;
+    return true;
+}
+
+void WaitProcess(WorkerProcess& process, bool kill) {
+    if (!process.handle) return;
+    if (WaitForSingleObject(process.handle, kill ? 0 : 10000) != WAIT_OBJECT_0) {
+        TerminateProcess(process.handle, 1);
+        WaitForSingleObject(process.handle, INFINITE);
+    }
+    CloseHandle(process.handle);
+    process.handle = nullptr;
+}
+#else
+struct WorkerProcess {
+    pid_t pid = -1;
+};
+
+std::string CurrentExecutablePath() {
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    return length > 0 ? std::string(path, (size_t)length) : std::string();
+}
+
+bool SpawnProcess(const std::vector<std::string>& args, WorkerProcess& process) {
+    std::vector<char*> argv;
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    process.pid = pid;
+    return true;
+}
+
+// Workers exit when the coordinator disconnects; give them a moment, then kill
+void WaitProcess(WorkerProcess& process, bool kill) {
+    if (process.pid < 0) return;
+    for (int i = 0; i < 1000 && !kill; i++) {
+        if (waitpid(process.pid, nullptr, WNOHANG) == process.pid) {
+            process.pid = -1;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ::kill(process.pid, SIGKILL);
+    waitpid(process.pid, nullptr, 0);
+    process.pid = -1;
+}
+#endif
+
+} // namespace
+
+struct ShardCoordinator::State {
+    ShardOptions options;
+    Socket listener;
+    std::thread acceptThread;
+    std::vector<WorkerProcess> processes;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::thread> connections;
+    unsigned connected = 0;
+    bool stopping = false;
+
+    // The band in flight; tiles read the window and write the band without the
+    // lock, since neither moves until every tile of the band is back
+    std::deque<ShardTile*> pending;
+    size_t tilesLeft = 0;
+    size_t inFlight = 0; // tiles some connection is sending or waiting on
+    bool failed = false;
+    std::string failure;
+    CpuBlurEngine engine = CpuBlurEngine::Direct;
+    float blurRadius = 0.0f;
+    uint32_t imageWidth = 0;
+    const uint8_t* window = nullptr; // input rows from windowY0 on, imageWidth wide
+    uint32_t windowY0 = 0;
+    CpuImage* band = nullptr;        // output rows from bandY0 on
+    uint32_t bandY0 = 0;
+    ShardStats stats;
+
+    void AcceptLoop();
+    void ServeWorker(Socket socket);
+    bool RunTile(Socket& socket, const ShardTile& tile, std::vector<uint8_t>& buffer);
+};
+
+void ShardCoordinator::State::AcceptLoop() {
+    TraceSetThreadName("shard accept");
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+        }
+        Socket socket = listener.Accept(0.2);
+        if (!socket.Valid()) continue;
+        socket.SetReceiveTimeout(options.tileTimeout);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        connected++;
+        connections.emplace_back(&State::ServeWorker, this, std::move(socket));
+        changed.notify_all();
+    }
+}
+
+// Sends the tile, waits for its core and copies it into the band
+bool ShardCoordinator::State::RunTile(Socket& socket, const ShardTile& tile, std::vector<uint8_t>& buffer) {
+    ShardHeader header;
+    header.engine = (uint32_t)engine;
+    header.tileId = tile.id;
+    header.blurRadius = blurRadius;
+    header.width = tile.haloWidth;
+    header.height = tile.haloHeight;
+    header.coreX = tile.x0 - tile.haloX0;
+    header.coreY = tile.y0 - tile.haloY0;
+    header.coreWidth = tile.width;
+    header.coreHeight = tile.height;
+
+    size_t rowBytes = (size_t)tile.haloWidth * 4;
+    buffer.resize(rowBytes * tile.haloHeight);
+    for (uint32_t y = 0; y < tile.haloHeight; y++) {
+        const uint8_t* row = window + ((size_t)(tile.haloY0 + y - windowY0) * imageWidth + tile.haloX0) * 4;
+        memcpy(buffer.data() + y * rowBytes, row, rowBytes);
+    }
+    {
+        TRACE_SCOPE("send tile");
+        if (!socket.SendAll(&header, sizeof(header)) || !socket.SendAll(buffer.data(), buffer.size())) return false;
+    }
+
+    ShardHeader answer;
+    TRACE_SCOPE("wait for tile");
+    if (!socket.ReceiveAll(&answer, sizeof(answer))) return false;
+    if (answer.magic != kShardMagic || answer.tileId != tile.id || answer.width != tile.width ||
+        answer.height != tile.height)
+    {
+        return false;
+    }
+    size_t coreRowBytes = (size_t)tile.width * 4;
+    buffer.resize(coreRowBytes * tile.height);
+    if (!socket.ReceiveAll(buffer.data(), buffer.size())) return false;
+    for (uint32_t y = 0; y < tile.height; y++) {
+        memcpy(band->Row(tile.y0 - bandY0 + y) + (size_t)tile.x0 * 4, buffer.data() + y * coreRowBytes, coreRowBytes);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.bytesSent += rowBytes * tile.haloHeight;
+    stats.bytesReceived += buffer.size();
+    return true;
+}
+
+void ShardCoordinator::State::ServeWorker(Socket socket) {
+    TraceSetThreadName("shard connection");
+    std::vector<uint8_t> buffer;
+    for (;;) {
+        ShardTile* tile;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return stopping || !pending.empty(); });
+            if (stopping) break;
+            tile = pending.front();
+            pending.pop_front();
+            inFlight++;
+        }
+        bool ok = RunTile(socket, *tile, buffer);
+        if (ok) {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight--;
+            tilesLeft--;
+            changed.notify_all();
+            continue;
+        }
+
+        // The worker died, hung or sent garbage: drop it and deal the tile again,
+        // unless the band has already failed and Blur is about to free its tiles
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight--;
+        stats.workersLost++;
+        if (!failed) {
+            if (++tile->attempts >= options.maxAttempts) {
+                failed = true;
+                failure = "tile at " + std::to_string(tile->x0) + "," + std::to_string(tile->y0) + " failed " +
+                    std::to_string(tile->attempts) + " times";
+            }
+            else {
+                stats.reissued++;
+                pending.push_front(tile);
+            }
+        }
+        connected--;
+        changed.notify_all();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    connected--;
+}
+
+ShardCoordinator::ShardCoordinator() : m_state(std::make_unique<State>()) {}
+
+ShardCoordinator::~ShardCoordinator() {
+    State& state = *m_state;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stopping = true;
+    }
+    state.changed.notify_all();
+    if (state.acceptThread.joinable()) state.acceptThread.join();
+    // Connections close as their threads end, which tells the workers to quit
+    for (std::thread& connection : state.connections) connection.join();
+    for (WorkerProcess& process : state.processes) WaitProcess(process, false);
+}
+
+bool ShardCoordinator::Start(const ShardOptions& options, std::string* error) {
+    State& state = *m_state;
+    state.options = options;
+    state.options.tileSize = std::max(options.tileSize, 16u);
+    state.listener = Socket::Listen(options.host, options.port, error);
+    if (!state.listener.Valid()) return false;
+
+    std::string self = CurrentExecutablePath();
+    if (options.localWorkers > 0 && self.empty()) return Fail(error, "can't find this executable to start workers");
+    std::string address = options.host + ":" + std::to_string(state.listener.LocalPort());
+    for (unsigned i = 0; i < options.localWorkers; i++) {
+        std::vector<std::string> args = { self };
+        args.insert(args.end(), options.workerArguments.begin(), options.workerArguments.end());
+        if (i == 0 && options.firstWorkerFailAfter >= 0) {
+            args.push_back("--fail-after");
+            args.push_back(std::to_string(options.firstWorkerFailAfter));
+        }
+        args.push_back("--worker");
+        args.push_back(address);
+        WorkerProcess process;
+        if (!SpawnProcess(args, process)) return Fail(error, "can't start worker process " + self);
+        state.processes.push_back(process);
+    }
+    state.acceptThread = std::thread(&State::AcceptLoop, &state);
+    return true;
+}
+
+uint16_t ShardCoordinator::Port() const {
+    return m_state->listener.LocalPort();
+}
+
+bool ShardCoordinator::Blur(RowReader& reader, RowWriter& writer, float blurRadius, CpuBlurEngine engine,
+    ShardStats* stats, std::string* error)
+{
+    State& state = *m_state;
+    int reach = CpuBlurEngineReach(engine, blurRadius);
+    if (reach < 0) return Fail(error, std::string("the ") + CpuBlurEngineName(engine) + " engine can't be tiled");
+    uint32_t width = reader.Width(), height = reader.Height();
+    uint32_t tileSize = state.options.tileSize;
+    size_t rowBytes = (size_t)width * 4;
+
+    // Input rows [windowY0, windowY1) and the output band
+    std::vector<uint8_t> window;
+    uint32_t windowY0 = 0, windowY1 = 0;
+    CpuImage band;
+    std::vector<ShardTile> tiles;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stats = ShardStats();
+        state.failed = false;
+        state.engine = engine;
+        state.blurRadius = blurRadius;
+        state.imageWidth = width;
+    }
+
+    uint64_t nextId = 0;
+    for (uint32_t y0 = 0; y0 < height; y0 += tileSize) {
+        uint32_t bandHeight = std::min(tileSize, height - y0);
+        uint32_t needY0 = (uint32_t)std::max((int64_t)y0 - reach, (int64_t)0);
+        uint32_t needY1 = (uint32_t)std::min((int64_t)y0 + bandHeight + reach, (int64_t)height);
+
+        // Slide the window down: drop rows above the halo, read up to its bottom
+        {
+            TRACE_SCOPE("read band");
+            size_t drop = std::min(needY0, windowY1) - windowY0;
+            window.erase(window.begin(), window.begin() + drop * rowBytes);
+            windowY0 = needY0;
+            window.resize((size_t)(needY1 - windowY0) * rowBytes);
+            for (; windowY1 < needY1; windowY1++) {
+                if (!reader.ReadRow(window.data() + (size_t)(windowY1 - windowY0) * rowBytes)) {
+                    return Fail(error, "reading row " + std::to_string(windowY1) + " failed");
+                }
+            }
+        }
+        if (band.height != bandHeight) band = CpuImage(width, bandHeight);
+
+        tiles.clear();
+        for (uint32_t x0 = 0; x0 < width; x0 += tileSize) {
+            ShardTile tile;
+            tile.id = nextId++;
+            tile.x0 = x0;
+            tile.y0 = y0;
+            tile.width = std::min(tileSize, width - x0);
+            tile.height = bandHeight;
+            tile.haloX0 = (uint32_t)std::max((int64_t)x0 - reach, (int64_t)0);
+            tile.haloWidth = (uint32_t)std::min((int64_t)x0 + tile.width + reach, (int64_t)width) - tile.haloX0;
+            tile.haloY0 = needY0;
+            tile.haloHeight = needY1 - needY0;
+            tiles.push_back(tile);
+        }
+
+        TRACE_SCOPE("blur band");
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.window = window.data();
+        state.windowY0 = windowY0;
+        state.band = &band;
+        state.bandY0 = y0;
+        state.tilesLeft = tiles.size();
+        for (ShardTile& tile : tiles) state.pending.push_back(&tile);
+        state.stats.tiles += tiles.size();
+        state.changed.notify_all();
+
+        auto idleSince = std::chrono::steady_clock::now();
+        while (state.tilesLeft > 0 && !state.failed) {
+            state.changed.wait_for(lock, std::chrono::milliseconds(200));
+            if (state.connected > 0) {
+                idleSince = std::chrono::steady_clock::now();
+                continue;
+            }
+            double idle = std::chrono::duration<double>(std::chrono::steady_clock::now() - idleSince).count();
+            if (idle > state.options.tileTimeout) {
+                state.failed = true;
+                state.failure = "no workers connected";
+            }
+        }
+        if (state.failed) {
+            // Nobody may touch the window, band or tiles once this returns
+            state.pending.clear();
+            state.changed.wait(lock, [&] { return state.inFlight == 0; });
+            state.pending.clear();
+            if (stats) *stats = state.stats;
+            return Fail(error, state.failure);
+        }
+        lock.unlock();
+
+        TRACE_SCOPE("write band");
+        for (uint32_t y = 0; y < bandHeight; y++) {
+            if (!writer.WriteRow(band.Row(y))) return Fail(error, "writing row " + std::to_string(y0 + y) + " failed");
+        }
+    }
+
+    if (stats) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        *stats = state.stats;
+    }
+    return writer.Finish() || Fail(error, "finishing the output failed");
+}
+
+int RunShardWorker(const std::string& host, uint16_t port, ThreadPool& pool, int failAfter) {
+    TraceSetThreadName("shard worker");
+    std::string error;
+    Socket socket = Socket::Connect(host, port, &error);
+    if (!socket.Valid()) {
+        fprintf(stderr, "worker: %s\n", error.c_str());
+        return 1;
+    }
+
+    CpuImage tile, blurred;
+    std::vector<uint8_t> core;
+    for (int done = 0;; done++) {
+        ShardHeader header;
+        if (!socket.ReceiveAll(&header, sizeof(header))) return 0; // coordinator is done
+        if (header.magic != kShardMagic || header.engine >= (uint32_t)CpuBlurEngine::Count ||
+            header.width == 0 || header.height == 0 || header.width > kMaxShardTileSide ||
+            header.height > kMaxShardTileSide || header.coreX > header.width ||
+            header.coreWidth > header.width - header.coreX || header.coreY > header.height ||
+            header.coreHeight > header.height - header.coreY)
+        {
+            fprintf(stderr, "worker: bad tile header\n");
+            return 1;
+        }
+        if (tile.width != header.width || tile.height != header.height) tile = CpuImage(header.width, header.height);
+        if (!socket.ReceiveAll(tile.pixels.data(), tile.pixels.size())) return 1;
+        if (failAfter >= 0 && done == failAfter) return 3; // simulated crash, tile never answered
+
+        {
+            TRACE_SCOPE("blur tile");
+            CpuBlurImage(tile, blurred, header.blurRadius, (CpuBlurEngine)header.engine, pool);
+        }
+        size_t coreRowBytes = (size_t)header.coreWidth * 4;
+        core.resize(coreRowBytes * header.coreHeight);
+        for (uint32_t y = 0; y < header.coreHeight; y++) {
+            memcpy(core.data() + y * coreRowBytes, blurred.Row(header.coreY + y) + (size_t)header.coreX * 4,
+                coreRowBytes);
+        }
+        ShardHeader answer = header;
+        answer.width = header.coreWidth;
+        answer.height = header.coreHeight;
+        if (!socket.SendAll(&answer, sizeof(answer)) || !socket.SendAll(core.data(), core.size())) return 1;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuStreamBlur.h"
+#include "ThreadPool.h"
+
+// One image blurred by several worker processes, for images too large for a
+// single one. The coordinator reads the image top to bottom one band of tiles
+// at a time and deals the band's tiles out to the workers over TCP, each
+// extended by the engine's reach (CpuBlurEngineReach) on every side or up to
+// the image edge. A worker blurs its tile as a whole image and sends back the
+// core, which is therefore exactly what blurring the whole image in one
+// process gives there; the coordinator writes each band out once all of its
+// tiles are back. A worker that disconnects, or takes longer than the tile
+// timeout, loses its tile to the next free worker.
+//
+// The coordinator holds one band of input with its halo rows and one band of
+// output, (2 x tileSize + 2 x reach) x width x 4 bytes, however tall the image.
+// Workers hold a tile and its result. The wire format is the host's byte
+// order, so all processes must run on machines of the same endianness.
+
+struct ShardOptions {
+    uint32_t tileSize = 1024;  // core tile width and height
+    unsigned localWorkers = 2; // worker processes Start spawns
+    // Extra arguments for the spawned workers, which run this executable with
+    // --worker HOST:PORT appended
+    std::vector<std::string> workerArguments;
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;          // 0 picks a free port
+    double tileTimeout = 120.0; // seconds a worker gets per tile
+    int maxAttempts = 3;        // per tile, before the blur gives up
+    int firstWorkerFailAfter = -1; // testing: the first local worker gets --fail-after N
+};
+
+struct ShardStats {
+    size_t tiles = 0;
+    size_t reissued = 0;     // tiles dealt again after their worker failed
+    unsigned workersLost = 0;
+    uint64_t bytesSent = 0;  // tile pixels to workers
+    uint64_t bytesReceived = 0;
+};
+
+class ShardCoordinator {
+public:
+    ShardCoordinator();
+    // Disconnects the workers and waits for the spawned ones to exit
+    ~ShardCoordinator();
+
+    // Listens and spawns the local workers. Workers started by hand may
+    // connect to Port() at any time and get tiles from then on.
+    bool Start(const ShardOptions& options, std::string* error = nullptr);
+    uint16_t Port() const;
+
+    // Blurs reader's image into writer. Fails for engines without a bounded
+    // reach, when a tile fails maxAttempts times, or when no worker is
+    // connected for longer than the tile timeout.
+    bool Blur(RowReader& reader, RowWriter& writer, float blurRadius, CpuBlurEngine engine,
+        ShardStats* stats = nullptr, std::string* error = nullptr);
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+// Worker side: connects to the coordinator and blurs tiles on pool until the
+// coordinator disconnects. With failAfter >= 0 it quits without answering
+// once it has returned that many tiles, to exercise reissuing. Returns the
+// process exit code.
+int RunShardWorker(const std::string& host, uint16_t port, ThreadPool& pool, int failAfter = -1);
@@ -0,0 +1,209 @@
+#include "CpuVariableBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CpuBlurKernels.h"
+#include "GaussianKernel.h"
+#include "Trace.h"
+
+namespace {
+
+// Passes between the first and last keep 4 fractional bits, values 0..4080
+constexpr int kFractionBits = 4;
+constexpr uint32_t kBandRows = 16;
+constexpr uint32_t kStripColumns = 64;
+
+// Square of half-width radius, plus the ring of pixels just outside it
+// weighted by ring. scale is one over the total weight.
+struct VariableBox {
+    int radius = 0;
+    float ring = 0.0f;
+    float scale = 1.0f;
+};
+
+// Pixels of the (2s + 1)^2 square, and the sum of x^2 over them
+double SquareCount(int s) { return (2.0 * s + 1) * (2.0 * s + 1); }
+double SquareMoment(int s) { return (2.0 * s + 1) * s * (s + 1.0) * (2.0 * s + 1) / 3.0; }
+
+// The box whose variance along each axis is `variance`. A square of half-width
+// s has s(s + 1)/3; the ring interpolates between consecutive squares.
+VariableBox BoxForVariance(double variance) {
+    VariableBox box;
+    const int maxRadius = kCpuVariableBlurMaxBoxRadius;
+    while (box.radius < maxRadius && (box.radius + 1) * (box.radius + 2) / 3.0 <= variance) box.radius++;
+    int r = box.radius;
+    double count = SquareCount(r);
+    double ringCount = SquareCount(r + 1) - count;
+    if (r < maxRadius) {
+        double ringMoment = SquareMoment(r + 1) - SquareMoment(r);
+        double ring = (variance * count - SquareMoment(r)) / (ringMoment - variance * ringCount);
+        box.ring = (float)std::min(std::max(ring, 0.0), 1.0);
+    }
+    box.scale = (float)(1.0 / (count + box.ring * ringCount));
+    return box;
+}
+
+// Inclusive prefix sums of the source, padded by `pad` clamped pixels on every
+// side. Entry (x, y) sums the padded pixels left of x and above y, so row and
+// column 0 are zero. Four interleaved channels of wrapping 32-bit sums.
+struct SummedAreaTable {
+    uint32_t width = 0; // padded width + 1
+    uint32_t height = 0;
+    uint32_t pad = 0;
+    std::vector<uint32_t> sums;
+
+    uint32_t* Row(uint32_t y) { return sums.data() + (size_t)y * width * 4; }
+    const uint32_t* Row(uint32_t y) const { return sums.data() + (size_t)y * width * 4; }
+};
+
+// One padded row's running sums, src values shifted up by shift
+template <typename Pixel>
+void RowPrefixSums(const Pixel* src, uint32_t width, uint32_t pad, int shift, uint32_t* out) {
+    uint32_t sum[4] = {};
+    for (int c = 0; c < 4; c++) out[c] = 0;
+    out += 4;
+    auto add = [&](const Pixel* pixel) {
+        for (int c = 0; c < 4; c++) {
+            sum[c] += (uint32_t)pixel[c] << shift;
+            out[c] = sum[c];
+        }
+        out += 4;
+    };
+    for (uint32_t x = 0; x < pad; x++) add(src);
+    for (uint32_t x = 0; x < width; x++) add(src + (size_t)x * 4);
+    for (uint32_t x = 0; x < pad; x++) add(src + (size_t)(width - 1) * 4);
+}
+
+// Builds the table in two parallel sweeps: every row's prefix sums by bands
+// of rows, then the running sum down each strip of columns, which adds whole
+// contiguous row segments at a time.
+template <typename Pixel>
+void BuildSummedAreaTable(const Pixel* src, uint32_t width, uint32_t height, int shift, SummedAreaTable& table,
+    ThreadPool& pool)
+{
+    TRACE_SCOPE("summed-area table");
+    uint32_t paddedHeight = height + 2 * table.pad;
+    std::fill(table.sums.begin(), table.sums.begin() + (size_t)table.width * 4, 0u);
+    pool.ParallelFor((paddedHeight + kBandRows - 1) / kBandRows, [&](size_t band) {
+        uint32_t y0 = (uint32_t)band * kBandRows;
+        uint32_t y1 = std::min(y0 + kBandRows, paddedHeight);
+        for (uint32_t y = y0; y < y1; y++) {
+            int64_t sy = std::min(std::max((int64_t)y - table.pad, (int64_t)0), (int64_t)height - 1);
+            RowPrefixSums(src + (size_t)sy * width * 4, width, table.pad, shift, table.Row(y + 1));
+        }
+    });
+    pool.ParallelFor((table.width + kStripColumns - 1) / kStripColumns, [&](size_t strip) {
+        size_t x0 = strip * kStripColumns * 4;
+        size_t x1 = std::min<size_t>(x0 + kStripColumns * 4, (size_t)table.width * 4);
+        for (uint32_t y = 2; y < table.height; y++) {
+            const uint32_t* above = table.Row(y - 1);
+            uint32_t* row = table.Row(y);
+            for (size_t i = x0; i < x1; i++) row[i] += above[i];
+        }
+    });
+}
+
+// One box pass: every pixel's box from the table, written through store(x, y,
+// channel, value) with value on the fixed-point scale
+template <typename Store>
+void BoxPassFromTable(const SummedAreaTable& table, uint32_t width, uint32_t height,
+    const std::vector<uint8_t>& mapIndex, const VariableBox* boxes, ThreadPool& pool, const Store& store)
+{
+    TRACE_SCOPE("variable box pass");
+    pool.ParallelFor((height + kBandRows - 1) / kBandRows, [&](size_t band) {
+        uint32_t y0 = (uint32_t)band * kBandRows;
+        uint32_t y1 = std::min(y0 + kBandRows, height);
+        for (uint32_t y = y0; y < y1; y++) {
+            const uint8_t* indices = mapIndex.data() + (size_t)y * width;
+            uint32_t cy = y + table.pad;
+            for (uint32_t x = 0; x < width; x++) {
+                const VariableBox& box = boxes[indices[x]];
+                uint32_t cx = x + table.pad;
+                // Sum of the square of half-width s around (cx, cy), modulo 2^32
+                auto squareSums = [&](int s, uint32_t sums[4]) {
+                    const uint32_t* top = table.Row(cy - s);
+                    const uint32_t* bottom = table.Row(cy + s + 1);
+                    size_t left = (size_t)(cx - s) * 4, right = (size_t)(cx + s + 1) * 4;
+                    for (int c = 0; c < 4; c++) {
+                        sums[c] = bottom[right + c] - top[right + c] - bottom[left + c] + top[left + c];
+                    }
+                };
+                uint32_t inner[4], outer[4];
+                squareSums(box.radius, inner);
+                if (box.ring > 0.0f) {
+                    squareSums(box.radius + 1, outer);
+                    for (int c = 0; c < 4; c++) {
+                        float sum = (float)inner[c] + box.ring * (float)(outer[c] - inner[c]);
+                        store(x, y, c, sum * box.scale);
+                    }
+                }
+                else {
+                    for (int c = 0; c < 4; c++) store(x, y, c, (float)inner[c] * box.scale);
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
+void CpuVariableBlur(const CpuImage& src, CpuImage& dst, const CpuImage& radiusMap, float blurRadius,
+    ThreadPool& pool, int passes)
+{
+    if (src.Empty()) return;
+    uint32_t width = src.width, height = src.height;
+    if (dst.width != width || dst.height != height) dst = CpuImage(width, height);
+    passes = std::max(passes, 1);
+
+    // Map value of every pixel, nearest neighbour when the map's size differs.
+    // Without a map the whole image gets blurRadius.
+    bool hasMap = !radiusMap.Empty();
+    std::vector<uint8_t> mapIndex((size_t)width * height, hasMap ? 0 : 255);
+    uint8_t maxIndex = hasMap ? 0 : 255;
+    for (uint32_t y = 0; y < height && hasMap; y++) {
+        uint32_t my = (uint32_t)((uint64_t)y * radiusMap.height / height);
+        const uint8_t* mapRow = radiusMap.Row(my);
+        uint8_t* out = mapIndex.data() + (size_t)y * width;
+        for (uint32_t x = 0; x < width; x++) {
+            out[x] = mapRow[(size_t)((uint64_t)x * radiusMap.width / width) * 4];
+            maxIndex = std::max(maxIndex, out[x]);
+        }
+    }
+
+    // Each pass contributes an equal share of every map value's variance
+    VariableBox boxes[256];
+    for (int v = 0; v < 256; v++) {
+        double sigma = SigmaFromBlurRadius(blurRadius * v / 255.0f);
+        boxes[v] = BoxForVariance(sigma * sigma / passes);
+    }
+    if (boxes[maxIndex].radius == 0 && boxes[maxIndex].ring == 0.0f) {
+        if (&dst != &src) dst.pixels = src.pixels;
+        return;
+    }
+
+    // The outer ring of the largest box reaches radius + 1 past the edge
+    SummedAreaTable table;
+    table.pad = (uint32_t)boxes[maxIndex].radius + 1;
+    table.width = width + 2 * table.pad + 1;
+    table.height = height + 2 * table.pad + 1;
+    table.sums.resize((size_t)table.width * table.height * 4);
+
+    std::vector<uint16_t> plane;
+    if (passes > 1) plane.resize((size_t)width * height * 4);
+    auto storePlane = [&](uint32_t x, uint32_t y, int c, float value) {
+        plane[((size_t)y * width + x) * 4 + c] = (uint16_t)(value + 0.5f);
+    };
+    const float toUnorm8 = 1.0f / (1 << kFractionBits);
+    auto storeImage = [&](uint32_t x, uint32_t y, int c, float value) {
+        dst.Row(y)[(size_t)x * 4 + c] = QuantizeUnorm8(value * toUnorm8);
+    };
+
+    BuildSummedAreaTable(src.pixels.data(), width, height, kFractionBits, table, pool);
+    for (int pass = 0; pass < passes; pass++) {
+        if (pass > 0) BuildSummedAreaTable(plane.data(), width, height, 0, table, pool);
+        if (pass + 1 < passes) BoxPassFromTable(table, width, height, mapIndex, boxes, pool, storePlane);
+        else BoxPassFromTable(table, width, height, mapIndex, boxes, pool, storeImage);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CpuImage.h"
+#include "ThreadPool.h"
+
+// Spatially varying blur for depth of field, tilt-shift and masked blurs.
+// radiusMap's first channel (red, or the gray of a PGM) scales blurRadius per
+// pixel: 255 blurs with blurRadius, 0 leaves the pixel sharp, and the sigma
+// follows the values in between linearly. A map of another size than src is
+// sampled nearest neighbour; an empty one blurs everything with blurRadius.
+//
+// Each of `passes` passes replaces every pixel with the mean of a square box
+// around it, read from a summed-area table of the previous pass, so a pixel
+// costs the same at any radius. The box for each map value is sized so the
+// passes' variances add up to that pixel's sigma^2, with a fractionally
+// weighted outer ring so the blur changes smoothly with the map. Three passes
+// fall off like a Gaussian; one is a plain box. Clamp addressing at the edges,
+// each pass clamping its own input: within the boxes' reach of an edge that
+// differs from CpuBoxCascadeBlur, which clamps the source.
+//
+// The tables hold 32-bit sums that are allowed to wrap: a box's sum comes out
+// of the four corners modulo 2^32, which is exact while the box itself sums to
+// less than 2^32, true for boxes up to kCpuVariableBlurMaxBoxRadius on 8-bit
+// values with 4 fractional bits, at any image size. Sigmas beyond that are
+// capped. Needs 16 bytes per pixel for the table (plus the border the largest
+// box reaches past the edge) and 8 for the intermediate passes.
+constexpr int kCpuVariableBlurMaxBoxRadius = 500;
+
+void CpuVariableBlur(const CpuImage& src, CpuImage& dst, const CpuImage& radiusMap, float blurRadius,
+    ThreadPool& pool, int passes = 3);
@@ -1,16 +1,64 @@
 Texture2D inputTexture : register(t0);
 SamplerState inputSampler : register(s0);
 
+// Set by LoadBlurShader from GaussianKernel.h (kMaxKernelVectors, kMaxLinearTapVectors)
+#ifndef BLUR_MAX_KERNEL_VECTORS
+#define BLUR_MAX_KERNEL_VECTORS 64
+#endif
+#ifndef BLUR_MAX_LINEAR_TAP_VECTORS
+#define BLUR_MAX_LINEAR_TAP_VECTORS 64
+#endif
+
+// LoadBlurShader also compiles the per-texel passes once per small kernel
+// radius (up to kMaxFixedKernelRadius), so their taps unroll with constant
+// offsets. Radius 0 is then a single fetch.
+#ifdef BLUR_FIXED_KERNEL_RADIUS
+#define BLUR_TAP_RADIUS BLUR_FIXED_KERNEL_RADIUS
+#define BLUR_TAP_LOOP [unroll]
+#else
+#define BLUR_TAP_RADIUS kernelRadius
+#define BLUR_TAP_LOOP
+#endif
+
 cbuffer BlurSettings : register(b0)
 {
     float2 texelSize;  // (1 / width, 1 / height)
     float blurRadius;
+    int kernelRadius;  // taps run from -kernelRadius to +kernelRadius
+    // Normalized weights from GetGaussianKernel, weight i lives in [i / 4][i % 4]
+    float4 kernelWeights[BLUR_MAX_KERNEL_VECTORS];
+    int linearTapCount;  // merged taps on each side of the center
+    // (offset, weight) pairs of the merged taps, two per float4
+    float4 linearTaps[BLUR_MAX_LINEAR_TAP_VECTORS];
 };
 
-// Standard 1D Gaussian function
-float Gaussian(float x, float sigma)
+float KernelWeight(int i)
+{
+    uint a = uint(abs(i));
+    return kernelWeights[a >> 2][a & 3];
+}
+
+float2 LinearTap(int i)
 {
-    return exp(-0.5 * (x / sigma) * (x / sigma)) / (sqrt(2.0 * 3.14159) * sigma);
+    float4 v = linearTaps[i >> 1];
+    return (i & 1) ? v.zw : v.xy;
+}
+
+// Center tap plus one bilinear fetch per merged pair on each side. The sampler's
+// linear filter does the blend that used to take two fetches.
+float4 LinearSampledBlur(float2 uv, float2 direction)
+{
+    float4 color = inputTexture.Sample(inputSampler, uv) * KernelWeight(0);
+
+    for (int i = 0; i < linearTapCount; i++)
+    {
+        float2 tap = LinearTap(i);
+        float2 offset = direction * tap.x;
+        color += inputTexture.Sample(inputSampler, uv + offset) * tap.y;
+        color += inputTexture.Sample(inputSampler, uv - offset) * tap.y;
+    }
+
+    return color;
 }
 
 // --------------------------------------
@@ -19,18 +67,15 @@ float Gaussian(float x, float sigma)
 float4 PSHorizontalBlur(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
 {
     float4 color = float4(0, 0, 0, 0);
-    float totalWeight = 0.0;
-    float sigma = blurRadius * 0.5;
 
-    for (int x = -int(blurRadius); x <= int(blurRadius); x++)
+    BLUR_TAP_LOOP
+    for (int x = -BLUR_TAP_RADIUS; x <= BLUR_TAP_RADIUS; x++)
     {
         float2 offset = float2(x * texelSize.x, 0.0);
-        float weight = Gaussian(abs(float(x)), sigma);
-        color += inputTexture.Sample(inputSampler, uv + offset) * weight;
-        totalWeight += weight;
+        color += inputTexture.Sample(inputSampler, uv + offset) * KernelWeight(x);
     }
 
-    return color / totalWeight;
+    return color;
 }
 
 // --------------------------------------
@@ -39,16 +84,26 @@ float4 PSHorizontalBlur(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TAR
 float4 PSVerticalBlur(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
 {
     float4 color = float4(0, 0, 0, 0);
-    float totalWeight = 0.0;
-    float sigma = blurRadius * 0.5;
 
-    for (int y = -int(blurRadius); y <= int(blurRadius); y++)
+    BLUR_TAP_LOOP
+    for (int y = -BLUR_TAP_RADIUS; y <= BLUR_TAP_RADIUS; y++)
     {
         float2 offset = float2(0.0, y * texelSize.y);
-        float weight = Gaussian(abs(float(y)), sigma);
-        color += inputTexture.Sample(inputSampler, uv + offset) * weight;
-        totalWeight += weight;
+        color += inputTexture.Sample(inputSampler, uv + offset) * KernelWeight(y);
     }
 
-    return color / totalWeight;
+    return color;
+}
+
+// --------------------------------------
+// Bilinear tap-merged variants of the two passes
+// --------------------------------------
+float4 PSHorizontalBlurLinear(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
+{
+    return LinearSampledBlur(uv, float2(texelSize.x, 0.0));
+}
+
+float4 PSVerticalBlurLinear(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
+{
+    return LinearSampledBlur(uv, float2(0.0, texelSize.y));
 }
@@ -0,0 +1,184 @@
+#include "GaussianKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+double GaussianTerm(int x, double sigma) {
+    double t = x / sigma;
+    return std::exp(-0.5 * t * t);
+}
+
+// Sum of GaussianTerm over all integer offsets. The constant 1/(sqrt(2pi)*sigma)
+// the shader used to carry cancels out once the kernel is normalized.
+double GaussianNormalizer(double sigma) {
+    double total = 1.0;
+    for (int x = 1;; x++) {
+        double term = GaussianTerm(x, sigma);
+        total += 2.0 * term;
+        if (term < total * 1e-20) break;
+    }
+    return total;
+}
+
+// Folds each pair of neighbouring taps (i, i + 1) into one fetch at the point
+// where a linear filter blends them in the ratio of their weights. An odd
+// radius leaves a last "pair" with a zero weight, which lands on the texel.
+void BuildLinearTaps(GaussianKernel& kernel) {
+    for (int i = 1; i <= kernel.radius; i += 2) {
+        double w0 = kernel.weights[i];
+        double w1 = i + 1 <= kernel.radius ? kernel.weights[i + 1] : 0.0;
+        double weight = w0 + w1;
+        double offset = weight > 0.0 ? (i * w0 + (i + 1) * w1) / weight : (double)i;
+        kernel.linearOffsets.push_back((float)offset);
+        kernel.linearWeights.push_back((float)weight);
+    }
+}
+
+// Slider drags produce a new sigma every frame, so the cache is bounded and
+// simply starts over when it fills up.
+constexpr size_t kMaxCachedKernels = 256;
+
+std::mutex g_kernelCacheMutex;
+std::map<std::tuple<float, float, int>, std::shared_ptr<const GaussianKernel>> g_kernelCache;
+
+} // namespace
+
+double ReferenceGaussianWeight(int x, double sigma) {
+    if (!(sigma > 0.0)) return x == 0 ? 1.0 : 0.0;
+    return GaussianTerm(x, sigma) / GaussianNormalizer(sigma);
+}
+
+GaussianKernel BuildGaussianKernel(float sigma, float tolerance, int maxTaps) {
+    GaussianKernel kernel;
+    kernel.sigma = sigma;
+    kernel.tolerance = tolerance;
+
+    int maxRadius = maxTaps > 1 ? (maxTaps - 1) / 2 : 0;
+    if (!(sigma > 0.0f) || maxRadius == 0) {
+        kernel.weights.assign(1, 1.0f);
+        kernel.truncatedMass = sigma > 0.0f ? 1.0 - 1.0 / GaussianNormalizer(sigma) : 0.0;
+        return kernel;
+    }
+
+    double total = GaussianNormalizer(sigma);
+    std::vector<double> terms(1, 1.0);
+    double kept = 1.0;
+    int radius = 0;
+    while (radius < maxRadius && (total - kept) / total > tolerance) {
+        radius++;
+        double term = GaussianTerm(radius, sigma);
+        terms.push_back(term);
+        kept += 2.0 * term;
+    }
+
+    kernel.radius = radius;
+    kernel.truncatedMass = (total - kept) / total;
+    kernel.weights.resize(radius + 1);
+    for (int i = 0; i <= radius; i++) {
+        kernel.weights[i] = (float)(terms[i] / kept);
+    }
+    BuildLinearTaps(kernel);
+    return kernel;
+}
+
+std::shared_ptr<const GaussianKernel> GetGaussianKernel(float sigma, float tolerance, int maxTaps) {
+    auto key = std::make_tuple(sigma, tolerance, maxTaps);
+
+    std::lock_guard<std::mutex> lock(g_kernelCacheMutex);
+    auto it = g_kernelCache.find(key);
+    if (it != g_kernelCache.end()) return it->second;
+
+    if (g_kernelCache.size() >= kMaxCachedKernels) g_kernelCache.clear();
+    auto kernel = std::make_shared<const GaussianKernel>(BuildGaussianKernel(sigma, tolerance, maxTaps));
+    g_kernelCache.emplace(key, kernel);
+    return kernel;
+}
+
+KernelError MeasureKernelError(const std::vector<double>& weights, double sigma) {
+    KernelError error;
+    int radius = (int)weights.size() / 2;
+    // Include the reference tail outside the approximation's support
+    int extent = radius + 1;
+    while (sigma > 0.0 && ReferenceGaussianWeight(extent, sigma) > 1e-15) extent++;
+    for (int x = -extent; x <= extent; x++) {
+        double w = (x >= -radius && x <= radius) ? weights[x + radius] : 0.0;
+        double diff = std::fabs(w - ReferenceGaussianWeight(x < 0 ? -x : x, sigma));
+        if (diff > error.maxAbs) error.maxAbs = diff;
+        error.l1 += diff;
+    }
+    return error;
+}
+
+BoxCascade BuildBoxCascade(float sigma, int passes) {
+    BoxCascade cascade;
+    cascade.sigma = sigma;
+    if (passes < 1) passes = 1;
+
+    // Ideal width of n equal boxes with the target variance, then the mix of
+    // the two nearest odd widths that gets closest to it
+    double variance = sigma > 0.0f ? (double)sigma * sigma : 0.0;
+    double idealWidth = std::sqrt(12.0 * variance / passes + 1.0);
+    int wl = (int)std::floor(idealWidth);
+    if (wl % 2 == 0) wl--;
+    if (wl < 1) wl = 1;
+    int wu = wl + 2;
+    double mIdeal = (12.0 * variance - passes * wl * wl - 4.0 * passes * wl - 3.0 * passes) / (-4.0 * wl - 4.0);
+    int m = (int)std::lround(mIdeal);
+    if (m < 0) m = 0;
+    if (m > passes) m = passes;
+
+    double achieved = 0.0;
+    for (int i = 0; i < passes; i++) {
+        int width = i < m ? wl : wu;
+        cascade.radii.push_back((width - 1) / 2);
+        achieved += (width * (double)width - 1.0) / 12.0;
+    }
+    cascade.achievedSigma = std::sqrt(achieved);
+    return cascade;
+}
+
+std::vector<double> BoxCascadeWeights(const BoxCascade& cascade) {
+    std::vector<double> weights(1, 1.0);
+    for (int r : cascade.radii) {
+        double scale = 1.0 / (2 * r + 1);
+        std::vector<double> next(weights.size() + 2 * r, 0.0);
+        for (size_t i = 0; i < weights.size(); i++) {
+            for (int j = 0; j <= 2 * r; j++) next[i + j] += weights[i] * scale;
+        }
+        weights.swap(next);
+    }
+    return weights;
+}
+
+BlurPyramid BuildBlurPyramid(float sigma) {
+    BlurPyramid pyramid;
+    pyramid.sigma = sigma;
+    pyramid.levelSigma = sigma;
+    while (pyramid.levels < kMaxPyramidLevels &&
+           sigma / (float)(2 << pyramid.levels) >= kMinPyramidLevelSigma) {
+        pyramid.levels++;
+    }
+    if (pyramid.levels == 0) return pyramid;
+
+    // Variance added by the resampling, in full-resolution pixels. Going down
+    // to level k the 2x2 box adds 1/4 of a level k-1 pixel squared; coming back
+    // up, bilinear weights (3/4, 1/4) add 3/16 of a level k pixel squared.
+    // Summed over all levels that is (4^L - 1) / 3.
+    double scale = (double)(1u << (2 * pyramid.levels)); // 4^L
+    double resampling = (scale - 1.0) / 3.0;
+    double remaining = (double)sigma * sigma - resampling;
+    pyramid.levelSigma = (float)std::sqrt(remaining / scale);
+
+    // Far enough out that the final kernel, plus a texel of bilinear
+    // footprint on the way down and up, never reaches the coarse clamp. Sized
+    // for the widest levelSigma this level count gets (just under twice the
+    // minimum), so the level sizes only change when the level count does.
+    float widest = std::max(pyramid.levelSigma, 2.0f * kMinPyramidLevelSigma);
+    pyramid.levelPadding = GetGaussianKernel(widest)->radius + 2;
+    return pyramid;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Largest one-sided radius the blur shaders accept. The weights travel in the
+// BlurSettings constant buffer packed four to a float4, so the shader is
+// compiled with BLUR_MAX_KERNEL_VECTORS = kMaxKernelVectors.
+constexpr int kMaxKernelRadius = 255;
+constexpr int kMaxKernelVectors = kMaxKernelRadius / 4 + 1;
+constexpr int kMaxKernelTaps = 2 * kMaxKernelRadius + 1;
+
+// Kernels up to this radius also get code compiled for that exact radius: the
+// CPU row kernels in CpuBlurKernels.h and the per-texel shader passes (with
+// BLUR_FIXED_KERNEL_RADIUS). Radius 0 is a copy.
+constexpr int kMaxFixedKernelRadius = 8;
+
+// Linear-sampled taps pack as (offset, weight) pairs, two to a float4.
+constexpr int kMaxLinearTaps = (kMaxKernelRadius + 1) / 2;
+constexpr int kMaxLinearTapVectors = (kMaxLinearTaps + 1) / 2;
+
+// Default truncation tolerance: half an 8-bit step. The dropped tail mass bounds
+// the per-pass error on [0, 1] data, so this keeps each pass below rounding.
+constexpr float kDefaultKernelTolerance = 0.5f / 255.0f;
+
+// Symmetric, normalized 1D Gaussian. weights[i] is the weight of taps -i and +i,
+// so weights[0] + 2 * (weights[1] + ... + weights[radius]) == 1.
+struct GaussianKernel {
+    float sigma = 0.0f;
+    float tolerance = 0.0f;
+    int radius = 0;
+    std::vector<float> weights;
+    double truncatedMass = 0.0; // fraction of the untruncated kernel that was dropped
+
+    // The same kernel with taps 2k+1 and 2k+2 merged into one bilinear fetch at
+    // a fractional offset. Each pair is sampled at -offset and +offset; the
+    // center tap keeps weights[0].
+    std::vector<float> linearOffsets;
+    std::vector<float> linearWeights;
+};
+
+// The sigma the blur has always used for a given "Blur Radius" slider value.
+inline float SigmaFromBlurRadius(float blurRadius) { return blurRadius * 0.5f; }
+
+// Builds the kernel with the smallest radius whose dropped tail mass is within
+// tolerance, capped so that 2 * radius + 1 <= maxTaps.
+GaussianKernel BuildGaussianKernel(float sigma, float tolerance, int maxTaps = kMaxKernelTaps);
+
+// Same as BuildGaussianKernel, but cached per (sigma, tolerance, maxTaps).
+// Safe to call from any thread.
+std::shared_ptr<const GaussianKernel> GetGaussianKernel(float sigma,
+    float tolerance = kDefaultKernelTolerance, int maxTaps = kMaxKernelTaps);
+
+// Double-precision weight of offset x in the untruncated discrete Gaussian,
+// normalized over all integer offsets. Used as the reference for error checks.
+double ReferenceGaussianWeight(int x, double sigma);
+
+// How far an approximate 1D kernel is from the reference Gaussian.
+struct KernelError {
+    double maxAbs = 0.0; // largest per-tap weight difference
+    double l1 = 0.0;     // sum of |difference|; l1 / 2 bounds one pass's error on [0, 1] data
+};
+
+// weights covers offsets -radius..radius, i.e. 2 * radius + 1 entries.
+KernelError MeasureKernelError(const std::vector<double>& weights, double sigma);
+
+// Successive box filters whose combined variance matches sigma, for a blur
+// whose cost per pixel does not depend on the radius. Widths follow the usual
+// split into m boxes of odd width wl and passes - m of width wl + 2.
+struct BoxCascade {
+    float sigma = 0.0f;
+    std::vector<int> radii;     // pass i averages 2 * radii[i] + 1 taps
+    double achievedSigma = 0.0; // sqrt of the summed box variances
+};
+
+BoxCascade BuildBoxCascade(float sigma, int passes = 3);
+
+// Combined kernel of all passes, over offsets -R..R with R = sum of the radii.
+std::vector<double> BoxCascadeWeights(const BoxCascade& cascade);
+
+// Downsample-blur-upsample plan for wide blurs. Each level halves the image
+// with one bilinear fetch between four texels (a 2x2 box) and comes back up
+// with plain bilinear interpolation; only the smallest level is blurred, with
+// a Gaussian of levelSigma in that level's pixels. Both resampling steps blur
+// a little themselves, and levelSigma is reduced so the total variance still
+// comes out at sigma^2.
+//
+// Clamping at a coarse level would repeat a whole block of edge pixels, so the
+// levels cover the image plus a margin of levelPadding smallest-level pixels
+// on each side, filled by clamping the full-resolution source. Every level is
+// then exactly twice the size of the next one.
+struct BlurPyramid {
+    float sigma = 0.0f;
+    int levels = 0;          // 0: no pyramid, blur at full resolution
+    float levelSigma = 0.0f; // Gaussian applied at the smallest level
+    int levelPadding = 0;    // margin on each side, in smallest-level pixels
+};
+
+// The smallest level keeps at least this sigma (in its own pixels), so the
+// 2x2 box downsample never aliases detail the final blur would keep.
+constexpr float kMinPyramidLevelSigma = 3.0f;
+constexpr int kMaxPyramidLevels = 8;
+
+BlurPyramid BuildBlurPyramid(float sigma);
+
+// Size of pyramid level 1..levels along an axis that is `size` pixels at full
+// resolution, margins included
+inline uint32_t PyramidLevelExtent(const BlurPyramid& pyramid, uint32_t size, int level) {
+    uint32_t smallest = ((size + (1u << pyramid.levels) - 1) >> pyramid.levels) + 2 * pyramid.levelPadding;
+    return smallest << (pyramid.levels - level);
+}
+
+// Left/top margin in full-resolution pixels
+inline uint32_t PyramidPadding(const BlurPyramid& pyramid) {
+    return (uint32_t)pyramid.levelPadding << pyramid.levels;
+}
@@ -0,0 +1,133 @@
+#include "ImageLoader.h"
+
+#include <new>
+
+#include "BlurResultCache.h"
+#include "Trace.h"
+
+bool ImageLoadJob::Cancelled() const {
+    return !m_loader.IsCurrent(m_request);
+}
+
+void ImageLoadJob::PostProxy(CpuImage proxy, uint32_t fullWidth, uint32_t fullHeight) {
+    if (Cancelled()) return;
+    ImageLoadResult result;
+    result.request = m_request;
+    result.path = m_path;
+    result.status = ImageLoadStatus::Proxy;
+    result.image = std::move(proxy);
+    result.fullWidth = fullWidth;
+    result.fullHeight = fullHeight;
+    result.contentHash = HashCpuImage(result.image);
+    m_loader.Complete(std::move(result));
+}
+
+ImageLoader::ImageLoader(ImageDecoder decoder, unsigned threadCount) : m_decoder(std::move(decoder)) {
+    if (threadCount == 0) threadCount = 1;
+    for (unsigned i = 0; i < threadCount; i++) {
+        m_workers.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ImageLoader::~ImageLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_requests.clear();
+    }
+    m_current.store(0, std::memory_order_release);
+    m_wakeCv.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+}
+
+uint64_t ImageLoader::Load(const std::filesystem::path& path) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_nextId++;
+        // Anything still queued is already stale, so only the newest request waits
+        m_requests.clear();
+        m_requests.push_back({ id, path });
+        m_results.clear();
+        m_finished = false;
+        m_current.store(id, std::memory_order_release);
+    }
+    m_wakeCv.notify_one();
+    return id;
+}
+
+void ImageLoader::CancelAll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests.clear();
+    m_results.clear();
+    m_finished = true;
+    m_current.store(0, std::memory_order_release);
+}
+
+bool ImageLoader::Poll(ImageLoadResult& result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_results.empty()) {
+        ImageLoadResult next = std::move(m_results.front());
+        m_results.pop_front();
+        if (!IsCurrent(next.request)) continue;
+        if (next.status != ImageLoadStatus::Proxy) m_finished = true;
+        result = std::move(next);
+        return true;
+    }
+    return false;
+}
+
+bool ImageLoader::Busy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_finished;
+}
+
+void ImageLoader::Complete(ImageLoadResult result) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Checked under the lock, so a result can't slip in after Load or
+    // CancelAll cleared the queue for a newer request
+    if (!IsCurrent(result.request)) return;
+    m_results.push_back(std::move(result));
+}
+
+void ImageLoader::WorkerLoop() {
+    TraceSetThreadName("image loader");
+    for (;;) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCv.wait(lock, [&] { return m_stop || !m_requests.empty(); });
+            if (m_stop) return;
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+        if (!IsCurrent(request.id)) continue;
+
+        ImageLoadJob job(*this, request.id, request.path);
+        ImageLoadResult result;
+        result.request = request.id;
+        result.path = request.path;
+        bool ok;
+        try {
+            TRACE_SCOPE("image decode");
+            ok = m_decoder(request.path, job, result.image, &result.error);
+        }
+        catch (const std::bad_alloc&) {
+            ok = false;
+            result.error = "out of memory";
+        }
+        if (job.Cancelled()) continue;
+        if (ok) {
+            result.status = ImageLoadStatus::Loaded;
+            result.fullWidth = result.image.width;
+            result.fullHeight = result.image.height;
+            result.contentHash = HashCpuImage(result.image);
+        }
+        else {
+            result.status = ImageLoadStatus::Failed;
+            result.image = CpuImage();
+            if (result.error.empty()) result.error = "decode failed";
+        }
+        Complete(std::move(result));
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuImage.h"
+
+// Decodes images on background threads so that opening a file never stalls
+// the render loop. Load queues a file and cancels every earlier request; the
+// render loop calls Poll once per frame to pick up what finished. A decoder
+// can post a low-resolution proxy first, which Poll hands out before the
+// full image. Results of cancelled requests are dropped, so Poll only ever
+// returns results for the newest request.
+
+enum class ImageLoadStatus {
+    Proxy,  // a small stand-in; the full image follows
+    Loaded, // the full image
+    Failed,
+};
+
+struct ImageLoadResult {
+    uint64_t request = 0;
+    std::filesystem::path path;
+    ImageLoadStatus status = ImageLoadStatus::Failed;
+    CpuImage image;
+    uint32_t fullWidth = 0;   // size of the full image, also set for a proxy
+    uint32_t fullHeight = 0;
+    uint64_t contentHash = 0; // HashCpuImage(image), so the render loop needn't read it again
+    std::string error;        // why a load failed
+};
+
+class ImageLoader;
+
+// What a decoder sees of its request.
+class ImageLoadJob {
+public:
+    // True once a newer Load or CancelAll superseded this request. Decoders
+    // check it between slices of work and give up early.
+    bool Cancelled() const;
+
+    // Hands a stand-in for the image to the render loop. fullWidth/fullHeight
+    // are the size of the image being decoded.
+    void PostProxy(CpuImage proxy, uint32_t fullWidth, uint32_t fullHeight);
+
+private:
+    friend class ImageLoader;
+    ImageLoadJob(ImageLoader& loader, uint64_t request, const std::filesystem::path& path)
+        : m_loader(loader), m_request(request), m_path(path) {}
+
+    ImageLoader& m_loader;
+    uint64_t m_request;
+    const std::filesystem::path& m_path;
+};
+
+// Decodes path into image as RGBA8. Runs on a loader thread.
+using ImageDecoder = std::function<bool(const std::filesystem::path& path, ImageLoadJob& job, CpuImage& image,
+    std::string* error)>;
+
+class ImageLoader {
+public:
+    // threadCount decoder threads; more than one lets a new file start
+    // decoding while a cancelled one is still winding down.
+    explicit ImageLoader(ImageDecoder decoder, unsigned threadCount = 2);
+    ~ImageLoader();
+
+    ImageLoader(const ImageLoader&) = delete;
+    ImageLoader& operator=(const ImageLoader&) = delete;
+
+    // Queues path and cancels everything requested before. Returns the
+    // request id that its results carry.
+    uint64_t Load(const std::filesystem::path& path);
+
+    // Cancels the current request, if any.
+    void CancelAll();
+
+    // Takes the next result of the current request without blocking.
+    bool Poll(ImageLoadResult& result);
+
+    // A request is queued or decoding and its final result not yet polled.
+    bool Busy() const;
+
+private:
+    friend class ImageLoadJob;
+
+    struct Request {
+        uint64_t id;
+        std::filesystem::path path;
+    };
+
+    void WorkerLoop();
+    void Complete(ImageLoadResult result);
+    bool IsCurrent(uint64_t request) const { return m_current.load(std::memory_order_acquire) == request; }
+
+    ImageDecoder m_decoder;
+    std::vector<std::thread> m_workers;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    std::deque<Request> m_requests;
+    std::deque<ImageLoadResult> m_results;
+    uint64_t m_nextId = 1;
+    bool m_finished = true; // the current request's final result was polled
+    bool m_stop = false;
+
+    // Id of the newest request; 0 after CancelAll.
+    std::atomic<uint64_t> m_current{ 0 };
+};
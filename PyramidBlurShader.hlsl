@@ -0,0 +1,21 @@
+// Resampling step of the "Pyramid" blur mode. ApplyPyramidBlur draws it with
+// the fullscreen triangle to halve each level on the way down and double it
+// on the way back up; the linear clamp sampler does the 2x2 average or the
+// bilinear interpolation. The smallest level is blurred with the regular
+// passes from GaussianBlurShader.hlsl.
+
+Texture2D inputTexture : register(t0);
+SamplerState inputSampler : register(s0);
+
+cbuffer PyramidSettings : register(b0)
+{
+    // Maps the output's uv to the input's. Not the identity where the levels
+    // carry a clamped margin around the image (see BlurPyramid).
+    float2 uvScale;
+    float2 uvOffset;
+};
+
+float4 PSResample(float4 pos : SV_POSITION, float2 uv : TEXCOORD) : SV_TARGET
+{
+    return inputTexture.Sample(inputSampler, uv * uvScale + uvOffset);
+}
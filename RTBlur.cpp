@@ -12,9 +12,22 @@
 #include "imgui_impl_dx11.h"
 #include "imconfig.h"
 #include "imgui_internal.h"
+#include <cstdio>
 #include <vector>
 #include <string>
+#include <chrono>
+#include <filesystem>
+#include <future>
 #include <shobjidl.h> // For IFileOpenDialog
+#include "GaussianKernel.h"
+#include "CpuBlur.h"
+#include "BlurResultCache.h"
+#include "CpuBlurEngine.h"
+#include "CpuEngineProfile.h"
+#include "CpuPreview.h"
+#include "CpuRecursiveBlur.h"
+#include "ImageLoader.h"
+#include "Trace.h"
 
 
 using Microsoft::WRL::ComPtr;
@@ -31,6 +44,7 @@ void CreateTempRenderTarget(UINT x, UINT y);
 void CreateBlurSettingsBuffer();
 void LoadBlurShader();
 void CreateBlurRenderTarget(UINT width, UINT height);
+void DrawFullScreenQuad(ID3D11ShaderResourceView* inputSRV);
 
 // Globals
 HWND hwnd = nullptr;
@@ -41,12 +55,145 @@ ID3D11RenderTargetView* g_mainRenderTargetView = nullptr;
 
 float g_blurRadius = 5.0f;
 
+enum BlurMode {
+    BlurMode_PerTexel,      // one fetch per kernel tap
+    BlurMode_LinearSampled, // neighbouring taps merged into one bilinear fetch
+    BlurMode_BoxCascade,    // fast Gaussian: running-sum boxes, cost independent of radius
+    BlurMode_Recursive,     // recursive IIR Gaussian, CPU only
+    BlurMode_Pyramid,       // downsample, blur the smallest level, upsample
+    BlurMode_Auto,          // CPU engine picked per blur from the calibrated cost model
+    BlurMode_Count
+};
+const char* g_blurModeNames[BlurMode_Count] = { "Per-texel", "Bilinear merged", "Box cascade (fast)",
+    "Recursive IIR (CPU)", "Pyramid (large radii)", "Auto (CPU)" };
+int g_blurMode = BlurMode_PerTexel;
+
+// Set when no hardware adapter could create a device. The UI then presents
+// through WARP and the blur runs on the CPU engine instead of the shaders.
+bool g_cpuBlurFallback = false;
+CpuImage g_loadedImage;      // decoded pixels of the current image
+uint64_t g_loadedImageHash = 0; // HashCpuImage(g_loadedImage)
+// g_loadedImage width over the width of the file it stands for: below 1
+// while a loader proxy is shown, and blur radii are scaled to match.
+float g_loadedImageScale = 1.0f;
+ID3D11ShaderResourceView* g_loadedImageSRV = nullptr;
+// The same texture read as sRGB, so sampling returns linear light
+ComPtr<ID3D11ShaderResourceView> g_loadedImageSrgbSRV;
+
+// Blur in linear light instead of on the sRGB-encoded values. The shaders
+// read the image through g_loadedImageSrgbSRV, keep the intermediate in a
+// half-float g_tempTexture (recreated as 8-bit when the mode is turned off)
+// and write through an sRGB render target view, so the hardware does the
+// decoding and encoding. The CPU direct engine switches
+// to CpuLinearLightBlur; the other CPU engines blur the encoded values.
+bool g_linearLight = false;
+
+// CPU results by (image, sigma, engine), so moving the slider back to a value
+// it has shown is a lookup. g_cpuBlurResult is the one on screen.
+int g_blurCacheBudgetMB = 512;
+BlurResultCache g_blurCache((size_t)g_blurCacheBudgetMB << 20);
+std::shared_ptr<const CpuImage> g_cpuBlurResult;
+
+// While the radius slider is held, CPU blurs run on g_loadedImage downscaled
+// to the size it is displayed at (see CpuPreview.h); the full-resolution blur
+// follows once the slider is released.
+bool g_previewWhileDragging = true;
+bool g_blurSliderActive = false; // as of the previous frame's UI
+bool g_showingPreview = false;   // g_cpuBlurResult is a preview
+CpuImage g_previewSource;        // g_loadedImage at g_previewSize, empty until needed
+uint64_t g_previewSourceHash = 0;
+PreviewSize g_previewSize;
+
+// Auto mode: the CPU engine cost model (CpuEngineProfile.h), loaded or
+// calibrated the first time the mode is used, and its latest pick
+CpuEngineProfile g_engineProfile;
+float g_autoTolerance = 1.5f;  // error the pick may have, 8-bit steps
+CpuEngineChoice g_autoChoice;
+bool g_autoChoiceCached = false; // the result came from g_blurCache, not a blur
+
+// Whether the current mode blurs on the CPU. The recursive filter is a serial
+// scan along each line, so it has no shader path and always runs here; the
+// auto mode picks among the CPU engines.
+bool BlurRunsOnCpu() {
+    return g_cpuBlurFallback || g_blurMode == BlurMode_Recursive || g_blurMode == BlurMode_Auto;
+}
+
+// Loads the engine profile for the default pool, calibrating (a few seconds)
+// if there is none for this machine yet
+void EnsureEngineProfile(bool recalibrate) {
+    ThreadPool& pool = GetDefaultThreadPool();
+    if (!recalibrate && g_engineProfile.Matches(pool)) return;
+    std::string path = DefaultCpuEngineProfilePath();
+    std::string error;
+    bool calibrated = true;
+    bool ok;
+    if (recalibrate) {
+        CalibrateCpuEngines(pool, g_engineProfile);
+        ok = SaveCpuEngineProfile(path, g_engineProfile, &error);
+    }
+    else {
+        ok = LoadOrCalibrateCpuEngines(path, pool, g_engineProfile, &calibrated, &error);
+    }
+    std::string message = (calibrated ? "Calibrated the CPU engines, profile " : "Loaded the CPU engine profile ") +
+        path + "\n";
+    OutputDebugStringA(ok ? message.c_str() : ("Engine profile not saved: " + error + "\n").c_str());
+}
+
+// The auto mode's blur: logs the pick with its predicted and actual time
+std::shared_ptr<const CpuImage> CpuBlurImageAutoCached(const CpuImage& src, uint64_t sourceHash, float blurRadius,
+    ThreadPool& pool)
+{
+    EnsureEngineProfile(false);
+    g_autoChoice = ChooseCpuEngine(g_engineProfile, src.width, src.height, blurRadius, g_autoTolerance);
+    uint64_t misses = g_blurCache.GetStats().misses;
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const CpuImage> result = CpuBlurImageCached(g_blurCache, src, sourceHash, blurRadius,
+        g_autoChoice.engine, pool);
+    g_autoChoice.actualMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    g_autoChoiceCached = g_blurCache.GetStats().misses == misses;
+
+    char message[256];
+    snprintf(message, sizeof(message), "Auto blur %ux%u radius %.2f: %s, predicted %.2f ms, took %.2f ms%s\n",
+        src.width, src.height, blurRadius, CpuBlurEngineName(g_autoChoice.engine), g_autoChoice.predictedMs,
+        g_autoChoice.actualMs, g_autoChoiceCached ? " (cached)" : "");
+    OutputDebugStringA(message);
+    return result;
+}
+
+CpuBlurEngine CpuEngineForBlurMode(int mode) {
+    switch (mode) {
+    case BlurMode_BoxCascade: return CpuBlurEngine::BoxCascade;
+    case BlurMode_Recursive: return CpuBlurEngine::Recursive;
+    case BlurMode_Pyramid: return CpuBlurEngine::Pyramid;
+    default: return g_linearLight ? CpuBlurEngine::LinearLight : CpuBlurEngine::Direct;
+    }
+}
+
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 
-ID3D11ShaderResourceView* LoadTextureFromFile(const wchar_t* filename) {
-    // Initialize COM
-    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+HRESULT CreateRgbaConverter(IWICImagingFactory* wicFactory, IWICBitmapSource* source,
+    ComPtr<IWICFormatConverter>& converter)
+{
+    HRESULT hr = wicFactory->CreateFormatConverter(&converter);
+    if (FAILED(hr)) return hr;
+    return converter->Initialize(source, GUID_WICPixelFormat32bppRGBA,
+        WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+}
+
+// Initializes COM on this thread for a scope, and balances it only if that
+// succeeded. Declared before any COM pointer so that it is released last.
+struct ScopedComInit {
+    HRESULT hr;
+    explicit ScopedComInit(DWORD flags) : hr(CoInitializeEx(nullptr, flags)) {}
+    ~ScopedComInit() { if (SUCCEEDED(hr)) CoUninitialize(); }
+};
+
+// ImageLoader decoder: runs on a loader thread. Posts the file's embedded
+// thumbnail, when it has one, as a proxy, then converts the full frame in
+// bands so that picking another file stops it within a band.
+bool DecodeImageWic(const std::filesystem::path& path, ImageLoadJob& job, CpuImage& image, std::string* error) {
+    ScopedComInit com(COINIT_MULTITHREADED);
 
     ComPtr<IWICImagingFactory> wicFactory;
     ComPtr<IWICBitmapDecoder> decoder;
@@ -55,50 +202,79 @@ ID3D11ShaderResourceView* LoadTextureFromFile(const wchar_t* filename) {
 
     HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
         IID_PPV_ARGS(&wicFactory));
-    if (FAILED(hr)) return nullptr;
+    if (FAILED(hr)) return false;
 
-    hr = wicFactory->CreateDecoderFromFilename(filename, nullptr, GENERIC_READ,
+    hr = wicFactory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ,
         WICDecodeMetadataCacheOnLoad, &decoder);
-    if (FAILED(hr)) return nullptr;
+    if (FAILED(hr)) {
+        *error = "unsupported or unreadable file";
+        return false;
+    }
 
     hr = decoder->GetFrame(0, &frame);
-    if (FAILED(hr)) return nullptr;
-
-    hr = wicFactory->CreateFormatConverter(&converter);
-    if (FAILED(hr)) return nullptr;
-
-    hr = converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA,
-        WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
-    if (FAILED(hr)) return nullptr;
+    if (FAILED(hr)) return false;
 
     UINT width = 0, height = 0;
-    converter->GetSize(&width, &height);
+    frame->GetSize(&width, &height);
+    if (width == 0 || height == 0) return false;
+
+    ComPtr<IWICBitmapSource> thumbnail;
+    if (SUCCEEDED(frame->GetThumbnail(&thumbnail)) || SUCCEEDED(decoder->GetThumbnail(&thumbnail))) {
+        ComPtr<IWICFormatConverter> thumbnailConverter;
+        UINT thumbWidth = 0, thumbHeight = 0;
+        if (SUCCEEDED(CreateRgbaConverter(wicFactory.Get(), thumbnail.Get(), thumbnailConverter)) &&
+            SUCCEEDED(thumbnailConverter->GetSize(&thumbWidth, &thumbHeight)) &&
+            thumbWidth > 0 && thumbHeight > 0 && thumbWidth < width)
+        {
+            CpuImage proxy(thumbWidth, thumbHeight);
+            hr = thumbnailConverter->CopyPixels(nullptr, thumbWidth * 4, (UINT)proxy.pixels.size(),
+                proxy.pixels.data());
+            if (SUCCEEDED(hr)) job.PostProxy(std::move(proxy), width, height);
+        }
+    }
 
-    std::vector<BYTE> imageData(width * height * 4);
-    hr = converter->CopyPixels(nullptr, width * 4, (UINT)imageData.size(), imageData.data());
-    if (FAILED(hr)) return nullptr;
+    hr = CreateRgbaConverter(wicFactory.Get(), frame.Get(), converter);
+    if (FAILED(hr)) return false;
+
+    constexpr UINT kBandRows = 256;
+    image = CpuImage(width, height);
+    for (UINT y = 0; y < height; y += kBandRows) {
+        if (job.Cancelled()) return false;
+        UINT rows = height - y < kBandRows ? height - y : kBandRows;
+        WICRect band = { 0, (INT)y, (INT)width, (INT)rows };
+        hr = converter->CopyPixels(&band, width * 4, width * 4 * rows, image.Row(y));
+        if (FAILED(hr)) return false;
+    }
+    return true;
+}
+
+// Two loader threads: a cancelled decode can finish its band on one while
+// the newly picked file starts on the other.
+ImageLoader g_imageLoader(DecodeImageWic, 2);
 
-    // Create the texture
+ID3D11ShaderResourceView* CreateImageTexture(const CpuImage& image) {
+    TRACE_SCOPE("texture upload");
     D3D11_TEXTURE2D_DESC texDesc = {};
-    texDesc.Width = width;
-    texDesc.Height = height;
+    texDesc.Width = image.width;
+    texDesc.Height = image.height;
     texDesc.MipLevels = 1;
     texDesc.ArraySize = 1;
-    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    // Typeless so that CreateSrgbView can read it as sRGB too
+    texDesc.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS;
     texDesc.SampleDesc.Count = 1;
     texDesc.Usage = D3D11_USAGE_DEFAULT;
     texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
     D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = imageData.data();
-    initData.SysMemPitch = width * 4;
+    initData.pSysMem = image.pixels.data();
+    initData.SysMemPitch = image.width * 4;
 
     ComPtr<ID3D11Texture2D> texture;
-    hr = g_pd3dDevice->CreateTexture2D(&texDesc, &initData, &texture);
+    HRESULT hr = g_pd3dDevice->CreateTexture2D(&texDesc, &initData, &texture);
     if (FAILED(hr)) return nullptr;
 
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = texDesc.Format;
+    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = 1;
 
@@ -109,6 +285,23 @@ ID3D11ShaderResourceView* LoadTextureFromFile(const wchar_t* filename) {
     return srv;
 }
 
+// A second view of a CreateImageTexture texture that decodes sRGB on read.
+ComPtr<ID3D11ShaderResourceView> CreateSrgbView(ID3D11ShaderResourceView* srv) {
+    ComPtr<ID3D11Resource> resource;
+    srv->GetResource(&resource);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+
+    ComPtr<ID3D11ShaderResourceView> srgbSRV;
+    if (FAILED(g_pd3dDevice->CreateShaderResourceView(resource.Get(), &srvDesc, &srgbSRV))) {
+        OutputDebugString(L"Failed to create the sRGB view of the image.\n");
+    }
+    return srgbSRV;
+}
+
 std::wstring OpenFileDialog() {
     ComPtr<IFileOpenDialog> fileDialog;
     HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, nullptr, CLSCTX_INPROC_SERVER,
@@ -302,7 +495,7 @@ void EnumAllAdapters() {
 DXGI_SWAP_CHAIN_DESC sd = {};
 
 
-void InitD3D(HWND hWnd) {
+bool InitD3D(HWND hWnd) {
 
     sd.BufferCount = 2;
     sd.BufferDesc.Width = 1280;
@@ -312,9 +505,29 @@ void InitD3D(HWND hWnd) {
     sd.OutputWindow = hWnd;
     sd.SampleDesc.Count = 1;
     sd.Windowed = TRUE;
-    D3D11CreateDeviceAndSwapChain(adapters[selectedAdapterIndex].Get(), D3D_DRIVER_TYPE_UNKNOWN,
-        nullptr, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION,
-        &sd, &g_pSwapChain, &g_pd3dDevice, &outFeatureLevel, &g_pd3dDeviceContext);
+    HRESULT hr = DXGI_ERROR_NOT_FOUND;
+    if (selectedAdapterIndex >= 0 && selectedAdapterIndex < (int)adapters.size()) {
+        hr = D3D11CreateDeviceAndSwapChain(adapters[selectedAdapterIndex].Get(), D3D_DRIVER_TYPE_UNKNOWN,
+            nullptr, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION,
+            &sd, &g_pSwapChain, &g_pd3dDevice, &outFeatureLevel, &g_pd3dDeviceContext);
+    }
+
+    // No usable adapter: keep the UI on the WARP software rasterizer and blur on the CPU
+    g_cpuBlurFallback = FAILED(hr);
+    if (g_cpuBlurFallback) {
+        wchar_t errorMsg[256];
+        swprintf_s(errorMsg, L"Hardware device creation failed (HRESULT: 0x%08X), using CPU blur (%S).\n",
+            hr, CpuIsaName(GetCpuBlurIsa()));
+        OutputDebugString(errorMsg);
+
+        hr = D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_WARP,
+            nullptr, 0, featureLevels, _countof(featureLevels), D3D11_SDK_VERSION,
+            &sd, &g_pSwapChain, &g_pd3dDevice, &outFeatureLevel, &g_pd3dDeviceContext);
+        if (FAILED(hr)) {
+            OutputDebugString(L"WARP device creation failed.\n");
+            return false;
+        }
+    }
 
     LoadFullscreenShaders();    // <-- compile VSMain/PSMain from FullScreenPass.hlsl
     CreateFullscreenTriangle(); // <-- create the big triangle
@@ -328,10 +541,142 @@ void InitD3D(HWND hWnd) {
 
     CreateBlurSettingsBuffer();
 
+    return true;
+}
+
+ComPtr<ID3D11Texture2D> g_cpuBlurTexture;
+ComPtr<ID3D11ShaderResourceView> g_cpuBlurSRV;
+
+// GPU timestamp queries for the trace. Each frame's queries are read back a
+// few frames later without flushing, so timing never stalls the pipeline; a
+// frame whose slot is still waiting on the GPU just goes untimed. GPU times
+// are placed on the CPU timeline by anchoring the frame's first timestamp to
+// the CPU time it was issued at, which is approximate (the GPU runs behind)
+// but keeps the spans in order and at the right length.
+constexpr int kGpuTimerFrames = 4;
+constexpr int kGpuTimerSpans = 16;
+
+struct GpuTimerFrame {
+    ComPtr<ID3D11Query> disjoint;
+    ComPtr<ID3D11Query> frameStart;
+    ComPtr<ID3D11Query> spanBegin[kGpuTimerSpans];
+    ComPtr<ID3D11Query> spanEnd[kGpuTimerSpans];
+    const char* names[kGpuTimerSpans] = {};
+    int spanCount = 0;
+    uint64_t cpuStartNs = 0;
+    bool pending = false; // ended, results not read yet
+};
+
+GpuTimerFrame g_gpuTimerFrames[kGpuTimerFrames];
+int g_gpuTimerFrame = 0;
+bool g_gpuTimerActive = false; // queries are being issued for this frame
+
+bool CreateTimestampQuery(D3D11_QUERY type, ComPtr<ID3D11Query>& query) {
+    if (query) return true;
+    D3D11_QUERY_DESC desc = {};
+    desc.Query = type;
+    return SUCCEEDED(g_pd3dDevice->CreateQuery(&desc, &query));
+}
+
+void ResetGpuTimer() {
+    for (GpuTimerFrame& frame : g_gpuTimerFrames) frame = GpuTimerFrame();
+    g_gpuTimerActive = false;
+}
+
+void GpuTimerBeginFrame() {
+    g_gpuTimerActive = false;
+    if (!TracingEnabled() || !g_pd3dDevice) return;
+    GpuTimerFrame& frame = g_gpuTimerFrames[g_gpuTimerFrame];
+    if (frame.pending) return;
+    if (!CreateTimestampQuery(D3D11_QUERY_TIMESTAMP_DISJOINT, frame.disjoint) ||
+        !CreateTimestampQuery(D3D11_QUERY_TIMESTAMP, frame.frameStart))
+    {
+        return;
+    }
+    g_pd3dDeviceContext->Begin(frame.disjoint.Get());
+    g_pd3dDeviceContext->End(frame.frameStart.Get());
+    frame.cpuStartNs = TraceNowNs();
+    frame.spanCount = 0;
+    g_gpuTimerActive = true;
+}
+
+// Returns the span index for GpuTimerEndSpan, or -1 when not timing
+int GpuTimerBeginSpan(const char* name) {
+    if (!g_gpuTimerActive) return -1;
+    GpuTimerFrame& frame = g_gpuTimerFrames[g_gpuTimerFrame];
+    int span = frame.spanCount;
+    if (span == kGpuTimerSpans || !CreateTimestampQuery(D3D11_QUERY_TIMESTAMP, frame.spanBegin[span]) ||
+        !CreateTimestampQuery(D3D11_QUERY_TIMESTAMP, frame.spanEnd[span]))
+    {
+        return -1;
+    }
+    frame.names[span] = name;
+    frame.spanCount++;
+    g_pd3dDeviceContext->End(frame.spanBegin[span].Get());
+    return span;
+}
+
+void GpuTimerEndSpan(int span) {
+    if (!g_gpuTimerActive || span < 0) return;
+    g_pd3dDeviceContext->End(g_gpuTimerFrames[g_gpuTimerFrame].spanEnd[span].Get());
+}
+
+struct ScopedGpuTrace {
+    int span;
+    explicit ScopedGpuTrace(const char* name) : span(GpuTimerBeginSpan(name)) {}
+    ~ScopedGpuTrace() { GpuTimerEndSpan(span); }
+};
+
+void GpuTimerEndFrame() {
+    if (!g_gpuTimerActive) return;
+    GpuTimerFrame& frame = g_gpuTimerFrames[g_gpuTimerFrame];
+    g_pd3dDeviceContext->End(frame.disjoint.Get());
+    frame.pending = true;
+    g_gpuTimerActive = false;
+    g_gpuTimerFrame = (g_gpuTimerFrame + 1) % kGpuTimerFrames;
+}
+
+// Turns finished frames' timestamps into trace events on the GPU track
+void GpuTimerCollect() {
+    for (int i = 1; i <= kGpuTimerFrames; i++) {
+        // Oldest first
+        GpuTimerFrame& frame = g_gpuTimerFrames[(g_gpuTimerFrame + i) % kGpuTimerFrames];
+        if (!frame.pending) continue;
+
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+        if (g_pd3dDeviceContext->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint),
+            D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        {
+            continue;
+        }
+        frame.pending = false;
+        UINT64 start = 0;
+        if (disjoint.Disjoint || disjoint.Frequency == 0 ||
+            g_pd3dDeviceContext->GetData(frame.frameStart.Get(), &start, sizeof(start), 0) != S_OK)
+        {
+            continue;
+        }
+
+        double nsPerTick = 1e9 / (double)disjoint.Frequency;
+        for (int span = 0; span < frame.spanCount; span++) {
+            UINT64 begin = 0, end = 0;
+            if (g_pd3dDeviceContext->GetData(frame.spanBegin[span].Get(), &begin, sizeof(begin), 0) != S_OK ||
+                g_pd3dDeviceContext->GetData(frame.spanEnd[span].Get(), &end, sizeof(end), 0) != S_OK ||
+                begin < start || end < begin)
+            {
+                continue;
+            }
+            TraceRecord(frame.names[span], "gpu", frame.cpuStartNs + (uint64_t)((begin - start) * nsPerTick),
+                (uint64_t)((end - begin) * nsPerTick), kGpuTraceThread);
+        }
+    }
 }
 
 void CleanupD3D() {
+    ResetGpuTimer();
     CleanupRenderTarget();
+    g_cpuBlurSRV.Reset();
+    g_cpuBlurTexture.Reset();
     if (g_pSwapChain) { g_pSwapChain->Release(); g_pSwapChain = nullptr; }
     if (g_pd3dDeviceContext) { g_pd3dDeviceContext->Release(); g_pd3dDeviceContext = nullptr; }
     if (g_pd3dDevice) { g_pd3dDevice->Release(); g_pd3dDevice = nullptr; }
@@ -344,7 +689,10 @@ void ReinitDeviceAndPipeline(HWND hWnd)
     // If there’s an existing device, release everything
     CleanupD3D();
 
-    InitD3D(hWnd);
+    if (!InitD3D(hWnd)) {
+        OutputDebugString(L"Failed to reinitialize the device.\n");
+        return;
+    }
 
     // CreateRenderTarget();
     // CreateBlurRenderTarget(...);
@@ -364,6 +712,10 @@ void ReinitDeviceAndPipeline(HWND hWnd)
 
 void ShowAdapterPicker() {
     ImGui::Text("Pick GPU:");
+    if (adapterNames.empty()) {
+        ImGui::Text("No adapters found, blurring on the CPU.");
+        return;
+    }
     if (ImGui::BeginCombo("GPU List", (char*)adapterNames[selectedAdapterIndex].c_str())) {
         for (int i = 0; i < adapterNames.size(); i++) {
             bool isSelected = (selectedAdapterIndex == i);
@@ -382,10 +734,15 @@ void ShowAdapterPicker() {
         ReinitDeviceAndPipeline(hwnd);
     }
 }
+// Must match cbuffer BlurSettings in GaussianBlurShader.hlsl
 struct BlurSettings {
     DirectX::XMFLOAT2 texelSize;
     float blurRadius;
-    float padding; // Padding to align to 16 bytes
+    int kernelRadius;
+    DirectX::XMFLOAT4 kernelWeights[kMaxKernelVectors];
+    int linearTapCount;
+    int padding[3]; // linearTaps starts a new 16-byte register
+    DirectX::XMFLOAT4 linearTaps[kMaxLinearTapVectors];
 };
 
 ComPtr<ID3D11Buffer> g_blurSettingsBuffer;
@@ -408,24 +765,45 @@ void CreateBlurSettingsBuffer() {
     g_pd3dDevice->CreateBuffer(&cbDesc, nullptr, &g_blurSettingsBuffer);
 }
 
-void UpdateBlurSettings(float blurRadius, UINT width, UINT height) {
+// Same as UpdateBlurSettings for a sigma that doesn't come from the slider,
+// e.g. the smallest level of the pyramid mode
+void UpdateBlurSettingsForSigma(float sigma, UINT width, UINT height) {
     D3D11_MAPPED_SUBRESOURCE mappedResource;
     g_pd3dDeviceContext->Map(g_blurSettingsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 
     BlurSettings* settings = reinterpret_cast<BlurSettings*>(mappedResource.pData);
     settings->texelSize = DirectX::XMFLOAT2(1.0f / width, 1.0f / height);
-    settings->blurRadius = blurRadius;
+    settings->blurRadius = sigma * 2.0f;
+
+    // Weights come from the cached table instead of exp() per tap in the shader
+    auto kernel = GetGaussianKernel(sigma);
+    settings->kernelRadius = kernel->radius;
+    float* weights = &settings->kernelWeights[0].x;
+    for (int i = 0; i < kMaxKernelVectors * 4; i++) {
+        weights[i] = i <= kernel->radius ? kernel->weights[i] : 0.0f;
+    }
+
+    // (offset in texels, weight) pairs for the bilinear tap-merged passes
+    settings->linearTapCount = (int)kernel->linearOffsets.size();
+    float* linearTaps = &settings->linearTaps[0].x;
+    for (int i = 0; i < kMaxLinearTapVectors * 2; i++) {
+        bool used = i < settings->linearTapCount;
+        linearTaps[i * 2 + 0] = used ? kernel->linearOffsets[i] : 0.0f;
+        linearTaps[i * 2 + 1] = used ? kernel->linearWeights[i] : 0.0f;
+    }
 
     g_pd3dDeviceContext->Unmap(g_blurSettingsBuffer.Get(), 0);
-    wchar_t debugMsg[256];
-    // swprintf_s(debugMsg, L"Blur Radius: %f\n", blurRadius);
-    // OutputDebugString(debugMsg);
+}
 
+void UpdateBlurSettings(float blurRadius, UINT width, UINT height) {
+    UpdateBlurSettingsForSigma(SigmaFromBlurRadius(blurRadius), width, height);
 }
 
 
 ComPtr<ID3D11Texture2D> g_blurRenderTargetTexture;
 ComPtr<ID3D11RenderTargetView> g_blurRenderTargetView;
+// Encodes to sRGB on write, for blurring in linear light
+ComPtr<ID3D11RenderTargetView> g_blurRenderTargetSrgbView;
 ComPtr<ID3D11ShaderResourceView> g_blurShaderResourceView;
 
 void CreateBlurRenderTarget(UINT width, UINT height) {
@@ -434,7 +812,7 @@ void CreateBlurRenderTarget(UINT width, UINT height) {
     texDesc.Height = height;
     texDesc.MipLevels = 1;
     texDesc.ArraySize = 1;
-    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texDesc.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS;
     texDesc.SampleDesc.Count = 1;
     texDesc.Usage = D3D11_USAGE_DEFAULT;
     texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
@@ -444,12 +822,26 @@ void CreateBlurRenderTarget(UINT width, UINT height) {
         OutputDebugString(L"Failed to create blur render target texture.\n");
     }
 
-    hr = g_pd3dDevice->CreateRenderTargetView(g_blurRenderTargetTexture.Get(), nullptr, &g_blurRenderTargetView);
+    D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+    rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+    hr = g_pd3dDevice->CreateRenderTargetView(g_blurRenderTargetTexture.Get(), &rtvDesc, &g_blurRenderTargetView);
     if (FAILED(hr)) {
         OutputDebugString(L"Failed to create blur render target view.\n");
     }
 
-    hr = g_pd3dDevice->CreateShaderResourceView(g_blurRenderTargetTexture.Get(), nullptr, &g_blurShaderResourceView);
+    rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    hr = g_pd3dDevice->CreateRenderTargetView(g_blurRenderTargetTexture.Get(), &rtvDesc, &g_blurRenderTargetSrgbView);
+    if (FAILED(hr)) {
+        OutputDebugString(L"Failed to create the sRGB blur render target view.\n");
+    }
+
+    // The display reads the stored bytes, whichever view wrote them
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    hr = g_pd3dDevice->CreateShaderResourceView(g_blurRenderTargetTexture.Get(), &srvDesc, &g_blurShaderResourceView);
     if (!g_blurShaderResourceView) {
         OutputDebugString(L"g_blurShaderResourceView is null.\n");
     }
@@ -472,7 +864,9 @@ void CreateTempRenderTarget(UINT width, UINT height)
     texDesc.Height = height;
     texDesc.MipLevels = 1;
     texDesc.ArraySize = 1;
-    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    // 8-bit like the CPU direct engine's intermediate, except in linear light,
+    // where 8 bits would band the darks and the pass is kept in half float
+    texDesc.Format = g_linearLight ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
     texDesc.SampleDesc.Count = 1;
     texDesc.Usage = D3D11_USAGE_DEFAULT;
     texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
@@ -490,14 +884,61 @@ void CreateTempRenderTarget(UINT width, UINT height)
 
 ComPtr<ID3D11PixelShader> g_blurHorizontalPS;
 ComPtr<ID3D11PixelShader> g_blurVerticalPS;
+ComPtr<ID3D11PixelShader> g_blurHorizontalLinearPS;
+ComPtr<ID3D11PixelShader> g_blurVerticalLinearPS;
+// Per-texel passes for one kernel radius each, compiled on first use
+ComPtr<ID3D11PixelShader> g_blurFixedHorizontalPS[kMaxFixedKernelRadius + 1];
+ComPtr<ID3D11PixelShader> g_blurFixedVerticalPS[kMaxFixedKernelRadius + 1];
+
+ComPtr<ID3D11ComputeShader> g_boxHorizontalCS;
+ComPtr<ID3D11ComputeShader> g_boxVerticalCS;
+
+// Must match cbuffer BoxBlurSettings in BoxBlurShader.hlsl
+struct BoxBlurSettings {
+    UINT size[2];
+    DirectX::XMFLOAT2 texelSize;
+    int boxRadius;
+    int padding[3];
+};
 
-void LoadBlurShader() {
-    ComPtr<ID3DBlob> psHorizontalBlob, psVerticalBlob;
+ComPtr<ID3D11Buffer> g_boxBlurSettingsBuffer;
+
+// Half-float ping-pong targets for the box passes, so the intermediate boxes
+// don't round to 8 bits
+ComPtr<ID3D11Texture2D> g_boxTextures[2];
+ComPtr<ID3D11ShaderResourceView> g_boxSRVs[2];
+ComPtr<ID3D11UnorderedAccessView> g_boxUAVs[2];
+
+ComPtr<ID3D11PixelShader> g_pyramidResamplePS;
+
+// Must match cbuffer PyramidSettings in PyramidBlurShader.hlsl
+struct PyramidSettings {
+    DirectX::XMFLOAT2 uvScale;
+    DirectX::XMFLOAT2 uvOffset;
+};
+
+ComPtr<ID3D11Buffer> g_pyramidSettingsBuffer;
+
+// Half-float render targets for the pyramid levels: level k lives in
+// g_pyramidTargets[k - 1], and the entry after the smallest level is scratch
+// for its horizontal pass
+struct PyramidTarget {
+    ComPtr<ID3D11Texture2D> texture;
+    ComPtr<ID3D11RenderTargetView> rtv;
+    ComPtr<ID3D11ShaderResourceView> srv;
+    UINT width = 0;
+    UINT height = 0;
+};
+PyramidTarget g_pyramidTargets[kMaxPyramidLevels + 1];
+
+bool CompileShaderBlob(const wchar_t* fileName, const char* entryPoint, const char* target,
+    const D3D_SHADER_MACRO* defines, ComPtr<ID3DBlob>& blob)
+{
     ComPtr<ID3DBlob> errorBlob;
 
     HRESULT hr = D3DCompileFromFile(
-        L"GaussianBlurShader.hlsl", // Ensure this path is correct
-        nullptr, nullptr, "PSHorizontalBlur", "ps_5_0", 0, 0, &psHorizontalBlob, &errorBlob
+        fileName, // Ensure this path is correct
+        defines, nullptr, entryPoint, target, 0, 0, &blob, &errorBlob
     );
 
     if (FAILED(hr)) {
@@ -505,34 +946,344 @@ void LoadBlurShader() {
             OutputDebugStringA((char*)errorBlob->GetBufferPointer()); // Log shader compilation errors
         }
         wchar_t errorMsg[256];
-        swprintf_s(errorMsg, L"Failed to compile GaussianBlurShader.hlsl. HRESULT: 0x%08X\n", hr);
+        swprintf_s(errorMsg, L"Failed to compile %s (%S). HRESULT: 0x%08X\n", fileName, entryPoint, hr);
         OutputDebugString(errorMsg);
-        return;
+        return false;
     }
+    return true;
+}
 
-    hr = g_pd3dDevice->CreatePixelShader(psHorizontalBlob->GetBufferPointer(), psHorizontalBlob->GetBufferSize(), nullptr, &g_blurHorizontalPS);
-    // Vertical
-    hr = D3DCompileFromFile(
-        L"GaussianBlurShader.hlsl",
-        nullptr, nullptr,
-        "PSVerticalBlur", // entry point
-        "ps_5_0",
-        0, 0,
-        &psVerticalBlob,
-        &errorBlob
-    );
+bool CompileBlurPixelShader(const wchar_t* fileName, const char* entryPoint,
+    const D3D_SHADER_MACRO* defines, ComPtr<ID3D11PixelShader>& shader)
+{
+    ComPtr<ID3DBlob> psBlob;
+    if (!CompileShaderBlob(fileName, entryPoint, "ps_5_0", defines, psBlob)) return false;
+
+    HRESULT hr = g_pd3dDevice->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &shader);
+    return SUCCEEDED(hr);
+}
+
+bool CompileBlurComputeShader(const wchar_t* fileName, const char* entryPoint,
+    const D3D_SHADER_MACRO* defines, ComPtr<ID3D11ComputeShader>& shader)
+{
+    // Compute shaders need feature level 11_0; on 10_x devices the box mode
+    // falls back to the per-texel passes
+    if (g_pd3dDevice->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0) return false;
+
+    ComPtr<ID3DBlob> csBlob;
+    if (!CompileShaderBlob(fileName, entryPoint, "cs_5_0", defines, csBlob)) return false;
+
+    HRESULT hr = g_pd3dDevice->CreateComputeShader(csBlob->GetBufferPointer(), csBlob->GetBufferSize(), nullptr, &shader);
+    return SUCCEEDED(hr);
+}
+
+void LoadBlurShader() {
+    // Size the weight arrays in the shader from GaussianKernel.h
+    std::string maxKernelVectors = std::to_string(kMaxKernelVectors);
+    std::string maxLinearTapVectors = std::to_string(kMaxLinearTapVectors);
+    D3D_SHADER_MACRO blurDefines[] = {
+        { "BLUR_MAX_KERNEL_VECTORS", maxKernelVectors.c_str() },
+        { "BLUR_MAX_LINEAR_TAP_VECTORS", maxLinearTapVectors.c_str() },
+        { nullptr, nullptr }
+    };
+
+    CompileBlurPixelShader(L"GaussianBlurShader.hlsl", "PSHorizontalBlur", blurDefines, g_blurHorizontalPS);
+    CompileBlurPixelShader(L"GaussianBlurShader.hlsl", "PSVerticalBlur", blurDefines, g_blurVerticalPS);
+    CompileBlurPixelShader(L"GaussianBlurShader.hlsl", "PSHorizontalBlurLinear", blurDefines, g_blurHorizontalLinearPS);
+    CompileBlurPixelShader(L"GaussianBlurShader.hlsl", "PSVerticalBlurLinear", blurDefines, g_blurVerticalLinearPS);
+    for (int radius = 0; radius <= kMaxFixedKernelRadius; radius++) {
+        g_blurFixedHorizontalPS[radius].Reset();
+        g_blurFixedVerticalPS[radius].Reset();
+    }
+
+    // Box mode resources belong to the previous device after a GPU switch
+    g_boxHorizontalCS.Reset();
+    g_boxVerticalCS.Reset();
+    g_boxBlurSettingsBuffer.Reset();
+    for (int i = 0; i < 2; i++) {
+        g_boxTextures[i].Reset();
+        g_boxSRVs[i].Reset();
+        g_boxUAVs[i].Reset();
+    }
+    CompileBlurComputeShader(L"BoxBlurShader.hlsl", "CSBoxHorizontal", nullptr, g_boxHorizontalCS);
+    CompileBlurComputeShader(L"BoxBlurShader.hlsl", "CSBoxVertical", nullptr, g_boxVerticalCS);
+
+    g_pyramidSettingsBuffer.Reset();
+    for (PyramidTarget& target : g_pyramidTargets) target = PyramidTarget();
+    CompileBlurPixelShader(L"PyramidBlurShader.hlsl", "PSResample", nullptr, g_pyramidResamplePS);
+}
+
+// The per-texel pass specialized for kernelRadius, or the generic one when
+// the radius is too large or the variant failed to compile.
+ID3D11PixelShader* PerTexelBlurShader(int kernelRadius, bool vertical) {
+    ComPtr<ID3D11PixelShader>& generic = vertical ? g_blurVerticalPS : g_blurHorizontalPS;
+    if (kernelRadius > kMaxFixedKernelRadius) return generic.Get();
+
+    ComPtr<ID3D11PixelShader>& fixed = vertical ? g_blurFixedVerticalPS[kernelRadius]
+                                                : g_blurFixedHorizontalPS[kernelRadius];
+    if (!fixed) {
+        std::string maxKernelVectors = std::to_string(kMaxKernelVectors);
+        std::string maxLinearTapVectors = std::to_string(kMaxLinearTapVectors);
+        std::string fixedRadius = std::to_string(kernelRadius);
+        D3D_SHADER_MACRO defines[] = {
+            { "BLUR_MAX_KERNEL_VECTORS", maxKernelVectors.c_str() },
+            { "BLUR_MAX_LINEAR_TAP_VECTORS", maxLinearTapVectors.c_str() },
+            { "BLUR_FIXED_KERNEL_RADIUS", fixedRadius.c_str() },
+            { nullptr, nullptr }
+        };
+        if (!CompileBlurPixelShader(L"GaussianBlurShader.hlsl", vertical ? "PSVerticalBlur" : "PSHorizontalBlur",
+            defines, fixed))
+        {
+            fixed = generic; // don't retry every frame
+        }
+    }
+    return fixed.Get();
+}
+
+bool CreateBoxBlurTargets(UINT width, UINT height)
+{
+    D3D11_TEXTURE2D_DESC texDesc = {};
+    if (g_boxTextures[0]) {
+        g_boxTextures[0]->GetDesc(&texDesc);
+        if (texDesc.Width == width && texDesc.Height == height) return true;
+    }
+
+    texDesc = {};
+    texDesc.Width = width;
+    texDesc.Height = height;
+    texDesc.MipLevels = 1;
+    texDesc.ArraySize = 1;
+    texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Usage = D3D11_USAGE_DEFAULT;
+    texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+    for (int i = 0; i < 2; i++) {
+        g_boxSRVs[i].Reset();
+        g_boxUAVs[i].Reset();
+        HRESULT hr = g_pd3dDevice->CreateTexture2D(&texDesc, nullptr, &g_boxTextures[i]);
+        if (SUCCEEDED(hr)) hr = g_pd3dDevice->CreateShaderResourceView(g_boxTextures[i].Get(), nullptr, &g_boxSRVs[i]);
+        if (SUCCEEDED(hr)) hr = g_pd3dDevice->CreateUnorderedAccessView(g_boxTextures[i].Get(), nullptr, &g_boxUAVs[i]);
+        if (FAILED(hr)) {
+            OutputDebugString(L"Failed to create box blur targets.\n");
+            g_boxTextures[0].Reset();
+            return false;
+        }
+    }
+
+    if (!g_boxBlurSettingsBuffer) {
+        D3D11_BUFFER_DESC cbDesc = {};
+        cbDesc.ByteWidth = sizeof(BoxBlurSettings);
+        cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+        cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(g_pd3dDevice->CreateBuffer(&cbDesc, nullptr, &g_boxBlurSettingsBuffer))) return false;
+    }
+    return true;
+}
+
+// Box cascade version of ApplyGaussianBlur: each box of BuildBoxCascade is one
+// compute dispatch (rows first, then columns), and the final result is drawn
+// into outputRTV with the fullscreen pass.
+bool ApplyBoxCascadeBlur(
+    ID3D11ShaderResourceView* inputSRV,
+    ID3D11RenderTargetView* outputRTV,
+    float blurRadius)
+{
+    if (!g_boxHorizontalCS || !g_boxVerticalCS) return false;
+
+    D3D11_TEXTURE2D_DESC texDesc;
+    g_tempTexture->GetDesc(&texDesc);
+    if (!CreateBoxBlurTargets(texDesc.Width, texDesc.Height)) return false;
+
+    BoxCascade cascade = BuildBoxCascade(SigmaFromBlurRadius(blurRadius));
+
+    ID3D11ShaderResourceView* source = inputSRV;
+    int target = 0;
+    for (int direction = 0; direction < 2; direction++) {
+        bool horizontal = direction == 0;
+        for (int radius : cascade.radii) {
+            if (radius == 0) continue;
+
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            g_pd3dDeviceContext->Map(g_boxBlurSettingsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+            BoxBlurSettings* settings = reinterpret_cast<BoxBlurSettings*>(mapped.pData);
+            settings->size[0] = texDesc.Width;
+            settings->size[1] = texDesc.Height;
+            settings->texelSize = DirectX::XMFLOAT2(1.0f / texDesc.Width, 1.0f / texDesc.Height);
+            settings->boxRadius = radius;
+            g_pd3dDeviceContext->Unmap(g_boxBlurSettingsBuffer.Get(), 0);
+
+            g_pd3dDeviceContext->CSSetShader(horizontal ? g_boxHorizontalCS.Get() : g_boxVerticalCS.Get(), nullptr, 0);
+            g_pd3dDeviceContext->CSSetConstantBuffers(0, 1, g_boxBlurSettingsBuffer.GetAddressOf());
+            g_pd3dDeviceContext->CSSetSamplers(0, 1, g_linearClampSampler.GetAddressOf());
+            g_pd3dDeviceContext->CSSetShaderResources(0, 1, &source);
+            g_pd3dDeviceContext->CSSetUnorderedAccessViews(0, 1, g_boxUAVs[target].GetAddressOf(), nullptr);
+
+            UINT lines = horizontal ? texDesc.Height : texDesc.Width;
+            g_pd3dDeviceContext->Dispatch((lines + 63) / 64, 1, 1);
+
+            // Unbind so the result can be read as an SRV by the next pass
+            ID3D11ShaderResourceView* nullSRV = nullptr;
+            ID3D11UnorderedAccessView* nullUAV = nullptr;
+            g_pd3dDeviceContext->CSSetShaderResources(0, 1, &nullSRV);
+            g_pd3dDeviceContext->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+
+            source = g_boxSRVs[target].Get();
+            target ^= 1;
+        }
+    }
+
+    // Copy (or, with no box wider than one texel, rescale) into the output
+    D3D11_VIEWPORT vp = {};
+    vp.Width = (float)texDesc.Width;
+    vp.Height = (float)texDesc.Height;
+    vp.MaxDepth = 1.0f;
+    g_pd3dDeviceContext->OMSetRenderTargets(1, &outputRTV, nullptr);
+    g_pd3dDeviceContext->RSSetViewports(1, &vp);
+    DrawFullScreenQuad(source);
+    return true;
+}
+
+bool CreatePyramidTarget(PyramidTarget& target, UINT width, UINT height)
+{
+    if (target.texture && target.width == width && target.height == height) return true;
+    target = PyramidTarget();
+
+    D3D11_TEXTURE2D_DESC texDesc = {};
+    texDesc.Width = width;
+    texDesc.Height = height;
+    texDesc.MipLevels = 1;
+    texDesc.ArraySize = 1;
+    texDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Usage = D3D11_USAGE_DEFAULT;
+    texDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    HRESULT hr = g_pd3dDevice->CreateTexture2D(&texDesc, nullptr, &target.texture);
+    if (SUCCEEDED(hr)) hr = g_pd3dDevice->CreateRenderTargetView(target.texture.Get(), nullptr, &target.rtv);
+    if (SUCCEEDED(hr)) hr = g_pd3dDevice->CreateShaderResourceView(target.texture.Get(), nullptr, &target.srv);
     if (FAILED(hr)) {
-        // handle error
+        OutputDebugString(L"Failed to create pyramid blur targets.\n");
+        target = PyramidTarget();
+        return false;
     }
+    target.width = width;
+    target.height = height;
+    return true;
+}
 
-    hr = g_pd3dDevice->CreatePixelShader(
-        psVerticalBlob->GetBufferPointer(),
-        psVerticalBlob->GetBufferSize(),
-        nullptr,
-        &g_blurVerticalPS
-    );
+// One fullscreen-triangle draw of ps from input into a width x height output.
+// Constant buffers are the caller's; both views are unbound afterwards so the
+// output can be read by the next pass.
+void DrawFullScreenPass(ID3D11PixelShader* ps, ID3D11ShaderResourceView* inputSRV,
+    ID3D11RenderTargetView* outputRTV, UINT width, UINT height)
+{
+    D3D11_VIEWPORT vp = {};
+    vp.Width = (float)width;
+    vp.Height = (float)height;
+    vp.MaxDepth = 1.0f;
+    g_pd3dDeviceContext->OMSetRenderTargets(1, &outputRTV, nullptr);
+    g_pd3dDeviceContext->RSSetViewports(1, &vp);
+
+    UINT stride = sizeof(FullscreenVertex);
+    UINT offset = 0;
+    ID3D11Buffer* vb = g_fullscreenVB.Get();
+    g_pd3dDeviceContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+    g_pd3dDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    g_pd3dDeviceContext->IASetInputLayout(g_inputLayout.Get());
+    g_pd3dDeviceContext->VSSetShader(g_fullscreenVS.Get(), nullptr, 0);
+    g_pd3dDeviceContext->PSSetShader(ps, nullptr, 0);
+    g_pd3dDeviceContext->PSSetSamplers(0, 1, g_linearClampSampler.GetAddressOf());
+    g_pd3dDeviceContext->PSSetShaderResources(0, 1, &inputSRV);
+
+    g_pd3dDeviceContext->Draw(3, 0);
+
+    ID3D11ShaderResourceView* nullSRV = nullptr;
+    g_pd3dDeviceContext->PSSetShaderResources(0, 1, &nullSRV);
+    g_pd3dDeviceContext->OMSetRenderTargets(0, nullptr, nullptr);
 }
 
+// Bilinear resample of a srcWidth x srcHeight input into dstWidth x dstHeight.
+// Destination texel i reads source texel coordinate (i + 0.5) * scale - 0.5 + offset.
+void DrawPyramidResample(ID3D11ShaderResourceView* inputSRV, UINT srcWidth, UINT srcHeight,
+    ID3D11RenderTargetView* outputRTV, UINT dstWidth, UINT dstHeight, float scale, float offset)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    g_pd3dDeviceContext->Map(g_pyramidSettingsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    PyramidSettings* settings = reinterpret_cast<PyramidSettings*>(mapped.pData);
+    settings->uvScale = DirectX::XMFLOAT2(dstWidth * scale / srcWidth, dstHeight * scale / srcHeight);
+    settings->uvOffset = DirectX::XMFLOAT2(offset / srcWidth, offset / srcHeight);
+    g_pd3dDeviceContext->Unmap(g_pyramidSettingsBuffer.Get(), 0);
+
+    g_pd3dDeviceContext->PSSetConstantBuffers(0, 1, g_pyramidSettingsBuffer.GetAddressOf());
+    DrawFullScreenPass(g_pyramidResamplePS.Get(), inputSRV, outputRTV, dstWidth, dstHeight);
+}
+
+// Pyramid version of ApplyGaussianBlur (see BlurPyramid): halve down to the
+// smallest level, blur it with the bilinear tap-merged passes, and upsample
+// back into outputRTV. Returns false when the radius is too small for a
+// pyramid, so the caller blurs at full resolution instead.
+bool ApplyPyramidBlur(
+    ID3D11ShaderResourceView* inputSRV,
+    ID3D11RenderTargetView* outputRTV,
+    float blurRadius)
+{
+    if (!g_pyramidResamplePS) return false;
+
+    BlurPyramid pyramid = BuildBlurPyramid(SigmaFromBlurRadius(blurRadius));
+    if (pyramid.levels == 0) return false;
+
+    // Level 0 is the input at the size of the blur targets, like the other modes
+    D3D11_TEXTURE2D_DESC texDesc;
+    g_tempTexture->GetDesc(&texDesc);
+    int levels = pyramid.levels;
+    for (int k = 1; k <= levels; k++) {
+        UINT width = PyramidLevelExtent(pyramid, texDesc.Width, k);
+        UINT height = PyramidLevelExtent(pyramid, texDesc.Height, k);
+        if (!CreatePyramidTarget(g_pyramidTargets[k - 1], width, height)) return false;
+    }
+    PyramidTarget& smallest = g_pyramidTargets[levels - 1];
+    PyramidTarget& scratch = g_pyramidTargets[levels];
+    if (!CreatePyramidTarget(scratch, smallest.width, smallest.height)) return false;
+
+    if (!g_pyramidSettingsBuffer) {
+        D3D11_BUFFER_DESC cbDesc = {};
+        cbDesc.ByteWidth = sizeof(PyramidSettings);
+        cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+        cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (FAILED(g_pd3dDevice->CreateBuffer(&cbDesc, nullptr, &g_pyramidSettingsBuffer))) return false;
+    }
+
+    // Down. The first step reads the input shifted by the margin, and the
+    // clamp sampler fills the margin with edge texels.
+    float padding = (float)PyramidPadding(pyramid);
+    DrawPyramidResample(inputSRV, texDesc.Width, texDesc.Height,
+        g_pyramidTargets[0].rtv.Get(), g_pyramidTargets[0].width, g_pyramidTargets[0].height, 2.0f, -padding);
+    for (int k = 1; k < levels; k++) {
+        const PyramidTarget& src = g_pyramidTargets[k - 1];
+        const PyramidTarget& dst = g_pyramidTargets[k];
+        DrawPyramidResample(src.srv.Get(), src.width, src.height, dst.rtv.Get(), dst.width, dst.height, 2.0f, 0.0f);
+    }
+
+    // Blur the smallest level
+    UpdateBlurSettingsForSigma(pyramid.levelSigma, smallest.width, smallest.height);
+    g_pd3dDeviceContext->PSSetConstantBuffers(0, 1, g_blurSettingsBuffer.GetAddressOf());
+    DrawFullScreenPass(g_blurHorizontalLinearPS.Get(), smallest.srv.Get(), scratch.rtv.Get(), smallest.width, smallest.height);
+    DrawFullScreenPass(g_blurVerticalLinearPS.Get(), scratch.srv.Get(), smallest.rtv.Get(), smallest.width, smallest.height);
+
+    // Up, each level overwritten by the one below it, and finally out of the margin
+    for (int k = levels - 1; k > 0; k--) {
+        const PyramidTarget& src = g_pyramidTargets[k];
+        const PyramidTarget& dst = g_pyramidTargets[k - 1];
+        DrawPyramidResample(src.srv.Get(), src.width, src.height, dst.rtv.Get(), dst.width, dst.height, 0.5f, 0.0f);
+    }
+    const PyramidTarget& first = g_pyramidTargets[0];
+    DrawPyramidResample(first.srv.Get(), first.width, first.height,
+        outputRTV, texDesc.Width, texDesc.Height, 0.5f, padding * 0.5f);
+    return true;
+}
 
 
 void ApplyGaussianBlur(
@@ -540,6 +1291,16 @@ void ApplyGaussianBlur(
     ID3D11RenderTargetView* outputRTV,
     float blurRadius)
 {
+    TRACE_SCOPE("ApplyGaussianBlur");
+    if (g_blurMode == BlurMode_BoxCascade) {
+        ScopedGpuTrace gpuTrace("box cascade blur");
+        if (ApplyBoxCascadeBlur(inputSRV, outputRTV, blurRadius)) return;
+    }
+    if (g_blurMode == BlurMode_Pyramid) {
+        ScopedGpuTrace gpuTrace("pyramid blur");
+        if (ApplyPyramidBlur(inputSRV, outputRTV, blurRadius)) return;
+    }
+
     // 1) HORIZONTAL PASS --> g_tempRTV
     // Clear the temp RT
     float clearColor[4] = { 0, 0, 0, 1 };
@@ -553,8 +1314,11 @@ void ApplyGaussianBlur(
     g_tempTexture->GetDesc(&texDesc); // or the input texture desc
     UpdateBlurSettings(blurRadius, texDesc.Width, texDesc.Height);
 
+    bool linearSampled = g_blurMode == BlurMode_LinearSampled || g_blurMode == BlurMode_Pyramid;
+    int kernelRadius = GetGaussianKernel(SigmaFromBlurRadius(blurRadius))->radius;
+
     // Bind horizontal blur PS
-    g_pd3dDeviceContext->PSSetShader(g_blurHorizontalPS.Get(), nullptr, 0);
+    g_pd3dDeviceContext->PSSetShader(linearSampled ? g_blurHorizontalLinearPS.Get() : PerTexelBlurShader(kernelRadius, false), nullptr, 0);
 
     // Samplers, constants, SRV
     g_pd3dDeviceContext->PSSetSamplers(0, 1, g_linearClampSampler.GetAddressOf());
@@ -582,7 +1346,10 @@ void ApplyGaussianBlur(
     g_pd3dDeviceContext->RSSetViewports(1, &vp);
 
     // Draw
-    g_pd3dDeviceContext->Draw(3, 0);
+    {
+        ScopedGpuTrace gpuTrace("blur horizontal pass");
+        g_pd3dDeviceContext->Draw(3, 0);
+    }
 
     // 2) VERTICAL PASS --> outputRTV
     g_pd3dDeviceContext->ClearRenderTargetView(outputRTV, clearColor);
@@ -592,7 +1359,7 @@ void ApplyGaussianBlur(
     UpdateBlurSettings(blurRadius, texDesc.Width, texDesc.Height);
 
     // Bind vertical blur PS
-    g_pd3dDeviceContext->PSSetShader(g_blurVerticalPS.Get(), nullptr, 0);
+    g_pd3dDeviceContext->PSSetShader(linearSampled ? g_blurVerticalLinearPS.Get() : PerTexelBlurShader(kernelRadius, true), nullptr, 0);
     // Samplers, constants
     g_pd3dDeviceContext->PSSetSamplers(0, 1, g_linearClampSampler.GetAddressOf());
     g_pd3dDeviceContext->PSSetConstantBuffers(0, 1, g_blurSettingsBuffer.GetAddressOf());
@@ -609,7 +1376,10 @@ void ApplyGaussianBlur(
     g_pd3dDeviceContext->RSSetViewports(1, &vp);
 
     // Final draw
-    g_pd3dDeviceContext->Draw(3, 0);
+    {
+        ScopedGpuTrace gpuTrace("blur vertical pass");
+        g_pd3dDeviceContext->Draw(3, 0);
+    }
 
     // Done! outputRTV now has the horizontally + vertically blurred image
 }
@@ -645,6 +1415,95 @@ void DrawFullScreenQuad(ID3D11ShaderResourceView* inputSRV)
 }
 
 
+// Copies a CPU blur result into g_cpuBlurTexture, recreating it when the size changes
+void UploadCpuBlurResult(const CpuImage& image)
+{
+    TRACE_SCOPE("upload CPU result");
+    D3D11_TEXTURE2D_DESC texDesc = {};
+    if (g_cpuBlurTexture) g_cpuBlurTexture->GetDesc(&texDesc);
+
+    if (g_cpuBlurTexture && texDesc.Width == image.width && texDesc.Height == image.height) {
+        g_pd3dDeviceContext->UpdateSubresource(g_cpuBlurTexture.Get(), 0, nullptr,
+            image.pixels.data(), (UINT)image.RowPitch(), 0);
+        return;
+    }
+
+    g_cpuBlurSRV.Reset();
+    g_cpuBlurTexture.Reset();
+
+    texDesc = {};
+    texDesc.Width = image.width;
+    texDesc.Height = image.height;
+    texDesc.MipLevels = 1;
+    texDesc.ArraySize = 1;
+    texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Usage = D3D11_USAGE_DEFAULT;
+    texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = image.pixels.data();
+    initData.SysMemPitch = (UINT)image.RowPitch();
+
+    HRESULT hr = g_pd3dDevice->CreateTexture2D(&texDesc, &initData, &g_cpuBlurTexture);
+    if (FAILED(hr)) {
+        OutputDebugString(L"Failed to create CPU blur texture.\n");
+        return;
+    }
+
+    hr = g_pd3dDevice->CreateShaderResourceView(g_cpuBlurTexture.Get(), nullptr, &g_cpuBlurSRV);
+    if (FAILED(hr)) {
+        OutputDebugString(L"Failed to create CPU blur SRV.\n");
+    }
+}
+
+
+// Trace events kept for export, oldest dropped past the cap, and the per-stage
+// numbers shown in the settings window
+constexpr size_t kMaxCapturedTraceEvents = 200000;
+std::vector<TraceEvent> g_traceEvents;
+TraceStats g_traceStats;
+
+// Called once per frame: gathers the finished GPU spans and everything the
+// CPU threads recorded since the last frame
+void CollectFrameTrace() {
+    GpuTimerCollect();
+    size_t first = g_traceEvents.size();
+    size_t added = TraceCollect(g_traceEvents);
+    g_traceStats.Add(g_traceEvents.data() + first, added);
+    if (g_traceEvents.size() > kMaxCapturedTraceEvents) {
+        g_traceEvents.erase(g_traceEvents.begin(), g_traceEvents.begin() + g_traceEvents.size() / 2);
+    }
+}
+
+void ShowTracePanel() {
+    if (!ImGui::CollapsingHeader("Performance")) return;
+
+    bool tracing = TracingEnabled();
+    if (ImGui::Checkbox("Trace stages", &tracing)) SetTracingEnabled(tracing);
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+        g_traceStats.Reset();
+        g_traceEvents.clear();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export Chrome trace")) {
+        if (!WriteChromeTrace("RTBlurTrace.json", g_traceEvents)) {
+            OutputDebugString(L"Failed to write RTBlurTrace.json.\n");
+        }
+    }
+
+    // ms per occurrence; stages split across threads are summed
+    ImGui::Text("%-26s %8s %8s %8s", "stage", "last", "avg", "max");
+    for (const TraceStats::Entry& entry : g_traceStats.Entries()) {
+        ImGui::Text("%-22s %-3s %8.3f %8.3f %8.3f", entry.name, entry.category, entry.lastMs, entry.averageMs,
+            entry.maxMs);
+    }
+    if (TraceDroppedEvents() > 0) {
+        ImGui::Text("Dropped events: %llu", (unsigned long long)TraceDroppedEvents());
+    }
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, WndProc, 0L, 0L,
         GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
@@ -656,7 +1515,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
     EnumAllAdapters();
     selectedAdapterIndex = 0;
-    InitD3D(hwnd);
+    if (!InitD3D(hwnd)) {
+        MessageBox(hwnd, L"Could not create a Direct3D 11 device.", L"RTBlur", MB_ICONERROR);
+        DestroyWindow(hwnd);
+        UnregisterClass(wc.lpszClassName, wc.hInstance);
+        return 1;
+    }
 	CreateBlurRenderTarget(1280, 720);
 	CreateTempRenderTarget(1280, 720);
     ImGui::CreateContext();
@@ -667,6 +1531,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
     ShowWindow(hwnd, SW_SHOWDEFAULT);
     UpdateWindow(hwnd);
 
+    TraceSetThreadName("main");
+    SetTracingEnabled(true);
+
    
 
 
@@ -679,12 +1546,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             continue;
         }
 
+        CollectFrameTrace();
+        GpuTimerBeginFrame();
+        ScopedTrace frameTrace("frame");
+
         static float oldBlurRadius = 0.0f;     // track last blur slider value
+        static int oldBlurMode = g_blurMode;
+        static bool oldLinearLight = g_linearLight;
+        static float oldAutoTolerance = g_autoTolerance;
         static bool needsUpdate = false;       // do we need to re-blur?
 
-        // check if slider changed
-        if (fabsf(g_blurRadius - oldBlurRadius) > 0.0001f) {
+        // check if slider or mode changed
+        if (fabsf(g_blurRadius - oldBlurRadius) > 0.0001f || g_blurMode != oldBlurMode ||
+            g_linearLight != oldLinearLight || g_autoTolerance != oldAutoTolerance)
+        {
+            if (g_linearLight != oldLinearLight && g_tempTexture) {
+                D3D11_TEXTURE2D_DESC tempDesc;
+                g_tempTexture->GetDesc(&tempDesc);
+                CreateTempRenderTarget(tempDesc.Width, tempDesc.Height);
+            }
             oldBlurRadius = g_blurRadius;
+            oldBlurMode = g_blurMode;
+            oldLinearLight = g_linearLight;
+            oldAutoTolerance = g_autoTolerance;
             needsUpdate = true;
         }
         
@@ -696,31 +1580,46 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         ShowAdapterPicker();
         ImGui::End();
 
-        static ID3D11ShaderResourceView* g_loadedImageSRV = nullptr;
-
-        if (ImGui::Button("Open Image")) {
-            // load image
-            needsUpdate = true; // new image => re-blur
-
-            std::wstring filePath = OpenFileDialog();
-            if (!filePath.empty()) {
-                if (g_loadedImageSRV) g_loadedImageSRV->Release(); // Free old texture
-                g_loadedImageSRV = LoadTextureFromFile(filePath.c_str());
-                if (!g_loadedImageSRV) {
-                    OutputDebugString(L"Failed to load image. Check the file path and format.\n");
-                }
-                else {
-                    // Retrieve the dimensions of the loaded texture
-                    ComPtr<ID3D11Resource> resource;
-                    g_loadedImageSRV->GetResource(&resource);
-
-                    ComPtr<ID3D11Texture2D> texture;
-                    resource.As(&texture);
+        // The file dialog runs on a thread of its own and the file decodes on
+        // the loader's, so the window keeps drawing (the previous image, then
+        // the file's thumbnail when it has one) until the new image is ready.
+        static std::future<std::wstring> openDialog;
+        if (ImGui::Button("Open Image") && !openDialog.valid()) {
+            openDialog = std::async(std::launch::async, [] {
+                ScopedComInit com(COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+                return OpenFileDialog();
+            });
+        }
+        if (openDialog.valid() && openDialog.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            std::wstring filePath = openDialog.get();
+            if (!filePath.empty()) g_imageLoader.Load(filePath);
+        }
+        if (g_imageLoader.Busy()) {
+            ImGui::SameLine();
+            ImGui::Text(g_loadedImageScale < 1.0f ? "Loading full image..." : "Loading...");
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel")) g_imageLoader.CancelAll();
+        }
 
-                    D3D11_TEXTURE2D_DESC texDesc;
-                    texture->GetDesc(&texDesc);
-                }
+        ImageLoadResult loaded;
+        while (g_imageLoader.Poll(loaded)) {
+            if (loaded.status == ImageLoadStatus::Failed) {
+                OutputDebugStringA(("Failed to load " + loaded.path.string() + ": " + loaded.error + "\n").c_str());
+                continue;
             }
+            ID3D11ShaderResourceView* srv = CreateImageTexture(loaded.image);
+            if (!srv) {
+                OutputDebugString(L"Failed to create a texture for the loaded image.\n");
+                continue;
+            }
+            if (g_loadedImageSRV) g_loadedImageSRV->Release(); // Free old texture
+            g_loadedImageSRV = srv;
+            g_loadedImageSrgbSRV = CreateSrgbView(srv);
+            g_loadedImageScale = (float)loaded.image.width / (float)loaded.fullWidth;
+            g_loadedImage = std::move(loaded.image);
+            g_loadedImageHash = loaded.contentHash;
+            g_previewSource = CpuImage();
+            needsUpdate = true; // new image => re-blur
         }
 
         if (g_loadedImageSRV) {
@@ -756,30 +1655,167 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
             }
             float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // Black
 
+            // The slider was let go: replace the preview with the full blur
+            if (g_showingPreview && !g_blurSliderActive) needsUpdate = true;
+
             if (needsUpdate && g_loadedImageSRV) {
-                g_pd3dDeviceContext->ClearRenderTargetView(g_blurRenderTargetView.Get(), clearColor);
+                ScopedGpuTrace gpuTrace("blur");
+                if (BlurRunsOnCpu()) {
+                    // A proxy has fewer pixels than the full image, so the
+                    // radius shrinks with it. The GPU passes work in
+                    // g_tempTexture's fixed-size pixels and need no scaling.
+                    float blurRadius = g_blurRadius * g_loadedImageScale;
+                    CpuBlurEngine engine = CpuEngineForBlurMode(g_blurMode);
+                    ThreadPool& pool = GetDefaultThreadPool();
+                    PreviewSize previewSize = ChoosePreviewSize(g_loadedImage.width, g_loadedImage.height,
+                        availableSize.x, availableSize.y);
+                    bool preview = g_previewWhileDragging && g_blurSliderActive && previewSize.scale < 1.0f;
+                    if (preview) {
+                        TRACE_SCOPE("preview blur");
+                        if (g_previewSource.Empty() || previewSize.width != g_previewSize.width ||
+                            previewSize.height != g_previewSize.height)
+                        {
+                            g_previewSize = previewSize;
+                            CpuDownsampleArea(g_loadedImage, g_previewSource, previewSize.width, previewSize.height, pool);
+                            g_previewSourceHash = HashCpuImage(g_previewSource);
+                        }
+                        float previewRadius = PreviewBlurRadius(blurRadius, g_previewSize);
+                        g_cpuBlurResult = g_blurMode == BlurMode_Auto
+                            ? CpuBlurImageAutoCached(g_previewSource, g_previewSourceHash, previewRadius, pool)
+                            : CpuBlurImageCached(g_blurCache, g_previewSource, g_previewSourceHash, previewRadius,
+                                engine, pool);
+                    }
+                    else {
+                        g_cpuBlurResult = g_blurMode == BlurMode_Auto
+                            ? CpuBlurImageAutoCached(g_loadedImage, g_loadedImageHash, blurRadius, pool)
+                            : CpuBlurImageCached(g_blurCache, g_loadedImage, g_loadedImageHash, blurRadius, engine,
+                                pool);
+                    }
+                    g_showingPreview = preview;
+                    UploadCpuBlurResult(*g_cpuBlurResult);
+                }
+                else {
+                    bool linear = g_linearLight && g_loadedImageSrgbSRV && g_blurRenderTargetSrgbView;
+                    ID3D11RenderTargetView* target = linear ? g_blurRenderTargetSrgbView.Get() : g_blurRenderTargetView.Get();
+                    g_pd3dDeviceContext->ClearRenderTargetView(target, clearColor);
 
-                ApplyGaussianBlur(g_loadedImageSRV, g_blurRenderTargetView.Get(), g_blurRadius);
+                    ApplyGaussianBlur(linear ? g_loadedImageSrgbSRV.Get() : g_loadedImageSRV, target, g_blurRadius);
+                }
                 needsUpdate = false;
             }
 
             ImVec2 avail = ImGui::GetContentRegionAvail();
             // Display the image with correct UV mapping and resolution
-            ImGui::Image(reinterpret_cast<ImTextureID>(g_blurShaderResourceView.Get()), availableSize, ImVec2(0, 0), ImVec2(1, 1));
+            ID3D11ShaderResourceView* blurredSRV = BlurRunsOnCpu() ? g_cpuBlurSRV.Get() : g_blurShaderResourceView.Get();
+            ImGui::Image(reinterpret_cast<ImTextureID>(blurredSRV), availableSize, ImVec2(0, 0), ImVec2(1, 1));
         }
         // GUI
         ImGui::Begin("Gaussian Blur Settings");
         ImGui::SliderFloat("Blur Radius", &g_blurRadius, 0.001f, 120.0f);
+        g_blurSliderActive = ImGui::IsItemActive();
+        ImGui::Combo("Blur Mode", &g_blurMode, g_blurModeNames, BlurMode_Count);
+        ImGui::Checkbox("Linear light", &g_linearLight);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip(BlurRunsOnCpu()
+                ? "Blur in linear light rather than on sRGB values (CPU: per-texel and bilinear modes)"
+                : "Blur in linear light rather than on sRGB values");
+        }
+        if (g_blurMode == BlurMode_BoxCascade) {
+            // Error of the approximation against the exact kernel, recomputed when the radius moves
+            static float reportedRadius = -1.0f;
+            static BoxCascade cascade;
+            static KernelError cascadeError;
+            if (reportedRadius != g_blurRadius) {
+                reportedRadius = g_blurRadius;
+                cascade = BuildBoxCascade(SigmaFromBlurRadius(g_blurRadius));
+                cascadeError = MeasureKernelError(BoxCascadeWeights(cascade), cascade.sigma);
+            }
+            ImGui::Text("Boxes: %d / %d / %d, sigma %.2f (target %.2f)", 2 * cascade.radii[0] + 1,
+                2 * cascade.radii[1] + 1, 2 * cascade.radii[2] + 1, cascade.achievedSigma, cascade.sigma);
+            ImGui::Text("Kernel error: max %.5f, L1 %.4f", cascadeError.maxAbs, cascadeError.l1);
+        }
+        if (g_blurMode == BlurMode_Pyramid) {
+            BlurPyramid pyramid = BuildBlurPyramid(SigmaFromBlurRadius(g_blurRadius));
+            if (pyramid.levels > 0) {
+                ImGui::Text("Levels: %d, sigma %.2f at 1/%d resolution", pyramid.levels, pyramid.levelSigma,
+                    1 << pyramid.levels);
+            }
+            else {
+                ImGui::Text("Small radius: blurring at full resolution");
+            }
+        }
+        if (g_blurMode == BlurMode_Recursive) {
+            static float reportedRadius = -1.0f;
+            static KernelError recursiveError;
+            double sigma = SigmaFromBlurRadius(g_blurRadius);
+            if (reportedRadius != g_blurRadius) {
+                reportedRadius = g_blurRadius;
+                if (sigma >= kMinRecursiveSigma) {
+                    recursiveError = MeasureKernelError(
+                        RecursiveGaussianWeights(BuildRecursiveGaussian(sigma), (int)ceil(4.0 * sigma)), sigma);
+                }
+            }
+            if (sigma >= kMinRecursiveSigma) {
+                ImGui::Text("Kernel error: max %.5f, L1 %.4f", recursiveError.maxAbs, recursiveError.l1);
+            }
+            else {
+                ImGui::Text("Small radius: using the direct kernel");
+            }
+        }
+        if (g_blurMode == BlurMode_Auto) {
+            ImGui::SliderFloat("Tolerance (8-bit steps)", &g_autoTolerance, 0.5f, 8.0f);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Largest error against the exact Gaussian the picked engine may have; "
+                    "the direct engine stays near 1");
+            }
+            if (g_engineProfile.Calibrated()) {
+                ImGui::Text("Picked %s: predicted %.2f ms, took %.2f ms%s", CpuBlurEngineName(g_autoChoice.engine),
+                    g_autoChoice.predictedMs, g_autoChoice.actualMs, g_autoChoiceCached ? " (cached)" : "");
+                ImGui::Text("Expected error %.2f steps; profile for %s, %u threads", g_autoChoice.expectedError,
+                    g_engineProfile.isa.c_str(), g_engineProfile.threads);
+            }
+            if (ImGui::Button("Recalibrate")) {
+                EnsureEngineProfile(true);
+                needsUpdate = true;
+            }
+        }
+        if (BlurRunsOnCpu()) {
+            ImGui::Checkbox("Preview at display size while dragging", &g_previewWhileDragging);
+            if (g_showingPreview) {
+                ImGui::Text("Preview: %ux%u, radius %.2f", g_previewSize.width, g_previewSize.height,
+                    PreviewBlurRadius(g_blurRadius * g_loadedImageScale, g_previewSize));
+            }
+            if (ImGui::SliderInt("Result cache (MB)", &g_blurCacheBudgetMB, 0, 4096)) {
+                g_blurCache.SetBudget((size_t)g_blurCacheBudgetMB << 20);
+            }
+            BlurResultCache::Stats cacheStats = g_blurCache.GetStats();
+            ImGui::Text("Cache: %zu results, %.1f MB, %llu hits, %llu misses, %llu evictions", cacheStats.entries,
+                cacheStats.bytes / 1048576.0, (unsigned long long)cacheStats.hits,
+                (unsigned long long)cacheStats.misses, (unsigned long long)cacheStats.evictions);
+        }
+        if (g_cpuBlurFallback) {
+            ImGui::Text("No usable GPU, blurring on the CPU (%s, %u threads)",
+                CpuIsaName(GetCpuBlurIsa()), GetDefaultThreadPool().ThreadCount());
+        }
+        ShowTracePanel();
         ImGui::Text("Placeholder for image display");
         ImGui::End();
 
-        ImGui::Render();
-        g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
-        float clear_color[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
-        g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color);
-        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+        {
+            TRACE_SCOPE("ImGui render");
+            ScopedGpuTrace gpuTrace("ImGui draw");
+            ImGui::Render();
+            g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
+            float clear_color[4] = { 0.2f, 0.2f, 0.2f, 1.0f };
+            g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color);
+            ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+        }
 
-        g_pSwapChain->Present(1, 0);
+        {
+            TRACE_SCOPE("Present");
+            g_pSwapChain->Present(1, 0);
+        }
+        GpuTimerEndFrame();
     }
 
     ImGui_ImplDX11_Shutdown();
@@ -0,0 +1,1006 @@
+// RTBlurBatch.cpp : headless batch blur for directories and file lists.
+//
+// Runs as a three-stage pipeline: decoder threads read and decode files,
+// blur jobs run the CPU engine on the shared thread pool, and encoder threads
+// write the results. Bounded queues connect the stages, so a stage that runs
+// ahead blocks instead of piling up decoded images in memory, and all three
+// kinds of work overlap. Reads and writes Netpbm (see CpuImageIO.h).
+//
+// With --stream each image is instead blurred a strip of rows at a time
+// straight from a memory-mapped file to the output (see CpuStreamBlur.h), so
+// images far larger than memory go through in O(radius * width) space. That
+// also accepts raw RGBA8 and uncompressed strip TIFF input.
+//
+// With --video a single frame sequence (Y4M or raw RGBA8 frames, from a file
+// or stdin, or a synthetic test pattern) is blurred frame by frame to a file
+// or stdout. Reading, blurring and writing run on their own threads over a
+// fixed set of frame buffers, so with three buffers frame N + 1 is read while
+// N is blurred and N - 1 is written. Reports sustained fps and the latency of
+// each frame from the start of its read to the end of its write.
+//
+// With --shard each image is cut into tiles that worker processes blur
+// (CpuTileShard.h): copies of this executable started with --worker, locally
+// or by hand on the same machine, output identical to blurring in one process.
+//
+// With --serve it stays up as a blur server on a local socket
+// (CpuBlurServer.h), blurring images that clients place in shared memory.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlurResultCache.h"
+#include "BoundedQueue.h"
+#include "CpuBlurEngine.h"
+#include "CpuBlurServer.h"
+#include "CpuEngineProfile.h"
+#include "CpuFrameIO.h"
+#include "CpuImageIO.h"
+#include "CpuRowIO.h"
+#include "CpuSocket.h"
+#include "CpuStreamBlur.h"
+#include "CpuTileShard.h"
+#include "GaussianKernel.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct BatchOptions {
+    std::vector<std::string> inputs; // files, directories, or @list files
+    std::string outputDir;
+    float blurRadius = 10.0f;
+    CpuBlurEngine engine = CpuBlurEngine::Direct;
+    unsigned threads = 0; // blur pool size, 0 = hardware threads
+    unsigned decoders = 2;
+    unsigned encoders = 2;
+    unsigned blurJobs = 1; // images blurred at the same time
+    unsigned queueDepth = 4;
+    unsigned blurBatch = 16; // decoded images blurred in one CpuBlurImages call
+    bool recursive = false;
+    bool stream = false;   // strip-streamed direct blur, one image at a time
+    uint32_t rawWidth = 0; // size of .raw inputs
+    uint32_t rawHeight = 0;
+    std::string tracePath; // Chrome trace of the run
+    unsigned cacheMB = 0;  // result cache budget, 0 = off
+    bool video = false;    // one frame sequence, read, blurred and written frame by frame
+    unsigned buffers = 3;  // --video frames in flight
+    uint32_t syntheticWidth = 0; // --video test pattern instead of an input
+    uint32_t syntheticHeight = 0;
+    uint64_t syntheticFrames = 300;
+    std::string radiusMapPath; // per-pixel radius scale, CpuVariableBlur
+    bool shard = false;        // tiles blurred by worker processes
+    ShardOptions shardOptions;
+    std::string workerAddress; // --worker: be a worker for this coordinator
+    int failAfter = -1;        // worker quits unanswered after this many tiles (testing)
+    std::string servePath;     // --serve: be a blur server on this socket
+    bool autoEngine = false;   // --engine auto: pick per image from the engine profile
+    double tolerance = 1.5;    // error the auto pick may have, 8-bit steps
+    std::string profilePath;   // empty: DefaultCpuEngineProfilePath
+    CpuEngineProfile engineProfile; // loaded or calibrated in main
+};
+
+void PrintUsage() {
+    printf("Usage: RTBlurBatch --out DIR [--radius R | --sigma S] [--engine ENGINE]\n"
+           "                   [--threads N] [--decoders N] [--encoders N] [--blur-jobs N] [--queue N] [--blur-batch N]\n"
+           "                   [--recursive] [--stream [--raw-size WxH]] [--trace FILE] [--cache-mb N]\n"
+           "                   [--radius-map FILE] [--tolerance STEPS] [--profile FILE] INPUT...\n"
+           "INPUT is a .pgm/.ppm/.pnm/.pam file, a directory of them, or @FILE listing one path per line.\n"
+           "--recursive also takes the subdirectories, recreating them under --out.\n"
+           "ENGINE is direct (the default), box, recursive, pyramid, fixed or linear (blurs in linear light),\n"
+           "or auto: the engine predicted fastest for each image among those within --tolerance (1.5)\n"
+           "8-bit steps of the exact Gaussian, from a per-machine profile (--profile, calibrated on first\n"
+           "use). Auto blurs images one at a time and reports its picks with predicted and actual times.\n"
+           "--stream blurs each image in strips with the direct engine, using memory proportional to\n"
+           "radius x width; it also reads .tif/.tiff (uncompressed, written out as .pam) and .raw RGBA8\n"
+           "files of the size given by --raw-size.\n"
+           "--blur-batch blurs up to N images that are already decoded in one submission to the pool\n"
+           "(16 by default, at most --queue + 1 at a time), which speeds up sets of thumbnails.\n"
+           "--trace writes a Chrome/Perfetto trace of every stage and blur pass.\n"
+           "--cache-mb keeps up to N MB of results keyed by image content, so duplicate inputs are\n"
+           "blurred once.\n"
+           "--radius-map scales the radius per pixel by a PGM/PPM/PAM map's first channel (255 = R,\n"
+           "0 = sharp), resampled to each image's size; it replaces --engine and --cache-mb.\n"
+           "\n"
+           "       RTBlurBatch --shard N --out DIR [--radius R | --sigma S] [--engine ENGINE] [--threads N]\n"
+           "                   [--tile N] [--listen HOST:PORT] [--tile-timeout S] [--fail-after N]\n"
+           "                   [--raw-size WxH] INPUT...\n"
+           "       RTBlurBatch --worker HOST:PORT [--threads N] [--fail-after N]\n"
+           "--shard starts N worker processes and has them blur each image in tiles of --tile pixels\n"
+           "(1024) plus the engine's reach, reading and writing the image a band of tiles at a time;\n"
+           "more workers can join with --worker. Tiles of a worker that fails or times out go to\n"
+           "another. Output matches a single-process blur exactly; recursive and pyramid can't be\n"
+           "tiled. --fail-after makes the (first) worker quit after N tiles, for testing.\n"
+           "\n"
+           "       RTBlurBatch --serve SOCKET [--threads N] [--blur-batch N]\n"
+           "--serve runs a blur server on a Unix domain socket until interrupted. Clients (BlurClient and\n"
+           "SharedSegment in CpuBlurServer.h) put images in shared memory and send requests naming them;\n"
+           "up to --blur-batch queued requests are blurred together, highest priority first.\n"
+           "RTBlurBench --server load-tests it.\n"
+           "\n"
+           "       RTBlurBatch --video --out FILE|- [--radius R | --sigma S] [--engine ENGINE] [--threads N]\n"
+           "                   [--buffers 2|3] [--raw-size WxH] [--radius-map FILE] [--trace FILE] INPUT|-\n"
+           "       RTBlurBatch --video --out FILE|- --synthetic WxH [--frames N] ...\n"
+           "--video blurs a Y4M stream (8-bit mono, 4:2:0, 4:2:2 or 4:4:4), or RGBA8 frames of --raw-size,\n"
+           "from a file or stdin (-) to a file or stdout (-) in the same format, and reports fps and\n"
+           "per-frame latency percentiles. --synthetic generates N frames (300 by default) of a moving\n"
+           "test pattern instead, written as RGBA8 frames.\n");
+}
+
+bool ParseEngine(const char* name, CpuBlurEngine& engine) {
+    for (int i = 0; i < (int)CpuBlurEngine::Count; i++) {
+        if (!strcmp(name, CpuBlurEngineName((CpuBlurEngine)i))) {
+            engine = (CpuBlurEngine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseOptions(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) return false;
+        if (!strcmp(arg, "--recursive")) {
+            options.recursive = true;
+            continue;
+        }
+        if (!strcmp(arg, "--stream")) {
+            options.stream = true;
+            continue;
+        }
+        if (!strcmp(arg, "--video")) {
+            options.video = true;
+            continue;
+        }
+        if (strncmp(arg, "--", 2) != 0) {
+            options.inputs.push_back(arg);
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        if (!strcmp(arg, "--out")) options.outputDir = value;
+        else if (!strcmp(arg, "--trace")) options.tracePath = value;
+        else if (!strcmp(arg, "--radius")) options.blurRadius = (float)atof(value);
+        else if (!strcmp(arg, "--sigma")) options.blurRadius = 2.0f * (float)atof(value); // SigmaFromBlurRadius inverted
+        else if (!strcmp(arg, "--threads")) options.threads = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--decoders")) options.decoders = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--encoders")) options.encoders = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--blur-jobs")) options.blurJobs = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--queue")) options.queueDepth = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--blur-batch")) options.blurBatch = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--cache-mb")) options.cacheMB = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--buffers")) options.buffers = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--radius-map")) options.radiusMapPath = value;
+        else if (!strcmp(arg, "--shard")) {
+            options.shard = true;
+            options.shardOptions.localWorkers = (unsigned)strtoul(value, nullptr, 10);
+        }
+        else if (!strcmp(arg, "--tile")) options.shardOptions.tileSize = (uint32_t)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--tile-timeout")) options.shardOptions.tileTimeout = atof(value);
+        else if (!strcmp(arg, "--fail-after")) options.failAfter = atoi(value);
+        else if (!strcmp(arg, "--worker")) options.workerAddress = value;
+        else if (!strcmp(arg, "--serve")) options.servePath = value;
+        else if (!strcmp(arg, "--listen")) {
+            if (!ParseHostPort(value, options.shardOptions.host, options.shardOptions.port)) {
+                fprintf(stderr, "Bad --listen %s, expected HOST:PORT\n", value);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--frames")) options.syntheticFrames = strtoull(value, nullptr, 10);
+        else if (!strcmp(arg, "--synthetic")) {
+            if (sscanf(value, "%ux%u", &options.syntheticWidth, &options.syntheticHeight) != 2 ||
+                options.syntheticWidth == 0 || options.syntheticHeight == 0)
+            {
+                fprintf(stderr, "Bad --synthetic %s, expected WxH\n", value);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--raw-size")) {
+            if (sscanf(value, "%ux%u", &options.rawWidth, &options.rawHeight) != 2) {
+                fprintf(stderr, "Bad --raw-size %s, expected WxH\n", value);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--tolerance")) options.tolerance = atof(value);
+        else if (!strcmp(arg, "--profile")) options.profilePath = value;
+        else if (!strcmp(arg, "--engine") && !strcmp(value, "auto")) options.autoEngine = true;
+        else if (!strcmp(arg, "--engine")) {
+            if (!ParseEngine(value, options.engine)) {
+                fprintf(stderr, "Unknown engine %s\n", value);
+                return false;
+            }
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    if (!options.workerAddress.empty()) return true;
+    if (!options.servePath.empty()) return options.blurBatch > 0;
+    if (options.autoEngine && (options.stream || options.shard || !options.radiusMapPath.empty())) {
+        fprintf(stderr, "--engine auto doesn't combine with --stream, --shard or --radius-map\n");
+        return false;
+    }
+    if (options.shard && CpuBlurEngineReach(options.engine, options.blurRadius) < 0) {
+        fprintf(stderr, "--shard can't tile the %s engine\n", CpuBlurEngineName(options.engine));
+        return false;
+    }
+    if (options.stream && options.engine != CpuBlurEngine::Direct) {
+        fprintf(stderr, "--stream only runs the direct engine\n");
+        return false;
+    }
+    if (!options.radiusMapPath.empty() && (options.stream || options.shard || options.cacheMB > 0)) {
+        fprintf(stderr, "--radius-map doesn't combine with --stream, --shard or --cache-mb\n");
+        return false;
+    }
+    if (options.video) {
+        bool synthetic = options.syntheticWidth > 0;
+        return (synthetic ? options.inputs.empty() : options.inputs.size() == 1) && !options.outputDir.empty() &&
+            options.blurRadius >= 0.0f && options.buffers >= 2 && options.buffers <= 3;
+    }
+    return !options.inputs.empty() && !options.outputDir.empty() && options.blurRadius >= 0.0f &&
+        options.decoders > 0 && options.encoders > 0 && options.blurJobs > 0 && options.queueDepth > 0 &&
+        options.blurBatch > 0;
+}
+
+std::string LowerExtension(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return ext;
+}
+
+bool IsTiffFile(const fs::path& path) {
+    std::string ext = LowerExtension(path);
+    return ext == ".tif" || ext == ".tiff";
+}
+
+bool IsInputFile(const BatchOptions& options, const fs::path& path) {
+    if (NetpbmFormatFromExtension(path.extension().string()) != NetpbmFormat::Unknown) return true;
+    return (options.stream || options.shard) && (IsTiffFile(path) || LowerExtension(path) == ".raw");
+}
+
+// An input and where its result goes under the output directory: its file
+// name, or with --recursive its path below the directory it was found in
+struct InputFile {
+    fs::path path;
+    fs::path name;
+};
+
+// Outputs keep the input name; TIFF has no streamed writer and becomes PAM
+fs::path OutputPath(const fs::path& outputDir, const InputFile& input) {
+    fs::path name = input.name;
+    if (IsTiffFile(input.path)) name.replace_extension(".pam");
+    return outputDir / name;
+}
+
+// Expands directories and @lists into a list of files sorted by path
+bool CollectInputs(const BatchOptions& options, std::vector<InputFile>& files) {
+    std::vector<std::string> pending = options.inputs;
+    for (size_t i = 0; i < pending.size(); i++) {
+        const std::string& input = pending[i];
+        if (input.size() > 1 && input[0] == '@') {
+            std::ifstream list(input.substr(1));
+            if (!list) {
+                fprintf(stderr, "Can't read file list %s\n", input.c_str() + 1);
+                return false;
+            }
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) pending.push_back(line);
+            }
+            continue;
+        }
+
+        std::error_code ec;
+        fs::path path(input);
+        if (fs::is_directory(path, ec)) {
+            auto add = [&](const fs::directory_entry& entry) {
+                if (entry.is_regular_file(ec) && IsInputFile(options, entry.path())) {
+                    files.push_back({ entry.path(), entry.path().lexically_relative(path) });
+                }
+            };
+            if (options.recursive) {
+                for (const auto& entry : fs::recursive_directory_iterator(path, ec)) add(entry);
+            }
+            else {
+                for (const auto& entry : fs::directory_iterator(path, ec)) add(entry);
+            }
+        }
+        else if (fs::is_regular_file(path, ec)) {
+            files.push_back({ path, path.filename() });
+        }
+        else {
+            fprintf(stderr, "No such file or directory: %s\n", input.c_str());
+            return false;
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const InputFile& a, const InputFile& b) { return a.path < b.path; });
+    files.erase(std::unique(files.begin(), files.end(),
+        [](const InputFile& a, const InputFile& b) { return a.path == b.path; }), files.end());
+    return true;
+}
+
+struct BatchItem {
+    size_t index = 0;
+    CpuImage image;
+    NetpbmFormat format = NetpbmFormat::Unknown;
+};
+
+// Total time a pipeline stage spent working rather than waiting on a queue
+struct StageTimer {
+    std::atomic<int64_t> busyNs{ 0 };
+    double Seconds() const { return busyNs.load() / 1e9; }
+};
+
+class ScopedStageTime {
+public:
+    explicit ScopedStageTime(StageTimer& timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTime() {
+        m_timer.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    StageTimer& m_timer;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Drains the trace rings on a background thread while the batch runs, so
+// long runs don't overflow them, and writes the Chrome trace at the end
+class TraceCapture {
+public:
+    explicit TraceCapture(const std::string& path) : m_path(path) {
+        if (path.empty()) return;
+        TraceSetThreadName("main");
+        SetTracingEnabled(true);
+        m_collector = std::thread([this] {
+            while (!m_stop.load()) {
+                TraceCollect(m_events);
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        });
+    }
+
+    ~TraceCapture() { Stop(); }
+
+    // Returns false if the trace couldn't be written
+    bool Finish() {
+        if (m_path.empty()) return true;
+        Stop();
+        SetTracingEnabled(false);
+        TraceCollect(m_events);
+        if (TraceDroppedEvents() > 0) {
+            fprintf(stderr, "Trace: %llu events dropped\n", (unsigned long long)TraceDroppedEvents());
+        }
+        if (!WriteChromeTrace(m_path, m_events)) {
+            fprintf(stderr, "Can't write trace %s\n", m_path.c_str());
+            return false;
+        }
+        printf("Wrote %zu trace events to %s\n", m_events.size(), m_path.c_str());
+        return true;
+    }
+
+private:
+    void Stop() {
+        m_stop = true;
+        if (m_collector.joinable()) m_collector.join();
+    }
+
+    std::string m_path;
+    std::vector<TraceEvent> m_events;
+    std::atomic<bool> m_stop{ false };
+    std::thread m_collector;
+};
+
+// --stream: one image at a time, each read, blurred and written in strips
+int RunStreaming(const BatchOptions& options, const std::vector<InputFile>& files, const fs::path& outputDir,
+    ThreadPool& pool)
+{
+    size_t imagesDone = 0, failures = 0, peakBuffer = 0;
+    uint64_t pixelBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const InputFile& input : files) {
+        const fs::path& file = input.path;
+        std::string error;
+        auto reader = OpenRowReader(file.string(), options.rawWidth, options.rawHeight, &error);
+        if (!reader) {
+            fprintf(stderr, "%s: can't open: %s\n", file.string().c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        fs::path output = OutputPath(outputDir, input);
+        auto writer = CreateRowWriter(output.string(), reader->Width(), reader->Height(), &error);
+        if (!writer) {
+            fprintf(stderr, "%s: can't create: %s\n", output.string().c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        CpuStreamBlurStats stats;
+        TRACE_SCOPE("stream blur");
+        if (!CpuStreamGaussianBlur(*reader, *writer, options.blurRadius, pool, &stats)) {
+            fprintf(stderr, "%s: streaming blur failed\n", file.string().c_str());
+            failures++;
+            continue;
+        }
+        peakBuffer = std::max(peakBuffer, stats.bufferBytes);
+        pixelBytes += (uint64_t)reader->Width() * reader->Height() * 4;
+        imagesDone++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu images in %.2f s: %.2f images/s, %.1f MB/s of RGBA pixels, largest row buffer %.1f MB\n",
+        imagesDone, seconds, imagesDone / seconds, pixelBytes / 1e6 / seconds, peakBuffer / 1e6);
+    if (failures > 0) {
+        fprintf(stderr, "%zu images failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+// --shard: like RunStreaming, but the blur happens in the worker processes
+int RunSharded(const BatchOptions& options, const std::vector<InputFile>& files, const fs::path& outputDir) {
+    ShardOptions shardOptions = options.shardOptions;
+    unsigned threads = options.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency() / std::max(1u, shardOptions.localWorkers));
+    }
+    shardOptions.workerArguments = { "--threads", std::to_string(threads) };
+    shardOptions.firstWorkerFailAfter = options.failAfter;
+
+    ShardCoordinator coordinator;
+    std::string error;
+    if (!coordinator.Start(shardOptions, &error)) {
+        fprintf(stderr, "Can't start the coordinator: %s\n", error.c_str());
+        return 2;
+    }
+    printf("%zu images, blur radius %.3f (sigma %.3f), %s engine, %u-pixel tiles, %u local workers of %u threads, "
+        "listening on %s:%u\n", files.size(), options.blurRadius, SigmaFromBlurRadius(options.blurRadius),
+        CpuBlurEngineName(options.engine), shardOptions.tileSize, shardOptions.localWorkers, threads,
+        shardOptions.host.c_str(), coordinator.Port());
+
+    size_t imagesDone = 0, failures = 0;
+    uint64_t pixelBytes = 0;
+    ShardStats total;
+    auto start = std::chrono::steady_clock::now();
+    for (const InputFile& input : files) {
+        const fs::path& file = input.path;
+        auto reader = OpenRowReader(file.string(), options.rawWidth, options.rawHeight, &error);
+        if (!reader) {
+            fprintf(stderr, "%s: can't open: %s\n", file.string().c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        fs::path output = OutputPath(outputDir, input);
+        auto writer = CreateRowWriter(output.string(), reader->Width(), reader->Height(), &error);
+        if (!writer) {
+            fprintf(stderr, "%s: can't create: %s\n", output.string().c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        ShardStats stats;
+        TRACE_SCOPE("sharded blur");
+        bool ok = coordinator.Blur(*reader, *writer, options.blurRadius, options.engine, &stats, &error);
+        total.tiles += stats.tiles;
+        total.reissued += stats.reissued;
+        total.workersLost += stats.workersLost;
+        total.bytesSent += stats.bytesSent;
+        total.bytesReceived += stats.bytesReceived;
+        if (!ok) {
+            fprintf(stderr, "%s: sharded blur failed: %s\n", file.string().c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        pixelBytes += (uint64_t)reader->Width() * reader->Height() * 4;
+        imagesDone++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu images in %.2f s: %.2f images/s, %.1f MB/s of RGBA pixels\n", imagesDone, seconds,
+        imagesDone / seconds, pixelBytes / 1e6 / seconds);
+    printf("%zu tiles, %zu reissued, %u workers lost, %.1f MB sent to workers, %.1f MB back\n", total.tiles,
+        total.reissued, total.workersLost, total.bytesSent / 1e6, total.bytesReceived / 1e6);
+    if (failures > 0) {
+        fprintf(stderr, "%zu images failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+const char* EngineLabel(const BatchOptions& options) {
+    if (options.autoEngine) return "auto";
+    return options.radiusMapPath.empty() ? CpuBlurEngineName(options.engine) : "variable (radius map)";
+}
+
+// --engine auto: what was picked how often, and the predicted against the
+// measured time of those blurs
+class AutoEngineLog {
+public:
+    void Add(const CpuEngineChoice& choice) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Picks& picks = m_picks[(size_t)choice.engine];
+        picks.count++;
+        picks.predictedMs += choice.predictedMs;
+        picks.actualMs += choice.actualMs;
+    }
+
+    void Print(FILE* out, double tolerance) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        fprintf(out, "Auto engine (tolerance %.2f steps):", tolerance);
+        const char* separator = " ";
+        for (size_t e = 0; e < m_picks.size(); e++) {
+            const Picks& picks = m_picks[e];
+            if (picks.count == 0) continue;
+            fprintf(out, "%s%s x %zu, predicted %.1f ms, took %.1f ms", separator,
+                CpuBlurEngineName((CpuBlurEngine)e), picks.count, picks.predictedMs, picks.actualMs);
+            separator = "; ";
+        }
+        fprintf(out, "\n");
+    }
+
+private:
+    struct Picks {
+        size_t count = 0;
+        double predictedMs = 0.0;
+        double actualMs = 0.0;
+    };
+    mutable std::mutex m_mutex;
+    std::array<Picks, (size_t)CpuBlurEngine::Count> m_picks;
+};
+
+void BlurWithOptions(const BatchOptions& options, const CpuImage& radiusMap, const CpuImage& src, CpuImage& dst,
+    ThreadPool& pool, AutoEngineLog* autoLog = nullptr)
+{
+    if (!options.radiusMapPath.empty()) {
+        CpuBlurImage(src, dst, options.blurRadius, radiusMap, pool);
+    }
+    else if (options.autoEngine) {
+        CpuEngineChoice choice = CpuBlurImageAuto(src, dst, options.blurRadius, options.tolerance,
+            options.engineProfile, pool);
+        if (autoLog) autoLog->Add(choice);
+    }
+    else {
+        CpuBlurImage(src, dst, options.blurRadius, options.engine, pool);
+    }
+}
+
+// --engine auto: the profile for this machine and pool, calibrated and saved
+// the first time
+void PrepareAutoEngine(BatchOptions& options, ThreadPool& pool) {
+    std::string path = options.profilePath.empty() ? DefaultCpuEngineProfilePath() : options.profilePath;
+    CpuEngineProfile& profile = options.engineProfile;
+    if (LoadCpuEngineProfile(path, profile) && profile.Matches(pool)) {
+        fprintf(stderr, "Engine profile: %s\n", path.c_str());
+        return;
+    }
+    fprintf(stderr, "Calibrating the CPU engines for %u threads...\n", pool.ThreadCount());
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    CalibrateCpuEngines(pool, profile);
+    bool saved = SaveCpuEngineProfile(path, profile, &error);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (saved) fprintf(stderr, "Calibrated in %.2f s, saved to %s\n", seconds, path.c_str());
+    else fprintf(stderr, "Calibrated in %.2f s, but %s\n", seconds, error.c_str());
+}
+
+// One of the --video frame buffers, handed from stage to stage
+struct VideoFrame {
+    uint64_t index = 0;
+    CpuImage input;
+    CpuImage output;
+    std::chrono::steady_clock::time_point readStart;
+};
+
+// Value below which fraction p of the sorted samples fall
+double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+// --video: reader, blur and writer stages over options.buffers frames. The
+// free queue holds the buffers no stage is using; a frame goes read -> blur
+// -> write -> free, so frames stay in order and memory stays at a fixed
+// number of frames however long the stream runs.
+int RunVideo(const BatchOptions& options, const CpuImage& radiusMap, ThreadPool& pool) {
+    std::string error;
+    std::unique_ptr<FrameReader> reader;
+    if (options.syntheticWidth > 0) {
+        reader = CreateSyntheticFrameReader(options.syntheticWidth, options.syntheticHeight, options.syntheticFrames);
+    }
+    else {
+        reader = OpenFrameReader(options.inputs[0], options.rawWidth, options.rawHeight, &error);
+    }
+    if (!reader) {
+        fprintf(stderr, "%s: %s\n", options.inputs.empty() ? "-" : options.inputs[0].c_str(), error.c_str());
+        return 1;
+    }
+    const FrameFormat& format = reader->Format();
+    std::unique_ptr<FrameWriter> writer = CreateFrameWriter(options.outputDir, format, &error);
+    if (!writer) {
+        fprintf(stderr, "%s: %s\n", options.outputDir.c_str(), error.c_str());
+        return 1;
+    }
+
+    // Frames may be going to stdout, so the report goes to stderr
+    fprintf(stderr, "%ux%u %s frames, blur radius %.3f (sigma %.3f), %s engine, %u blur threads, %u buffers\n",
+        format.width, format.height, format.chroma == FrameChroma::Rgba ? "RGBA8" : "Y4M", options.blurRadius,
+        SigmaFromBlurRadius(options.blurRadius), EngineLabel(options), pool.ThreadCount(), options.buffers);
+
+    BoundedQueue<std::unique_ptr<VideoFrame>> freeFrames(options.buffers);
+    BoundedQueue<std::unique_ptr<VideoFrame>> toBlur(options.buffers);
+    BoundedQueue<std::unique_ptr<VideoFrame>> toWrite(options.buffers);
+    for (unsigned i = 0; i < options.buffers; i++) freeFrames.Push(std::make_unique<VideoFrame>());
+    auto stopAll = [&] {
+        freeFrames.Close();
+        toBlur.Close();
+        toWrite.Close();
+    };
+
+    StageTimer readTime, blurTime, writeTime;
+    AutoEngineLog autoLog;
+    std::atomic<bool> readFailed{ false };
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread readThread([&] {
+        TraceSetThreadName("frame reader");
+        std::unique_ptr<VideoFrame> frame;
+        for (uint64_t index = 0; freeFrames.Pop(frame); index++) {
+            frame->index = index;
+            frame->readStart = std::chrono::steady_clock::now();
+            bool ok;
+            {
+                TRACE_SCOPE("read frame");
+                ScopedStageTime busy(readTime);
+                ok = reader->ReadFrame(frame->input);
+            }
+            if (!ok) {
+                readFailed = !reader->Error().empty();
+                break;
+            }
+            if (!toBlur.Push(std::move(frame))) break;
+        }
+        toBlur.Close();
+    });
+
+    std::thread blurThread([&] {
+        TraceSetThreadName("frame blur");
+        std::unique_ptr<VideoFrame> frame;
+        while (toBlur.Pop(frame)) {
+            {
+                TRACE_SCOPE("blur frame");
+                ScopedStageTime busy(blurTime);
+                BlurWithOptions(options, radiusMap, frame->input, frame->output, pool, &autoLog);
+            }
+            if (!toWrite.Push(std::move(frame))) break;
+        }
+        toWrite.Close();
+    });
+
+    // Writes on this thread
+    std::vector<double> latencyMs;
+    bool writeFailed = false;
+    std::unique_ptr<VideoFrame> frame;
+    while (toWrite.Pop(frame)) {
+        {
+            TRACE_SCOPE("write frame");
+            ScopedStageTime busy(writeTime);
+            writeFailed = !writer->WriteFrame(frame->output);
+        }
+        if (writeFailed) {
+            stopAll();
+            break;
+        }
+        latencyMs.push_back(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame->readStart).count());
+        freeFrames.Push(std::move(frame));
+    }
+    stopAll();
+    readThread.join();
+    blurThread.join();
+    writeFailed = !writer->Finish() || writeFailed;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t frames = latencyMs.size();
+    std::vector<double> sorted = latencyMs;
+    std::sort(sorted.begin(), sorted.end());
+    fprintf(stderr, "%zu frames in %.2f s: %.2f fps sustained, %.1f MB/s of RGBA pixels\n", frames, seconds,
+        frames / seconds, frames * (double)format.width * format.height * 4 / 1e6 / seconds);
+    fprintf(stderr, "Frame latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", Percentile(sorted, 0.5),
+        Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back());
+    fprintf(stderr, "Stage busy time: read %.2f s, blur %.2f s, write %.2f s\n", readTime.Seconds(),
+        blurTime.Seconds(), writeTime.Seconds());
+    if (options.autoEngine) autoLog.Print(stderr, options.tolerance);
+
+    if (readFailed) {
+        fprintf(stderr, "Reading frames failed: %s\n", reader->Error().c_str());
+        return 1;
+    }
+    if (writeFailed) {
+        fprintf(stderr, "Writing frames to %s failed\n", options.outputDir.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+
+    CpuImage radiusMap;
+    if (!options.radiusMapPath.empty()) {
+        std::vector<uint8_t> bytes;
+        NetpbmFormat format;
+        std::string error = "can't read file";
+        if (!ReadFileBytes(options.radiusMapPath, bytes) || !DecodeNetpbm(bytes, radiusMap, format, &error)) {
+            fprintf(stderr, "%s: %s\n", options.radiusMapPath.c_str(), error.c_str());
+            return 2;
+        }
+    }
+
+    if (!options.workerAddress.empty()) {
+        std::string host;
+        uint16_t port = 0;
+        if (!ParseHostPort(options.workerAddress, host, port)) {
+            fprintf(stderr, "Bad --worker %s, expected HOST:PORT\n", options.workerAddress.c_str());
+            return 2;
+        }
+        ThreadPool pool(options.threads);
+        return RunShardWorker(host, port, pool, options.failAfter);
+    }
+
+    if (!options.servePath.empty()) {
+        BlurServerOptions serverOptions;
+        serverOptions.socketPath = options.servePath;
+        serverOptions.threads = options.threads;
+        serverOptions.maxBatch = options.blurBatch;
+        return RunBlurServer(serverOptions);
+    }
+
+    if (options.video) {
+        ThreadPool pool(options.threads);
+        if (options.autoEngine) PrepareAutoEngine(options, pool);
+        TraceCapture trace(options.tracePath);
+        int status = RunVideo(options, radiusMap, pool);
+        return trace.Finish() ? status : 1;
+    }
+
+    std::vector<InputFile> files;
+    if (!CollectInputs(options, files)) return 2;
+    if (files.empty()) {
+        fprintf(stderr, "No input images found\n");
+        return 2;
+    }
+
+    std::error_code ec;
+    fs::path outputDir(options.outputDir);
+    fs::create_directories(outputDir, ec);
+    if (!fs::is_directory(outputDir, ec)) {
+        fprintf(stderr, "Can't create output directory %s\n", options.outputDir.c_str());
+        return 2;
+    }
+
+    // Outputs keep the input file names, so refuse to blur a directory onto
+    // itself, or two inputs of the same name (from different directories) into
+    // one output
+    std::vector<std::pair<fs::path, const InputFile*>> outputs;
+    for (const InputFile& input : files) {
+        fs::path output = OutputPath(outputDir, input);
+        if (fs::equivalent(input.path, output, ec)) {
+            fprintf(stderr, "%s: output would overwrite the input\n", input.path.string().c_str());
+            return 2;
+        }
+        outputs.emplace_back(output, &input);
+    }
+    std::sort(outputs.begin(), outputs.end());
+    for (size_t i = 1; i < outputs.size(); i++) {
+        if (outputs[i].first != outputs[i - 1].first) continue;
+        fprintf(stderr, "%s and %s would both be written to %s\n", outputs[i - 1].second->path.string().c_str(),
+            outputs[i].second->path.string().c_str(), outputs[i].first.string().c_str());
+        return 2;
+    }
+    // --recursive mirrors the input directories
+    for (const auto& output : outputs) {
+        fs::create_directories(output.first.parent_path(), ec);
+        if (!fs::is_directory(output.first.parent_path(), ec)) {
+            fprintf(stderr, "Can't create output directory %s\n", output.first.parent_path().string().c_str());
+            return 2;
+        }
+    }
+
+    if (options.shard) {
+        TraceCapture trace(options.tracePath);
+        int status = RunSharded(options, files, outputDir);
+        return trace.Finish() ? status : 1;
+    }
+
+    ThreadPool pool(options.threads);
+    if (options.autoEngine) PrepareAutoEngine(options, pool);
+    TraceCapture trace(options.tracePath);
+    if (options.stream) {
+        printf("%zu images, blur radius %.3f (sigma %.3f), streamed in strips, %u blur threads\n",
+            files.size(), options.blurRadius, SigmaFromBlurRadius(options.blurRadius), pool.ThreadCount());
+        int status = RunStreaming(options, files, outputDir, pool);
+        return trace.Finish() ? status : 1;
+    }
+    printf("%zu images, blur radius %.3f (sigma %.3f), %s engine, %u blur threads, %u decoders, %u encoders\n",
+        files.size(), options.blurRadius, SigmaFromBlurRadius(options.blurRadius),
+        EngineLabel(options), pool.ThreadCount(), options.decoders, options.encoders);
+
+    BlurResultCache cache((size_t)options.cacheMB << 20);
+    BoundedQueue<BatchItem> decoded(options.queueDepth);
+    BoundedQueue<BatchItem> blurred(options.queueDepth);
+
+    std::atomic<size_t> nextFile{ 0 };
+    std::atomic<unsigned> decodersLeft{ options.decoders };
+    std::atomic<unsigned> blurJobsLeft{ options.blurJobs };
+    std::atomic<size_t> imagesDone{ 0 }, failures{ 0 };
+    std::atomic<uint64_t> pixelBytes{ 0 }, bytesRead{ 0 }, bytesWritten{ 0 };
+    StageTimer decodeTime, blurTime, encodeTime;
+    AutoEngineLog autoLog;
+    std::mutex logMutex;
+
+    auto report = [&](const fs::path& path, const char* what, const std::string& detail) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        fprintf(stderr, "%s: %s%s%s\n", path.string().c_str(), what, detail.empty() ? "" : ": ", detail.c_str());
+        failures++;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < options.decoders; i++) {
+        threads.emplace_back([&] {
+            TraceSetThreadName("decoder");
+            for (size_t index; (index = nextFile.fetch_add(1)) < files.size();) {
+                BatchItem item;
+                item.index = index;
+                std::string error = "can't read file";
+                bool ok;
+                {
+                    TRACE_SCOPE("decode");
+                    ScopedStageTime busy(decodeTime);
+                    std::vector<uint8_t> bytes;
+                    ok = ReadFileBytes(files[index].path.string(), bytes);
+                    bytesRead += bytes.size();
+                    ok = ok && DecodeNetpbm(bytes, item.image, item.format, &error);
+                }
+                if (!ok) {
+                    report(files[index].path, "decode failed", error);
+                    continue;
+                }
+                if (!decoded.Push(std::move(item))) break;
+            }
+            if (--decodersLeft == 0) decoded.Close();
+        });
+    }
+
+    for (unsigned i = 0; i < options.blurJobs; i++) {
+        threads.emplace_back([&] {
+            TraceSetThreadName("blur job");
+            bool batching = options.cacheMB == 0 && options.radiusMapPath.empty() && !options.autoEngine;
+            std::vector<BatchItem> items;
+            BatchItem item;
+            bool open = true;
+            while (open && decoded.Pop(item)) {
+                // Whatever else is decoded already goes into the same submission
+                items.clear();
+                items.push_back(std::move(item));
+                while (batching && items.size() < options.blurBatch && decoded.TryPop(item)) {
+                    items.push_back(std::move(item));
+                }
+
+                std::vector<BatchItem> outs(items.size());
+                for (size_t i = 0; i < items.size(); i++) {
+                    outs[i].index = items[i].index;
+                    outs[i].format = items[i].format;
+                }
+                {
+                    TRACE_SCOPE("blur");
+                    ScopedStageTime busy(blurTime);
+                    if (items.size() > 1) {
+                        std::vector<CpuBlurJob> jobs(items.size());
+                        for (size_t i = 0; i < items.size(); i++) {
+                            jobs[i] = { &items[i].image, &outs[i].image, options.blurRadius };
+                        }
+                        CpuBlurImages(jobs, options.engine, pool);
+                    }
+                    else if (options.cacheMB > 0) {
+                        const CpuImage& image = items[0].image;
+                        CpuEngineChoice choice;
+                        choice.engine = options.engine;
+                        if (options.autoEngine) {
+                            choice = ChooseCpuEngine(options.engineProfile, image.width, image.height,
+                                options.blurRadius, options.tolerance);
+                        }
+                        auto blurStart = std::chrono::steady_clock::now();
+                        outs[0].image = *CpuBlurImageCached(cache, image, HashCpuImage(image), options.blurRadius,
+                            choice.engine, pool);
+                        choice.actualMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - blurStart).count();
+                        if (options.autoEngine) autoLog.Add(choice);
+                    }
+                    else {
+                        BlurWithOptions(options, radiusMap, items[0].image, outs[0].image, pool, &autoLog);
+                    }
+                }
+                for (size_t i = 0; i < items.size() && open; i++) {
+                    pixelBytes += items[i].image.pixels.size();
+                    open = blurred.Push(std::move(outs[i]));
+                }
+            }
+            if (--blurJobsLeft == 0) blurred.Close();
+        });
+    }
+
+    for (unsigned i = 0; i < options.encoders; i++) {
+        threads.emplace_back([&] {
+            TraceSetThreadName("encoder");
+            BatchItem item;
+            while (blurred.Pop(item)) {
+                fs::path output = OutputPath(outputDir, files[item.index]);
+                bool ok;
+                {
+                    TRACE_SCOPE("encode");
+                    ScopedStageTime busy(encodeTime);
+                    std::vector<uint8_t> bytes = EncodeNetpbm(item.image, item.format);
+                    bytesWritten += bytes.size();
+                    ok = WriteFileBytes(output.string(), bytes);
+                }
+                if (!ok) {
+                    report(output, "write failed", "");
+                    continue;
+                }
+                imagesDone++;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double megabytes = pixelBytes.load() / 1e6;
+    printf("%zu images in %.2f s: %.2f images/s, %.1f MB/s of RGBA pixels (read %.1f MB, wrote %.1f MB)\n",
+        imagesDone.load(), seconds, imagesDone.load() / seconds, megabytes / seconds,
+        bytesRead.load() / 1e6, bytesWritten.load() / 1e6);
+    printf("Stage busy time: decode %.2f s, blur %.2f s, encode %.2f s\n",
+        decodeTime.Seconds(), blurTime.Seconds(), encodeTime.Seconds());
+    if (options.autoEngine) autoLog.Print(stdout, options.tolerance);
+    if (options.cacheMB > 0) {
+        BlurResultCache::Stats stats = cache.GetStats();
+        printf("Result cache: %llu hits, %llu misses, %llu evictions, %.1f of %u MB used\n",
+            (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+            (unsigned long long)stats.evictions, stats.bytes / 1048576.0, options.cacheMB);
+    }
+    if (!trace.Finish()) return 1;
+    if (failures.load() > 0) {
+        fprintf(stderr, "%zu images failed\n", failures.load());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1211 @@
+// RTBlurBench.cpp : headless benchmark for the CPU blur engines.
+//
+// By default, measures how CpuGaussianBlurTiled scales with the thread count
+// on a large image and checks that every thread count reproduces the
+// single-threaded CpuGaussianBlur output bit for bit.
+//
+// --suite sweeps image sizes, radii, thread counts and every CPU engine (and
+// with --all-isas every instruction set of the direct engine), and reports
+// speed next to accuracy against CpuReferenceGaussianBlur, optionally as JSON
+// for tracking regressions. Results that no other engine beats on both time
+// and max error for the same size, radius and thread count are marked as the
+// Pareto front.
+//
+// --preview checks the interactive preview (CpuPreview.h): blurring a copy
+// downscaled to the display size with the scaled radius, against blurring at
+// full resolution and downscaling the result.
+//
+// --kernels times the direct engine with the row kernels specialized for each
+// small kernel radius (CpuBlurKernels.h) against the generic ones.
+//
+// --vertical-pass times the direct engine with each CpuVerticalPass strategy
+// on images from 1K to 32K wide.
+//
+// --fused times the direct engine's two-pass and fused tile schedules
+// (CpuBlurSchedule).
+//
+// --variable times the summed-area-table blur (CpuVariableBlur.h) with a flat
+// radius map and with a ramp from sharp to the full radius, next to the box
+// cascade engine, and measures the flat map's error.
+//
+// --batch blurs a set of thumbnails one CpuBlurImage call at a time and as
+// one CpuBlurImages batch, per engine.
+//
+// --server load-tests a blur server (CpuBlurServer.h): client threads each
+// blur images in their own shared memory segment, one request after another,
+// and the latency of every request is reported as percentiles. Starts a server
+// in this process unless --socket names a running one (RTBlurBatch --serve).
+//
+// --calibrate measures the cost model the auto engine choice runs on
+// (CpuEngineProfile.h) and checks it: for each size and radius, the engine it
+// picks and its predicted time next to the measured time of every engine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurEngine.h"
+#include "CpuBlurKernels.h"
+#include "CpuBlurServer.h"
+#include "CpuBlurTiled.h"
+#include "CpuEngineProfile.h"
+#include "CpuPreview.h"
+#include "CpuReferenceBlur.h"
+#include "CpuVariableBlur.h"
+#include "ThreadPool.h"
+
+namespace {
+
+struct ImageSize {
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+struct BenchOptions {
+    uint32_t width = 8000;
+    uint32_t height = 5000;
+    float blurRadius = 10.0f;
+    unsigned maxThreads = 0; // 0 = hardware threads
+    int repeat = 3;
+
+    // --suite; empty lists come from the preset
+    bool preview = false;
+    bool kernels = false;
+    bool verticalPass = false;
+    bool fused = false;
+    bool variable = false;
+    bool batch = false;
+    unsigned batchCount = 1000; // --batch images
+    bool server = false;
+    std::string socketPath;     // --server: empty starts one in this process
+    unsigned clients = 8;
+    unsigned requests = 200;    // per client
+    bool calibrate = false;
+    double tolerance = 1.5;     // --calibrate: error allowed to the engine picked, 8-bit steps
+    std::string profilePath;    // --calibrate: also save the profile here
+    ImageSize displaySize{ 1200, 675 }; // --preview: area the image is shown in
+    bool suite = false;
+    std::string preset = "quick";
+    std::vector<ImageSize> sizes;
+    std::vector<float> radii;
+    std::vector<CpuBlurEngine> engines;
+    std::vector<unsigned> threads;
+    bool allIsas = false;
+    ImageSize accuracySize{ 1280, 720 };
+    double minSeconds = 0.25; // keep timing a case until this much has run
+    std::string jsonPath;     // "-" for stdout
+    double minPsnr = 0.0;     // fail if any result is below, 0 = don't check
+    double maxError = 0.0;    // fail if any result is above, 0 = don't check
+};
+
+void PrintUsage() {
+    printf("Usage: RTBlurBench [--width N] [--height N] [--radius R] [--max-threads N] [--repeat N]\n"
+           "       RTBlurBench --suite [--preset quick|full] [--sizes LIST] [--radii LIST] [--engines LIST]\n"
+           "                   [--threads LIST] [--all-isas] [--accuracy-size WxH] [--min-seconds S]\n"
+           "                   [--repeat N] [--json FILE|-] [--min-psnr DB] [--max-error STEPS]\n"
+           "       RTBlurBench --preview [--width N] [--height N] [--display WxH] [--radii LIST]\n"
+           "                   [--engines LIST] [--max-error STEPS]\n"
+           "       RTBlurBench --kernels [--width N] [--height N] [--max-threads N] [--repeat N] [--all-isas]\n"
+           "       RTBlurBench --vertical-pass [--sizes LIST] [--radii LIST] [--max-threads N] [--repeat N]\n"
+           "       RTBlurBench --fused [--sizes LIST] [--radii LIST] [--max-threads N] [--repeat N]\n"
+           "       RTBlurBench --variable [--sizes LIST] [--radii LIST] [--max-threads N] [--repeat N]\n"
+           "       RTBlurBench --batch [--count N] [--sizes LIST] [--radii LIST] [--engines LIST] [--max-threads N]\n"
+           "                   [--repeat N]\n"
+           "       RTBlurBench --calibrate [--tolerance STEPS] [--profile FILE] [--sizes LIST] [--radii LIST]\n"
+           "                   [--max-threads N] [--repeat N]\n"
+           "       RTBlurBench --server [--socket PATH] [--clients N] [--requests N] [--sizes LIST] [--radii LIST]\n"
+           "                   [--engines LIST] [--max-threads N]\n"
+           "LISTs are comma separated. Sizes are WxH or 720p, 1080p, 4k, 24mp, 100mp; engines are\n"
+           "direct, box, recursive, pyramid, fixed, linear.\n");
+}
+
+std::vector<std::string> SplitList(const char* value) {
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* c = value;; c++) {
+        if (*c == ',' || *c == '\0') {
+            if (!item.empty()) items.push_back(item);
+            item.clear();
+            if (*c == '\0') break;
+        }
+        else {
+            item += *c;
+        }
+    }
+    return items;
+}
+
+bool ParseSize(const std::string& text, ImageSize& size) {
+    static const struct { const char* name; uint32_t width, height; } kNamed[] = {
+        { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4k", 3840, 2160 },
+        { "24mp", 6000, 4000 }, { "100mp", 10000, 10000 },
+    };
+    for (const auto& named : kNamed) {
+        if (text == named.name) {
+            size = { named.width, named.height };
+            return true;
+        }
+    }
+    return sscanf(text.c_str(), "%ux%u", &size.width, &size.height) == 2 && size.width > 0 && size.height > 0;
+}
+
+bool ParseEngine(const std::string& name, CpuBlurEngine& engine) {
+    for (int i = 0; i < (int)CpuBlurEngine::Count; i++) {
+        if (name == CpuBlurEngineName((CpuBlurEngine)i)) {
+            engine = (CpuBlurEngine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseSuiteList(const char* arg, const char* value, BenchOptions& options) {
+    for (const std::string& item : SplitList(value)) {
+        if (!strcmp(arg, "--sizes")) {
+            ImageSize size;
+            if (!ParseSize(item, size)) return false;
+            options.sizes.push_back(size);
+        }
+        else if (!strcmp(arg, "--radii")) {
+            options.radii.push_back((float)atof(item.c_str()));
+        }
+        else if (!strcmp(arg, "--engines")) {
+            CpuBlurEngine engine;
+            if (!ParseEngine(item, engine)) return false;
+            options.engines.push_back(engine);
+        }
+        else {
+            unsigned threads = (unsigned)strtoul(item.c_str(), nullptr, 10);
+            if (threads == 0) return false;
+            options.threads.push_back(threads);
+        }
+    }
+    return true;
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) return false;
+        if (!strcmp(arg, "--suite")) {
+            options.suite = true;
+            continue;
+        }
+        if (!strcmp(arg, "--preview")) {
+            options.preview = true;
+            continue;
+        }
+        if (!strcmp(arg, "--kernels")) {
+            options.kernels = true;
+            continue;
+        }
+        if (!strcmp(arg, "--vertical-pass")) {
+            options.verticalPass = true;
+            continue;
+        }
+        if (!strcmp(arg, "--fused")) {
+            options.fused = true;
+            continue;
+        }
+        if (!strcmp(arg, "--variable")) {
+            options.variable = true;
+            continue;
+        }
+        if (!strcmp(arg, "--batch")) {
+            options.batch = true;
+            continue;
+        }
+        if (!strcmp(arg, "--calibrate")) {
+            options.calibrate = true;
+            continue;
+        }
+        if (!strcmp(arg, "--server")) {
+            options.server = true;
+            continue;
+        }
+        if (!strcmp(arg, "--all-isas")) {
+            options.allIsas = true;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        if (!strcmp(arg, "--width")) options.width = (uint32_t)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--height")) options.height = (uint32_t)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--radius")) options.blurRadius = (float)atof(value);
+        else if (!strcmp(arg, "--max-threads")) options.maxThreads = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--repeat")) options.repeat = atoi(value);
+        else if (!strcmp(arg, "--count")) options.batchCount = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--socket")) options.socketPath = value;
+        else if (!strcmp(arg, "--tolerance")) options.tolerance = atof(value);
+        else if (!strcmp(arg, "--profile")) options.profilePath = value;
+        else if (!strcmp(arg, "--clients")) options.clients = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--requests")) options.requests = (unsigned)strtoul(value, nullptr, 10);
+        else if (!strcmp(arg, "--preset")) options.preset = value;
+        else if (!strcmp(arg, "--min-seconds")) options.minSeconds = atof(value);
+        else if (!strcmp(arg, "--json")) options.jsonPath = value;
+        else if (!strcmp(arg, "--min-psnr")) options.minPsnr = atof(value);
+        else if (!strcmp(arg, "--max-error")) options.maxError = atof(value);
+        else if (!strcmp(arg, "--display")) {
+            if (!ParseSize(value, options.displaySize)) {
+                fprintf(stderr, "Bad size %s\n", value);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--accuracy-size")) {
+            if (!ParseSize(value, options.accuracySize)) {
+                fprintf(stderr, "Bad size %s\n", value);
+                return false;
+            }
+        }
+        else if (!strcmp(arg, "--sizes") || !strcmp(arg, "--radii") || !strcmp(arg, "--engines") ||
+                 !strcmp(arg, "--threads"))
+        {
+            if (!ParseSuiteList(arg, value, options)) {
+                fprintf(stderr, "Bad %s list %s\n", arg, value);
+                return false;
+            }
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    if (options.preset != "quick" && options.preset != "full") {
+        fprintf(stderr, "Unknown preset %s\n", options.preset.c_str());
+        return false;
+    }
+    return options.width > 0 && options.height > 0 && options.repeat > 0 && options.clients > 0 &&
+        options.requests > 0;
+}
+
+void FillNoise(CpuImage& image, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    for (uint8_t& value : image.pixels) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        value = (uint8_t)state;
+    }
+}
+
+// Blocks of flat color with hard edges at several scales, over mild noise, so
+// that accuracy numbers reflect edges and gradients rather than averaged-out
+// noise
+void FillTestPattern(CpuImage& image, uint32_t seed) {
+    FillNoise(image, seed);
+    for (uint32_t y = 0; y < image.height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < image.width; x++) {
+            uint32_t block = (x / 37) * 7919u + (y / 53) * 104729u + ((x / 211) ^ (y / 157)) * 31u;
+            block ^= block >> 7;
+            block *= 0x9E3779B1u;
+            for (int c = 0; c < 4; c++) {
+                int base = (int)((block >> (c * 8)) & 0xFF);
+                int noise = (row[x * 4 + c] & 15) - 8;
+                row[x * 4 + c] = (uint8_t)std::min(std::max(base + noise, 0), 255);
+            }
+        }
+    }
+}
+
+double Milliseconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+unsigned HardwareThreads() {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads ? hardwareThreads : 1;
+}
+
+// Original mode: thread scaling of the direct engine on one image
+int RunScaling(const BenchOptions& options) {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    unsigned maxThreads = options.maxThreads ? options.maxThreads : (hardwareThreads ? hardwareThreads : 1);
+
+    CpuImage source(options.width, options.height);
+    FillNoise(source, 12345);
+    double megapixels = (double)options.width * options.height / 1e6;
+
+    printf("Image %ux%u (%.1f MP), blur radius %.3f, %s kernels, %u hardware threads\n",
+        options.width, options.height, megapixels, options.blurRadius,
+        CpuIsaName(GetCpuBlurIsa()), hardwareThreads);
+
+    CpuImage reference;
+    auto start = std::chrono::steady_clock::now();
+    CpuGaussianBlur(source, reference, options.blurRadius);
+    printf("Single-threaded CpuGaussianBlur: %.1f ms\n\n", Milliseconds(std::chrono::steady_clock::now() - start));
+
+    printf("%8s %10s %10s %8s %10s %10s\n", "threads", "ms", "MP/s", "speedup", "efficiency", "identical");
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    bool allIdentical = true;
+    double baseMs = 0.0;
+    CpuImage output;
+    for (unsigned threads : threadCounts) {
+        ThreadPool pool(threads);
+        CpuGaussianBlurTiled(source, output, options.blurRadius, pool); // warm-up
+        bool identical = output.pixels == reference.pixels;
+        allIdentical = allIdentical && identical;
+
+        double bestMs = 0.0;
+        for (int r = 0; r < options.repeat; r++) {
+            start = std::chrono::steady_clock::now();
+            CpuGaussianBlurTiled(source, output, options.blurRadius, pool);
+            double ms = Milliseconds(std::chrono::steady_clock::now() - start);
+            if (r == 0 || ms < bestMs) bestMs = ms;
+        }
+        if (threads == 1) baseMs = bestMs;
+
+        double speedup = baseMs / bestMs;
+        printf("%8u %10.1f %10.1f %7.2fx %9.0f%% %10s\n", threads, bestMs, megapixels / (bestMs / 1000.0),
+            speedup, 100.0 * speedup / threads, identical ? "yes" : "NO");
+    }
+
+    if (!allIdentical) {
+        fprintf(stderr, "Tiled output differs from the single-threaded blur\n");
+        return 1;
+    }
+    return 0;
+}
+
+// One engine as run by the suite. Only the direct engine has per-ISA kernels.
+struct SuiteEngine {
+    CpuBlurEngine engine;
+    CpuIsa isa;
+};
+
+struct SuiteResult {
+    size_t engineIndex = 0;
+    ImageSize size;
+    float blurRadius = 0.0f;
+    unsigned threads = 0;
+    int runs = 0;
+    double bestMs = 0.0;
+    double medianMs = 0.0;
+    ImageError error;
+    bool pareto = false;
+};
+
+void ApplyPreset(BenchOptions& options) {
+    bool full = options.preset == "full";
+    if (options.sizes.empty()) {
+        for (const char* name : { "720p", "1080p", "4k", "24mp", "100mp" }) {
+            ImageSize size;
+            ParseSize(name, size);
+            options.sizes.push_back(size);
+            if (!full && options.sizes.size() == 2) break;
+        }
+    }
+    if (options.radii.empty()) {
+        // The slider's range, 0.001 to 120
+        options.radii = full ? std::vector<float>{ 0.001f, 1.0f, 5.0f, 10.0f, 20.0f, 40.0f, 80.0f, 120.0f }
+                             : std::vector<float>{ 0.001f, 2.0f, 10.0f, 40.0f, 120.0f };
+    }
+    if (options.engines.empty()) {
+        for (int i = 0; i < (int)CpuBlurEngine::Count; i++) options.engines.push_back((CpuBlurEngine)i);
+    }
+    if (options.threads.empty()) {
+        unsigned maxThreads = options.maxThreads ? options.maxThreads : HardwareThreads();
+        if (full) {
+            for (unsigned n = 1; n < maxThreads; n *= 2) options.threads.push_back(n);
+        }
+        else {
+            options.threads.push_back(1);
+        }
+        if (options.threads.back() != maxThreads) options.threads.push_back(maxThreads);
+    }
+}
+
+// Runs the blur until minSeconds have been spent and at least `repeat` runs
+// are in, or a single run alone takes longer than minSeconds
+void TimeBlur(const CpuImage& source, CpuImage& output, float blurRadius, CpuBlurEngine engine, ThreadPool& pool,
+    const BenchOptions& options, SuiteResult& result)
+{
+    CpuBlurImage(source, output, blurRadius, engine, pool); // warm-up
+    std::vector<double> times;
+    double total = 0.0;
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        CpuBlurImage(source, output, blurRadius, engine, pool);
+        double ms = Milliseconds(std::chrono::steady_clock::now() - start);
+        times.push_back(ms);
+        total += ms / 1000.0;
+        bool enoughTime = total >= options.minSeconds;
+        if (enoughTime && ((int)times.size() >= options.repeat || ms / 1000.0 >= options.minSeconds)) break;
+        if (times.size() >= 1000) break;
+    }
+    std::sort(times.begin(), times.end());
+    result.runs = (int)times.size();
+    result.bestMs = times.front();
+    result.medianMs = times[times.size() / 2];
+}
+
+// Within each (size, radius, threads) group, keeps the results no other one
+// matches or beats on both best time and max error. The linear-light engine
+// computes a different blur, so it is only compared with itself.
+void MarkParetoFront(std::vector<SuiteResult>& results, const std::vector<SuiteEngine>& engines) {
+    for (SuiteResult& a : results) {
+        a.pareto = true;
+        bool aLinear = engines[a.engineIndex].engine == CpuBlurEngine::LinearLight;
+        for (const SuiteResult& b : results) {
+            bool bLinear = engines[b.engineIndex].engine == CpuBlurEngine::LinearLight;
+            if (&a == &b || a.size.width != b.size.width || a.size.height != b.size.height ||
+                a.blurRadius != b.blurRadius || a.threads != b.threads || aLinear != bLinear)
+            {
+                continue;
+            }
+            bool noWorse = b.bestMs <= a.bestMs && b.error.maxAbs <= a.error.maxAbs;
+            bool better = b.bestMs < a.bestMs || b.error.maxAbs < a.error.maxAbs;
+            if (noWorse && better) {
+                a.pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+// Byte traffic if the engine read the source once and wrote the result once;
+// the GB/s figure is relative to that, not to what the engine really moves
+double EffectiveGBps(const SuiteResult& result) {
+    double bytes = 2.0 * result.size.width * result.size.height * 4;
+    return bytes / (result.bestMs / 1000.0) / 1e9;
+}
+
+double NsPerPixel(const SuiteResult& result) {
+    return result.bestMs * 1e6 / ((double)result.size.width * result.size.height);
+}
+
+// JSON has no infinity; an exact result reports null
+void WriteJsonNumber(FILE* file, double value) {
+    if (std::isfinite(value)) fprintf(file, "%.6g", value);
+    else fprintf(file, "null");
+}
+
+bool WriteSuiteJson(const std::string& path, const BenchOptions& options, const std::vector<SuiteEngine>& engines,
+    const std::vector<SuiteResult>& results)
+{
+    FILE* file = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    fprintf(file, "{\n  \"tool\": \"RTBlurBench\",\n  \"schema\": 1,\n");
+    fprintf(file, "  \"machine\": { \"isa\": \"%s\", \"hardware_threads\": %u },\n",
+        CpuIsaName(DetectCpuIsa()), HardwareThreads());
+    fprintf(file, "  \"accuracy\": { \"width\": %u, \"height\": %u, \"reference\": \"double untruncated gaussian\" },\n",
+        options.accuracySize.width, options.accuracySize.height);
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const SuiteResult& r = results[i];
+        const SuiteEngine& e = engines[r.engineIndex];
+        fprintf(file, "    { \"engine\": \"%s\", \"isa\": \"%s\", \"format\": \"rgba8\", "
+            "\"width\": %u, \"height\": %u, \"radius\": %g, \"sigma\": %g, \"threads\": %u, \"runs\": %d, "
+            "\"best_ms\": %.4f, \"median_ms\": %.4f, \"ns_per_pixel\": %.4f, \"gb_per_s\": %.4f, "
+            "\"max_error\": %.4f, \"mean_error\": %.5f, \"psnr_db\": ",
+            CpuBlurEngineName(e.engine), CpuIsaName(e.isa), r.size.width, r.size.height, r.blurRadius,
+            SigmaFromBlurRadius(r.blurRadius), r.threads, r.runs, r.bestMs, r.medianMs, NsPerPixel(r),
+            EffectiveGBps(r), r.error.maxAbs, r.error.meanAbs);
+        WriteJsonNumber(file, r.error.psnr);
+        fprintf(file, ", \"pareto\": %s }%s\n", r.pareto ? "true" : "false", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    bool ok = !ferror(file);
+    if (file != stdout) ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+int RunSuite(BenchOptions options) {
+    ApplyPreset(options);
+    // With the JSON on stdout, the table goes to stderr
+    FILE* log = options.jsonPath == "-" ? stderr : stdout;
+
+    std::vector<SuiteEngine> engines;
+    CpuIsa bestIsa = DetectCpuIsa();
+    for (CpuBlurEngine engine : options.engines) {
+        if ((engine == CpuBlurEngine::Direct || engine == CpuBlurEngine::FixedPoint ||
+            engine == CpuBlurEngine::LinearLight) && options.allIsas)
+        {
+            for (int isa = 0; isa <= (int)bestIsa; isa++) engines.push_back({ engine, (CpuIsa)isa });
+        }
+        else {
+            engines.push_back({ engine, bestIsa });
+        }
+    }
+
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    auto getPool = [&](unsigned threads) -> ThreadPool& {
+        for (auto& pool : pools) {
+            if (pool->ThreadCount() == threads) return *pool;
+        }
+        pools.push_back(std::make_unique<ThreadPool>(threads));
+        return *pools.back();
+    };
+    ThreadPool& widestPool = getPool(*std::max_element(options.threads.begin(), options.threads.end()));
+
+    // Accuracy depends on the engine and radius, not on the image size or
+    // thread count, so it is measured once per pair on one test image
+    fprintf(log, "Accuracy on %ux%u against the double-precision reference\n",
+        options.accuracySize.width, options.accuracySize.height);
+    CpuImage accuracySource(options.accuracySize.width, options.accuracySize.height);
+    FillTestPattern(accuracySource, 777);
+    std::vector<std::vector<ImageError>> errors(engines.size(), std::vector<ImageError>(options.radii.size()));
+    std::vector<double> reference;
+    CpuImage output;
+    for (size_t r = 0; r < options.radii.size(); r++) {
+        CpuReferenceGaussianBlur(accuracySource, reference, SigmaFromBlurRadius(options.radii[r]), widestPool);
+        std::vector<double> linearReference;
+        for (size_t e = 0; e < engines.size(); e++) {
+            // The linear-light engine is held to the same blur done in linear light
+            bool linear = engines[e].engine == CpuBlurEngine::LinearLight;
+            if (linear && linearReference.empty()) {
+                CpuReferenceGaussianBlur(accuracySource, linearReference, SigmaFromBlurRadius(options.radii[r]),
+                    widestPool, true);
+            }
+            SetCpuBlurIsa(engines[e].isa);
+            CpuBlurImage(accuracySource, output, options.radii[r], engines[e].engine, widestPool);
+            errors[e][r] = MeasureImageError(output, linear ? linearReference : reference);
+        }
+    }
+
+    std::vector<SuiteResult> results;
+    for (const ImageSize& size : options.sizes) {
+        CpuImage source(size.width, size.height);
+        FillTestPattern(source, 12345);
+        for (size_t r = 0; r < options.radii.size(); r++) {
+            for (unsigned threads : options.threads) {
+                ThreadPool& pool = getPool(threads);
+                for (size_t e = 0; e < engines.size(); e++) {
+                    SuiteResult result;
+                    result.engineIndex = e;
+                    result.size = size;
+                    result.blurRadius = options.radii[r];
+                    result.threads = threads;
+                    result.error = errors[e][r];
+                    SetCpuBlurIsa(engines[e].isa);
+                    TimeBlur(source, output, result.blurRadius, engines[e].engine, pool, options, result);
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+    SetCpuBlurIsa(bestIsa);
+    MarkParetoFront(results, engines);
+
+    fprintf(log, "\n%-10s %-8s %11s %8s %7s %10s %8s %8s %8s %8s %s\n", "engine", "isa", "size", "radius", "threads",
+        "ms", "ns/px", "GB/s", "max err", "PSNR", "pareto");
+    for (const SuiteResult& r : results) {
+        char size[32];
+        snprintf(size, sizeof(size), "%ux%u", r.size.width, r.size.height);
+        fprintf(log, "%-10s %-8s %11s %8.3f %7u %10.2f %8.3f %8.2f %8.3f %8.2f %s\n",
+            CpuBlurEngineName(engines[r.engineIndex].engine), CpuIsaName(engines[r.engineIndex].isa), size,
+            r.blurRadius, r.threads, r.bestMs, NsPerPixel(r), EffectiveGBps(r), r.error.maxAbs,
+            std::isfinite(r.error.psnr) ? r.error.psnr : 999.0, r.pareto ? "*" : "");
+    }
+
+    if (!options.jsonPath.empty() && !WriteSuiteJson(options.jsonPath, options, engines, results)) {
+        fprintf(stderr, "Can't write %s\n", options.jsonPath.c_str());
+        return 2;
+    }
+
+    // Release gate: accuracy bounds across every engine and radius
+    bool pass = true;
+    for (size_t e = 0; e < engines.size(); e++) {
+        for (size_t r = 0; r < options.radii.size(); r++) {
+            const ImageError& error = errors[e][r];
+            bool low = options.minPsnr > 0.0 && error.psnr < options.minPsnr;
+            bool high = options.maxError > 0.0 && error.maxAbs > options.maxError;
+            if (low || high) {
+                fprintf(stderr, "%s (%s) at radius %g: max error %.3f, PSNR %.2f dB is out of bounds\n",
+                    CpuBlurEngineName(engines[e].engine), CpuIsaName(engines[e].isa), options.radii[r],
+                    error.maxAbs, error.psnr);
+                pass = false;
+            }
+        }
+    }
+    return pass ? 0 : 1;
+}
+
+// Preview blur against the full-resolution blur downscaled the same way.
+// Blurring and area-averaging commute for continuous images; on pixels the
+// preview's small kernel misplaces hard edges by a fraction of a preview
+// pixel, so expect a low mean difference with larger peaks at edges when the
+// preview radius is only a pixel or two.
+int RunPreviewCheck(BenchOptions options) {
+    if (options.radii.empty()) options.radii = { 2.0f, 10.0f, 40.0f, 120.0f };
+    if (options.engines.empty()) {
+        for (int i = 0; i < (int)CpuBlurEngine::Count; i++) options.engines.push_back((CpuBlurEngine)i);
+    }
+
+    ThreadPool pool(options.maxThreads);
+    CpuImage source(options.width, options.height);
+    FillTestPattern(source, 4242);
+    PreviewSize preview = ChoosePreviewSize(source.width, source.height,
+        (float)options.displaySize.width, (float)options.displaySize.height);
+
+    CpuImage previewSource;
+    auto start = std::chrono::steady_clock::now();
+    CpuDownsampleArea(source, previewSource, preview.width, preview.height, pool);
+    double downsampleMs = Milliseconds(std::chrono::steady_clock::now() - start);
+
+    printf("Image %ux%u, preview %ux%u (scale %.4f), downsample %.1f ms (once per image), %u threads\n\n",
+        source.width, source.height, preview.width, preview.height, preview.scale, downsampleMs, pool.ThreadCount());
+    printf("%-10s %8s %8s %10s %10s %8s %9s %9s\n", "engine", "radius", "preview", "full ms", "preview ms",
+        "speedup", "max diff", "mean diff");
+
+    bool pass = true;
+    CpuImage full, fullDownsampled, previewBlurred;
+    for (float blurRadius : options.radii) {
+        for (CpuBlurEngine engine : options.engines) {
+            start = std::chrono::steady_clock::now();
+            CpuBlurImage(source, full, blurRadius, engine, pool);
+            double fullMs = Milliseconds(std::chrono::steady_clock::now() - start);
+
+            float previewRadius = PreviewBlurRadius(blurRadius, preview);
+            start = std::chrono::steady_clock::now();
+            CpuBlurImage(previewSource, previewBlurred, previewRadius, engine, pool);
+            double previewMs = Milliseconds(std::chrono::steady_clock::now() - start);
+
+            CpuDownsampleArea(full, fullDownsampled, preview.width, preview.height, pool);
+            int maxDiff = 0;
+            double sumDiff = 0.0;
+            for (size_t i = 0; i < previewBlurred.pixels.size(); i++) {
+                int diff = std::abs(previewBlurred.pixels[i] - fullDownsampled.pixels[i]);
+                maxDiff = std::max(maxDiff, diff);
+                sumDiff += diff;
+            }
+            double meanDiff = sumDiff / previewBlurred.pixels.size();
+            printf("%-10s %8.3f %8.3f %10.1f %10.2f %7.1fx %9d %9.4f\n", CpuBlurEngineName(engine), blurRadius,
+                previewRadius, fullMs, previewMs, fullMs / previewMs, maxDiff, meanDiff);
+            if (options.maxError > 0.0 && maxDiff > options.maxError) pass = false;
+        }
+    }
+    if (!pass) {
+        fprintf(stderr, "Preview differs from the downscaled full-resolution blur by more than %g\n",
+            options.maxError);
+        return 1;
+    }
+    return 0;
+}
+
+// Specialized against generic row kernels, per kernel radius the
+// specializations cover. Single-threaded unless --max-threads is given, so
+// the kernels rather than memory bandwidth set the pace.
+int RunKernelComparison(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads ? options.maxThreads : 1);
+    CpuImage source(options.width, options.height);
+    FillNoise(source, 777);
+
+    // The smallest slider value that gives each kernel radius
+    float blurRadii[kMaxFixedKernelRadius + 1] = {};
+    int found = 0;
+    for (float blurRadius = 0.001f; found <= kMaxFixedKernelRadius; blurRadius += 0.01f) {
+        int radius = GetGaussianKernel(SigmaFromBlurRadius(blurRadius))->radius;
+        if (radius >= found && radius <= kMaxFixedKernelRadius) {
+            for (; found <= radius; found++) blurRadii[found] = blurRadius;
+        }
+    }
+
+    printf("Image %ux%u, direct engine, %u threads\n\n", source.width, source.height, pool.ThreadCount());
+    printf("%-8s %6s %8s %12s %12s %8s %10s\n", "isa", "taps", "radius", "generic ms", "fixed ms", "speedup",
+        "identical");
+
+    CpuIsa bestIsa = DetectCpuIsa();
+    bool allIdentical = true;
+    CpuImage generic, fixed;
+    for (int isa = options.allIsas ? 0 : (int)bestIsa; isa <= (int)bestIsa; isa++) {
+        SetCpuBlurIsa((CpuIsa)isa);
+        for (int radius = 0; radius <= kMaxFixedKernelRadius; radius++) {
+            double ms[2] = {};
+            for (int specialized = 0; specialized < 2; specialized++) {
+                SetCpuBlurKernelSpecialization(specialized != 0);
+                CpuImage& output = specialized ? fixed : generic;
+                CpuGaussianBlurTiled(source, output, blurRadii[radius], pool); // warm-up
+                for (int r = 0; r < options.repeat; r++) {
+                    auto start = std::chrono::steady_clock::now();
+                    CpuGaussianBlurTiled(source, output, blurRadii[radius], pool);
+                    double runMs = Milliseconds(std::chrono::steady_clock::now() - start);
+                    if (r == 0 || runMs < ms[specialized]) ms[specialized] = runMs;
+                }
+            }
+            bool identical = generic.pixels == fixed.pixels;
+            allIdentical = allIdentical && identical;
+            printf("%-8s %6d %8.3f %12.2f %12.2f %7.2fx %10s\n", CpuIsaName((CpuIsa)isa), 2 * radius + 1,
+                blurRadii[radius], ms[0], ms[1], ms[0] / ms[1], identical ? "yes" : "NO");
+        }
+    }
+    SetCpuBlurKernelSpecialization(true);
+    SetCpuBlurIsa(bestIsa);
+
+    if (!allIdentical) {
+        fprintf(stderr, "Specialized kernels differ from the generic ones\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Fastest of a warm-up and options.repeat runs of the direct engine.
+double TimeDirectBlur(const CpuImage& source, CpuImage& output, float blurRadius, ThreadPool& pool, int repeat) {
+    CpuGaussianBlurTiled(source, output, blurRadius, pool); // warm-up
+    double best = 0.0;
+    for (int r = 0; r < repeat; r++) {
+        auto start = std::chrono::steady_clock::now();
+        CpuGaussianBlurTiled(source, output, blurRadius, pool);
+        double runMs = Milliseconds(std::chrono::steady_clock::now() - start);
+        if (r == 0 || runMs < best) best = runMs;
+    }
+    return best;
+}
+
+// Strips against transposing for the vertical pass, on images 1K to 32K wide
+// and 1024 rows tall unless --sizes is given. Single-threaded unless
+// --max-threads is given. The horizontal pass is the same for both and
+// included in the times.
+int RunVerticalPassComparison(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads ? options.maxThreads : 1);
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) {
+        for (uint32_t width = 1024; width <= 32768; width *= 2) sizes.push_back({ width, 1024 });
+    }
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 4.0f, 20.0f, 80.0f };
+
+    printf("Direct engine, %s kernels, %u threads\n\n", CpuIsaName(GetCpuBlurIsa()), pool.ThreadCount());
+    printf("%-12s %8s %12s %14s %8s %10s %10s\n", "size", "radius", "strips ms", "transpose ms", "speedup", "auto",
+        "identical");
+
+    // The fused schedule has no vertical pass over the whole image
+    SetCpuBlurSchedule(CpuBlurSchedule::TwoPass);
+    bool allIdentical = true;
+    CpuImage outputs[2];
+    const CpuVerticalPass passes[2] = { CpuVerticalPass::Strips, CpuVerticalPass::Transpose };
+    for (const ImageSize& size : sizes) {
+        CpuImage source(size.width, size.height);
+        FillNoise(source, 777);
+        for (float blurRadius : radii) {
+            double ms[2] = {};
+            for (int p = 0; p < 2; p++) {
+                SetCpuVerticalPass(passes[p]);
+                ms[p] = TimeDirectBlur(source, outputs[p], blurRadius, pool, options.repeat);
+            }
+            SetCpuVerticalPass(CpuVerticalPass::Auto);
+            int kernelRadius = GetGaussianKernel(SigmaFromBlurRadius(blurRadius))->radius;
+            bool identical = outputs[0].pixels == outputs[1].pixels;
+            allIdentical = allIdentical && identical;
+            char sizeText[32];
+            snprintf(sizeText, sizeof(sizeText), "%ux%u", size.width, size.height);
+            printf("%-12s %8.3f %12.2f %14.2f %7.2fx %10s %10s\n", sizeText, blurRadius, ms[0], ms[1], ms[0] / ms[1],
+                CpuVerticalPassName(ResolveCpuVerticalPass(size.width, kernelRadius)), identical ? "yes" : "NO");
+        }
+    }
+
+    SetCpuBlurSchedule(CpuBlurSchedule::Auto);
+
+    if (!allIdentical) {
+        fprintf(stderr, "The vertical pass strategies disagree\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Two-pass against fused tiles. The traffic columns estimate the bytes each
+// schedule moves through memory per run: source and destination once each,
+// plus writing and reading back the intermediate image for two passes, and
+// the source rows of every tile's halo for fused tiles. Single-threaded unless
+// --max-threads is given; the difference shows most when several threads
+// share the memory bandwidth.
+int RunFusedComparison(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads ? options.maxThreads : 1);
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) sizes = { { 1920, 1080 }, { 3840, 2160 }, { 6000, 4000 }, { 16384, 2048 } };
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 2.0f, 10.0f, 40.0f, 120.0f };
+
+    const CpuCacheSizes& caches = GetCpuCacheSizes();
+    printf("Direct engine, %s kernels, %u threads, L2 %zu KB\n\n", CpuIsaName(GetCpuBlurIsa()), pool.ThreadCount(),
+        caches.l2 / 1024);
+    printf("%-12s %8s %12s %10s %8s %11s %10s %10s %10s %10s\n", "size", "radius", "two-pass ms", "fused ms", "speedup",
+        "tile", "2-pass MB", "fused MB", "auto", "identical");
+
+    bool allIdentical = true;
+    CpuImage outputs[2];
+    const CpuBlurSchedule schedules[2] = { CpuBlurSchedule::TwoPass, CpuBlurSchedule::Fused };
+    for (const ImageSize& size : sizes) {
+        CpuImage source(size.width, size.height);
+        FillNoise(source, 777);
+        double imageMB = (double)source.pixels.size() / (1024.0 * 1024.0);
+        for (float blurRadius : radii) {
+            double ms[2] = {};
+            for (int s = 0; s < 2; s++) {
+                SetCpuBlurSchedule(schedules[s]);
+                ms[s] = TimeDirectBlur(source, outputs[s], blurRadius, pool, options.repeat);
+            }
+            SetCpuBlurSchedule(CpuBlurSchedule::Auto);
+            int kernelRadius = GetGaussianKernel(SigmaFromBlurRadius(blurRadius))->radius;
+            CpuBlurTiling tiling = ChooseCpuBlurTiling(size.width, size.height, kernelRadius);
+            uint32_t tileRows = CpuBlurFusedTileRows(tiling, size.width, size.height, kernelRadius, pool.ThreadCount());
+            size_t tilesPerColumn = (size.height + tileRows - 1) / tileRows;
+            double haloShare = std::min(1.0, (tilesPerColumn - 1) * 2.0 * kernelRadius / size.height);
+            bool identical = outputs[0].pixels == outputs[1].pixels;
+            allIdentical = allIdentical && identical;
+            char sizeText[32], tileText[32];
+            snprintf(sizeText, sizeof(sizeText), "%ux%u", size.width, size.height);
+            snprintf(tileText, sizeof(tileText), "%ux%u", tiling.fusedColumns, tileRows);
+            CpuBlurSchedule chosen = ResolveCpuBlurSchedule(size.width, size.height, kernelRadius, pool.ThreadCount());
+            printf("%-12s %8.3f %12.2f %10.2f %7.2fx %11s %10.1f %10.1f %10s %10s\n", sizeText, blurRadius, ms[0], ms[1],
+                ms[0] / ms[1], tileText, 4.0 * imageMB, (2.0 + haloShare) * imageMB, CpuBlurScheduleName(chosen),
+                identical ? "yes" : "NO");
+        }
+    }
+    SetCpuBlurSchedule(CpuBlurSchedule::Auto);
+
+    if (!allIdentical) {
+        fprintf(stderr, "The fused schedule differs from the two-pass one\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Fastest of a warm-up and repeat runs of blur()
+template <typename Blur>
+double TimeBest(int repeat, const Blur& blur) {
+    blur();
+    double best = 0.0;
+    for (int r = 0; r < repeat; r++) {
+        auto start = std::chrono::steady_clock::now();
+        blur();
+        double runMs = Milliseconds(std::chrono::steady_clock::now() - start);
+        if (r == 0 || runMs < best) best = runMs;
+    }
+    return best;
+}
+
+// The variable-radius blur should cost the same at every radius, and with a
+// flat map come out as accurate as the box cascade it mirrors. Single-threaded
+// unless --max-threads is given.
+int RunVariableComparison(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads ? options.maxThreads : 1);
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) sizes = { { 1920, 1080 }, { 3840, 2160 } };
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 4.0f, 20.0f, 80.0f, 240.0f };
+
+    printf("Summed-area-table blur, %u threads; errors on a %ux%u flat map\n\n", pool.ThreadCount(),
+        options.accuracySize.width, options.accuracySize.height);
+    printf("%-12s %8s %10s %10s %10s %10s %10s\n", "size", "radius", "flat ms", "ramp ms", "box ms", "max err",
+        "box err");
+
+    CpuImage accuracySource(options.accuracySize.width, options.accuracySize.height);
+    FillTestPattern(accuracySource, 99);
+    const CpuImage flatMap;
+    for (const ImageSize& size : sizes) {
+        CpuImage source(size.width, size.height), output;
+        FillNoise(source, 777);
+        CpuImage rampMap(size.width, size.height);
+        for (uint32_t y = 0; y < size.height; y++) {
+            uint8_t value = (uint8_t)(y * 255 / std::max(size.height - 1, 1u));
+            for (uint32_t x = 0; x < size.width; x++) rampMap.Row(y)[x * 4] = value;
+        }
+        for (float blurRadius : radii) {
+            double flatMs = TimeBest(options.repeat, [&] { CpuVariableBlur(source, output, flatMap, blurRadius, pool); });
+            double rampMs = TimeBest(options.repeat, [&] { CpuVariableBlur(source, output, rampMap, blurRadius, pool); });
+            double boxMs = TimeBest(options.repeat,
+                [&] { CpuBlurImage(source, output, blurRadius, CpuBlurEngine::BoxCascade, pool); });
+
+            std::vector<double> reference;
+            CpuReferenceGaussianBlur(accuracySource, reference, SigmaFromBlurRadius(blurRadius), pool);
+            CpuVariableBlur(accuracySource, output, flatMap, blurRadius, pool);
+            ImageError error = MeasureImageError(output, reference);
+            CpuBlurImage(accuracySource, output, blurRadius, CpuBlurEngine::BoxCascade, pool);
+            ImageError boxError = MeasureImageError(output, reference);
+
+            char sizeText[32];
+            snprintf(sizeText, sizeof(sizeText), "%ux%u", size.width, size.height);
+            printf("%-12s %8.3f %10.2f %10.2f %10.2f %10.2f %10.2f\n", sizeText, blurRadius, flatMs, rampMs, boxMs,
+                error.maxAbs, boxError.maxAbs);
+        }
+    }
+    return 0;
+}
+
+// Thumbnails one call at a time against one batched call. Each image gets the
+// next radius of the list in turn, so a batch mixes radii. The whole set is
+// blurred per run, and images/s is over the fastest run.
+int RunBatchComparison(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads);
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) sizes = { { 128, 128 }, { 256, 256 }, { 512, 512 } };
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 2.0f, 6.0f, 12.0f, 20.0f };
+    std::vector<CpuBlurEngine> engines = options.engines;
+    if (engines.empty()) engines = { CpuBlurEngine::Direct, CpuBlurEngine::BoxCascade, CpuBlurEngine::FixedPoint };
+
+    printf("%u images per run, %u threads\n\n", options.batchCount, pool.ThreadCount());
+    printf("%-10s %-10s %14s %14s %8s %10s\n", "size", "engine", "per-call img/s", "batched img/s", "speedup",
+        "identical");
+
+    bool allIdentical = true;
+    for (const ImageSize& size : sizes) {
+        std::vector<CpuImage> sources(options.batchCount, CpuImage(size.width, size.height));
+        for (size_t i = 0; i < sources.size(); i++) FillNoise(sources[i], 1000 + (uint32_t)i);
+        std::vector<CpuImage> single(sources.size()), batched(sources.size());
+        std::vector<CpuBlurJob> jobs(sources.size());
+        for (size_t i = 0; i < sources.size(); i++) jobs[i] = { &sources[i], &batched[i], radii[i % radii.size()] };
+
+        for (CpuBlurEngine engine : engines) {
+            double singleMs = TimeBest(options.repeat, [&] {
+                for (size_t i = 0; i < sources.size(); i++) {
+                    CpuBlurImage(sources[i], single[i], jobs[i].blurRadius, engine, pool);
+                }
+            });
+            double batchedMs = TimeBest(options.repeat, [&] { CpuBlurImages(jobs, engine, pool); });
+            bool identical = true;
+            for (size_t i = 0; i < sources.size(); i++) identical = identical && single[i].pixels == batched[i].pixels;
+            allIdentical = allIdentical && identical;
+
+            char sizeText[32];
+            snprintf(sizeText, sizeof(sizeText), "%ux%u", size.width, size.height);
+            printf("%-10s %-10s %14.0f %14.0f %7.2fx %10s\n", sizeText, CpuBlurEngineName(engine),
+                sources.size() * 1000.0 / singleMs, sources.size() * 1000.0 / batchedMs, singleMs / batchedMs,
+                identical ? "yes" : "NO");
+        }
+    }
+
+    if (!allIdentical) {
+        fprintf(stderr, "Batched blurs differ from single calls\n");
+        return 1;
+    }
+    return 0;
+}
+
+// The model's prediction and pick against what every engine actually takes.
+// "best" is the fastest engine within the tolerance as measured; a pick that
+// isn't it costs the "lost" share of time.
+int RunCalibration(const BenchOptions& options) {
+    ThreadPool pool(options.maxThreads);
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) sizes = { { 640, 480 }, { 1920, 1080 } };
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 3.0f, 10.0f, 30.0f, 60.0f, 110.0f };
+
+    CpuEngineProfile profile;
+    auto start = std::chrono::steady_clock::now();
+    CalibrateCpuEngines(pool, profile);
+    printf("Calibrated in %.2f s, %s, %u threads\n\n", Milliseconds(std::chrono::steady_clock::now() - start) / 1000.0,
+        profile.isa.c_str(), profile.threads);
+    std::string error;
+    if (!options.profilePath.empty() && !SaveCpuEngineProfile(options.profilePath, profile, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    printf("%-8s", "radius");
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        if (profile.costs[e].calibrated) printf(" %22s", CpuBlurEngineName((CpuBlurEngine)e));
+    }
+    printf("\n%-8s", "");
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        if (profile.costs[e].calibrated) printf(" %22s", "ms/call ns/px error");
+    }
+    printf("\n");
+    for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+        printf("%-8g", kCpuEngineCalibrationRadius[r]);
+        for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+            const CpuEngineCost& cost = profile.costs[e];
+            if (cost.calibrated) printf("  %6.3f %7.2f %5.2f", cost.overheadMs[r], cost.nsPerPixel[r], cost.maxError[r]);
+        }
+        printf("\n");
+    }
+
+    printf("\nTolerance %.2f steps\n%-10s %7s %-10s %10s %10s %-10s %7s\n", options.tolerance, "size", "radius",
+        "picked", "predicted", "actual", "best", "lost");
+    double totalPicked = 0.0, totalBest = 0.0;
+    for (const ImageSize& size : sizes) {
+        CpuImage source(size.width, size.height), output;
+        FillTestPattern(source, 17);
+        for (float blurRadius : radii) {
+            CpuEngineChoice choice = ChooseCpuEngine(profile, size.width, size.height, blurRadius, options.tolerance);
+            double pickedMs = 0.0, bestMs = 0.0;
+            CpuBlurEngine best = choice.engine;
+            for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+                CpuBlurEngine engine = (CpuBlurEngine)e;
+                if (!profile.costs[e].calibrated) continue;
+                bool allowed = profile.ExpectedError(engine, blurRadius) <= options.tolerance;
+                if (!allowed && engine != choice.engine) continue;
+                double ms = TimeBest(options.repeat, [&] { CpuBlurImage(source, output, blurRadius, engine, pool); });
+                if (engine == choice.engine) pickedMs = ms;
+                if (allowed && (bestMs == 0.0 || ms < bestMs)) {
+                    bestMs = ms;
+                    best = engine;
+                }
+            }
+            if (bestMs == 0.0) bestMs = pickedMs;
+            totalPicked += pickedMs;
+            totalBest += bestMs;
+
+            char sizeText[32];
+            snprintf(sizeText, sizeof(sizeText), "%ux%u", size.width, size.height);
+            printf("%-10s %7.1f %-10s %8.2f ms %7.2f ms %-10s %6.1f%%\n", sizeText, blurRadius,
+                CpuBlurEngineName(choice.engine), choice.predictedMs, pickedMs, CpuBlurEngineName(best),
+                100.0 * (pickedMs - bestMs) / bestMs);
+        }
+    }
+    printf("\nPicked engines took %.1f%% longer than the fastest within tolerance overall\n",
+        100.0 * (totalPicked - totalBest) / totalBest);
+    return 0;
+}
+
+double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p * values.size());
+    return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+}
+
+// Closed loop: each client sends its next request as soon as the last one is
+// answered, cycling through every size, radius and engine. The first client
+// sends at a higher priority than the rest, so its latencies show what jumping
+// the queue buys. A client's first answer for each case is checked against
+// CpuBlurImage in this process.
+int RunServerLoad(const BenchOptions& options) {
+    std::vector<ImageSize> sizes = options.sizes;
+    if (sizes.empty()) sizes = { { 256, 256 }, { 640, 480 } };
+    std::vector<float> radii = options.radii;
+    if (radii.empty()) radii = { 4.0f, 12.0f };
+    std::vector<CpuBlurEngine> engines = options.engines;
+    if (engines.empty()) engines = { CpuBlurEngine::Direct };
+
+    std::string tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000007);
+    std::string socketPath = options.socketPath;
+    BlurServer server;
+    if (socketPath.empty()) {
+        socketPath = (std::filesystem::temp_directory_path() / ("rtblur-bench-" + tag + ".sock")).string();
+        BlurServerOptions serverOptions;
+        serverOptions.socketPath = socketPath;
+        serverOptions.threads = options.maxThreads;
+        std::string error;
+        if (!server.Start(serverOptions, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    size_t largest = 0;
+    for (const ImageSize& size : sizes) largest = std::max(largest, (size_t)size.width * size.height * 4);
+    size_t cases = sizes.size() * radii.size() * engines.size();
+    printf("%u clients x %u requests, %zu sizes x %zu radii x %zu engines, server at %s\n\n", options.clients,
+        options.requests, sizes.size(), radii.size(), engines.size(), socketPath.c_str());
+
+    std::vector<std::vector<double>> latencies(options.clients);
+    std::vector<double> queueMs(options.clients), serverMs(options.clients), batchSizes(options.clients);
+    std::vector<std::string> failures(options.clients);
+    std::vector<char> identical(options.clients, 1);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (unsigned c = 0; c < options.clients; c++) {
+        clients.emplace_back([&, c] {
+            SharedSegment segment;
+            BlurClient client;
+            std::string& error = failures[c];
+            if (!segment.Create("/rtblur-bench-" + tag + "-" + std::to_string(c), 2 * largest, &error) ||
+                !client.Connect(socketPath, &error))
+            {
+                return;
+            }
+            ThreadPool serial(1);
+            CpuImage source, expected;
+            for (unsigned r = 0; r < options.requests; r++) {
+                size_t which = (r + c) % cases;
+                const ImageSize& size = sizes[which % sizes.size()];
+                float blurRadius = radii[which / sizes.size() % radii.size()];
+                CpuBlurEngine engine = engines[which / sizes.size() / radii.size()];
+                source = CpuImage(size.width, size.height);
+                FillNoise(source, 7 * c + r + 1);
+                memcpy(segment.Data(), source.pixels.data(), source.pixels.size());
+
+                BlurReply reply;
+                auto sent = std::chrono::steady_clock::now();
+                int priority = c == 0 ? 1 : 0;
+                if (!client.Blur(segment, 0, largest, size.width, size.height, blurRadius, engine, priority, &reply,
+                        &error))
+                {
+                    return;
+                }
+                latencies[c].push_back(Milliseconds(std::chrono::steady_clock::now() - sent));
+                queueMs[c] += reply.queueMs;
+                serverMs[c] += reply.blurMs;
+                batchSizes[c] += reply.batchSize;
+                if (r < cases) {
+                    CpuBlurImage(source, expected, blurRadius, engine, serial);
+                    identical[c] = identical[c] && !memcmp(segment.Data() + largest, expected.pixels.data(),
+                        expected.pixels.size());
+                }
+            }
+        });
+    }
+    for (std::thread& thread : clients) thread.join();
+    double seconds = Milliseconds(std::chrono::steady_clock::now() - start) / 1000.0;
+
+    std::vector<double> all;
+    double queueTotal = 0.0, serverTotal = 0.0, batchTotal = 0.0;
+    bool allIdentical = true;
+    for (unsigned c = 0; c < options.clients; c++) {
+        if (!failures[c].empty()) {
+            fprintf(stderr, "Client %u: %s\n", c, failures[c].c_str());
+            return 1;
+        }
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        queueTotal += queueMs[c];
+        serverTotal += serverMs[c];
+        batchTotal += batchSizes[c];
+        allIdentical = allIdentical && identical[c];
+    }
+    double count = (double)all.size();
+    printf("%.0f requests in %.2f s, %.1f requests/s\n", count, seconds, count / seconds);
+    printf("Latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", Percentile(all, 0.5),
+        Percentile(all, 0.9), Percentile(all, 0.99), Percentile(all, 1.0));
+    if (options.clients > 1) {
+        printf("Priority client: p50 %.2f ms, p99 %.2f ms\n", Percentile(latencies[0], 0.5),
+            Percentile(latencies[0], 0.99));
+    }
+    printf("Server side: %.2f ms queued, %.2f ms in batches of %.1f on average\n", queueTotal / count,
+        serverTotal / count, batchTotal / count);
+    printf("Results match CpuBlurImage: %s\n", allIdentical ? "yes" : "NO");
+
+    BlurClient statsClient;
+    std::string stats;
+    if (statsClient.Connect(socketPath) && statsClient.Stats(stats)) printf("Server stats: %s\n", stats.c_str());
+    return allIdentical ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 2;
+    }
+    if (options.preview) return RunPreviewCheck(options);
+    if (options.kernels) return RunKernelComparison(options);
+    if (options.verticalPass) return RunVerticalPassComparison(options);
+    if (options.fused) return RunFusedComparison(options);
+    if (options.variable) return RunVariableComparison(options);
+    if (options.batch) return RunBatchComparison(options);
+    if (options.server) return RunServerLoad(options);
+    if (options.calibrate) return RunCalibration(options);
+    return options.suite ? RunSuite(options) : RunScaling(options);
+}
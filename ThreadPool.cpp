@@ -0,0 +1,116 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+
+    size_t workerCount = threadCount - 1;
+    size_t queueCount = workerCount > 0 ? workerCount : 1;
+    for (size_t i = 0; i < queueCount; i++) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wakeCv.notify_all();
+    for (std::thread& worker : m_workers) worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+    if (count == 1 || m_workers.empty()) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+
+    TaskGroup group;
+    group.body = &task;
+    group.remaining = count;
+
+    // Deal the indices out in contiguous runs so neighbouring tiles start on
+    // the same worker; stealing evens out whatever imbalance is left.
+    size_t queueCount = m_queues.size();
+    size_t first = m_nextQueue.fetch_add(1) % queueCount;
+    for (size_t q = 0; q < queueCount; q++) {
+        size_t begin = count * q / queueCount;
+        size_t end = count * (q + 1) / queueCount;
+        if (begin == end) continue;
+        WorkQueue& queue = *m_queues[(first + q) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t i = begin; i < end; i++) queue.tasks.push_back({ &group, i });
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_pending += count;
+    }
+    m_wakeCv.notify_all();
+
+    // Help out until every task of this group has finished
+    while (group.remaining.load() > 0) {
+        if (TryRunTask(first)) continue;
+        std::unique_lock<std::mutex> lock(m_doneMutex);
+        m_doneCv.wait(lock, [&] { return group.remaining.load() == 0; });
+    }
+}
+
+void ThreadPool::WorkerLoop(size_t queueIndex) {
+    for (;;) {
+        if (TryRunTask(queueIndex)) continue;
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wakeCv.wait(lock, [&] { return m_stop || m_pending.load() > 0; });
+        if (m_stop) return;
+    }
+}
+
+bool ThreadPool::TryRunTask(size_t preferredQueue) {
+    size_t queueCount = m_queues.size();
+    Task task = {};
+    bool found = false;
+
+    // Own queue from the back (most recently dealt, still warm in cache)
+    {
+        WorkQueue& own = *m_queues[preferredQueue % queueCount];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    // Otherwise steal from the front of someone else's
+    for (size_t i = 1; !found && i < queueCount; i++) {
+        WorkQueue& victim = *m_queues[(preferredQueue + i) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    m_pending--;
+    RunTask(task);
+    return true;
+}
+
+void ThreadPool::RunTask(const Task& task) {
+    (*task.group->body)(task.index);
+    if (--task.group->remaining == 0) {
+        std::lock_guard<std::mutex> lock(m_doneMutex);
+        m_doneCv.notify_all();
+    }
+}
+
+ThreadPool& GetDefaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
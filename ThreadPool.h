@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for the CPU blur. ParallelFor spreads task indices over
+// per-worker queues; a worker pops from the back of its own queue and steals
+// from the front of the others once it runs dry. The calling thread helps
+// until its tasks are done, so a pool of N threads starts N - 1 workers.
+// Several threads may call ParallelFor at the same time.
+class ThreadPool {
+public:
+    // threadCount 0 means one per hardware thread.
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Total threads that run tasks, including the caller of ParallelFor.
+    unsigned ThreadCount() const { return (unsigned)m_workers.size() + 1; }
+
+    // Runs task(0) .. task(count - 1) and returns once all of them finished.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    struct TaskGroup {
+        const std::function<void(size_t)>* body;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Task {
+        TaskGroup* group;
+        size_t index;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(size_t queueIndex);
+    bool TryRunTask(size_t preferredQueue);
+    void RunTask(const Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::atomic<size_t> m_pending{ 0 };
+    bool m_stop = false;
+
+    std::mutex m_doneMutex;
+    std::condition_variable m_doneCv;
+
+    std::atomic<size_t> m_nextQueue{ 0 };
+};
+
+// Process-wide pool sized to the machine.
+ThreadPool& GetDefaultThreadPool();
@@ -0,0 +1,219 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Single-producer, single-consumer ring. The owning thread writes at head,
+// the collector reads from tail; each side only stores its own index.
+struct TraceRing {
+    TraceEvent events[kTraceRingEvents];
+    std::atomic<uint64_t> head{ 0 };
+    std::atomic<uint64_t> tail{ 0 };
+    uint32_t threadId = 0;
+    std::string threadName;
+    // Set when the owning thread ends; once drained, the ring goes to the next
+    // new thread, so servers starting a thread per connection don't grow
+    std::atomic<bool> exited{ false };
+};
+
+struct TraceRegistry {
+    std::mutex mutex; // taken once per thread on its first event, and by collectors
+    std::vector<std::unique_ptr<TraceRing>> rings; // never shrinks, so rings outlive their threads
+    uint32_t nextThreadId = 1;
+};
+
+TraceRegistry& Registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+std::atomic<bool> g_tracingEnabled{ false };
+std::atomic<uint64_t> g_droppedEvents{ 0 };
+
+// The calling thread's ring, created on its first event, and its name until then
+struct ThreadTrace {
+    TraceRing* ring = nullptr;
+    std::string name;
+    ~ThreadTrace() {
+        if (ring) ring->exited.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadTrace t_trace;
+
+TraceRing& ThreadRing() {
+    if (!t_trace.ring) {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        TraceRing* ring = nullptr;
+        for (auto& candidate : registry.rings) {
+            // Exited and collected: nobody writes or reads it any more
+            if (candidate->exited.load(std::memory_order_acquire) &&
+                candidate->tail.load(std::memory_order_relaxed) == candidate->head.load(std::memory_order_relaxed))
+            {
+                ring = candidate.get();
+                ring->exited.store(false, std::memory_order_relaxed);
+                break;
+            }
+        }
+        if (!ring) {
+            registry.rings.push_back(std::make_unique<TraceRing>());
+            ring = registry.rings.back().get();
+        }
+        ring->threadId = registry.nextThreadId++;
+        ring->threadName = t_trace.name;
+        t_trace.ring = ring;
+    }
+    return *t_trace.ring;
+}
+
+void AppendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text ? text : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') out += '\\';
+        if ((unsigned char)*c < 0x20) continue;
+        out += *c;
+    }
+    out += '"';
+}
+
+} // namespace
+
+void SetTracingEnabled(bool enabled) {
+    g_tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TracingEnabled() {
+    return g_tracingEnabled.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceNowNs() {
+    static const auto start = std::chrono::steady_clock::now();
+    // + 1 so that 0 can mean "not recording" in ScopedTrace
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count() + 1;
+}
+
+void TraceRecord(const char* name, const char* category, uint64_t startNs, uint64_t durationNs, uint32_t threadId) {
+    if (!TracingEnabled()) return;
+    TraceRing& ring = ThreadRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kTraceRingEvents) {
+        g_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = ring.events[head % kTraceRingEvents];
+    event.name = name;
+    event.category = category;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+    event.threadId = threadId ? threadId : ring.threadId;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void TraceSetThreadName(const char* name) {
+    // Threads that never record an event get no ring
+    t_trace.name = name;
+    if (!t_trace.ring) return;
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    t_trace.ring->threadName = name;
+}
+
+size_t TraceCollect(std::vector<TraceEvent>& events) {
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t before = events.size();
+    for (auto& ring : registry.rings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; i++) events.push_back(ring->events[i % kTraceRingEvents]);
+        ring->tail.store(head, std::memory_order_release);
+    }
+    return events.size() - before;
+}
+
+uint64_t TraceDroppedEvents() {
+    return g_droppedEvents.load(std::memory_order_relaxed);
+}
+
+size_t TraceRingCount() {
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.rings.size();
+}
+
+void TraceStats::Add(const TraceEvent* events, size_t count) {
+    // Sum this collection's events per name
+    std::vector<double> sums(m_entries.size(), 0.0);
+    std::vector<bool> seen(m_entries.size(), false);
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent& event = events[i];
+        size_t index = 0;
+        while (index < m_entries.size() && strcmp(m_entries[index].name, event.name) != 0) index++;
+        if (index == m_entries.size()) {
+            Entry entry;
+            entry.name = event.name;
+            entry.category = event.category;
+            m_entries.push_back(entry);
+            sums.push_back(0.0);
+            seen.push_back(false);
+        }
+        m_entries[index].count++;
+        sums[index] += event.durationNs / 1e6;
+        seen[index] = true;
+    }
+
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (!seen[i]) continue;
+        Entry& entry = m_entries[i];
+        entry.lastMs = sums[i];
+        entry.averageMs = entry.collections == 0 ? sums[i] : entry.averageMs + 0.1 * (sums[i] - entry.averageMs);
+        entry.collections++;
+        entry.maxMs = std::max(entry.maxMs, sums[i]);
+    }
+}
+
+bool WriteChromeTrace(const std::string& path, const std::vector<TraceEvent>& events) {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char buffer[160];
+
+    // Thread names as metadata events
+    {
+        std::lock_guard<std::mutex> lock(Registry().mutex);
+        for (const auto& ring : Registry().rings) {
+            if (ring->threadName.empty()) continue;
+            snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+                ring->threadId);
+            json += buffer;
+            AppendJsonString(json, ring->threadName.c_str());
+            json += "}},\n";
+        }
+    }
+    snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"GPU\"}}",
+        kGpuTraceThread);
+    json += buffer;
+
+    for (const TraceEvent& event : events) {
+        json += ",\n{\"ph\":\"X\",\"name\":";
+        AppendJsonString(json, event.name);
+        json += ",\"cat\":";
+        AppendJsonString(json, event.category);
+        snprintf(buffer, sizeof(buffer), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.threadId, event.startNs / 1000.0, event.durationNs / 1000.0);
+        json += buffer;
+    }
+    json += "\n]}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(json.data(), (std::streamsize)json.size());
+    file.close();
+    return !file.fail();
+}
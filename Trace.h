@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Low-overhead timing of pipeline stages. ScopedTrace records one complete
+// event (name, start, duration) into a ring owned by the calling thread;
+// pushing is a couple of atomic loads and one store, and nothing is recorded
+// while tracing is disabled. A single consumer (the frame loop, or a tool at
+// exit) drains every ring with TraceCollect and feeds the events to
+// TraceStats for a live panel or to WriteChromeTrace for chrome://tracing and
+// Perfetto.
+//
+// Names and categories must outlive the trace; pass string literals.
+
+struct TraceEvent {
+    const char* name = nullptr;
+    const char* category = nullptr;
+    uint64_t startNs = 0; // TraceNowNs() clock
+    uint64_t durationNs = 0;
+    uint32_t threadId = 0;
+};
+
+// Thread id for events measured on the GPU and placed on the CPU timeline.
+constexpr uint32_t kGpuTraceThread = 0xFFFF;
+
+// Events each thread's ring holds between collections. When a ring is full,
+// new events are dropped and counted rather than blocking the producer. A
+// thread gets its ring on its first event, and the ring of a thread that has
+// ended is reused once its events are collected.
+constexpr size_t kTraceRingEvents = 1 << 14;
+
+void SetTracingEnabled(bool enabled);
+bool TracingEnabled();
+
+// Nanoseconds on a monotonic clock, counted from the first call.
+uint64_t TraceNowNs();
+
+// Records an event measured by other means, e.g. a GPU timestamp pair.
+// threadId 0 means the calling thread.
+void TraceRecord(const char* name, const char* category, uint64_t startNs, uint64_t durationNs,
+    uint32_t threadId = 0);
+
+// Label for the calling thread in exported traces.
+void TraceSetThreadName(const char* name);
+
+// Moves every event recorded so far onto the end of events and returns how
+// many were added. Only one thread may collect at a time.
+size_t TraceCollect(std::vector<TraceEvent>& events);
+
+// Events lost to full rings since the start.
+uint64_t TraceDroppedEvents();
+
+// Rings allocated so far, live or waiting for reuse.
+size_t TraceRingCount();
+
+class ScopedTrace {
+public:
+    explicit ScopedTrace(const char* name, const char* category = "cpu")
+        : m_name(name), m_category(category), m_startNs(TracingEnabled() ? TraceNowNs() : 0) {}
+    ~ScopedTrace() { End(); }
+
+    // Records the event now rather than at the end of the scope
+    void End() {
+        if (m_startNs) TraceRecord(m_name, m_category, m_startNs, TraceNowNs() - m_startNs);
+        m_startNs = 0;
+    }
+
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_category;
+    uint64_t m_startNs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ScopedTrace TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+// Per-name timings over successive collections, for a stats panel. Events of
+// the same name in one Add are summed (a pass split into tiles counts once,
+// as CPU time across threads).
+class TraceStats {
+public:
+    struct Entry {
+        const char* name = nullptr;
+        const char* category = nullptr;
+        uint64_t count = 0;       // events seen
+        uint64_t collections = 0; // Adds that had this name
+        double lastMs = 0.0;
+        double averageMs = 0.0; // moving average over recent collections
+        double maxMs = 0.0;
+    };
+
+    void Add(const TraceEvent* events, size_t count);
+    void Reset() { m_entries.clear(); }
+    const std::vector<Entry>& Entries() const { return m_entries; }
+
+private:
+    std::vector<Entry> m_entries; // in order of first appearance
+};
+
+// Chrome trace event format ("X" complete events, microseconds), which
+// chrome://tracing and ui.perfetto.dev both open.
+bool WriteChromeTrace(const std::string& path, const std::vector<TraceEvent>& events);
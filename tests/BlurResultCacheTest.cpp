@@ -0,0 +1,139 @@
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "BlurResultCache.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// 16x16 RGBA8: 1024 bytes each
+constexpr size_t kImageBytes = 16 * 16 * 4;
+
+std::shared_ptr<const CpuImage> MakeImage(uint8_t fill, uint32_t side = 16) {
+    auto image = std::make_shared<CpuImage>(side, side);
+    for (uint8_t& value : image->pixels) value = fill;
+    return image;
+}
+
+BlurCacheKey MakeKey(uint64_t sourceHash, int32_t sigmaSteps = 1024) {
+    BlurCacheKey key;
+    key.sourceHash = sourceHash;
+    key.sigmaSteps = sigmaSteps;
+    return key;
+}
+
+void TestLruOrder() {
+    BlurResultCache cache(3 * kImageBytes);
+    cache.Insert(MakeKey(1), MakeImage(1));
+    cache.Insert(MakeKey(2), MakeImage(2));
+    cache.Insert(MakeKey(3), MakeImage(3));
+    // 1 becomes the most recently used, leaving 2 the oldest
+    CHECK(cache.Find(MakeKey(1)));
+    cache.Insert(MakeKey(4), MakeImage(4));
+    CHECK(!cache.Find(MakeKey(2)), "least recently used entry kept");
+    CHECK(cache.Find(MakeKey(1)) && cache.Find(MakeKey(3)) && cache.Find(MakeKey(4)));
+
+    BlurResultCache::Stats stats = cache.GetStats();
+    CHECK(stats.entries == 3 && stats.bytes == 3 * kImageBytes, "entries %zu bytes %zu", stats.entries, stats.bytes);
+    CHECK(stats.evictions == 1 && stats.insertions == 4, "evictions %llu", (unsigned long long)stats.evictions);
+    CHECK(stats.misses == 1 && stats.hits == 4, "hits %llu misses %llu", (unsigned long long)stats.hits,
+        (unsigned long long)stats.misses);
+
+    // Keys differing only in engine are separate entries
+    BlurCacheKey other = MakeKey(4);
+    other.engine = CpuBlurEngine::BoxCascade;
+    CHECK(!cache.Find(other));
+}
+
+void TestBudgetShrink() {
+    BlurResultCache cache(4 * kImageBytes);
+    for (uint64_t i = 1; i <= 4; i++) cache.Insert(MakeKey(i), MakeImage((uint8_t)i));
+    CHECK(cache.Find(MakeKey(1))); // order, newest first: 1 4 3 2
+    std::shared_ptr<const CpuImage> held = cache.Find(MakeKey(2)); // 2 1 4 3
+
+    cache.SetBudget(2 * kImageBytes + kImageBytes / 2);
+    BlurResultCache::Stats stats = cache.GetStats();
+    CHECK(stats.entries == 2 && stats.bytes == 2 * kImageBytes && stats.budgetBytes == 2 * kImageBytes + kImageBytes / 2,
+        "entries %zu bytes %zu", stats.entries, stats.bytes);
+    CHECK(cache.Find(MakeKey(2)) && cache.Find(MakeKey(1)));
+    CHECK(!cache.Find(MakeKey(3)) && !cache.Find(MakeKey(4)));
+
+    // A result handed out before stays valid after its eviction
+    cache.SetBudget(0);
+    CHECK(cache.GetStats().entries == 0 && cache.GetStats().bytes == 0);
+    CHECK(held && held->pixels[0] == 2);
+
+    // Nothing larger than the whole budget is kept
+    cache.SetBudget(kImageBytes);
+    cache.Insert(MakeKey(5), MakeImage(5, 17));
+    CHECK(!cache.Find(MakeKey(5)) && cache.GetStats().bytes == 0);
+}
+
+void TestReplace() {
+    BlurResultCache cache(3 * kImageBytes);
+    cache.Insert(MakeKey(1), MakeImage(1));
+    cache.Insert(MakeKey(2), MakeImage(2));
+    cache.Insert(MakeKey(1), MakeImage(9, 8));
+    BlurResultCache::Stats stats = cache.GetStats();
+    CHECK(stats.entries == 2 && stats.bytes == kImageBytes + kImageBytes / 4, "entries %zu bytes %zu", stats.entries,
+        stats.bytes);
+    auto replaced = cache.Find(MakeKey(1));
+    CHECK(replaced && replaced->width == 8 && replaced->pixels[0] == 9);
+
+    // The replacement counts as the newest use
+    cache.Insert(MakeKey(3), MakeImage(3));
+    cache.Insert(MakeKey(2), MakeImage(2));
+    cache.Insert(MakeKey(4), MakeImage(4));
+    CHECK(!cache.Find(MakeKey(1)) && cache.Find(MakeKey(2)) && cache.Find(MakeKey(3)) && cache.Find(MakeKey(4)));
+
+    // Replacing with a result over budget drops the old one too
+    cache.Insert(MakeKey(2), MakeImage(2, 64));
+    CHECK(!cache.Find(MakeKey(2)));
+    CHECK(cache.GetStats().bytes == 2 * kImageBytes);
+}
+
+void TestSigmaQuantization() {
+    CHECK(kCacheSigmaStep == 1.0f / 1024.0f);
+    CHECK(QuantizeCacheSigma(0.0f) == 0 && QuantizeCacheSigma(-1.0f) == 0);
+    CHECK(QuantizeCacheSigma(1.0f) == 1024 && QuantizeCacheSigma(60.0f) == 60 * 1024);
+    for (float sigma = 0.0001f; sigma < 120.0f; sigma *= 1.37f) {
+        int32_t steps = QuantizeCacheSigma(sigma);
+        CHECK(std::fabs(CacheSigma(steps) - sigma) <= 0.5f * kCacheSigmaStep + sigma * 1e-6f, "sigma %g", sigma);
+        CHECK(QuantizeCacheSigma(CacheSigma(steps)) == steps, "sigma %g", sigma);
+    }
+    CHECK(QuantizeCacheSigma(5.0f + 0.4f * kCacheSigmaStep) == QuantizeCacheSigma(5.0f));
+    CHECK(QuantizeCacheSigma(5.0f + 0.6f * kCacheSigmaStep) == QuantizeCacheSigma(5.0f) + 1);
+
+    // Radii within a step share a result, which is the blur at the quantized
+    // sigma; one a step further is a miss
+    CpuImage src(40, 30);
+    for (size_t i = 0; i < src.pixels.size(); i++) src.pixels[i] = (uint8_t)(i * 37 % 251);
+    uint64_t hash = HashCpuImage(src);
+    ThreadPool pool(2);
+    BlurResultCache cache(1 << 20);
+    float blurRadius = 7.3f;
+    auto first = CpuBlurImageCached(cache, src, hash, blurRadius, CpuBlurEngine::Direct, pool);
+    auto second = CpuBlurImageCached(cache, src, hash, blurRadius + 0.4f * kCacheSigmaStep, CpuBlurEngine::Direct, pool);
+    CHECK(first == second, "radius within a sigma step missed");
+    auto third = CpuBlurImageCached(cache, src, hash, blurRadius + 2.5f * kCacheSigmaStep, CpuBlurEngine::Direct, pool);
+    CHECK(third != first, "radius a sigma step away hit");
+    CHECK(cache.GetStats().hits == 1 && cache.GetStats().misses == 2);
+
+    CpuImage fresh;
+    float quantizedRadius = 2.0f * CacheSigma(QuantizeCacheSigma(SigmaFromBlurRadius(blurRadius)));
+    CpuBlurImage(src, fresh, quantizedRadius, CpuBlurEngine::Direct, pool);
+    CHECK(first->pixels == fresh.pixels, "cached result differs from a fresh blur at its key");
+}
+
+} // namespace
+
+int main() {
+    TestLruOrder();
+    TestBudgetShrink();
+    TestReplace();
+    TestSigmaQuantization();
+    return TestExitCode();
+}
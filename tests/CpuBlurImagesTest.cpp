@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height, uint32_t seed) {
+    CpuImage image(width, height);
+    uint32_t state = seed;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 17 + y / 13) % 2 ? 200 : 40) + (state & 31));
+        }
+    }
+    return image;
+}
+
+// A batch of every size class, in no particular order: small ones the batch
+// hands to one thread each, up to one of exactly kCpuBlurBatchSmallPixels, and
+// two past it that it blurs with the whole pool
+struct TestJob {
+    uint32_t width, height;
+    float blurRadius;
+};
+
+const TestJob kJobs[] = {
+    { 64, 48, 3.0f },
+    { 1100, 1000, 12.0f },
+    { 1, 1, 5.0f },
+    { 300, 7, 40.0f },
+    { 1024, 1024, 2.0f },
+    { 1025, 1024, 4.0f },
+    { 1, 1025, 8.0f },
+    { 211, 157, 20.0f },
+    { 33, 290, 1.0f },
+    { 640, 480, 0.5f },
+};
+
+// Every engine, on a pool of several threads, gives each image what
+// CpuBlurImage gives it alone; destinations of the wrong size are resized and
+// a job may blur in place
+void TestMatchesCpuBlurImage() {
+    ThreadPool pool(3);
+    std::vector<CpuImage> sources;
+    bool small = false, large = false;
+    for (const TestJob& job : kJobs) {
+        sources.push_back(MakeTestImage(job.width, job.height, 2463534242u + job.width * 31 + job.height));
+        size_t pixels = (size_t)job.width * job.height;
+        small |= pixels <= kCpuBlurBatchSmallPixels;
+        large |= pixels > kCpuBlurBatchSmallPixels;
+    }
+    CHECK(small && large);
+    CHECK((size_t)kJobs[4].width * kJobs[4].height == kCpuBlurBatchSmallPixels);
+
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        CpuBlurEngine engine = (CpuBlurEngine)e;
+        std::vector<CpuImage> expected(sources.size());
+        for (size_t i = 0; i < sources.size(); i++) {
+            CpuBlurImage(sources[i], expected[i], kJobs[i].blurRadius, engine, pool);
+        }
+
+        std::vector<CpuImage> outputs(sources.size(), CpuImage(5, 3));
+        std::vector<CpuImage> inPlace = sources;
+        std::vector<CpuBlurJob> jobs;
+        for (size_t i = 0; i < sources.size(); i++) {
+            // Every other image blurs over its own copy of the source
+            CpuBlurJob job;
+            job.src = i % 2 ? &inPlace[i] : &sources[i];
+            job.dst = i % 2 ? &inPlace[i] : &outputs[i];
+            job.blurRadius = kJobs[i].blurRadius;
+            jobs.push_back(job);
+        }
+        CpuBlurImages(jobs, engine, pool);
+
+        for (size_t i = 0; i < sources.size(); i++) {
+            const CpuImage& output = i % 2 ? inPlace[i] : outputs[i];
+            CHECK(output.width == kJobs[i].width && output.height == kJobs[i].height &&
+                    output.pixels == expected[i].pixels,
+                "%s: %ux%u radius %g differs from CpuBlurImage", CpuBlurEngineName(engine), kJobs[i].width,
+                kJobs[i].height, kJobs[i].blurRadius);
+        }
+    }
+}
+
+// An empty batch does nothing
+void TestEmpty() {
+    ThreadPool pool(2);
+    CpuBlurImages({}, CpuBlurEngine::Direct, pool);
+}
+
+} // namespace
+
+int main() {
+    TestMatchesCpuBlurImage();
+    TestEmpty();
+    return TestExitCode();
+}
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlur.h"
+#include "CpuBlurEngine.h"
+#include "CpuBlurKernels.h"
+#include "CpuFeatures.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+const CpuIsa kIsas[] = { CpuIsa::Scalar, CpuIsa::Sse41, CpuIsa::Avx2, CpuIsa::Avx512 };
+
+// The engines that run row kernels picked by instruction set
+const CpuBlurEngine kEngines[] = { CpuBlurEngine::Direct, CpuBlurEngine::FixedPoint, CpuBlurEngine::LinearLight };
+
+// Copy, the radii with specialized kernels, and wider generic ones
+const float kBlurRadii[] = { 0.001f, 1.0f, 3.0f, 8.0f, 16.0f, 17.0f, 40.0f, 120.0f };
+
+// Odd sizes, so that every SIMD loop leaves a scalar tail
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 88172645u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            // Flat blocks with hard edges over noise, and the extremes
+            row[x] = (uint8_t)((((x / 4) / 23 + y / 19) % 3 == 0 ? 255 : 0) ^ (state & 31));
+        }
+    }
+    return image;
+}
+
+// Every blur run under isa, in a fixed order
+std::vector<CpuImage> RunBlurs(CpuIsa isa, const CpuImage& src, ThreadPool& pool) {
+    SetCpuBlurIsa(isa);
+    std::vector<CpuImage> results;
+    for (bool specialized : { true, false }) {
+        SetCpuBlurKernelSpecialization(specialized);
+        for (CpuBlurEngine engine : kEngines) {
+            for (float blurRadius : kBlurRadii) {
+                results.emplace_back();
+                CpuBlurImage(src, results.back(), blurRadius, engine, pool);
+            }
+        }
+    }
+    SetCpuBlurKernelSpecialization(true);
+
+    // Both ways of running the vertical pass
+    for (float blurRadius : kBlurRadii) {
+        auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+        results.emplace_back(src.width, src.height);
+        CpuBlurVerticalRows(src, results.back(), *kernel, 0, src.height, 0, src.width);
+        results.emplace_back(src.width, src.height);
+        CpuBlurVerticalRowsTransposed(src, results.back(), *kernel, 0, src.height, 0, src.width);
+    }
+    return results;
+}
+
+void TestIsasMatchScalar() {
+    CpuImage src = MakeTestImage(203, 97);
+    ThreadPool pool(3);
+    std::vector<CpuImage> scalar = RunBlurs(CpuIsa::Scalar, src, pool);
+    for (CpuIsa isa : kIsas) {
+        std::vector<CpuImage> results = RunBlurs(isa, src, pool);
+        CpuIsa ran = GetCpuBlurIsa();
+        if (ran != isa) printf("%s not supported here, ran %s\n", CpuIsaName(isa), CpuIsaName(ran));
+        CHECK(results.size() == scalar.size());
+        for (size_t i = 0; i < results.size() && i < scalar.size(); i++) {
+            CHECK(results[i].pixels == scalar[i].pixels, "%s differs from scalar in blur %zu", CpuIsaName(ran), i);
+        }
+    }
+    SetCpuBlurIsa(DetectCpuIsa());
+}
+
+} // namespace
+
+int main() {
+    TestIsasMatchScalar();
+    return TestExitCode();
+}
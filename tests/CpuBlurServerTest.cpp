@@ -0,0 +1,228 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "CpuBlurEngine.h"
+#include "CpuBlurServer.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+std::string g_tag;
+
+std::string SocketPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / ("rtblur-test-" + g_tag + "-" + name + ".sock")).string();
+}
+
+std::string SegmentName(const char* name) {
+    return "/rtblur-test-" + g_tag + "-" + name;
+}
+
+void Fill(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t seed) {
+    uint32_t state = seed;
+    for (size_t i = 0; i < (size_t)width * height * 4; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        size_t x = i / 4 % width, y = i / 4 / width;
+        pixels[i] = (uint8_t)(((x / 7 + y / 5) % 2 ? 190 : 50) + (state & 31));
+    }
+}
+
+CpuImage Copy(const uint8_t* pixels, uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    memcpy(image.pixels.data(), pixels, image.pixels.size());
+    return image;
+}
+
+// Waits up to two seconds for count requests to be waiting in the queue
+bool WaitForQueued(const BlurServer& server, size_t count) {
+    for (int i = 0; i < 2000; i++) {
+        std::string json = server.StatsJson();
+        size_t at = json.find("\"queued\": ");
+        if (at != std::string::npos && (size_t)atoi(json.c_str() + at + 10) == count) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+struct ServerCase {
+    uint32_t width, height;
+    float blurRadius;
+    CpuBlurEngine engine;
+    bool inPlace;
+};
+
+// Every engine, through the segment and back, matches blurring locally
+void TestRoundTrip() {
+    BlurServerOptions options;
+    options.socketPath = SocketPath("round-trip");
+    options.threads = 2;
+    BlurServer server;
+    std::string error;
+    CHECK(server.Start(options, &error), "%s", error.c_str());
+
+    const ServerCase cases[] = {
+        { 64, 48, 3.0f, CpuBlurEngine::Direct, false },
+        { 203, 97, 12.0f, CpuBlurEngine::Direct, true },
+        { 130, 70, 20.0f, CpuBlurEngine::BoxCascade, false },
+        { 90, 90, 8.0f, CpuBlurEngine::Recursive, true },
+        { 160, 120, 40.0f, CpuBlurEngine::Pyramid, false },
+        { 77, 33, 5.0f, CpuBlurEngine::FixedPoint, false },
+        { 100, 60, 6.0f, CpuBlurEngine::LinearLight, true },
+    };
+    SharedSegment segment;
+    CHECK(segment.Create(SegmentName("round-trip"), 2 * 203 * 97 * 4, &error), "%s", error.c_str());
+    BlurClient client;
+    CHECK(client.Connect(options.socketPath, &error), "%s", error.c_str());
+    ThreadPool pool(2);
+    uint32_t seed = 1;
+    for (const ServerCase& c : cases) {
+        size_t bytes = (size_t)c.width * c.height * 4;
+        size_t dstOffset = c.inPlace ? 0 : bytes;
+        Fill(segment.Data(), c.width, c.height, seed++);
+        CpuImage src = Copy(segment.Data(), c.width, c.height), expected;
+        CpuBlurImage(src, expected, c.blurRadius, c.engine, pool);
+        BlurReply reply;
+        bool ok = client.Blur(segment, 0, dstOffset, c.width, c.height, c.blurRadius, c.engine, 0, &reply, &error);
+        CHECK(ok && reply.status == BlurServerStatus::Ok, "%s: %s", CpuBlurEngineName(c.engine), error.c_str());
+        CHECK(!memcmp(segment.Data() + dstOffset, expected.pixels.data(), bytes), "%s %ux%u radius %g differs",
+            CpuBlurEngineName(c.engine), c.width, c.height, c.blurRadius);
+    }
+    server.Stop();
+    CHECK(!std::filesystem::exists(options.socketPath), "Stop left the socket file");
+}
+
+// With one request blurred at a time, two that queue behind a long blur run
+// highest priority first. Both write the same destination, so the one that
+// ran last is the one left there.
+void TestPriority() {
+    BlurServerOptions options;
+    options.socketPath = SocketPath("priority");
+    options.threads = 1;
+    options.maxBatch = 1;
+    BlurServer server;
+    std::string error;
+    CHECK(server.Start(options, &error), "%s", error.c_str());
+
+    const uint32_t bigSide = 2048, side = 64;
+    size_t bigBytes = (size_t)bigSide * bigSide * 4, bytes = (size_t)side * side * 4;
+    SharedSegment segment;
+    CHECK(segment.Create(SegmentName("priority"), 2 * bigBytes + 3 * bytes, &error), "%s", error.c_str());
+    uint8_t* low = segment.Data() + 2 * bigBytes;
+    uint8_t* high = low + bytes;
+    Fill(segment.Data(), bigSide, bigSide, 7);
+    Fill(low, side, side, 8);
+    Fill(high, side, side, 9);
+    CpuImage lowResult;
+    ThreadPool pool(1);
+    CpuBlurImage(Copy(low, side, side), lowResult, 4.0f, CpuBlurEngine::Direct, pool);
+
+    auto blur = [&](size_t srcOffset, size_t dstOffset, uint32_t size, float radius, int priority) {
+        BlurClient client;
+        std::string clientError;
+        bool ok = client.Connect(options.socketPath, &clientError) &&
+            client.Blur(segment, srcOffset, dstOffset, size, size, radius, CpuBlurEngine::Direct, priority,
+                nullptr, &clientError);
+        CHECK(ok, "%s", clientError.c_str());
+    };
+    size_t dstOffset = 2 * bigBytes + 2 * bytes;
+    std::thread blocker(blur, 0, bigBytes, bigSide, 100.0f, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread lowClient(blur, 2 * bigBytes, dstOffset, side, 4.0f, 0);
+    bool bothQueued = WaitForQueued(server, 1);
+    std::thread highClient(blur, 2 * bigBytes + bytes, dstOffset, side, 4.0f, 5);
+    bothQueued = bothQueued && WaitForQueued(server, 2);
+    blocker.join();
+    lowClient.join();
+    highClient.join();
+    CHECK(bothQueued, "the long blur finished before both requests queued");
+    CHECK(!memcmp(segment.Data() + dstOffset, lowResult.pixels.data(), bytes),
+        "the lower priority request didn't run last");
+}
+
+// Bad requests and segments get an error status, and the connection goes on
+void TestErrors() {
+    BlurServerOptions options;
+    options.socketPath = SocketPath("errors");
+    options.threads = 1;
+    BlurServer server;
+    std::string error;
+    CHECK(server.Start(options, &error), "%s", error.c_str());
+    BlurClient client;
+    CHECK(client.Connect(options.socketPath, &error), "%s", error.c_str());
+
+    SharedSegment segment;
+    CHECK(segment.Create(SegmentName("errors"), 32 * 32 * 4, &error), "%s", error.c_str());
+    BlurReply reply;
+    CHECK(!client.Blur(segment, 0, 0, 32, 32, 4.0f, (CpuBlurEngine)99, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::BadRequest, "%s", BlurServerStatusName(reply.status));
+    CHECK(!client.Blur(segment, 0, 0, 0, 32, 4.0f, CpuBlurEngine::Direct, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::BadRequest, "%s", BlurServerStatusName(reply.status));
+    CHECK(!client.Blur(segment, 0, 0, 32, 32, -1.0f, CpuBlurEngine::Direct, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::BadRequest, "%s", BlurServerStatusName(reply.status));
+    CHECK(!client.Blur(segment, 4, 0, 32, 32, 4.0f, CpuBlurEngine::Direct, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::OutOfBounds, "%s", BlurServerStatusName(reply.status));
+    CHECK(!client.Blur(segment, 0, 0, 64, 64, 4.0f, CpuBlurEngine::Direct, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::OutOfBounds, "%s", BlurServerStatusName(reply.status));
+
+    // Opened by name, then removed by its creator
+    SharedSegment removed;
+    {
+        SharedSegment creator;
+        CHECK(creator.Create(SegmentName("removed"), 32 * 32 * 4, &error), "%s", error.c_str());
+        CHECK(removed.Open(creator.Name(), &error), "%s", error.c_str());
+    }
+    CHECK(!client.Blur(removed, 0, 0, 32, 32, 4.0f, CpuBlurEngine::Direct, 0, &reply));
+    CHECK(reply.status == BlurServerStatus::BadSegment, "%s", BlurServerStatusName(reply.status));
+
+    CHECK(client.Connected(), "an error status closed the connection");
+    CHECK(client.Blur(segment, 0, 0, 32, 32, 4.0f, CpuBlurEngine::Direct, 0, &reply, &error), "%s", error.c_str());
+    std::string json;
+    CHECK(client.Stats(json, &error), "%s", error.c_str());
+    CHECK(json.find("\"requests\": 7") != std::string::npos && json.find("\"errors\": 6") != std::string::npos,
+        "%s", json.c_str());
+}
+
+// A second server doesn't take a live server's socket; a stale one is replaced
+void TestSocketInUse() {
+    BlurServerOptions options;
+    options.socketPath = SocketPath("in-use");
+    options.threads = 1;
+    BlurServer first, second;
+    std::string error;
+    CHECK(first.Start(options, &error), "%s", error.c_str());
+    CHECK(!second.Start(options, &error));
+    CHECK(error.find("already in use") != std::string::npos, "%s", error.c_str());
+    BlurClient client;
+    CHECK(client.Connect(options.socketPath, &error), "the first server lost its socket: %s", error.c_str());
+    first.Stop();
+
+    // Left behind by a server that never removed it
+    Socket::ListenLocal(options.socketPath, &error).Close();
+    CHECK(std::filesystem::exists(options.socketPath));
+    CHECK(second.Start(options, &error), "%s", error.c_str());
+    second.Stop();
+
+    std::ofstream(options.socketPath) << "not a socket";
+    CHECK(!second.Start(options, &error));
+    CHECK(std::filesystem::exists(options.socketPath), "a regular file was removed");
+    std::filesystem::remove(options.socketPath);
+}
+
+} // namespace
+
+int main() {
+    g_tag = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000007);
+    TestRoundTrip();
+    TestPriority();
+    TestErrors();
+    TestSocketInUse();
+    return TestExitCode();
+}
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlurTiled.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// Kernel radii 1 to 3, which Auto runs fused, and wider ones past
+// kCpuBlurFusedMaxRadius that only a forced schedule fuses
+const float kBlurRadii[] = { 1.0f, 1.5f, 2.0f, 3.0f, 4.0f, 8.0f, 24.0f };
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 88172645u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 23 + y / 19) % 3 == 0 ? 255 : 0) ^ (state & 31));
+        }
+    }
+    return image;
+}
+
+CpuImage Blur(const CpuImage& src, float blurRadius, CpuBlurSchedule schedule, ThreadPool& pool) {
+    SetCpuBlurSchedule(schedule);
+    CpuImage dst;
+    CpuGaussianBlurTiled(src, dst, blurRadius, pool);
+    SetCpuBlurSchedule(CpuBlurSchedule::Auto);
+    return dst;
+}
+
+// The fused schedule gives the two-pass result bit for bit, on an image cut
+// into several tiles each way, so that tile edges and image edges both fall
+// inside every kernel's reach
+void TestFusedMatchesTwoPass() {
+    CpuImage src = MakeTestImage(2100, 700);
+    ThreadPool pool(3);
+    bool belowBound = false, pastBound = false;
+    for (float blurRadius : kBlurRadii) {
+        int kernelRadius = GetGaussianKernel(SigmaFromBlurRadius(blurRadius))->radius;
+        belowBound |= kernelRadius <= kCpuBlurFusedMaxRadius;
+        pastBound |= kernelRadius > kCpuBlurFusedMaxRadius;
+
+        CpuBlurTiling tiling = ChooseCpuBlurTiling(src.width, src.height, kernelRadius);
+        uint32_t tileRows = CpuBlurFusedTileRows(tiling, src.width, src.height, kernelRadius, pool.ThreadCount());
+        CHECK(tiling.fusedColumns < src.width && tileRows < src.height, "radius %d: one %ux%u tile", kernelRadius,
+            tiling.fusedColumns, tileRows);
+
+        CpuImage twoPass = Blur(src, blurRadius, CpuBlurSchedule::TwoPass, pool);
+        CpuImage fused = Blur(src, blurRadius, CpuBlurSchedule::Fused, pool);
+        CHECK(fused.pixels == twoPass.pixels, "kernel radius %d: fused differs from two-pass", kernelRadius);
+
+        // Auto picks one of the two, by the bound
+        CpuBlurSchedule resolved = ResolveCpuBlurSchedule(src.width, src.height, kernelRadius, pool.ThreadCount());
+        CHECK(resolved == (kernelRadius <= kCpuBlurFusedMaxRadius ? CpuBlurSchedule::Fused : CpuBlurSchedule::TwoPass),
+            "kernel radius %d: Auto picked %s", kernelRadius, CpuBlurScheduleName(resolved));
+        CHECK(Blur(src, blurRadius, CpuBlurSchedule::Auto, pool).pixels == twoPass.pixels);
+    }
+    CHECK(belowBound && pastBound);
+}
+
+// Images narrower or shorter than the halo, where every row and column clamps
+void TestSmallImages() {
+    ThreadPool pool(2);
+    const uint32_t sizes[][2] = { { 1, 1 }, { 1, 40 }, { 40, 1 }, { 7, 5 }, { 33, 9 } };
+    for (const auto& size : sizes) {
+        CpuImage src = MakeTestImage(size[0], size[1]);
+        for (float blurRadius : kBlurRadii) {
+            CpuImage twoPass = Blur(src, blurRadius, CpuBlurSchedule::TwoPass, pool);
+            CpuImage fused = Blur(src, blurRadius, CpuBlurSchedule::Fused, pool);
+            CHECK(fused.pixels == twoPass.pixels, "%ux%u radius %g: fused differs from two-pass", size[0], size[1],
+                blurRadius);
+        }
+    }
+}
+
+// Same output on any thread count, which changes how tall the fused tiles are,
+// and in place, where the fused schedule falls back to two passes
+void TestThreadsAndInPlace() {
+    CpuImage src = MakeTestImage(517, 403);
+    ThreadPool one(1), four(4);
+    for (float blurRadius : { 2.0f, 8.0f }) {
+        CpuImage expected = Blur(src, blurRadius, CpuBlurSchedule::TwoPass, one);
+        CHECK(Blur(src, blurRadius, CpuBlurSchedule::Fused, one).pixels == expected.pixels, "radius %g", blurRadius);
+        CHECK(Blur(src, blurRadius, CpuBlurSchedule::Fused, four).pixels == expected.pixels, "radius %g", blurRadius);
+
+        CpuImage inPlace = src;
+        SetCpuBlurSchedule(CpuBlurSchedule::Fused);
+        CpuGaussianBlurTiled(inPlace, inPlace, blurRadius, four);
+        SetCpuBlurSchedule(CpuBlurSchedule::Auto);
+        CHECK(inPlace.pixels == expected.pixels, "radius %g in place", blurRadius);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestFusedMatchesTwoPass();
+    TestSmallImages();
+    TestThreadsAndInPlace();
+    return TestExitCode();
+}
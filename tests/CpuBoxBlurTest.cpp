@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuReferenceBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// 29x31 blocks over noise; 204x125 leaves a one-pixel block along the right
+// and bottom edges, where clamping each box instead of the source shows most
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 362436069u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 29 + y / 31) % 2 ? 230 : 20) + (state & 15));
+        }
+    }
+    return image;
+}
+
+// Widths of two neighbouring odd sizes, whose variances add up to sigma^2
+// within half the step between them; the combined weights sum to one and have
+// that variance
+void TestCascadeWidths() {
+    for (double sigma = 0.3; sigma < 300.0; sigma *= 1.02) {
+        BoxCascade cascade = BuildBoxCascade((float)sigma);
+        CHECK(cascade.radii.size() == 3);
+        int smallest = *std::min_element(cascade.radii.begin(), cascade.radii.end());
+        int largest = *std::max_element(cascade.radii.begin(), cascade.radii.end());
+        CHECK(largest - smallest <= 1, "sigma %g: radii %d to %d", sigma, smallest, largest);
+
+        double variance = 0.0;
+        for (int radius : cascade.radii) variance += radius * (radius + 1.0) / 3.0;
+        CHECK(std::fabs(std::sqrt(variance) - cascade.achievedSigma) <= 1e-9, "sigma %g", sigma);
+        double target = (double)cascade.sigma * cascade.sigma;
+        double halfStep = (2 * smallest + 2) / 6.0;
+        CHECK(std::fabs(variance - target) <= halfStep, "sigma %g: variance %g", sigma, variance);
+
+        std::vector<double> weights = BoxCascadeWeights(cascade);
+        int reach = (int)weights.size() / 2;
+        double sum = 0.0, second = 0.0;
+        for (int x = -reach; x <= reach; x++) {
+            sum += weights[x + reach];
+            second += weights[x + reach] * x * x;
+        }
+        CHECK(std::fabs(sum - 1.0) <= 1e-9 && std::fabs(second - variance) <= 1e-6 * (1.0 + variance),
+            "sigma %g: sum %g variance %g", sigma, sum, second);
+    }
+}
+
+// Against the untruncated Gaussian, edges included: within what the combined
+// kernel's L1 distance allows for two passes over 8-bit data, plus a step of
+// rounding (about 11 to 14 steps from radius 3; under 5 measured)
+void TestImageError() {
+    CpuImage src = MakeTestImage(204, 125), box;
+    ThreadPool pool(2);
+    std::vector<double> reference;
+    for (float blurRadius : { 3.0f, 5.0f, 8.0f, 12.0f, 20.0f, 40.0f, 80.0f, 160.0f }) {
+        float sigma = SigmaFromBlurRadius(blurRadius);
+        KernelError kernel = MeasureKernelError(BoxCascadeWeights(BuildBoxCascade(sigma)), sigma);
+        double bound = kernel.l1 * 255.0 + 1.0;
+        CpuBlurImage(src, box, blurRadius, CpuBlurEngine::BoxCascade, pool);
+        CHECK(box.width == src.width && box.height == src.height);
+        CpuReferenceGaussianBlur(src, reference, sigma, pool);
+        ImageError error = MeasureImageError(box, reference);
+        CHECK(error.maxAbs <= bound, "radius %g: max %.2f past the bound %.2f", blurRadius, error.maxAbs, bound);
+        CHECK(error.maxAbs <= 6.0, "radius %g: max %.2f", blurRadius, error.maxAbs);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestCascadeWidths();
+    TestImageError();
+    return TestExitCode();
+}
@@ -0,0 +1,232 @@
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "CpuBlur.h"
+#include "CpuEngineProfile.h"
+#include "CpuFeatures.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// 1000x1000, so PredictMs is the fixed cost plus nsPerPixel in milliseconds
+constexpr uint32_t kSide = 1000;
+
+std::string TempPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary) << contents;
+}
+
+void SetCost(CpuEngineProfile& profile, CpuBlurEngine engine, double overheadMs, const double (&nsPerPixel)[6],
+    double maxError)
+{
+    CpuEngineCost& cost = profile.costs[(size_t)engine];
+    cost.calibrated = true;
+    for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+        cost.overheadMs[r] = overheadMs;
+        cost.nsPerPixel[r] = nsPerPixel[r];
+        cost.maxError[r] = maxError;
+    }
+}
+
+// Direct slows with the radius and is the most accurate; the others trade
+// error for speed: box fastest, then recursive, pyramid, fixed point.
+// LinearLight is fastest and exact, to show it is never picked.
+CpuEngineProfile MakeProfile(const ThreadPool& pool) {
+    CpuEngineProfile profile;
+    profile.isa = CpuIsaName(GetCpuBlurIsa());
+    profile.threads = pool.ThreadCount();
+    SetCost(profile, CpuBlurEngine::Direct, 0.05, { 5, 13, 33, 81, 161, 241 }, 0.25);
+    SetCost(profile, CpuBlurEngine::BoxCascade, 0.1, { 3, 3, 3, 3, 3, 3 }, 3.0);
+    SetCost(profile, CpuBlurEngine::Recursive, 0.1, { 5, 5, 5, 5, 5, 5 }, 1.5);
+    SetCost(profile, CpuBlurEngine::Pyramid, 0.2, { 9, 9, 8, 8, 8, 8 }, 2.0);
+    SetCost(profile, CpuBlurEngine::FixedPoint, 0.05, { 2.5, 6.5, 16.5, 40.5, 80.5, 120.5 }, 0.75);
+    SetCost(profile, CpuBlurEngine::LinearLight, 0.01, { 0.1, 0.1, 0.1, 0.1, 0.1, 0.1 }, 0.0);
+    return profile;
+}
+
+// Saved and loaded back unchanged, for the same ISA and pool size; LinearLight
+// isn't saved as pickable
+void TestRoundTrip() {
+    ThreadPool pool(2), other(3);
+    CpuEngineProfile profile = MakeProfile(pool);
+    profile.costs[(size_t)CpuBlurEngine::Pyramid].maxError[4] = 1.25;
+    std::string path = TempPath("rtblur-engine-profile-test.txt"), error;
+    CHECK(SaveCpuEngineProfile(path, profile, &error), "%s", error.c_str());
+
+    CpuEngineProfile loaded;
+    CHECK(LoadCpuEngineProfile(path, loaded, &error), "%s", error.c_str());
+    CHECK(loaded.isa == profile.isa && loaded.threads == profile.threads);
+    CHECK(loaded.Matches(pool) && !loaded.Matches(other));
+    for (int e = 0; e < (int)CpuBlurEngine::Count; e++) {
+        const CpuEngineCost& a = profile.costs[e];
+        const CpuEngineCost& b = loaded.costs[e];
+        CHECK(b.calibrated == (a.calibrated && (CpuBlurEngine)e != CpuBlurEngine::LinearLight), "engine %d", e);
+        for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+            CHECK(a.overheadMs[r] == b.overheadMs[r] && a.nsPerPixel[r] == b.nsPerPixel[r] &&
+                    a.maxError[r] == b.maxError[r],
+                "engine %d radius %d", e, r);
+        }
+    }
+
+    CpuEngineProfile otherIsa = profile;
+    otherIsa.isa = "not-an-isa";
+    CHECK(!otherIsa.Matches(pool));
+    std::filesystem::remove(path);
+}
+
+// A missing file, another header, other calibration radii or no thread count
+// are all refused with a message, leaving the profile as it was
+void TestRejected() {
+    ThreadPool pool(2);
+    std::string path = TempPath("rtblur-engine-profile-test.txt"), error;
+    CHECK(SaveCpuEngineProfile(path, MakeProfile(pool)));
+    std::string saved = ReadFile(path);
+
+    std::string radii = "radii";
+    for (float radius : kCpuEngineCalibrationRadius) radii += " " + std::to_string((int)radius);
+    CHECK(saved.find(radii + "\n") != std::string::npos, "%s", saved.c_str());
+    auto replaced = [&](const std::string& from, const std::string& to) {
+        std::string text = saved;
+        size_t at = text.find(from);
+        CHECK(at != std::string::npos, "no %s", from.c_str());
+        if (at != std::string::npos) text.replace(at, from.size(), to);
+        return text;
+    };
+    std::string lastRadius = " " + std::to_string((int)kCpuEngineCalibrationRadius[kCpuEngineCalibrationRadii - 1]);
+    const std::string stale[] = {
+        replaced("RTBlur CPU engine profile 1", "RTBlur CPU engine profile 0"),
+        replaced("RTBlur CPU engine profile 1\n", ""),
+        replaced(radii, radii + " 240"),
+        replaced(radii, radii.substr(0, radii.size() - lastRadius.size())),
+        replaced(radii, "radii 1 2 3 4 5 6"),
+        replaced("threads 2", "threads 0"),
+    };
+    for (const std::string& text : stale) {
+        WriteFile(path, text);
+        CpuEngineProfile profile;
+        profile.threads = 7;
+        error.clear();
+        CHECK(!LoadCpuEngineProfile(path, profile, &error), "accepted:\n%s", text.c_str());
+        CHECK(profile.threads == 7 && !error.empty());
+    }
+
+    std::filesystem::remove(path);
+    CpuEngineProfile profile;
+    CHECK(!LoadCpuEngineProfile(path, profile, &error) && !error.empty());
+}
+
+// Linear between calibration radii, flat below the first, and past the last
+// rising with the last segment's slope but never falling
+void TestPredict() {
+    CpuEngineProfile profile;
+    profile.threads = 1;
+    SetCost(profile, CpuBlurEngine::Direct, 0.0, { 10, 30, 20, 20, 50, 40 }, 0.0);
+    SetCost(profile, CpuBlurEngine::FixedPoint, 0.5, { 10, 30, 20, 20, 40, 60 }, 0.0);
+    auto predict = [&](CpuBlurEngine engine, float blurRadius) {
+        return profile.PredictMs(engine, kSide, kSide, blurRadius);
+    };
+    const double values[] = { 10, 30, 20, 20, 50, 40 };
+    for (int r = 0; r < kCpuEngineCalibrationRadii; r++) {
+        CHECK(std::fabs(predict(CpuBlurEngine::Direct, kCpuEngineCalibrationRadius[r]) - values[r]) < 1e-9);
+    }
+    const float radii[] = { 0.5f, 1.0f, 4.0f, 11.0f, 28.0f, 60.0f, 100.0f, 200.0f };
+    const double expected[] = { 10, 10, 20, 25, 20, 35, 45, 40 };
+    for (int i = 0; i < 8; i++) {
+        double ms = predict(CpuBlurEngine::Direct, radii[i]);
+        CHECK(std::fabs(ms - expected[i]) < 1e-9, "radius %g: %g ms, not %g", radii[i], ms, expected[i]);
+    }
+    // Rising past the last radius: 40 to 60 over 80 to 120, then on to 200
+    CHECK(std::fabs(predict(CpuBlurEngine::FixedPoint, 200.0f) - (0.5 + 100.0)) < 1e-9);
+    CHECK(std::fabs(predict(CpuBlurEngine::FixedPoint, 100.0f) - (0.5 + 50.0)) < 1e-9);
+    // The fixed cost stays when the image is empty; the per-pixel one scales
+    CHECK(std::fabs(profile.PredictMs(CpuBlurEngine::FixedPoint, 0, 0, 100.0f) - 0.5) < 1e-9);
+    CHECK(std::fabs(profile.PredictMs(CpuBlurEngine::FixedPoint, 2 * kSide, kSide, 100.0f) - 100.5) < 1e-9);
+}
+
+// The worse of the two calibration radii around a radius; the nearest one
+// outside them
+void TestExpectedError() {
+    CpuEngineProfile profile;
+    profile.threads = 1;
+    const double errors[] = { 0.5, 2.0, 1.0, 1.5, 0.75, 3.0 };
+    CpuEngineCost& cost = profile.costs[(size_t)CpuBlurEngine::Pyramid];
+    for (int r = 0; r < kCpuEngineCalibrationRadii; r++) cost.maxError[r] = errors[r];
+    const float radii[] = { 1.0f, 2.0f, 4.0f, 6.0f, 11.0f, 16.0f, 28.0f, 60.0f, 80.0f, 100.0f, 120.0f, 500.0f };
+    const double expected[] = { 0.5, 0.5, 2.0, 2.0, 2.0, 1.0, 1.5, 1.5, 0.75, 3.0, 3.0, 3.0 };
+    for (int i = 0; i < 12; i++) {
+        double error = profile.ExpectedError(CpuBlurEngine::Pyramid, radii[i]);
+        CHECK(error == expected[i], "radius %g: %g, not %g", radii[i], error, expected[i]);
+    }
+}
+
+// The fastest engine within the tolerance; Direct, with its own prediction,
+// when none is, for copies, and never LinearLight or an uncalibrated engine
+void TestChoose() {
+    ThreadPool pool(1);
+    CpuEngineProfile profile = MakeProfile(pool);
+    struct Case {
+        double tolerance;
+        CpuBlurEngine engine;
+    };
+    const Case cases[] = {
+        { 10.0, CpuBlurEngine::BoxCascade },
+        { 3.0, CpuBlurEngine::BoxCascade },
+        { 2.9, CpuBlurEngine::Recursive },
+        { 1.0, CpuBlurEngine::FixedPoint },
+        { 0.5, CpuBlurEngine::Direct },
+        { 0.1, CpuBlurEngine::Direct },
+    };
+    for (const Case& c : cases) {
+        CpuEngineChoice choice = ChooseCpuEngine(profile, kSide, kSide, 40.0f, c.tolerance);
+        CHECK(choice.engine == c.engine, "tolerance %g: %s, not %s", c.tolerance, CpuBlurEngineName(choice.engine),
+            CpuBlurEngineName(c.engine));
+        CHECK(choice.predictedMs == profile.PredictMs(choice.engine, kSide, kSide, 40.0f) &&
+            choice.expectedError == profile.ExpectedError(choice.engine, 40.0f));
+    }
+
+    // At a small radius the fixed-point kernel is cheaper than the boxes
+    CHECK(ChooseCpuEngine(profile, kSide, kSide, 2.0f, 10.0).engine == CpuBlurEngine::FixedPoint);
+
+    // Uncalibrated engines are skipped
+    profile.costs[(size_t)CpuBlurEngine::BoxCascade].calibrated = false;
+    CHECK(ChooseCpuEngine(profile, kSide, kSide, 40.0f, 10.0).engine == CpuBlurEngine::Recursive);
+
+    // A radius-0 kernel is a copy for every engine
+    CpuEngineChoice copy = ChooseCpuEngine(profile, kSide, kSide, 0.0f, 10.0);
+    CHECK(CpuBlurIsCopy(*GetGaussianKernel(SigmaFromBlurRadius(0.0f))));
+    CHECK(copy.engine == CpuBlurEngine::Direct && copy.predictedMs == profile.PredictMs(CpuBlurEngine::Direct,
+        kSide, kSide, 0.0f));
+
+    // CpuBlurImageAuto blurs with the engine it reports
+    CpuImage src(40, 30), picked, direct;
+    for (size_t i = 0; i < src.pixels.size(); i++) src.pixels[i] = (uint8_t)(i * 37 % 251);
+    CpuEngineChoice choice = CpuBlurImageAuto(src, picked, 8.0f, 0.5, profile, pool);
+    CHECK(choice.engine == CpuBlurEngine::Direct && choice.actualMs >= 0.0);
+    CpuBlurImage(src, direct, 8.0f, CpuBlurEngine::Direct, pool);
+    CHECK(picked.pixels == direct.pixels);
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestRejected();
+    TestPredict();
+    TestExpectedError();
+    TestChoose();
+    return TestExitCode();
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CpuFixedPointBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// The specialized kernel radii and wider generic ones
+const float kBlurRadii[] = { 1.0f, 2.0f, 3.0f, 6.0f, 12.0f, 17.0f, 40.0f, 120.0f };
+
+// Both passes with the kernel's float weights in double precision, clamped at
+// the edges and not rounded in between: what FixedPointBlurMaxDeviation is
+// measured from
+template <typename T>
+std::vector<double> FloatWeightBlur(const T* src, uint32_t width, uint32_t height, const GaussianKernel& kernel) {
+    int r = kernel.radius;
+    std::vector<double> temp((size_t)width * height * 4), out(temp.size());
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) {
+                double sum = 0.0;
+                for (int i = -r; i <= r; i++) {
+                    int sx = std::min(std::max((int)x + i, 0), (int)width - 1);
+                    sum += kernel.weights[std::abs(i)] * src[((size_t)y * width + sx) * 4 + c];
+                }
+                temp[((size_t)y * width + x) * 4 + c] = sum;
+            }
+        }
+    }
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) {
+                double sum = 0.0;
+                for (int i = -r; i <= r; i++) {
+                    int sy = std::min(std::max((int)y + i, 0), (int)height - 1);
+                    sum += kernel.weights[std::abs(i)] * temp[((size_t)sy * width + x) * 4 + c];
+                }
+                out[((size_t)y * width + x) * 4 + c] = sum;
+            }
+        }
+    }
+    return out;
+}
+
+template <typename T>
+double MaxDifference(const std::vector<T>& image, const std::vector<double>& reference) {
+    double worst = 0.0;
+    for (size_t i = 0; i < image.size(); i++) worst = std::max(worst, std::fabs(image[i] - reference[i]));
+    return worst;
+}
+
+// Hard edges over noise, across the whole range of T
+template <typename T>
+std::vector<T> MakeTestPixels(uint32_t width, uint32_t height, uint32_t maxValue) {
+    std::vector<T> pixels((size_t)width * height * 4);
+    uint32_t state = 2463534242u;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        size_t x = i / 4 % width, y = i / 4 / width;
+        uint32_t base = (x / 13 + y / 11) % 2 ? maxValue - maxValue / 8 : 0;
+        pixels[i] = (T)std::min(maxValue, base + state % (maxValue / 8 + 1));
+    }
+    return pixels;
+}
+
+// Q15 weights that sum to exactly one, each tap but the center within 2^-16
+// of its float weight
+void TestWeights() {
+    const int one = 1 << 15;
+    for (double sigma = 0.3; sigma < 200.0; sigma *= 1.1) {
+        auto kernel = GetGaussianKernel((float)sigma);
+        FixedPointKernel fixed = BuildFixedPointKernel(*kernel);
+        if (fixed.radius == 0) continue;
+        CHECK(fixed.radius == kernel->radius, "sigma %g", sigma);
+        int sum = fixed.weights[0];
+        for (int i = 1; i <= fixed.radius; i++) {
+            sum += 2 * fixed.weights[i];
+            CHECK(std::fabs((double)fixed.weights[i] / one - kernel->weights[i]) <= 1.0 / (2 * one),
+                "sigma %g tap %d", sigma, i);
+        }
+        CHECK(sum == one, "sigma %g: weights sum to %d", sigma, sum);
+    }
+}
+
+void TestDeviation8() {
+    const uint32_t width = 131, height = 77;
+    ThreadPool pool(2);
+    CpuImage src(width, height), dst;
+    src.pixels = MakeTestPixels<uint8_t>(width, height, 255);
+    for (float blurRadius : kBlurRadii) {
+        auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+        double bound = FixedPointBlurMaxDeviation(BuildFixedPointKernel(*kernel), 255.0);
+        CpuFixedPointBlur(src, dst, blurRadius, pool);
+        double worst = MaxDifference(dst.pixels, FloatWeightBlur(src.pixels.data(), width, height, *kernel));
+        CHECK(worst <= bound, "radius %g: %.3f past the bound %.3f", blurRadius, worst, bound);
+        // As documented: 1 to 1.5 levels up to radius 40, growing with the tap count
+        if (blurRadius <= 40.0f) CHECK(bound <= 1.5, "radius %g: bound %.3f", blurRadius, bound);
+    }
+}
+
+void TestDeviation16() {
+    const uint32_t width = 97, height = 61;
+    ThreadPool pool(2);
+    std::vector<uint16_t> src = MakeTestPixels<uint16_t>(width, height, 65535), dst(src.size());
+    for (float blurRadius : kBlurRadii) {
+        auto kernel = GetGaussianKernel(SigmaFromBlurRadius(blurRadius));
+        double bound = FixedPointBlurMaxDeviation(BuildFixedPointKernel(*kernel), 65535.0);
+        CpuFixedPointBlur16(src.data(), dst.data(), width, height, blurRadius, pool);
+        double worst = MaxDifference(dst, FloatWeightBlur(src.data(), width, height, *kernel));
+        CHECK(worst <= bound, "radius %g: %.3f past the bound %.3f", blurRadius, worst, bound);
+    }
+}
+
+// Weights summing to one and round-half-up leave a flat image as it is
+void TestConstant() {
+    ThreadPool pool(2);
+    for (uint8_t value : { 0, 1, 127, 128, 254, 255 }) {
+        CpuImage src(45, 23), dst;
+        std::fill(src.pixels.begin(), src.pixels.end(), value);
+        for (float blurRadius : kBlurRadii) {
+            CpuFixedPointBlur(src, dst, blurRadius, pool);
+            CHECK(dst.pixels == src.pixels, "RGBA8 %d radius %g", value, blurRadius);
+        }
+    }
+    for (uint16_t value : { 0, 1, 255, 32767, 32768, 65534, 65535 }) {
+        std::vector<uint16_t> src(45 * 23 * 4, value), dst(src.size());
+        for (float blurRadius : kBlurRadii) {
+            CpuFixedPointBlur16(src.data(), dst.data(), 45, 23, blurRadius, pool);
+            CHECK(dst == src, "RGBA16 %d radius %g", value, blurRadius);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    TestWeights();
+    TestDeviation8();
+    TestDeviation16();
+    TestConstant();
+    return TestExitCode();
+}
@@ -0,0 +1,54 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "CpuFrameIO.h"
+#include "TestCheck.h"
+
+namespace {
+
+std::string WriteTemp(const std::string& bytes) {
+    std::string path = (std::filesystem::temp_directory_path() / "RTBlurFrameIOTest.y4m").string();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), (std::streamsize)bytes.size());
+    return path;
+}
+
+void TestY4mFrame() {
+    // 4x2 4:2:0: eight luma bytes, then one byte each of Cb and Cr per 2x2
+    std::string stream = "YUV4MPEG2 W4 H2 F25:1 C420jpeg\nFRAME\n";
+    stream += std::string("\x10\x20\x30\x40\x50\x60\x70\x80", 8) + "\x11\x22" + "\x33\x44";
+    std::string error;
+    auto reader = OpenFrameReader(WriteTemp(stream), 0, 0, &error);
+    CHECK(reader, "%s", error.c_str());
+    if (!reader) return;
+    CHECK(reader->Format().width == 4 && reader->Format().height == 2 && reader->Format().FrameBytes() == 12);
+    CpuImage rgba;
+    CHECK(reader->ReadFrame(rgba), "%s", reader->Error().c_str());
+    CHECK(rgba.width == 4 && rgba.height == 2);
+    const uint8_t* pixel = rgba.Row(1) + 3 * 4;
+    CHECK(pixel[0] == 0x80 && pixel[1] == 0x22 && pixel[2] == 0x44 && pixel[3] == 255);
+    CHECK(!reader->ReadFrame(rgba) && reader->Error().empty(), "%s", reader->Error().c_str());
+}
+
+// Oversized or wrapping frame sizes fail before anything is allocated
+void TestY4mSizeLimit() {
+    for (const char* size : { "W100000 H100000", "W4 H20000", "W4294967300 H2", "W0 H2", "H2" }) {
+        std::string error;
+        auto reader = OpenFrameReader(WriteTemp(std::string("YUV4MPEG2 ") + size + " C444\n"), 0, 0, &error);
+        CHECK(!reader && !error.empty(), "%s accepted", size);
+    }
+    std::string error;
+    CHECK(OpenFrameReader(WriteTemp("YUV4MPEG2 W16384 H8 Cmono\n"), 0, 0, &error), "%s", error.c_str());
+}
+
+} // namespace
+
+int main() {
+    TestY4mFrame();
+    TestY4mSizeLimit();
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::temp_directory_path() / "RTBlurFrameIOTest.y4m", ec);
+    return TestExitCode();
+}
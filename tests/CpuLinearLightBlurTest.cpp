@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuLinearLightBlur.h"
+#include "CpuReferenceBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// Dark noise with bright blocks, and one bright square on black, where the
+// sRGB curve magnifies errors in the dark pixels next to the bright ones
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 521288629u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            bool block = (x / 41 + y / 37) % 3 == 0;
+            bool square = x >= 3 * width / 4 - 20 && x < 3 * width / 4 + 20 && y >= height / 2 - 20 &&
+                y < height / 2 + 20;
+            bool black = x >= width / 2 && !square;
+            for (int c = 0; c < 3; c++) {
+                uint8_t noise = (uint8_t)((state >> (c * 8)) & 15);
+                row[x * 4 + c] = square ? 255 : black ? 0 : block ? (uint8_t)(240 + noise) : noise;
+            }
+            row[x * 4 + 3] = (uint8_t)(block ? 255 : 128 + (state >> 24) % 64);
+        }
+    }
+    return image;
+}
+
+// Against the exact Gaussian in linear light, in 8-bit steps of the output
+void TestAccuracy() {
+    CpuImage src = MakeTestImage(300, 200);
+    ThreadPool pool(2);
+    CpuImage blurred;
+    std::vector<double> reference;
+    double worst = 0.0;
+    for (float blurRadius : { 2.0f, 4.0f, 10.0f, 20.0f, 30.0f, 40.0f, 80.0f, 120.0f }) {
+        CpuBlurImage(src, blurred, blurRadius, CpuBlurEngine::LinearLight, pool);
+        CpuReferenceGaussianBlur(src, reference, SigmaFromBlurRadius(blurRadius), pool, true);
+        ImageError error = MeasureImageError(blurred, reference);
+        CHECK(error.maxAbs <= 1.5, "radius %g max error %.2f", blurRadius, error.maxAbs);
+        if (error.maxAbs > worst) worst = error.maxAbs;
+    }
+    printf("linear light vs reference: worst %.2f 8-bit steps\n", worst);
+}
+
+// A flat image stays flat, and a crop blurred with CpuBlurEngineReach's
+// margin matches the whole image inside the crop
+void TestFlatAndReach() {
+    ThreadPool pool(2);
+    CpuImage flat(64, 48), blurred;
+    for (size_t i = 0; i < flat.pixels.size(); i++) flat.pixels[i] = (uint8_t)(i % 4 == 3 ? 200 : 17 + 90 * (i % 4));
+    CpuBlurImage(flat, blurred, 30.0f, CpuBlurEngine::LinearLight, pool);
+    CHECK(blurred.pixels == flat.pixels);
+
+    CpuImage src = MakeTestImage(300, 200), whole, crop, cropBlurred;
+    float blurRadius = 12.0f;
+    CpuBlurImage(src, whole, blurRadius, CpuBlurEngine::LinearLight, pool);
+    int reach = CpuBlurEngineReach(CpuBlurEngine::LinearLight, blurRadius);
+    uint32_t x0 = 120, y0 = 80, side = 40;
+    crop = CpuImage(side + 2 * reach, side + 2 * reach);
+    for (uint32_t y = 0; y < crop.height; y++) {
+        memcpy(crop.Row(y), src.Row(y0 - reach + y) + (size_t)(x0 - reach) * 4, crop.RowPitch());
+    }
+    CpuBlurImage(crop, cropBlurred, blurRadius, CpuBlurEngine::LinearLight, pool);
+    bool same = true;
+    for (uint32_t y = 0; y < side; y++) {
+        same &= !memcmp(cropBlurred.Row(y + reach) + (size_t)reach * 4, whole.Row(y0 + y) + (size_t)x0 * 4, side * 4);
+    }
+    CHECK(same, "crop with reach %d differs from the whole-image blur", reach);
+}
+
+} // namespace
+
+int main() {
+    TestAccuracy();
+    TestFlatAndReach();
+    return TestExitCode();
+}
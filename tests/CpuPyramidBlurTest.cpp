@@ -0,0 +1,83 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuReferenceBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 362436069u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 29 + y / 31) % 2 ? 230 : 20) + (state & 15));
+        }
+    }
+    return image;
+}
+
+// More levels for larger sigmas, never past kMaxPyramidLevels, none until the
+// smallest level could keep kMinPyramidLevelSigma; and the resampling plus the
+// level's Gaussian add up to the variance asked for
+void TestLevels() {
+    int previous = 0;
+    for (double sigma = 0.5; sigma < 4000.0; sigma *= 1.05) {
+        BlurPyramid pyramid = BuildBlurPyramid((float)sigma);
+        CHECK(pyramid.levels >= previous, "sigma %g: %d levels after %d", sigma, pyramid.levels, previous);
+        CHECK(pyramid.levels <= kMaxPyramidLevels, "sigma %g: %d levels", sigma, pyramid.levels);
+        CHECK((pyramid.levels == 0) == (sigma < 2.0 * kMinPyramidLevelSigma), "sigma %g: %d levels", sigma,
+            pyramid.levels);
+        previous = pyramid.levels;
+        if (pyramid.levels == 0) continue;
+
+        double scale = std::ldexp(1.0, 2 * pyramid.levels);
+        double variance = (double)pyramid.levelSigma * pyramid.levelSigma * scale + (scale - 1.0) / 3.0;
+        CHECK(std::fabs(variance - sigma * sigma) <= 1e-4 * sigma * sigma, "sigma %g: variance %g", sigma,
+            variance);
+        CHECK(pyramid.levelPadding > 0);
+        for (int level = 1; level < pyramid.levels; level++) {
+            CHECK(PyramidLevelExtent(pyramid, 203, level) == 2 * PyramidLevelExtent(pyramid, 203, level + 1));
+        }
+    }
+    CHECK(previous == kMaxPyramidLevels, "%d levels at the largest sigma", previous);
+}
+
+// Against the untruncated Gaussian, edges included: within 2 8-bit steps at
+// any level count, 0.5 on average (about 0.7 and 0.3 measured)
+void TestImageError() {
+    CpuImage src = MakeTestImage(203, 131), pyramid, direct;
+    ThreadPool pool(2);
+    std::vector<double> reference;
+    for (float blurRadius : { 12.0f, 20.0f, 40.0f, 60.0f, 120.0f, 240.0f }) {
+        float sigma = SigmaFromBlurRadius(blurRadius);
+        CHECK(BuildBlurPyramid(sigma).levels > 0, "radius %g has no pyramid", blurRadius);
+        CpuBlurImage(src, pyramid, blurRadius, CpuBlurEngine::Pyramid, pool);
+        CHECK(pyramid.width == src.width && pyramid.height == src.height);
+        CpuReferenceGaussianBlur(src, reference, sigma, pool);
+        ImageError error = MeasureImageError(pyramid, reference);
+        CHECK(error.maxAbs <= 2.0 && error.meanAbs <= 0.5, "radius %g: max %.2f mean %.3f", blurRadius,
+            error.maxAbs, error.meanAbs);
+    }
+
+    // Too small for a pyramid: the direct engine
+    CpuBlurImage(src, pyramid, 8.0f, CpuBlurEngine::Pyramid, pool);
+    CpuBlurImage(src, direct, 8.0f, CpuBlurEngine::Direct, pool);
+    CHECK(pyramid.pixels == direct.pixels, "radius 8 differs from direct");
+}
+
+} // namespace
+
+int main() {
+    TestLevels();
+    TestImageError();
+    return TestExitCode();
+}
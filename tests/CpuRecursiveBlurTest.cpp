@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuRecursiveBlur.h"
+#include "CpuReferenceBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+// 0.001 to 120 in steps of about 10%
+std::vector<double> TestSigmas() {
+    std::vector<double> sigmas;
+    for (double sigma = 0.001; sigma < 120.0; sigma *= 1.1) sigmas.push_back(sigma);
+    sigmas.push_back(120.0);
+    return sigmas;
+}
+
+// Half the L1 distance to the Gaussian, which bounds one pass's error on
+// [0, 1] data. Young-van Vliet is furthest from it just above
+// kMinRecursiveSigma and settles near 0.01 from sigma 20 on.
+double MaxHalfL1(double sigma) {
+    if (sigma < 4.0) return 0.045;
+    if (sigma < 10.0) return 0.03;
+    if (sigma < 20.0) return 0.02;
+    return 0.012;
+}
+
+void TestImpulseResponse() {
+    for (double sigma : TestSigmas()) {
+        if (sigma < kMinRecursiveSigma) continue;
+        RecursiveGaussian filter = BuildRecursiveGaussian(sigma);
+        int radius = (int)std::ceil(16.0 * sigma) + 16;
+        std::vector<double> weights = RecursiveGaussianWeights(filter, radius);
+        CHECK((int)weights.size() == 2 * radius + 1, "sigma %g", sigma);
+
+        double sum = 0.0;
+        for (int i = 0; i <= 2 * radius; i++) {
+            sum += weights[i];
+            CHECK(std::fabs(weights[i] - weights[2 * radius - i]) < 1e-7, "sigma %g tap %d not symmetric", sigma, i);
+        }
+        CHECK(std::fabs(sum - 1.0) < 1e-6, "sigma %g DC gain %.9g", sigma, sum);
+
+        KernelError error = MeasureKernelError(weights, sigma);
+        CHECK(error.l1 / 2.0 <= MaxHalfL1(sigma), "sigma %g l1 %g", sigma, error.l1);
+    }
+}
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 362436069u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 29 + y / 31) % 2 ? 230 : 20) + (state & 15));
+        }
+    }
+    return image;
+}
+
+// Error of the whole blur in 8-bit steps, edges included, against the
+// untruncated Gaussian: within both passes' bound plus rounding. Below
+// kMinRecursiveSigma the direct engine runs.
+void TestImageError() {
+    CpuImage src = MakeTestImage(160, 120);
+    ThreadPool pool(2);
+    CpuImage recursive, direct;
+    std::vector<double> reference;
+    for (double sigma : TestSigmas()) {
+        float blurRadius = (float)(sigma * 2.0);
+        CpuBlurImage(src, recursive, blurRadius, CpuBlurEngine::Recursive, pool);
+        if (SigmaFromBlurRadius(blurRadius) < kMinRecursiveSigma) {
+            CpuBlurImage(src, direct, blurRadius, CpuBlurEngine::Direct, pool);
+            CHECK(recursive.pixels == direct.pixels, "sigma %g", sigma);
+            continue;
+        }
+        CpuReferenceGaussianBlur(src, reference, SigmaFromBlurRadius(blurRadius), pool);
+        ImageError error = MeasureImageError(recursive, reference);
+        CHECK(error.maxAbs <= MaxHalfL1(sigma) * 2.0 * 255.0 + 1.0, "sigma %g max error %.2f", sigma, error.maxAbs);
+    }
+}
+
+// Edges continue the edge value, as clamp addressing does, so a flat image
+// stays flat at any sigma
+void TestFlatStaysFlat() {
+    CpuImage flat(97, 61);
+    for (size_t i = 0; i < flat.pixels.size(); i++) flat.pixels[i] = (uint8_t)(i % 4 == 3 ? 255 : 37 + 80 * (i % 4));
+    ThreadPool pool(2);
+    CpuImage blurred;
+    for (float blurRadius : { 4.0f, 10.0f, 60.0f, 240.0f }) {
+        CpuBlurImage(flat, blurred, blurRadius, CpuBlurEngine::Recursive, pool);
+        CHECK(blurred.pixels == flat.pixels, "radius %g", blurRadius);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestImpulseResponse();
+    TestImageError();
+    TestFlatStaysFlat();
+    return TestExitCode();
+}
@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CpuRowIO.h"
+#include "TestCheck.h"
+
+namespace {
+
+struct TiffEntry {
+    uint16_t tag;
+    uint16_t type; // 3 SHORT, 4 LONG, 16 LONG8
+    uint64_t count;
+    uint64_t value; // stored inline
+};
+
+void Put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+// Little-endian TIFF or BigTIFF: header, pixels, then one IFD. ifdCount
+// overrides the entry count written.
+std::vector<uint8_t> MakeTiff(bool big, const std::vector<TiffEntry>& entries, const std::vector<uint8_t>& pixels,
+    uint64_t ifdCount = UINT64_MAX)
+{
+    size_t headerSize = big ? 16 : 8;
+    std::vector<uint8_t> out = { 'I', 'I' };
+    Put(out, big ? 43 : 42, 2);
+    if (big) {
+        Put(out, 8, 2);
+        Put(out, 0, 2);
+    }
+    Put(out, headerSize + pixels.size(), big ? 8 : 4);
+    out.insert(out.end(), pixels.begin(), pixels.end());
+    Put(out, ifdCount != UINT64_MAX ? ifdCount : entries.size(), big ? 8 : 2);
+    for (const TiffEntry& entry : entries) {
+        Put(out, entry.tag, 2);
+        Put(out, entry.type, 2);
+        Put(out, entry.count, big ? 8 : 4);
+        Put(out, entry.value, big ? 8 : 4);
+    }
+    Put(out, 0, big ? 8 : 4);
+    return out;
+}
+
+// A 3x2 image of one sample per pixel
+std::vector<TiffEntry> GrayEntries(bool big, uint16_t photometric) {
+    uint64_t stripOffset = big ? 16 : 8;
+    return {
+        { 256, 3, 1, 3 },
+        { 257, 3, 1, 2 },
+        { 258, 3, 1, 8 },
+        { 259, 3, 1, 1 },
+        { 262, 3, 1, photometric },
+        { 273, 4, 1, stripOffset },
+        { 277, 3, 1, 1 },
+        { 278, 3, 1, 2 },
+    };
+}
+
+const std::vector<uint8_t> kGrayPixels = { 0, 10, 200, 255, 128, 1 };
+
+std::string WriteTemp(const std::vector<uint8_t>& bytes) {
+    std::string path = (std::filesystem::temp_directory_path() / "RTBlurRowIOTest.tif").string();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    return path;
+}
+
+std::unique_ptr<RowReader> Open(const std::vector<uint8_t>& bytes, std::string* error) {
+    return OpenRowReader(WriteTemp(bytes), 0, 0, error);
+}
+
+void TestGrayPolarity() {
+    for (bool big : { false, true }) {
+        for (uint16_t photometric : { 0, 1 }) {
+            std::string error;
+            auto reader = Open(MakeTiff(big, GrayEntries(big, photometric), kGrayPixels), &error);
+            CHECK(reader, "big %d photometric %d: %s", big, photometric, error.c_str());
+            if (!reader) continue;
+            std::vector<uint8_t> rgba(3 * 4);
+            for (uint32_t y = 0; y < 2; y++) {
+                CHECK(reader->ReadRow(rgba.data()));
+                for (uint32_t x = 0; x < 3; x++) {
+                    uint8_t gray = kGrayPixels[y * 3 + x];
+                    uint8_t expected = photometric == 0 ? (uint8_t)(255 - gray) : gray;
+                    CHECK(rgba[x * 4] == expected && rgba[x * 4 + 1] == expected && rgba[x * 4 + 2] == expected,
+                        "big %d photometric %d pixel %u,%u is %d", big, photometric, x, y, rgba[x * 4]);
+                    CHECK(rgba[x * 4 + 3] == 255);
+                }
+            }
+        }
+    }
+}
+
+// Counts whose byte size overflows 64 bits must not pass as inline values
+void TestOverflowingCounts() {
+    std::string error;
+    std::vector<TiffEntry> entries = GrayEntries(true, 1);
+    entries[5] = { 273, 16, 1ull << 61, 16 };
+    CHECK(!Open(MakeTiff(true, entries, kGrayPixels), &error), "strip offsets with count 2^61 accepted");
+
+    entries = GrayEntries(true, 1);
+    entries[2] = { 258, 3, 1ull << 63, 8 };
+    CHECK(!Open(MakeTiff(true, entries, kGrayPixels), &error), "bits per sample with count 2^63 accepted");
+
+    CHECK(!Open(MakeTiff(true, GrayEntries(true, 1), kGrayPixels, 1ull << 62), &error), "IFD of 2^62 entries accepted");
+
+    std::vector<uint8_t> bytes = MakeTiff(true, GrayEntries(true, 1), kGrayPixels);
+    for (int i = 8; i < 16; i++) bytes[i] = 0xFF;
+    CHECK(!Open(bytes, &error), "IFD offset near 2^64 accepted");
+}
+
+} // namespace
+
+int main() {
+    TestGrayPolarity();
+    TestOverflowingCounts();
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::temp_directory_path() / "RTBlurRowIOTest.tif", ec);
+    return TestExitCode();
+}
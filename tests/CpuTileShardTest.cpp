@@ -0,0 +1,215 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "CpuBlurEngine.h"
+#include "CpuSocket.h"
+#include "CpuTileShard.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+class ImageRowReader : public RowReader {
+public:
+    explicit ImageRowReader(const CpuImage& image) : m_image(image) {}
+    uint32_t Width() const override { return m_image.width; }
+    uint32_t Height() const override { return m_image.height; }
+    bool ReadRow(uint8_t* rgba) override {
+        if (m_y >= m_image.height) return false;
+        memcpy(rgba, m_image.Row(m_y++), m_image.RowPitch());
+        return true;
+    }
+
+private:
+    const CpuImage& m_image;
+    uint32_t m_y = 0;
+};
+
+class ImageRowWriter : public RowWriter {
+public:
+    ImageRowWriter(uint32_t width, uint32_t height) : image(width, height) {}
+    bool WriteRow(const uint8_t* rgba) override {
+        if (m_y >= image.height) return false;
+        memcpy(image.Row(m_y++), rgba, image.RowPitch());
+        return true;
+    }
+    bool Finish() override { return m_y == image.height; }
+
+    CpuImage image;
+
+private:
+    uint32_t m_y = 0;
+};
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 2463534242u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 13 + y / 11) % 2 ? 200 : 40) + (state & 31));
+        }
+    }
+    return image;
+}
+
+struct ShardCase {
+    CpuBlurEngine engine;
+    float blurRadius;
+};
+
+const ShardCase kCases[] = {
+    { CpuBlurEngine::Direct, 6.0f },
+    { CpuBlurEngine::Direct, 40.0f },
+    { CpuBlurEngine::FixedPoint, 3.0f },
+    { CpuBlurEngine::BoxCascade, 20.0f },
+    { CpuBlurEngine::LinearLight, 10.0f },
+};
+
+bool ShardBlur(ShardCoordinator& coordinator, const CpuImage& src, CpuImage& dst, const ShardCase& shardCase,
+    ShardStats& stats, std::string& error)
+{
+    ImageRowReader reader(src);
+    ImageRowWriter writer(src.width, src.height);
+    bool ok = coordinator.Blur(reader, writer, shardCase.blurRadius, shardCase.engine, &stats, &error);
+    dst = std::move(writer.image);
+    return ok && writer.Finish();
+}
+
+// Tiles of 48 with halos up to the 62-pixel reach of radius 40, including
+// partial tiles at the right and bottom edges, on worker processes running
+// this executable
+void TestMatchesSingleProcess() {
+    CpuImage src = MakeTestImage(203, 131), single, sharded;
+    ThreadPool pool(2);
+    ShardOptions options;
+    options.tileSize = 48;
+    options.localWorkers = 3;
+    options.workerArguments = { "--threads", "1" };
+    ShardCoordinator coordinator;
+    std::string error;
+    CHECK(coordinator.Start(options, &error), "%s", error.c_str());
+    for (const ShardCase& shardCase : kCases) {
+        ShardStats stats;
+        bool ok = ShardBlur(coordinator, src, sharded, shardCase, stats, error);
+        CHECK(ok, "%s radius %g: %s", CpuBlurEngineName(shardCase.engine), shardCase.blurRadius, error.c_str());
+        CpuBlurImage(src, single, shardCase.blurRadius, shardCase.engine, pool);
+        CHECK(sharded.pixels == single.pixels, "%s radius %g differs from one process",
+            CpuBlurEngineName(shardCase.engine), shardCase.blurRadius);
+        CHECK(stats.tiles == 5 * 3 && stats.workersLost == 0, "tiles %zu lost %u", stats.tiles, stats.workersLost);
+    }
+
+    // Engines without a bounded reach are refused rather than tiled wrongly
+    ShardStats stats;
+    CHECK(!ShardBlur(coordinator, src, sharded, { CpuBlurEngine::Recursive, 10.0f }, stats, error));
+}
+
+// A worker that quits holding a tile, with no answer sent, as when it is
+// killed: its tile goes to the next worker and the output is unchanged. The
+// first connection dies on its first tile before the second one exists, so
+// exactly one tile is reissued. A spawned process doing the same is covered
+// by the second half, where which tile it dies on depends on timing.
+void TestWorkerKilledMidRun() {
+    CpuImage src = MakeTestImage(203, 131), single, sharded;
+    ThreadPool pool(2);
+    ShardCase shardCase = { CpuBlurEngine::Direct, 12.0f };
+    CpuBlurImage(src, single, shardCase.blurRadius, shardCase.engine, pool);
+    {
+        ShardOptions options;
+        options.tileSize = 48;
+        options.localWorkers = 0;
+        auto coordinator = std::make_unique<ShardCoordinator>();
+        std::string error;
+        CHECK(coordinator->Start(options, &error), "%s", error.c_str());
+        uint16_t port = coordinator->Port();
+        int dyingExit = -1;
+        std::thread workers([&] {
+            ThreadPool workerPool(1);
+            dyingExit = RunShardWorker("127.0.0.1", port, workerPool, 0);
+            RunShardWorker("127.0.0.1", port, workerPool);
+        });
+        ShardStats stats;
+        bool ok = ShardBlur(*coordinator, src, sharded, shardCase, stats, error);
+        CHECK(ok, "%s", error.c_str());
+        CHECK(sharded.pixels == single.pixels, "output differs after losing a worker");
+        CHECK(stats.workersLost == 1 && stats.reissued == 1, "lost %u reissued %zu", stats.workersLost,
+            stats.reissued);
+        // Disconnecting ends the second worker
+        coordinator.reset();
+        workers.join();
+        CHECK(dyingExit == 3);
+    }
+    {
+        ShardOptions options;
+        options.tileSize = 48;
+        options.localWorkers = 2;
+        options.workerArguments = { "--threads", "1" };
+        options.firstWorkerFailAfter = 1;
+        ShardCoordinator coordinator;
+        std::string error;
+        CHECK(coordinator.Start(options, &error), "%s", error.c_str());
+        ShardStats stats;
+        bool ok = ShardBlur(coordinator, src, sharded, shardCase, stats, error);
+        CHECK(ok, "%s", error.c_str());
+        CHECK(sharded.pixels == single.pixels, "output differs after losing a worker process");
+        CHECK(stats.workersLost <= 1 && stats.reissued == stats.workersLost, "lost %u reissued %zu",
+            stats.workersLost, stats.reissued);
+    }
+}
+
+// A tile that every worker dies on fails the blur after maxAttempts. One tile,
+// so both workers get the same one.
+void TestGivesUp() {
+    CpuImage src = MakeTestImage(32, 32), sharded;
+    ShardOptions options;
+    options.tileSize = 32;
+    options.localWorkers = 0;
+    options.maxAttempts = 2;
+    options.tileTimeout = 10.0;
+    ShardCoordinator coordinator;
+    std::string error;
+    CHECK(coordinator.Start(options, &error), "%s", error.c_str());
+    uint16_t port = coordinator.Port();
+    std::thread workers([&] {
+        ThreadPool workerPool(1);
+        for (int i = 0; i < 2; i++) RunShardWorker("127.0.0.1", port, workerPool, 0);
+    });
+    ShardStats stats;
+    CHECK(!ShardBlur(coordinator, src, sharded, { CpuBlurEngine::Direct, 4.0f }, stats, error));
+    CHECK(error.find("failed 2 times") != std::string::npos, "%s", error.c_str());
+    CHECK(stats.workersLost == 2 && stats.reissued == 1, "lost %u reissued %zu", stats.workersLost, stats.reissued);
+    workers.join();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // ShardCoordinator::Start runs this executable as its workers
+    const char* workerAddress = nullptr;
+    int failAfter = -1;
+    unsigned threads = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--worker")) workerAddress = argv[i + 1];
+        else if (!strcmp(argv[i], "--fail-after")) failAfter = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--threads")) threads = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    }
+    if (workerAddress) {
+        std::string host;
+        uint16_t port = 0;
+        if (!ParseHostPort(workerAddress, host, port)) return 2;
+        ThreadPool pool(threads);
+        return RunShardWorker(host, port, pool, failAfter);
+    }
+
+    TestMatchesSingleProcess();
+    TestWorkerKilledMidRun();
+    TestGivesUp();
+    return TestExitCode();
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "CpuBlurEngine.h"
+#include "CpuVariableBlur.h"
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+#include "ThreadPool.h"
+
+namespace {
+
+CpuImage MakeTestImage(uint32_t width, uint32_t height) {
+    CpuImage image(width, height);
+    uint32_t state = 88675123u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = image.Row(y);
+        for (uint32_t x = 0; x < width * 4; x++) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            row[x] = (uint8_t)((((x / 4) / 23 + y / 19) % 2 ? 220 : 30) + (state & 31));
+        }
+    }
+    return image;
+}
+
+CpuImage FlatMap(uint32_t width, uint32_t height, uint8_t value) {
+    CpuImage map(width, height);
+    for (uint8_t& v : map.pixels) v = value;
+    return map;
+}
+
+// A map of 255 is the same as no map, and where the boxes BuildBoxCascade
+// picks are what the map's variance asks of each pass (sigma^2 = s(s + 1),
+// three boxes of radius s), the two blurs differ only in how their
+// intermediates round: 4 fractional bits here, floats and 8-bit rows there.
+// Only past the boxes' reach from the edges, since each pass here clamps its
+// own input where the cascade clamps the source
+void TestFlatMapMatchesBoxCascade() {
+    const uint32_t width = 400, height = 300;
+    CpuImage src = MakeTestImage(width, height);
+    ThreadPool pool(2);
+    CpuImage variable, mapped, box;
+    for (int s = 1; s <= 40; s = s * 3 / 2 + 1) {
+        float blurRadius = 2.0f * (float)std::sqrt(s * (s + 1.0));
+        BoxCascade cascade = BuildBoxCascade(SigmaFromBlurRadius(blurRadius));
+        CHECK(cascade.radii == std::vector<int>(3, s), "s %d", s);
+        CpuVariableBlur(src, variable, CpuImage(), blurRadius, pool);
+        CpuVariableBlur(src, mapped, FlatMap(width, height, 255), blurRadius, pool);
+        CHECK(variable.pixels == mapped.pixels, "s %d: a map of 255 differs from none", s);
+        CpuBlurImage(src, box, blurRadius, CpuBlurEngine::BoxCascade, pool);
+        uint32_t reach = 3 * ((uint32_t)s + 1);
+        int difference = 0;
+        for (uint32_t y = reach; y < height - reach; y++) {
+            for (uint32_t x = reach * 4; x < (width - reach) * 4; x++) {
+                difference = std::max(difference, std::abs(variable.Row(y)[x] - box.Row(y)[x]));
+            }
+        }
+        CHECK(difference <= 1, "s %d: %d steps from the box cascade", s, difference);
+    }
+}
+
+// Map value 0 leaves pixels exactly as they were, whether the whole map is 0
+// or only part of one, here a 2x1 map stretched over the image
+void TestZeroMapIsIdentity() {
+    CpuImage src = MakeTestImage(160, 120);
+    ThreadPool pool(2);
+    CpuImage blurred;
+    for (float blurRadius : { 3.0f, 40.0f }) {
+        CpuVariableBlur(src, blurred, FlatMap(7, 5, 0), blurRadius, pool);
+        CHECK(blurred.pixels == src.pixels, "radius %g", blurRadius);
+
+        CpuImage halfMap = FlatMap(2, 1, 0);
+        halfMap.Row(0)[4] = 255;
+        CpuVariableBlur(src, blurred, halfMap, blurRadius, pool);
+        bool sharp = true, blurredRight = false;
+        for (uint32_t y = 0; y < src.height; y++) {
+            sharp &= !memcmp(blurred.Row(y), src.Row(y), 80 * 4);
+            blurredRight |= memcmp(blurred.Row(y) + 80 * 4, src.Row(y) + 80 * 4, 80 * 4) != 0;
+        }
+        CHECK(sharp, "radius %g: the half of the map at 0 changed", blurRadius);
+        CHECK(blurredRight, "radius %g: the half of the map at 255 stayed sharp", blurRadius);
+    }
+
+    // In place too
+    CpuImage image = src;
+    CpuVariableBlur(image, image, FlatMap(1, 1, 0), 20.0f, pool);
+    CHECK(image.pixels == src.pixels);
+}
+
+} // namespace
+
+int main() {
+    TestFlatMapMatchesBoxCascade();
+    TestZeroMapIsIdentity();
+    return TestExitCode();
+}
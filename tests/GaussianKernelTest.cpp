@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "GaussianKernel.h"
+#include "TestCheck.h"
+
+namespace {
+
+// Roomy enough that no sigma below 120 is capped at any tolerance tested
+constexpr int kUncappedTaps = 4097;
+
+const float kTolerances[] = { kDefaultKernelTolerance, kDefaultKernelTolerance / 12.92f, 1e-5f };
+
+// 0.001 to 120 in steps of about 5%, plus the slider's small whole-pixel radii
+std::vector<float> TestSigmas() {
+    std::vector<float> sigmas;
+    for (double sigma = 0.001; sigma < 120.0; sigma *= 1.05) sigmas.push_back((float)sigma);
+    for (int blurRadius = 1; blurRadius <= 40; blurRadius++) sigmas.push_back(SigmaFromBlurRadius((float)blurRadius));
+    return sigmas;
+}
+
+// weights[-radius..radius] in double, as MeasureKernelError takes them
+std::vector<double> FullKernel(const GaussianKernel& kernel) {
+    std::vector<double> full(2 * kernel.radius + 1);
+    for (int i = -kernel.radius; i <= kernel.radius; i++) full[i + kernel.radius] = kernel.weights[i < 0 ? -i : i];
+    return full;
+}
+
+void CheckKernel(const GaussianKernel& kernel, float sigma, float tolerance, int maxTaps) {
+    int maxRadius = (maxTaps - 1) / 2;
+    bool capped = kernel.radius == maxRadius && kernel.truncatedMass > tolerance;
+    CHECK(kernel.radius >= 0 && kernel.radius <= maxRadius, "sigma %g radius %d", sigma, kernel.radius);
+    CHECK((int)kernel.weights.size() == kernel.radius + 1, "sigma %g", sigma);
+    CHECK(capped || kernel.truncatedMass <= tolerance, "sigma %g tolerance %g truncatedMass %g", sigma, tolerance,
+        kernel.truncatedMass);
+
+    // The smallest radius that meets the tolerance: one tap less would not
+    if (kernel.radius > 0) {
+        double oneLess = kernel.truncatedMass + 2.0 * ReferenceGaussianWeight(kernel.radius, sigma);
+        CHECK(oneLess > tolerance, "sigma %g tolerance %g radius %d is not minimal", sigma, tolerance, kernel.radius);
+    }
+
+    double sum = kernel.weights[0];
+    for (int i = 1; i <= kernel.radius; i++) {
+        sum += 2.0 * kernel.weights[i];
+        CHECK(kernel.weights[i] <= kernel.weights[i - 1], "sigma %g tap %d", sigma, i);
+    }
+    CHECK(std::fabs(sum - 1.0) < 1e-5, "sigma %g sum %.9g", sigma, sum);
+
+    // Renormalizing the kept taps moves them by as much mass as was dropped,
+    // so the L1 distance to the exact Gaussian is twice the truncated mass
+    KernelError error = MeasureKernelError(FullKernel(kernel), sigma);
+    CHECK(std::fabs(error.l1 / 2.0 - kernel.truncatedMass) < 1e-6, "sigma %g l1 %g truncatedMass %g", sigma, error.l1,
+        kernel.truncatedMass);
+    CHECK(capped || error.l1 / 2.0 <= tolerance + 1e-6, "sigma %g tolerance %g l1 %g", sigma, tolerance, error.l1);
+    CHECK(error.maxAbs <= error.l1, "sigma %g", sigma);
+}
+
+void TestTruncation() {
+    for (float tolerance : kTolerances) {
+        for (float sigma : TestSigmas()) {
+            CheckKernel(BuildGaussianKernel(sigma, tolerance, kUncappedTaps), sigma, tolerance, kUncappedTaps);
+            GaussianKernel shaderKernel = BuildGaussianKernel(sigma, tolerance);
+            CheckKernel(shaderKernel, sigma, tolerance, kMaxKernelTaps);
+        }
+    }
+}
+
+void TestTinySigmaIsCopy() {
+    for (float sigma : { 0.0f, 0.001f, 0.1f, 0.2f }) {
+        GaussianKernel kernel = BuildGaussianKernel(sigma, kDefaultKernelTolerance);
+        CHECK(kernel.radius == 0 && kernel.weights[0] == 1.0f, "sigma %g", sigma);
+    }
+}
+
+void TestCache() {
+    for (float sigma : { 0.5f, 3.0f, 47.25f }) {
+        auto first = GetGaussianKernel(sigma);
+        auto second = GetGaussianKernel(sigma);
+        CHECK(first == second, "sigma %g not cached", sigma);
+        GaussianKernel built = BuildGaussianKernel(sigma, kDefaultKernelTolerance);
+        CHECK(first->radius == built.radius && first->weights == built.weights, "sigma %g", sigma);
+        CHECK(GetGaussianKernel(sigma, kDefaultKernelTolerance / 12.92f) != first, "sigma %g", sigma);
+    }
+}
+
+// A linear filter with clamp addressing, as the GPU samples: the fraction
+// between texels is quantized to 8 bits
+double SampleBilinearClamp(const std::vector<double>& row, double position) {
+    double base = std::floor(position);
+    double fraction = std::round((position - base) * 256.0) / 256.0;
+    int last = (int)row.size() - 1;
+    int i0 = std::min(std::max((int)base, 0), last);
+    int i1 = std::min(std::max((int)base + 1, 0), last);
+    return row[i0] * (1.0 - fraction) + row[i1] * fraction;
+}
+
+// The merged (offset, weight) pairs the bilinear shader passes sample give
+// the per-texel kernel's result, edges included
+void TestLinearSampledParity() {
+    std::vector<double> row(600);
+    uint32_t state = 2463534242u;
+    for (double& value : row) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        value = (state % 256) / 255.0;
+    }
+
+    double worst = 0.0;
+    for (float sigma : TestSigmas()) {
+        GaussianKernel kernel = BuildGaussianKernel(sigma, kDefaultKernelTolerance);
+        CHECK(kernel.linearOffsets.size() == (size_t)(kernel.radius + 1) / 2, "sigma %g", sigma);
+        for (int x = 0; x < (int)row.size(); x++) {
+            double perTexel = 0.0;
+            for (int i = -kernel.radius; i <= kernel.radius; i++) {
+                int clamped = std::min(std::max(x + i, 0), (int)row.size() - 1);
+                perTexel += kernel.weights[i < 0 ? -i : i] * row[clamped];
+            }
+            double linear = kernel.weights[0] * row[x];
+            for (size_t k = 0; k < kernel.linearOffsets.size(); k++) {
+                double offset = kernel.linearOffsets[k];
+                linear += kernel.linearWeights[k] *
+                    (SampleBilinearClamp(row, x - offset) + SampleBilinearClamp(row, x + offset));
+            }
+            worst = std::max(worst, std::fabs(linear - perTexel) * 255.0);
+        }
+    }
+    CHECK(worst < 0.5, "linear-sampled kernel is %.3f 8-bit steps off the per-texel one", worst);
+    printf("linear-sampled vs per-texel: worst %.3f 8-bit steps\n", worst);
+}
+
+} // namespace
+
+int main() {
+    TestTruncation();
+    TestTinySigmaIsCopy();
+    TestCache();
+    TestLinearSampledParity();
+    return TestExitCode();
+}
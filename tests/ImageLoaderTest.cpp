@@ -0,0 +1,213 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "BlurResultCache.h"
+#include "ImageLoader.h"
+#include "TestCheck.h"
+
+namespace {
+
+// Stands in for the WIC decoder, with its behaviour picked by file name and
+// its progress visible to the test
+class FakeDecoder {
+public:
+    bool Decode(const std::filesystem::path& path, ImageLoadJob& job, CpuImage& image, std::string* error) {
+        std::string name = path.filename().string();
+        if (name == "proxy") {
+            job.PostProxy(Filled(2, 11), 8, 8);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&] { return m_released; });
+            image = Filled(8, 22);
+            return true;
+        }
+        if (name == "slow") {
+            job.PostProxy(Filled(2, 33), 16, 16);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_started++;
+            }
+            m_cv.notify_all();
+            // Works in slices until superseded, like the banded WIC copy
+            while (!job.Cancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_sawCancel++;
+            }
+            m_cv.notify_all();
+            image = Filled(16, 44); // must never reach Poll
+            return true;
+        }
+        if (name == "fast") {
+            image = Filled(4, 55);
+            return true;
+        }
+        if (name == "oom") throw std::bad_alloc();
+        *error = "broken file";
+        return false;
+    }
+
+    void Release() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_released = true;
+        }
+        m_cv.notify_all();
+    }
+
+    bool WaitStarted(int count) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_for(lock, std::chrono::seconds(10), [&] { return m_started >= count; });
+    }
+
+    bool WaitSawCancel(int count) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_for(lock, std::chrono::seconds(10), [&] { return m_sawCancel >= count; });
+    }
+
+private:
+    static CpuImage Filled(uint32_t side, uint8_t value) {
+        CpuImage image(side, side);
+        for (uint8_t& v : image.pixels) v = value;
+        return image;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_released = false;
+    int m_started = 0;
+    int m_sawCancel = 0;
+};
+
+ImageDecoder MakeDecoder(FakeDecoder& fake) {
+    return [&fake](const std::filesystem::path& path, ImageLoadJob& job, CpuImage& image, std::string* error) {
+        return fake.Decode(path, job, image, error);
+    };
+}
+
+// Polls as the render loop does, once a millisecond, for up to 10 s
+bool PollFor(ImageLoader& loader, ImageLoadResult& result) {
+    for (int i = 0; i < 10000; i++) {
+        if (loader.Poll(result)) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// Nothing more arrives within a while
+bool StaysQuiet(ImageLoader& loader) {
+    ImageLoadResult result;
+    for (int i = 0; i < 50; i++) {
+        if (loader.Poll(result)) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void TestProxyThenFull() {
+    FakeDecoder fake;
+    ImageLoader loader(MakeDecoder(fake));
+    uint64_t request = loader.Load("proxy");
+    CHECK(loader.Busy());
+
+    ImageLoadResult result;
+    CHECK(PollFor(loader, result), "no proxy");
+    CHECK(result.request == request && result.status == ImageLoadStatus::Proxy);
+    CHECK(result.image.width == 2 && result.fullWidth == 8 && result.fullHeight == 8);
+    CHECK(result.contentHash == HashCpuImage(result.image));
+    CHECK(loader.Busy(), "a proxy is not the final result");
+
+    fake.Release();
+    CHECK(PollFor(loader, result), "no full image");
+    CHECK(result.request == request && result.status == ImageLoadStatus::Loaded);
+    CHECK(result.image.width == 8 && result.image.pixels[0] == 22 && result.fullWidth == 8);
+    CHECK(result.path == std::filesystem::path("proxy"));
+    CHECK(!loader.Busy());
+    CHECK(StaysQuiet(loader));
+}
+
+void TestSupersede() {
+    FakeDecoder fake;
+    ImageLoader loader(MakeDecoder(fake));
+    loader.Load("slow");
+    CHECK(fake.WaitStarted(1));
+    // The slow file's proxy is queued but not polled; the newer request drops it
+    uint64_t newer = loader.Load("fast");
+    CHECK(fake.WaitSawCancel(1), "superseded decode was not told to stop");
+
+    ImageLoadResult result;
+    CHECK(PollFor(loader, result), "no result for the newer file");
+    CHECK(result.request == newer && result.status == ImageLoadStatus::Loaded && result.image.pixels[0] == 55,
+        "request %llu status %d", (unsigned long long)result.request, (int)result.status);
+    CHECK(!loader.Busy());
+    CHECK(StaysQuiet(loader), "a superseded result reached Poll");
+
+    // Supersede twice in a row while one decode is still running
+    loader.Load("slow");
+    CHECK(fake.WaitStarted(2));
+    loader.Load("slow");
+    CHECK(fake.WaitSawCancel(2));
+    CHECK(fake.WaitStarted(3));
+    uint64_t last = loader.Load("fast");
+    CHECK(fake.WaitSawCancel(3));
+    CHECK(PollFor(loader, result));
+    CHECK(result.request == last && result.status == ImageLoadStatus::Loaded);
+    CHECK(StaysQuiet(loader));
+}
+
+void TestCancel() {
+    FakeDecoder fake;
+    ImageLoader loader(MakeDecoder(fake));
+    loader.Load("slow");
+    CHECK(fake.WaitStarted(1));
+    loader.CancelAll();
+    CHECK(!loader.Busy());
+    CHECK(fake.WaitSawCancel(1), "cancelled decode was not told to stop");
+    CHECK(StaysQuiet(loader), "a cancelled result reached Poll");
+
+    // The loader still works afterwards, and CancelAll with nothing pending is harmless
+    loader.CancelAll();
+    uint64_t request = loader.Load("fast");
+    ImageLoadResult result;
+    CHECK(PollFor(loader, result));
+    CHECK(result.request == request && result.status == ImageLoadStatus::Loaded);
+}
+
+void TestFailures() {
+    FakeDecoder fake;
+    ImageLoader loader(MakeDecoder(fake));
+    ImageLoadResult result;
+    loader.Load("missing");
+    CHECK(PollFor(loader, result));
+    CHECK(result.status == ImageLoadStatus::Failed && result.error == "broken file" && result.image.Empty());
+    CHECK(!loader.Busy());
+
+    loader.Load("oom");
+    CHECK(PollFor(loader, result));
+    CHECK(result.status == ImageLoadStatus::Failed && result.error == "out of memory");
+}
+
+// Destroying the loader stops a decode in progress
+void TestDestroyWhileDecoding() {
+    FakeDecoder fake;
+    {
+        ImageLoader loader(MakeDecoder(fake));
+        loader.Load("slow");
+        CHECK(fake.WaitStarted(1));
+    }
+    CHECK(fake.WaitSawCancel(1));
+}
+
+} // namespace
+
+int main() {
+    TestProxyThenFull();
+    TestSupersede();
+    TestCancel();
+    TestFailures();
+    TestDestroyWhileDecoding();
+    return TestExitCode();
+}
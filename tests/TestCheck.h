@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+
+// Just enough of a test framework for the CPU tests: a failed CHECK prints
+// where it failed, and main returns TestExitCode() so that ctest sees it.
+
+inline int& TestFailureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void TestContext(const char* format = "", ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+// CHECK(condition) or CHECK(condition, printf-style context)
+#define CHECK(condition, ...)                                                               \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            TestFailureCount()++;                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed. ", __FILE__, __LINE__, #condition);   \
+            TestContext(__VA_ARGS__);                                                       \
+        }                                                                                   \
+    } while (0)
+
+inline int TestExitCode() {
+    int failures = TestFailureCount();
+    if (failures) fprintf(stderr, "%d check(s) failed\n", failures);
+    else printf("all checks passed\n");
+    return failures ? 1 : 0;
+}
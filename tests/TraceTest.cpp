@@ -0,0 +1,185 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TestCheck.h"
+#include "Trace.h"
+
+namespace {
+
+size_t CountNamed(const std::vector<TraceEvent>& events, const char* name) {
+    size_t count = 0;
+    for (const TraceEvent& event : events) count += event.name && !strcmp(event.name, name);
+    return count;
+}
+
+// Whether text is one JSON value: brackets balance outside strings, strings
+// close, and only \" and \\ escapes appear
+bool WellFormedJson(const std::string& text) {
+    std::vector<char> open;
+    bool inString = false;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (inString) {
+            if ((unsigned char)c < 0x20) return false;
+            if (c == '\\') {
+                if (i + 1 == text.size() || (text[i + 1] != '"' && text[i + 1] != '\\')) return false;
+                i++;
+            }
+            else if (c == '"') {
+                inString = false;
+            }
+            continue;
+        }
+        if (c == '"') inString = true;
+        else if (c == '{' || c == '[') open.push_back(c);
+        else if (c == '}' || c == ']') {
+            if (open.empty() || open.back() != (c == '}' ? '{' : '[')) return false;
+            open.pop_back();
+        }
+    }
+    return !inString && open.empty();
+}
+
+// Scoped events from several threads, each on its own thread id, all collected
+void TestThreads() {
+    SetTracingEnabled(true);
+    const int threadCount = 4, eventsPerThread = 100;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([] {
+            TraceSetThreadName("test worker");
+            for (int i = 0; i < eventsPerThread; i++) {
+                TRACE_SCOPE("worker event");
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    {
+        TRACE_SCOPE("main event");
+    }
+
+    std::vector<TraceEvent> events;
+    size_t added = TraceCollect(events);
+    CHECK(added == events.size());
+    CHECK(CountNamed(events, "worker event") == (size_t)threadCount * eventsPerThread, "%zu worker events",
+        CountNamed(events, "worker event"));
+    CHECK(CountNamed(events, "main event") == 1);
+    std::vector<uint32_t> threadIds;
+    for (const TraceEvent& event : events) {
+        CHECK(event.startNs > 0 && !strcmp(event.category, "cpu"));
+        if (strcmp(event.name, "worker event")) continue;
+        bool seen = false;
+        for (uint32_t id : threadIds) seen |= id == event.threadId;
+        if (!seen) threadIds.push_back(event.threadId);
+    }
+    CHECK(threadIds.size() == (size_t)threadCount, "%zu thread ids", threadIds.size());
+
+    // Collected events are gone from the rings
+    std::vector<TraceEvent> again;
+    CHECK(TraceCollect(again) == 0);
+}
+
+// A full ring drops and counts new events, keeping the ones it has
+void TestOverflow() {
+    SetTracingEnabled(true);
+    uint64_t droppedBefore = TraceDroppedEvents();
+    std::thread([] {
+        for (size_t i = 0; i < kTraceRingEvents + 10; i++) {
+            TraceRecord(i < kTraceRingEvents ? "kept" : "overflow", "cpu", i + 1, 1);
+        }
+    }).join();
+    CHECK(TraceDroppedEvents() - droppedBefore == 10, "%llu dropped",
+        (unsigned long long)(TraceDroppedEvents() - droppedBefore));
+    std::vector<TraceEvent> events;
+    TraceCollect(events);
+    CHECK(CountNamed(events, "kept") == kTraceRingEvents && CountNamed(events, "overflow") == 0);
+    bool inOrder = true;
+    for (size_t i = 0; i < events.size(); i++) inOrder &= events[i].startNs == i + 1;
+    CHECK(inOrder, "the first events were overwritten");
+}
+
+// Nothing is recorded while tracing is off, and no ring is allocated for it
+void TestDisabled() {
+    SetTracingEnabled(false);
+    size_t rings = TraceRingCount();
+    std::thread([] {
+        TraceSetThreadName("untraced");
+        TRACE_SCOPE("while disabled");
+        TraceRecord("while disabled", "cpu", 1, 1);
+    }).join();
+    std::vector<TraceEvent> events;
+    CHECK(TraceCollect(events) == 0);
+    CHECK(TraceRingCount() == rings, "%zu rings, %zu before", TraceRingCount(), rings);
+
+    // A scope that starts while disabled stays unrecorded if tracing starts
+    {
+        TRACE_SCOPE("started disabled");
+        SetTracingEnabled(true);
+    }
+    CHECK(TraceCollect(events) == 0);
+}
+
+// Threads that end hand their rings on once their events are collected
+void TestRingReuse() {
+    SetTracingEnabled(true);
+    std::vector<TraceEvent> events;
+    std::thread([] { TRACE_SCOPE("first thread"); }).join();
+    TraceCollect(events);
+    size_t rings = TraceRingCount();
+    for (int i = 0; i < 20; i++) {
+        std::thread([] {
+            TraceSetThreadName("short-lived");
+            TRACE_SCOPE("short-lived");
+        }).join();
+        TraceCollect(events);
+    }
+    CHECK(TraceRingCount() == rings, "%zu rings, %zu before", TraceRingCount(), rings);
+    CHECK(CountNamed(events, "short-lived") == 20);
+}
+
+// The export is one JSON object, with names escaped and thread names as
+// metadata events
+void TestChromeTrace() {
+    SetTracingEnabled(true);
+    std::thread([] {
+        TraceSetThreadName("thread \"quoted\"");
+        TRACE_SCOPE("a \"quoted\" \\ name\n");
+    }).join();
+    TraceRecord("gpu pass", "gpu", 1000, 2000, kGpuTraceThread);
+    std::vector<TraceEvent> events;
+    TraceCollect(events);
+
+    std::string path = (std::filesystem::temp_directory_path() / "rtblur-trace-test.json").string();
+    CHECK(WriteChromeTrace(path, events));
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    file.close();
+    std::filesystem::remove(path);
+    std::string json = contents.str();
+
+    CHECK(WellFormedJson(json), "%s", json.c_str());
+    CHECK(json.find("\"traceEvents\":[") != std::string::npos);
+    CHECK(json.find("\"name\":\"a \\\"quoted\\\" \\\\ name\"") != std::string::npos, "name not escaped");
+    CHECK(json.find("\"args\":{\"name\":\"thread \\\"quoted\\\"\"}") != std::string::npos, "thread name missing");
+    CHECK(json.find("\"args\":{\"name\":\"GPU\"}") != std::string::npos);
+    CHECK(json.find("\"name\":\"gpu pass\",\"cat\":\"gpu\",\"pid\":1,\"tid\":65535,\"ts\":1.000,\"dur\":2.000") !=
+        std::string::npos, "GPU event missing");
+}
+
+} // namespace
+
+int main() {
+    TestThreads();
+    TestOverflow();
+    TestDisabled();
+    TestRingReuse();
+    TestChromeTrace();
+    return TestExitCode();
+}